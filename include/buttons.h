@@ -0,0 +1,242 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "scheduler.h"
+#include "spsc_ring.h"
+#include "telemetry.h"
+
+namespace glove {
+
+    // Buttons on GPIO lines, debounced in time. The interrupt handler only
+    // stores when a line moved; the acquisition task takes the level once the
+    // line has been quiet DEBOUNCE_US and dates the change at the first edge
+    // of the burst, so the events carry when the finger moved, not when the
+    // task noticed. Lines without an interrupt are caught by poll() as well,
+    // a poll period later.
+    //
+    // BUTTON_PRESS, BUTTON_RELEASE   one button
+    // BUTTON_LONG                    one button held LONG_PRESS_US
+    // BUTTON_CHORD                   a press leaving two or more buttons down
+
+    enum BUTTON_EVENT : uint8_t { BUTTON_PRESS=0, BUTTON_RELEASE=1, BUTTON_LONG=2, BUTTON_CHORD=3 };
+
+    struct ButtonEvent{
+        uint32_t      atUs                   { 0 };
+        BUTTON_EVENT  kind                   { BUTTON_PRESS };
+        uint8_t       buttons                { 0 };     // FRAME_BUTTONS the event is about
+        uint8_t       held                   { 0 };     // FRAME_BUTTONS down after it
+    };
+
+    class Buttons{
+
+        public:
+
+            // Indexed like the FRAME_BUTTONS bits: left, middle, right.
+            static const size_t    COUNT          { 3 };
+            static const uint32_t  DEBOUNCE_US    { 5000 },
+                                   LONG_PRESS_US  { 1000000 };
+
+            void        setClock(const Clock* clk)                   noexcept { clock = clk; }
+
+            // Context to hand to the interrupt handler of button 'idx'.
+            void*       line(size_t idx)                             noexcept;
+            static void onEdge(void* line)                           noexcept;
+            void        edge(size_t idx)                             noexcept;
+
+            // Acquisition side: 'levels' are the lines now, FRAME_BUTTONS bits.
+            void        poll(uint32_t nowUs, uint8_t levels)         noexcept;
+            uint8_t     held(void)                             const noexcept { return stable; }
+
+            // Transport side: the oldest event not taken yet.
+            bool        take(ButtonEvent& ev)                        noexcept { return events.pop(ev); }
+            uint32_t    queued(void)                           const noexcept { return eventCount; }
+            uint32_t    dropped(void)                          const noexcept { return events.drops(); }
+
+        private:
+
+            struct Line{
+                Buttons*     owner    { nullptr };
+                size_t       idx      { 0 };
+            };
+
+            const Clock*           clock                { nullptr };
+            Line                   lines[COUNT];
+            std::atomic<uint32_t>  edgeCount[COUNT]     {},
+                                   firstEdgeUs[COUNT]   {},
+                                   lastEdgeUs[COUNT]    {};
+            std::atomic<bool>      armed[COUNT]         { {true}, {true}, {true} };
+
+            uint32_t               seen[COUNT]          {},
+                                   settleFromUs[COUNT]  {},
+                                   quietFromUs[COUNT]   {},
+                                   pressedUs[COUNT]     {};
+            bool                   settling[COUNT]      {};
+            uint8_t                stable               { 0 },
+                                   longSent             { 0 };
+            uint32_t               eventCount           { 0 };
+
+            SpscRing<ButtonEvent, 16> events;
+
+            void        queue(uint32_t atUs, BUTTON_EVENT kind, uint8_t buttons) noexcept;
+    };
+
+    inline void* Buttons::line(size_t idx) noexcept{
+        lines[idx].owner = this;
+        lines[idx].idx   = idx;
+        return &lines[idx];
+    }
+
+    inline void Buttons::onEdge(void* line) noexcept{
+        const Line* ln { static_cast<const Line*>(line) };
+        ln->owner->edge(ln->idx);
+    }
+
+    inline void Buttons::edge(size_t idx) noexcept{
+        const uint32_t now { clock != nullptr ? clock->nowUs() : 0 };
+
+        if(armed[idx].exchange(false, std::memory_order_relaxed))
+            firstEdgeUs[idx].store(now, std::memory_order_relaxed);
+        lastEdgeUs[idx].store(now, std::memory_order_relaxed);
+        edgeCount[idx].fetch_add(1, std::memory_order_release);
+    }
+
+    inline void Buttons::queue(uint32_t atUs, BUTTON_EVENT kind, uint8_t buttons) noexcept{
+        eventCount++;
+        events.push(ButtonEvent{ atUs, kind, buttons, stable });
+    }
+
+    inline void Buttons::poll(uint32_t nowUs, uint8_t levels) noexcept{
+        for(size_t idx{0}; idx<COUNT; idx++){
+            const uint8_t  bit   { static_cast<uint8_t>(1 << idx) };
+            const uint32_t count { edgeCount[idx].load(std::memory_order_acquire) };
+
+            if(count != seen[idx]){
+                seen[idx]        = count;
+                quietFromUs[idx] = lastEdgeUs[idx].load(std::memory_order_relaxed);
+                if(!settling[idx]){
+                    settling[idx]     = true;
+                    settleFromUs[idx] = firstEdgeUs[idx].load(std::memory_order_relaxed);
+                }
+            } else if(!settling[idx] && (levels & bit) != (stable & bit)){
+                settling[idx]     = true;
+                settleFromUs[idx] = quietFromUs[idx] = nowUs;
+            }
+
+            if(!settling[idx] || nowUs - quietFromUs[idx] < DEBOUNCE_US)
+                continue;
+
+            settling[idx] = false;
+            armed[idx].store(true, std::memory_order_relaxed);
+            if((levels & bit) == (stable & bit))
+                continue;                                   // a glitch, back where it was
+
+            stable ^= bit;
+            if(stable & bit){
+                pressedUs[idx] = settleFromUs[idx];
+                longSent      &= static_cast<uint8_t>(~bit);
+                queue(settleFromUs[idx], BUTTON_PRESS, bit);
+                if(stable & (stable - 1))
+                    queue(settleFromUs[idx], BUTTON_CHORD, stable);
+            } else {
+                queue(settleFromUs[idx], BUTTON_RELEASE, bit);
+            }
+        }
+
+        for(size_t idx{0}; idx<COUNT; idx++){
+            const uint8_t bit { static_cast<uint8_t>(1 << idx) };
+            if((stable & bit) && !(longSent & bit) && nowUs - pressedUs[idx] >= LONG_PRESS_US){
+                longSent |= bit;
+                queue(pressedUs[idx] + LONG_PRESS_US, BUTTON_LONG, bit);
+            }
+        }
+    }
+
+    // Button event record, sent on Bluetooth between the binary frames.
+    // Little endian:
+    //
+    // off size
+    //  0   4   magic 'G' 'B' 'T' 'N'
+    //  4   1   version
+    //  5   1   event, see BUTTON_EVENT
+    //  6   1   buttons the event is about, FRAME_BUTTONS bits
+    //  7   1   buttons down after it
+    //  8   4   time of the first edge, device microseconds (frame timestamps clock)
+    // 12   2   CRC-16/CCITT of bytes 0 - 11
+
+    const uint8_t  BUTTON_VERSION    { 1 };
+    const size_t   BUTTON_SIZE       { 14 };
+
+    inline size_t encodeButtonEvent(const ButtonEvent& ev, uint8_t* out) noexcept{
+        memcpy(out, "GBTN", 4);
+        out[4] = BUTTON_VERSION;
+        out[5] = ev.kind;
+        out[6] = ev.buttons;
+        out[7] = ev.held;
+        put32(out + 8, ev.atUs);
+        put16(out + 12, crc16(out, 12));
+        return BUTTON_SIZE;
+    }
+
+    // Incremental reader of the records inside a byte stream, for the host tools.
+    class ButtonEventDecoder{
+
+        public:
+
+            // True when 'byte' completes a record with a good CRC.
+            bool       push(uint8_t byte, ButtonEvent& ev)          noexcept;
+
+        private:
+
+            uint8_t    buffer[BUTTON_SIZE]    {};
+            size_t     fill                   { 0 };
+    };
+
+    inline bool ButtonEventDecoder::push(uint8_t byte, ButtonEvent& ev) noexcept{
+        buffer[fill++] = byte;
+
+        if(fill <= 4 && byte != "GBTN"[fill - 1]){
+            fill = 0;
+            if(byte == 'G')
+                buffer[fill++] = byte;
+            return false;
+        }
+        if(fill == 6 && (buffer[4] == 0 || buffer[4] > BUTTON_VERSION || buffer[5] > BUTTON_CHORD)){
+            fill = 0;
+            return false;
+        }
+        if(fill < BUTTON_SIZE)
+            return false;
+
+        fill = 0;
+        if(get16(buffer + 12) != crc16(buffer, 12))
+            return false;
+
+        ev.kind    = static_cast<BUTTON_EVENT>(buffer[5]);
+        ev.buttons = buffer[6];
+        ev.held    = buffer[7];
+        ev.atUs    = get32(buffer + 8);
+        return true;
+    }
+
+} // End namespace glove
@@ -0,0 +1,272 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "hal.h"
+#include "telemetry.h"
+#include "response_curve.h"
+
+namespace glove {
+
+    // Calibration record, little endian:
+    //
+    // off size
+    //  0   2   magic 'G' 'C'
+    //  2   1   schema version
+    //  3   1   user
+    //  4   2   payload length
+    //  6       payload
+    //          v1: IMU offsets, 3 x (accel x,y,z, gyro x,y,z) int16       36
+    //              finger min, max, t,i,m,r,p uint16                      20
+    //              articulation offsets, arm, forearm, hand x psi,theta,phi float   36
+    //          v2: v1 + curve shape, point count, 8 x (x, y) float         66
+    //          v3: v2 + reference pose, arm, forearm, hand x w,x,y,z float 48
+    //  end 2   CRC-16/CCITT of everything before
+    //
+    // Older records are read and upgraded with the defaults of the missing
+    // fields; newer ones are refused.
+
+    const uint8_t  CALIB_MAGIC0      { 'G' },
+                   CALIB_MAGIC1      { 'C' },
+                   CALIB_VERSION     { 3 },
+                   CALIB_USERS       { 4 };
+
+    const size_t   CALIB_IMUS        { 3 },
+                   CALIB_FINGERS     { 5 },
+                   CALIB_HEADER      { 6 },
+                   CALIB_V1_PAYLOAD  { 92 },
+                   CALIB_V2_PAYLOAD  { CALIB_V1_PAYLOAD + 2 + ResponseCurve::MAX_POINTS * 8 },
+                   CALIB_V3_PAYLOAD  { CALIB_V2_PAYLOAD + CALIB_IMUS * 16 },
+                   CALIB_MAX_SIZE    { CALIB_HEADER + CALIB_V3_PAYLOAD + 2 };
+
+    struct CalibrationProfile{
+        uint8_t      user                                 { 0 };
+        int16_t      imuOffsets[CALIB_IMUS][6]            {};
+        uint16_t     fingerMin[CALIB_FINGERS]             {},    // indexed like Glove::EVENTS
+                     fingerMax[CALIB_FINGERS]             {};
+        float        articulation[CALIB_IMUS][3]          {};
+        CURVE_SHAPE  curveShape                           { LEGACY_LOG };
+        uint8_t      pointCount                           { 0 };
+        SplinePoint  points[ResponseCurve::MAX_POINTS]    {};
+        Quat         reference[CALIB_IMUS]                {};    // identity: no pose calibrated
+    };
+
+    inline uint8_t* putFloat(uint8_t* out, float val) noexcept{
+        uint32_t bits;
+        memcpy(&bits, &val, sizeof(bits));
+        put32(out, bits);
+        return out + 4;
+    }
+
+    inline float getFloat(const uint8_t* in) noexcept{
+        const uint32_t bits { get32(in) };
+        float          val;
+        memcpy(&val, &bits, sizeof(val));
+        return val;
+    }
+
+    inline size_t payloadSize(uint8_t version) noexcept{
+        switch(version){
+            case 1:  return CALIB_V1_PAYLOAD;
+            case 2:  return CALIB_V2_PAYLOAD;
+            case 3:  return CALIB_V3_PAYLOAD;
+            default: return 0;
+        }
+    }
+
+    // Writes the record at 'out' (CALIB_MAX_SIZE bytes) in the given schema
+    // version, older ones being written only by glove_bench to check the
+    // upgrade; returns its size.
+    inline size_t encodeProfile(const CalibrationProfile& prof, uint8_t* out,
+                                uint8_t version=CALIB_VERSION) noexcept{
+        const size_t payload { payloadSize(version) };
+        if(payload == 0)
+            return 0;
+
+        uint8_t* pos { out };
+        *pos++ = CALIB_MAGIC0;
+        *pos++ = CALIB_MAGIC1;
+        *pos++ = version;
+        *pos++ = prof.user;
+        put16(pos, static_cast<uint16_t>(payload));
+        pos += 2;
+
+        for(const auto& imu: prof.imuOffsets)
+            for(int16_t off: imu){
+                put16(pos, static_cast<uint16_t>(off));
+                pos += 2;
+            }
+        for(size_t idx{0}; idx<CALIB_FINGERS; idx++){
+            put16(pos,     prof.fingerMin[idx]);
+            put16(pos + 2, prof.fingerMax[idx]);
+            pos += 4;
+        }
+        for(const auto& joint: prof.articulation)
+            for(float angle: joint)
+                pos = putFloat(pos, angle);
+
+        if(version >= 2){
+            *pos++ = prof.curveShape;
+            *pos++ = prof.pointCount;
+            for(const auto& pt: prof.points){
+                pos = putFloat(pos, pt.x);
+                pos = putFloat(pos, pt.y);
+            }
+        }
+
+        if(version >= 3)
+            for(const auto& ref: prof.reference){
+                pos = putFloat(pos, ref.w);
+                pos = putFloat(pos, ref.x);
+                pos = putFloat(pos, ref.y);
+                pos = putFloat(pos, ref.z);
+            }
+
+        put16(pos, crc16(out, static_cast<size_t>(pos - out)));
+        return static_cast<size_t>(pos - out) + 2;
+    }
+
+    // False on bad magic, length or CRC and on versions newer than this firmware.
+    inline bool decodeProfile(const uint8_t* in, size_t len, CalibrationProfile& prof) noexcept{
+        if(len < CALIB_HEADER + 2 || in[0] != CALIB_MAGIC0 || in[1] != CALIB_MAGIC1)
+            return false;
+
+        const uint8_t version { in[2] };
+        const size_t  payload { payloadSize(version) };
+        if(payload == 0 || get16(in + 4) != payload || len != CALIB_HEADER + payload + 2)
+            return false;
+        if(get16(in + len - 2) != crc16(in, len - 2))
+            return false;
+
+        prof = CalibrationProfile{};
+        prof.user = in[3];
+
+        const uint8_t* pos { in + CALIB_HEADER };
+        for(auto& imu: prof.imuOffsets)
+            for(int16_t& off: imu){
+                off  = static_cast<int16_t>(get16(pos));
+                pos += 2;
+            }
+        for(size_t idx{0}; idx<CALIB_FINGERS; idx++){
+            prof.fingerMin[idx] = get16(pos);
+            prof.fingerMax[idx] = get16(pos + 2);
+            pos += 4;
+        }
+        for(auto& joint: prof.articulation)
+            for(float& angle: joint){
+                angle = getFloat(pos);
+                pos  += 4;
+            }
+
+        // v1 had no response curves: the defaults above are the original formula.
+        if(version >= 2){
+            prof.curveShape = *pos <= SPLINE ? static_cast<CURVE_SHAPE>(*pos) : LEGACY_LOG;
+            pos++;
+            prof.pointCount = *pos <= ResponseCurve::MAX_POINTS ? *pos : 0;
+            pos++;
+            for(auto& pt: prof.points){
+                pt.x = getFloat(pos);
+                pt.y = getFloat(pos + 4);
+                pos += 8;
+            }
+        }
+
+        // Before v3 only the Euler offsets were stored: no reference pose.
+        if(version >= 3)
+            for(auto& ref: prof.reference){
+                ref  = Quat{ getFloat(pos), getFloat(pos + 4), getFloat(pos + 8), getFloat(pos + 12) };
+                pos += 16;
+            }
+
+        return true;
+    }
+
+    // One record per user, plus the index of the user selected at boot.
+    class CalibrationStore{
+
+        public:
+
+            explicit   CalibrationStore(KvStore& kv)                  noexcept : store{kv} {}
+
+            bool       load(uint8_t user, CalibrationProfile& prof)   noexcept;
+            bool       save(const CalibrationProfile& prof)           noexcept;
+            bool       erase(uint8_t user)                            noexcept;
+
+            uint8_t    activeUser(void)                               noexcept;
+            bool       setActiveUser(uint8_t user)                    noexcept;
+
+        private:
+
+            KvStore&   store;
+
+            static void key(uint8_t user, char* name)                 noexcept;
+    };
+
+    inline void CalibrationStore::key(uint8_t user, char* name) noexcept{
+        memcpy(name, "cal", 3);
+        name[3] = static_cast<char>('0' + user);
+        name[4] = '\0';
+    }
+
+    inline bool CalibrationStore::load(uint8_t user, CalibrationProfile& prof) noexcept{
+        if(user >= CALIB_USERS)
+            return false;
+
+        char    name[5];
+        uint8_t record[CALIB_MAX_SIZE];
+        key(user, name);
+
+        const size_t len { store.get(name, record, sizeof(record)) };
+        return len > 0 && decodeProfile(record, len, prof) && prof.user == user;
+    }
+
+    inline bool CalibrationStore::save(const CalibrationProfile& prof) noexcept{
+        if(prof.user >= CALIB_USERS)
+            return false;
+
+        char    name[5];
+        uint8_t record[CALIB_MAX_SIZE];
+        key(prof.user, name);
+
+        const size_t len { encodeProfile(prof, record) };
+        return len > 0 && store.put(name, record, len);
+    }
+
+    inline bool CalibrationStore::erase(uint8_t user) noexcept{
+        if(user >= CALIB_USERS)
+            return false;
+
+        char name[5];
+        key(user, name);
+        return store.erase(name);
+    }
+
+    inline uint8_t CalibrationStore::activeUser(void) noexcept{
+        uint8_t user { 0 };
+        return store.get("user", &user, 1) == 1 && user < CALIB_USERS ? user : 0;
+    }
+
+    inline bool CalibrationStore::setActiveUser(uint8_t user) noexcept{
+        return user < CALIB_USERS && store.put("user", &user, 1);
+    }
+
+} // End namespace glove
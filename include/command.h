@@ -0,0 +1,247 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "telemetry.h"
+
+namespace glove {
+
+    // Host commands, on the serial port and on Bluetooth, framed so they can
+    // share the link with the telemetry. Little endian:
+    //
+    // Request
+    // off size
+    //  0   2   sync 0xC5 0x3A
+    //  2   1   command, see COMMAND
+    //  3   1   tag, echoed in the response
+    //  4   1   payload length, up to CMD_MAX_PAYLOAD
+    //  5   n   payload
+    //  .   2   CRC-16/CCITT of the bytes from offset 2
+    //
+    // Response
+    //  0   2   sync 0xC5 0x3B
+    //  2   1   command
+    //  3   1   tag
+    //  4   1   status, see COMMAND_STATUS
+    //  5   1   payload length
+    //  6   n   payload
+    //  .   2   CRC-16/CCITT of the bytes from offset 2
+    //
+    // Payloads, request -> response:
+    //
+    // CMD_PING             anything                        -> the same
+    // CMD_TIME_SYNC        host time (4)                   -> the same, device us when the request was
+    //                                                         read (4) and when the response left (4), see time_sync.h
+    // CMD_SET_RATE         task (RATE_TASK), period us (4) -> none
+    // CMD_SET_FORMAT       Glove::OUTPUT_FORMAT (1)        -> none
+    // CMD_SET_DELTA        deadband centidegrees (2), finger deadband (1),
+    //                      max stale us (4), keyframe us (4) -> none, limits in delta_stream.h
+    // CMD_SET_SENSITIVITY  percent (1)                     -> none
+    // CMD_SET_BUS_SPEED    Hz (4)                          -> none
+    // CMD_SET_FUSION       FILTER_KIND (1), gain / 1000 (2) -> none, IMU_RAW filter, limits in fusion.h
+    // CMD_CALIBRATE        CALIBRATE_ACTION (1)            -> none
+    // CMD_GET_STATS        none                            -> stats report, see profiler.h
+    // CMD_FLIGHT_DUMP      none                            -> none, the dump follows on the serial port
+    // CMD_READ_CALIB       user (1)                        -> calibration record, see calibration.h
+    // CMD_WRITE_CALIB      calibration record              -> none, the user is in the record
+    // CMD_SELECT_USER      user (1)                        -> none
+    // CMD_GET_IDENTITY     none                            -> identity record, see identity.h
+    // CMD_SET_IDENTITY     identity record                 -> none, the name from the next boot
+    //
+    // A request with a bad CRC gets no response: the host retries on its
+    // timeout. Bytes outside a frame are handed back as they are, for the
+    // single byte requests (FLIGHT_DUMP_REQUEST, STATS_REQUEST).
+
+    const uint8_t  CMD_SYNC0         { 0xC5 },
+                   CMD_SYNC1         { 0x3A },
+                   RSP_SYNC1         { 0x3B };
+
+    const size_t   CMD_MAX_PAYLOAD   { 240 },
+                   CMD_OVERHEAD      { 7 },
+                   RSP_OVERHEAD      { 8 },
+                   RSP_MAX_SIZE      { RSP_OVERHEAD + CMD_MAX_PAYLOAD };
+
+    enum COMMAND : uint8_t {
+        CMD_PING             = 0x01,
+        CMD_TIME_SYNC        = 0x02,
+        CMD_SET_RATE         = 0x10,
+        CMD_SET_FORMAT       = 0x11,
+        CMD_SET_DELTA        = 0x12,
+        CMD_SET_SENSITIVITY  = 0x13,
+        CMD_SET_BUS_SPEED    = 0x14,
+        CMD_SET_FUSION       = 0x15,
+        CMD_CALIBRATE        = 0x20,
+        CMD_GET_STATS        = 0x30,
+        CMD_FLIGHT_DUMP      = 0x31,
+        CMD_READ_CALIB       = 0x40,
+        CMD_WRITE_CALIB      = 0x41,
+        CMD_SELECT_USER      = 0x42,
+        CMD_GET_IDENTITY     = 0x50,
+        CMD_SET_IDENTITY     = 0x51
+    };
+
+    enum COMMAND_STATUS : uint8_t { CMD_OK=0, CMD_UNKNOWN=1, CMD_BAD_ARGS=2, CMD_FAILED=3 };
+
+    // Tasks of CMD_SET_RATE: the firmware schedule applies them, see Glove::takeRate().
+    enum RATE_TASK : uint8_t { RATE_FINGERS=0, RATE_IMUS=1, RATE_OUTPUT=2, RATE_DISPLAY=3, RATE_TASKS=4 };
+
+    // CMD_CALIBRATE: starts a calibration, or confirms its step as the LEFT button does.
+    enum CALIBRATE_ACTION : uint8_t { CALIBRATE_NONE=0, CALIBRATE_FINGERS=1, CALIBRATE_ARM=2, CALIBRATE_CONFIRM=3 };
+
+    struct Command{
+        uint8_t      id                       { 0 },
+                     tag                      { 0 },
+                     status                   { CMD_OK },    // responses only
+                     length                   { 0 };
+        uint8_t      payload[CMD_MAX_PAYLOAD] {};
+    };
+
+    // 'out' takes CMD_OVERHEAD + len bytes.
+    inline size_t encodeCommand(uint8_t id, uint8_t tag, const uint8_t* payload, size_t len, uint8_t* out) noexcept{
+        out[0] = CMD_SYNC0;
+        out[1] = CMD_SYNC1;
+        out[2] = id;
+        out[3] = tag;
+        out[4] = static_cast<uint8_t>(len);
+        if(len > 0)
+            memcpy(out + 5, payload, len);
+        put16(out + 5 + len, crc16(out + 2, 3 + len));
+        return CMD_OVERHEAD + len;
+    }
+
+    // 'out' takes RSP_OVERHEAD + len bytes.
+    inline size_t encodeResponse(const Command& cmd, COMMAND_STATUS status, const uint8_t* payload,
+                                 size_t len, uint8_t* out) noexcept{
+        out[0] = CMD_SYNC0;
+        out[1] = RSP_SYNC1;
+        out[2] = cmd.id;
+        out[3] = cmd.tag;
+        out[4] = status;
+        out[5] = static_cast<uint8_t>(len);
+        if(len > 0)
+            memcpy(out + 6, payload, len);
+        put16(out + 6 + len, crc16(out + 2, 4 + len));
+        return RSP_OVERHEAD + len;
+    }
+
+    // Incremental parser of the requests, or of the responses on the host, in
+    // a byte stream. No allocation, resynchronizes after garbage or a bad CRC.
+    class CommandParser{
+
+        public:
+
+            enum RESULT : uint8_t { PARSE_MORE=0, PARSE_READY=1, PARSE_LOOSE=2 };
+
+            explicit   CommandParser(bool responses = false)        noexcept : sync1{responses ? RSP_SYNC1 : CMD_SYNC1},
+                                                                               header{responses ? 6u : 5u} {}
+
+            // PARSE_READY: command() is complete; PARSE_LOOSE: loose() is a byte outside a frame.
+            RESULT     push(uint8_t byte)                           noexcept;
+            // The next frame already buffered: a bad one may have held several
+            // good ones back. Call it after a result other than PARSE_MORE,
+            // until it gives PARSE_MORE, before pushing again.
+            RESULT     next(void)                                   noexcept;
+            const Command& command(void)                      const noexcept { return cmd; }
+            uint8_t    loose(void)                            const noexcept { return looseByte; }
+
+            uint32_t   frames(void)                           const noexcept { return frameCount; }
+            uint32_t   crcErrors(void)                        const noexcept { return crcCount; }
+            uint32_t   droppedBytes(void)                     const noexcept { return dropCount; }
+
+        private:
+
+            const uint8_t  sync1;
+            const size_t   header;
+            uint8_t        buffer[RSP_MAX_SIZE]   {};
+            size_t         fill                   { 0 };
+            Command        cmd;
+            uint8_t        looseByte              { 0 };
+            uint32_t       frameCount             { 0 },
+                           crcCount               { 0 },
+                           dropCount              { 0 };
+
+            RESULT         parse(void)                              noexcept;
+            void           shift(void)                              noexcept;
+    };
+
+    inline CommandParser::RESULT CommandParser::push(uint8_t byte) noexcept{
+        if(fill == 0 && byte != CMD_SYNC0){
+            looseByte = byte;
+            return PARSE_LOOSE;
+        }
+        buffer[fill++] = byte;
+        return parse();
+    }
+
+    // What's left of a bad frame starts a frame or is dropped.
+    inline CommandParser::RESULT CommandParser::next(void) noexcept{
+        if(fill > 0 && buffer[0] != CMD_SYNC0)
+            shift();
+        return parse();
+    }
+
+    // What's left after a bad frame may hold the start of a good one, or all of it.
+    inline CommandParser::RESULT CommandParser::parse(void) noexcept{
+        while(true){
+            if(fill >= 2 && buffer[1] != sync1){
+                shift();
+                continue;
+            }
+            if(fill >= header && buffer[header - 1] > CMD_MAX_PAYLOAD){
+                shift();
+                continue;
+            }
+            if(fill < header || fill < header + buffer[header - 1] + 2)
+                return PARSE_MORE;
+
+            const size_t len { header + buffer[header - 1] };
+            if(get16(buffer + len) != crc16(buffer + 2, len - 2)){
+                crcCount++;
+                shift();
+                continue;
+            }
+
+            cmd.id     = buffer[2];
+            cmd.tag    = buffer[3];
+            cmd.status = header == 6 ? buffer[4] : static_cast<uint8_t>(CMD_OK);
+            cmd.length = buffer[header - 1];
+            memcpy(cmd.payload, buffer + header, cmd.length);
+
+            fill -= len + 2;
+            memmove(buffer, buffer + len + 2, fill);
+            frameCount++;
+            return PARSE_READY;
+        }
+    }
+
+    // Drops bytes up to the next sync candidate after the first one.
+    inline void CommandParser::shift(void) noexcept{
+        size_t skip { 1 };
+        while(skip < fill && buffer[skip] != CMD_SYNC0)
+            skip++;
+
+        dropCount += skip;
+        fill      -= skip;
+        memmove(buffer, buffer + skip, fill);
+    }
+
+} // End namespace glove
@@ -0,0 +1,83 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace glove {
+
+    // Host test links: a FIFO of up to CAPACITY writes of up to BYTES each,
+    // every one held until its due time. A serial link keeps the order, so an
+    // entry never leaves before the one pushed ahead of it. Times are
+    // microseconds of a wrapping 32 bit clock, compared by their difference.
+    template<size_t CAPACITY, size_t BYTES>
+    class DelayLine{
+
+        public:
+
+            struct Pending{
+                uint32_t   dueUs                  { 0 };
+                size_t     len                    { 0 };
+                uint8_t    data[BYTES]            {};
+            };
+
+            // False if full or 'len' is larger than BYTES.
+            bool       push(uint32_t dueUs, const uint8_t* data, size_t len) noexcept;
+            // The oldest entry if it is due at 'nowUs', else nullptr.
+            const Pending* due(uint32_t nowUs)                const noexcept;
+            void       pop(void)                                    noexcept;
+            size_t     size(void)                             const noexcept { return count; }
+
+        private:
+
+            Pending    items[CAPACITY];
+            size_t     first                      { 0 },
+                       count                      { 0 };
+    };
+
+    // An empty line takes any time as it is: only the entry ahead can hold one back.
+    template<size_t CAPACITY, size_t BYTES>
+    inline bool DelayLine<CAPACITY, BYTES>::push(uint32_t dueUs, const uint8_t* data, size_t len) noexcept{
+        if(count == CAPACITY || len > BYTES)
+            return false;
+
+        const Pending* ahead { count > 0 ? &items[(first + count - 1) % CAPACITY] : nullptr };
+        Pending&       slot  { items[(first + count) % CAPACITY] };
+        slot.dueUs = ahead != nullptr && static_cast<int32_t>(dueUs - ahead->dueUs) < 0 ? ahead->dueUs : dueUs;
+        slot.len   = len;
+        memcpy(slot.data, data, len);
+        count++;
+        return true;
+    }
+
+    template<size_t CAPACITY, size_t BYTES>
+    inline const typename DelayLine<CAPACITY, BYTES>::Pending* DelayLine<CAPACITY, BYTES>::due(uint32_t nowUs) const noexcept{
+        return count > 0 && static_cast<int32_t>(nowUs - items[first].dueUs) >= 0 ? &items[first] : nullptr;
+    }
+
+    template<size_t CAPACITY, size_t BYTES>
+    inline void DelayLine<CAPACITY, BYTES>::pop(void) noexcept{
+        if(count == 0)
+            return;
+        first = (first + 1) % CAPACITY;
+        count--;
+    }
+
+} // End namespace glove
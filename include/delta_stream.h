@@ -0,0 +1,333 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include "telemetry.h"
+
+namespace glove {
+
+    // Adaptive stream: a full frame (telemetry.h) every keyframe period and in
+    // between delta frames, carrying only the channels that moved past their
+    // deadband or weren't sent for maxStale. Nothing goes out while the hand
+    // is still, so the rate can go up without the link following it.
+    //
+    // Delta frame, little endian:
+    //
+    // off size
+    //  0   2   sync 0xA5 0x5A
+    //  2   1   DELTA_VERSION
+    //  3   1   flags, as in the full frame
+    //  4   2   sequence number, shared with the full frames
+    //  6   4   timestamp, device microseconds
+    // 10   2   channels that follow: bits 0-2 arm, forearm, hand; bits 3-7 fingers t,i,m,r,p; bit 8 buttons
+    // 12   .   in that order: quaternions w,x,y,z Q14 signed (8 bytes), fingers (1 byte), buttons (1 byte)
+    //  .   2   CRC-16/CCITT of the bytes from offset 2
+    //
+    // A lost delta leaves the channel behind until its next change, maxStale
+    // or the next keyframe: the sequence numbers tell.
+
+    const uint8_t  DELTA_VERSION     { 0x81 };
+
+    const size_t   DELTA_HEADER      { 12 },
+                   DELTA_CHANNELS    { FRAME_IMUS + FRAME_FINGERS + 1 },
+                   DELTA_MAX_SIZE    { DELTA_HEADER + FRAME_IMUS * 8 + FRAME_FINGERS + 1 + 2 };
+
+    // Limits of what CMD_SET_DELTA accepts.
+    const uint16_t DELTA_MAX_DEADBAND_CDEG   { 2000 };       // 20 degrees
+    const uint8_t  DELTA_MAX_FINGER_DEADBAND { 45 };
+    const uint32_t DELTA_MIN_REFRESH_US      { 10000 },
+                   DELTA_MAX_REFRESH_US      { 60000000 };
+
+    struct DeltaConfig{
+        float      quatDeadbandDeg        { 0.5f };       // rotation from the value sent
+        uint8_t    fingerDeadband         { 1 };          // normalized units, 0 - 90
+        uint32_t   maxStaleUs             { 250000 },
+                   keyframeUs             { 1000000 };
+    };
+
+    class DeltaEncoder{
+
+        public:
+
+                       DeltaEncoder(void)                                    noexcept { configure(DeltaConfig{}); }
+
+            void       configure(const DeltaConfig& conf)                    noexcept;
+            // The next frame goes out full.
+            void       restart(void)                                         noexcept { haveKey = false; }
+
+            // Writes 'sample' to 'out' (DELTA_MAX_SIZE bytes at least) as a full or
+            // a delta frame, with its sequence number; 0 when there's nothing to send.
+            size_t     encode(const TelemetrySample& sample, uint8_t* out)   noexcept;
+
+            uint32_t   keyframes(void)                                 const noexcept { return keyCount; }
+            uint32_t   deltas(void)                                    const noexcept { return deltaCount; }
+            uint32_t   skipped(void)                                   const noexcept { return skipCount; }
+
+        private:
+
+            DeltaConfig     config;
+            float           cosHalfDeadband                  { 1.0f };
+            bool            haveKey                          { false };
+            uint32_t        keyUs                            { 0 },
+                            sentUs[DELTA_CHANNELS]           {};
+            TelemetrySample sent;                                          // as the decoder has it
+            uint32_t        keyCount                         { 0 },
+                            deltaCount                       { 0 },
+                            skipCount                        { 0 };
+
+            uint16_t   changed(const TelemetrySample& sample)          const noexcept;
+            void       remember(const TelemetrySample& sample, uint16_t mask) noexcept;
+    };
+
+    inline void DeltaEncoder::configure(const DeltaConfig& conf) noexcept{
+        config          = conf;
+        cosHalfDeadband = cosf(conf.quatDeadbandDeg * static_cast<float>(M_PI / 360.0));
+        haveKey         = false;
+    }
+
+    // Channels past their deadband or too old.
+    inline uint16_t DeltaEncoder::changed(const TelemetrySample& sample) const noexcept{
+        uint16_t mask { 0 };
+
+        // The quantized quaternion isn't quite unit: the norms go in the test.
+        for(size_t imu{0}; imu<FRAME_IMUS; imu++){
+            float dot   { 0.0f },
+                  norms { 0.0f },
+                  normn { 0.0f };
+            for(size_t comp{0}; comp<4; comp++){
+                dot   += sample.quat[imu][comp] * sent.quat[imu][comp];
+                norms += sent.quat[imu][comp]   * sent.quat[imu][comp];
+                normn += sample.quat[imu][comp] * sample.quat[imu][comp];
+            }
+            if(dot * dot < cosHalfDeadband * cosHalfDeadband * norms * normn)
+                mask |= static_cast<uint16_t>(1 << imu);
+        }
+
+        for(size_t finger{0}; finger<FRAME_FINGERS; finger++)
+            if(abs(sample.fingers[finger] - sent.fingers[finger]) > config.fingerDeadband)
+                mask |= static_cast<uint16_t>(1 << (FRAME_IMUS + finger));
+
+        if(sample.buttons != sent.buttons)
+            mask |= static_cast<uint16_t>(1 << (DELTA_CHANNELS - 1));
+
+        for(size_t chan{0}; chan<DELTA_CHANNELS; chan++)
+            if(sample.timestampUs - sentUs[chan] >= config.maxStaleUs)
+                mask |= static_cast<uint16_t>(1 << chan);
+
+        return mask;
+    }
+
+    // Keeps what the decoder will have: the quaternions quantized.
+    inline void DeltaEncoder::remember(const TelemetrySample& sample, uint16_t mask) noexcept{
+        for(size_t chan{0}; chan<DELTA_CHANNELS; chan++){
+            if(!(mask & (1 << chan)))
+                continue;
+            sentUs[chan] = sample.timestampUs;
+            if(chan < FRAME_IMUS)
+                for(size_t comp{0}; comp<4; comp++)
+                    sent.quat[chan][comp] = quantizeQuat(sample.quat[chan][comp]) / QUAT_SCALE;
+            else if(chan < FRAME_IMUS + FRAME_FINGERS)
+                sent.fingers[chan - FRAME_IMUS] = sample.fingers[chan - FRAME_IMUS];
+            else
+                sent.buttons = sample.buttons;
+        }
+        sent.flags = sample.flags;
+    }
+
+    inline size_t DeltaEncoder::encode(const TelemetrySample& sample, uint8_t* out) noexcept{
+        const uint16_t ALL { static_cast<uint16_t>((1 << DELTA_CHANNELS) - 1) };
+
+        if(!haveKey || sample.timestampUs - keyUs >= config.keyframeUs){
+            haveKey = true;
+            keyUs   = sample.timestampUs;
+            keyCount++;
+            remember(sample, ALL);
+            return encodeFrame(sample, out);
+        }
+
+        const uint16_t mask { changed(sample) };
+        if(mask == 0 && !((sample.flags ^ sent.flags) & FRAME_CALIBRATING)){
+            skipCount++;
+            return 0;
+        }
+
+        out[0] = FRAME_SYNC0;
+        out[1] = FRAME_SYNC1;
+        out[2] = DELTA_VERSION;
+        out[3] = sample.flags;
+        put16(out + 4, sample.seq);
+        put32(out + 6, sample.timestampUs);
+        put16(out + 10, mask);
+
+        uint8_t* pos { out + DELTA_HEADER };
+        for(size_t imu{0}; imu<FRAME_IMUS; imu++)
+            if(mask & (1 << imu))
+                for(size_t comp{0}; comp<4; comp++, pos += 2)
+                    put16(pos, static_cast<uint16_t>(quantizeQuat(sample.quat[imu][comp])));
+        for(size_t finger{0}; finger<FRAME_FINGERS; finger++)
+            if(mask & (1 << (FRAME_IMUS + finger)))
+                *pos++ = sample.fingers[finger];
+        if(mask & (1 << (DELTA_CHANNELS - 1)))
+            *pos++ = sample.buttons;
+
+        put16(pos, crc16(out + 2, static_cast<size_t>(pos - out - 2)));
+        deltaCount++;
+        remember(sample, mask);
+        return static_cast<size_t>(pos - out) + 2;
+    }
+
+    // Bytes of the delta frame with 'mask' channels.
+    inline size_t deltaFrameSize(uint16_t mask) noexcept{
+        size_t len { DELTA_HEADER + 2 };
+        for(size_t chan{0}; chan<DELTA_CHANNELS; chan++)
+            if(mask & (1 << chan))
+                len += chan < FRAME_IMUS ? 8 : 1;
+        return len;
+    }
+
+    // Incremental decoder of a stream of full and delta frames, rebuilding the
+    // whole state; resynchronizes like FrameDecoder. The deltas before the
+    // first full frame are dropped.
+    class DeltaDecoder{
+
+        public:
+
+            // True when 'byte' completes a valid frame: 'sample' is the state after it.
+            bool        push(uint8_t byte, TelemetrySample& sample)  noexcept;
+
+            uint32_t    keyframes(void)                        const noexcept { return keyCount; }
+            uint32_t    deltas(void)                           const noexcept { return deltaCount; }
+            uint32_t    crcErrors(void)                        const noexcept { return crcCount; }
+            uint32_t    droppedBytes(void)                     const noexcept { return dropCount; }
+            uint32_t    lostFrames(void)                       const noexcept { return lostCount; }
+
+        private:
+
+            uint8_t         buffer[DELTA_MAX_SIZE] {};
+            size_t          fill                   { 0 };
+            bool            haveKey                { false },
+                            haveSeq                { false };
+            uint16_t        lastSeq                { 0 };
+            TelemetrySample state;
+            uint32_t        keyCount               { 0 },
+                            deltaCount             { 0 },
+                            crcCount               { 0 },
+                            dropCount              { 0 },
+                            lostCount              { 0 };
+
+            bool        applyDelta(size_t len)               noexcept;
+            void        resync(size_t from)                  noexcept;
+    };
+
+    inline bool DeltaDecoder::push(uint8_t byte, TelemetrySample& sample) noexcept{
+        buffer[fill++] = byte;
+
+        if(fill == 1 && buffer[0] != FRAME_SYNC0){
+            fill = 0;
+            dropCount++;
+            return false;
+        }
+        // What's left after a bad frame may hold the start of a good one, or all of it.
+        size_t len { 0 };
+        while(len == 0){
+            if(fill == 0)
+                return false;
+            if((fill >= 2 && buffer[1] != FRAME_SYNC1) ||
+               (fill >= 3 && buffer[2] != FRAME_VERSION && buffer[2] != DELTA_VERSION)){
+                resync(1);
+                continue;
+            }
+
+            const bool   delta { fill >= 3 && buffer[2] == DELTA_VERSION };
+            if(fill < (delta ? DELTA_HEADER : FRAME_SIZE))
+                return false;
+            if(delta && get16(buffer + 10) >> DELTA_CHANNELS){
+                resync(1);
+                continue;
+            }
+
+            const size_t size  { delta ? deltaFrameSize(get16(buffer + 10)) : FRAME_SIZE };
+            if(fill < size)
+                return false;
+            if(!(delta ? applyDelta(size) : decodeFrame(buffer, state))){
+                crcCount++;
+                resync(1);
+                continue;
+            }
+            len = size;
+        }
+
+        const bool delta { buffer[2] == DELTA_VERSION };
+        fill -= len;
+        memmove(buffer, buffer + len, fill);
+        if(haveSeq)
+            lostCount += static_cast<uint16_t>(state.seq - lastSeq - 1);
+        haveSeq  = true;
+        lastSeq  = state.seq;
+        haveKey |= !delta;
+        if(!haveKey)
+            return false;
+
+        if(delta)
+            deltaCount++;
+        else
+            keyCount++;
+        sample = state;
+        return true;
+    }
+
+    inline bool DeltaDecoder::applyDelta(size_t len) noexcept{
+        if(get16(buffer + len - 2) != crc16(buffer + 2, len - 4))
+            return false;
+
+        const uint16_t mask { get16(buffer + 10) };
+        state.flags       = buffer[3];
+        state.seq         = get16(buffer + 4);
+        state.timestampUs = get32(buffer + 6);
+
+        const uint8_t* pos { buffer + DELTA_HEADER };
+        for(size_t imu{0}; imu<FRAME_IMUS; imu++)
+            if(mask & (1 << imu))
+                for(size_t comp{0}; comp<4; comp++, pos += 2)
+                    state.quat[imu][comp] = static_cast<int16_t>(get16(pos)) / QUAT_SCALE;
+        for(size_t finger{0}; finger<FRAME_FINGERS; finger++)
+            if(mask & (1 << (FRAME_IMUS + finger)))
+                state.fingers[finger] = *pos++;
+        if(mask & (1 << (DELTA_CHANNELS - 1)))
+            state.buttons = *pos;
+        return true;
+    }
+
+    inline void DeltaDecoder::resync(size_t from) noexcept{
+        size_t next { from };
+        while(next < fill && ( buffer[next] != FRAME_SYNC0 ||
+                               ( next + 1 < fill && buffer[next + 1] != FRAME_SYNC1 )))
+            next++;
+
+        dropCount += next;
+        fill      -= next;
+        memmove(buffer, buffer + next, fill);
+    }
+
+} // End namespace glove
@@ -0,0 +1,133 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+namespace glove {
+
+    // Filters for the finger readings, one per channel, 12 bit in and out.
+    //
+    // ADC_FILTER_NONE      the reading as it is
+    // ADC_FILTER_LOWPASS   first order low pass at 'cutoff' Hz
+    // ADC_FILTER_MEDIAN    median of the last 5 readings: spikes go, steps stay sharp
+    // ADC_FILTER_ONE_EURO  low pass opening with the speed, 'cutoff' Hz at rest plus
+    //                      'beta' Hz per count/s (Casiez, Roussel, Vogel: the 1 Euro filter)
+    //
+    // Float, like fusion.h: the ESP32 has a single precision FPU.
+
+    enum ADC_FILTER : uint8_t { ADC_FILTER_NONE=0, ADC_FILTER_LOWPASS=1, ADC_FILTER_MEDIAN=2, ADC_FILTER_ONE_EURO=3 };
+
+    class FingerFilter{
+
+        public:
+
+            static const size_t  MEDIAN_WINDOW { 5 };
+
+            void       configure(ADC_FILTER filterKind, float cutoffHz, float speedGain) noexcept;
+            void       reset(void)                                    noexcept { primed = false; fill = 0; }
+
+            // 'dt' in seconds since the previous reading.
+            uint16_t   update(uint16_t raw, float dt)                 noexcept;
+            uint16_t   value(void)                              const noexcept { return out; }
+            ADC_FILTER filterKind(void)                         const noexcept { return kind; }
+
+        private:
+
+            // Cutoff of the speed estimate of the 1 Euro filter.
+            static constexpr float SPEED_CUTOFF_HZ { 1.0f };
+
+            ADC_FILTER   kind                 { ADC_FILTER_NONE };
+            float        cutoff               { 5.0f },
+                         beta                 { 0.0f };
+            bool         primed               { false };
+            float        level                { 0.0f },
+                         speed                { 0.0f };
+            uint16_t     window[MEDIAN_WINDOW] {};
+            uint8_t      pos                  { 0 },
+                         fill                 { 0 };
+            uint16_t     out                  { 0 };
+
+            static float smoothing(float cutoffHz, float dt)          noexcept;
+            uint16_t     median(uint16_t raw)                         noexcept;
+    };
+
+    inline void FingerFilter::configure(ADC_FILTER filterKind, float cutoffHz, float speedGain) noexcept{
+        kind   = filterKind;
+        cutoff = cutoffHz > 0.0f ? cutoffHz : 1.0f;
+        beta   = speedGain;
+        reset();
+    }
+
+    // Weight of the new reading for a first order low pass at 'cutoffHz'.
+    inline float FingerFilter::smoothing(float cutoffHz, float dt) noexcept{
+        const float tau { 1.0f / (2.0f * static_cast<float>(M_PI) * cutoffHz) };
+        return dt / (dt + tau);
+    }
+
+    inline uint16_t FingerFilter::median(uint16_t raw) noexcept{
+        window[pos] = raw;
+        pos         = static_cast<uint8_t>((pos + 1) % MEDIAN_WINDOW);
+        if(fill < MEDIAN_WINDOW)
+            fill++;
+
+        uint16_t sorted[MEDIAN_WINDOW];
+        for(size_t idx{0}; idx<fill; idx++){
+            const uint16_t val  { window[idx] };
+            size_t         dest { idx };
+            for(; dest > 0 && sorted[dest - 1] > val; dest--)
+                sorted[dest] = sorted[dest - 1];
+            sorted[dest] = val;
+        }
+        return sorted[fill / 2];
+    }
+
+    inline uint16_t FingerFilter::update(uint16_t raw, float dt) noexcept{
+        if(!primed){
+            primed = true;
+            level  = raw;
+            speed  = 0.0f;
+            out    = kind == ADC_FILTER_MEDIAN ? median(raw) : raw;
+            return out;
+        }
+        if(dt <= 0.0f)
+            return out;
+
+        switch(kind){
+            case ADC_FILTER_LOWPASS:
+                level += smoothing(cutoff, dt) * (raw - level);
+                break;
+            case ADC_FILTER_MEDIAN:
+                return out = median(raw);
+            case ADC_FILTER_ONE_EURO: {
+                const float rate { (raw - level) / dt };
+                speed += smoothing(SPEED_CUTOFF_HZ, dt) * (rate - speed);
+                level += smoothing(cutoff + beta * fabsf(speed), dt) * (raw - level);
+                break;
+            }
+            default:
+                return out = raw;
+        }
+
+        out = static_cast<uint16_t>(level + 0.5f);
+        return out;
+    }
+
+} // End namespace glove
@@ -0,0 +1,346 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "hal.h"
+#include "telemetry.h"
+
+// Entries kept in RAM, 36 bytes each: about 1.5 s of IMU_FIFO acquisition.
+#ifndef GLOVE_FLIGHT_ENTRIES
+#define GLOVE_FLIGHT_ENTRIES 1024
+#endif
+
+namespace glove {
+
+    // Flight recorder: the last acquisition steps, kept in RAM and dumped
+    // over the serial port on demand. Little endian:
+    //
+    // Header
+    // off size
+    //  0   4   magic 'G' 'F' 'L' 'R'
+    //  4   1   version
+    //  5   1   entry size
+    //  6   2   entries that follow, oldest first
+    //  8   4   timestamp of the freeze, device microseconds
+    // 12   4   entries recorded since boot, the older ones are lost
+    //
+    // Entry
+    //  0   4   timestamp, device microseconds
+    //  4   1   kind, see FLIGHT_KIND
+    //  5   1   FLIGHT_FINGERS: buttons as in the frames, FLIGHT_IMUS: bit n new packet from IMU n
+    //  6   2   us since the previous entry of the same kind, saturated
+    //  8   2   us spent in the step, saturated
+    // 10   1   I2C errors during the step, saturated
+    // 11   1   I2C bus recoveries during the step, saturated
+    // 12  24   FLIGHT_FINGERS: raw ADC of thumb, index, middle, ring, little, then zero
+    //          FLIGHT_IMUS: quaternions w,x,y,z of arm, forearm, hand, Q14 signed
+    //
+    // Trailer
+    //  0   2   CRC-16/CCITT of the header and the entries
+
+    const uint8_t  FLIGHT_VERSION    { 1 };
+
+    const size_t   FLIGHT_HEADER     { 16 },
+                   FLIGHT_ENTRY      { 36 },
+                   FLIGHT_FINGERS    { 5 },
+                   FLIGHT_IMUS       { 3 },
+                   FLIGHT_ENTRIES    { GLOVE_FLIGHT_ENTRIES };
+
+    // Byte a host sends on the serial port to freeze the recorder and get the dump.
+    const uint8_t  FLIGHT_DUMP_REQUEST { 'D' };
+
+    enum FLIGHT_KIND : uint8_t { FLIGHT_FINGERS_STEP=1, FLIGHT_IMUS_STEP=2 };
+
+    struct FlightEntry{
+        uint32_t   timestampUs                  { 0 };
+        uint8_t    kind                         { FLIGHT_FINGERS_STEP };
+        uint8_t    flags                        { 0 };
+        uint16_t   periodUs                     { 0 },
+                   runUs                        { 0 };
+        uint8_t    busErrors                    { 0 },
+                   busRecoveries                { 0 };
+        uint16_t   adc[FLIGHT_FINGERS]          {};
+        Quat       quat[FLIGHT_IMUS]            {};
+    };
+
+    struct FlightDumpHeader{
+        uint16_t   entries                      { 0 };
+        uint32_t   frozenUs                     { 0 };
+        uint32_t   recorded                     { 0 };
+    };
+
+    inline uint16_t saturate16(uint32_t val) noexcept{
+        return val > 0xFFFF ? 0xFFFF : static_cast<uint16_t>(val);
+    }
+
+    inline uint8_t saturate8(uint32_t val) noexcept{
+        return val > 0xFF ? 0xFF : static_cast<uint8_t>(val);
+    }
+
+    inline void encodeFlightEntry(const FlightEntry& entry, uint8_t* out) noexcept{
+        put32(out, entry.timestampUs);
+        out[4] = entry.kind;
+        out[5] = entry.flags;
+        put16(out + 6, entry.periodUs);
+        put16(out + 8, entry.runUs);
+        out[10] = entry.busErrors;
+        out[11] = entry.busRecoveries;
+
+        uint8_t* pos { out + 12 };
+        if(entry.kind == FLIGHT_IMUS_STEP){
+            for(const auto& q: entry.quat){
+                put16(pos,     static_cast<uint16_t>(quantizeQuat(q.w)));
+                put16(pos + 2, static_cast<uint16_t>(quantizeQuat(q.x)));
+                put16(pos + 4, static_cast<uint16_t>(quantizeQuat(q.y)));
+                put16(pos + 6, static_cast<uint16_t>(quantizeQuat(q.z)));
+                pos += 8;
+            }
+        } else {
+            for(uint16_t val: entry.adc){
+                put16(pos, val);
+                pos += 2;
+            }
+            memset(pos, 0, FLIGHT_ENTRY - static_cast<size_t>(pos - out));
+        }
+    }
+
+    inline void decodeFlightEntry(const uint8_t* in, FlightEntry& entry) noexcept{
+        entry               = FlightEntry{};
+        entry.timestampUs   = get32(in);
+        entry.kind          = in[4];
+        entry.flags         = in[5];
+        entry.periodUs      = get16(in + 6);
+        entry.runUs         = get16(in + 8);
+        entry.busErrors     = in[10];
+        entry.busRecoveries = in[11];
+
+        const uint8_t* pos { in + 12 };
+        if(entry.kind == FLIGHT_IMUS_STEP){
+            for(auto& q: entry.quat){
+                q    = Quat{ static_cast<int16_t>(get16(pos))     / QUAT_SCALE,
+                             static_cast<int16_t>(get16(pos + 2)) / QUAT_SCALE,
+                             static_cast<int16_t>(get16(pos + 4)) / QUAT_SCALE,
+                             static_cast<int16_t>(get16(pos + 6)) / QUAT_SCALE };
+                pos += 8;
+            }
+        } else {
+            for(uint16_t& val: entry.adc){
+                val  = get16(pos);
+                pos += 2;
+            }
+        }
+    }
+
+    inline void encodeFlightHeader(const FlightDumpHeader& hdr, uint8_t* out) noexcept{
+        memcpy(out, "GFLR", 4);
+        out[4] = FLIGHT_VERSION;
+        out[5] = FLIGHT_ENTRY;
+        put16(out + 6, hdr.entries);
+        put32(out + 8, hdr.frozenUs);
+        put32(out + 12, hdr.recorded);
+    }
+
+    // False on bad magic, on versions newer than this code and on another entry size.
+    inline bool decodeFlightHeader(const uint8_t* in, FlightDumpHeader& hdr) noexcept{
+        if(memcmp(in, "GFLR", 4) != 0 || in[4] == 0 || in[4] > FLIGHT_VERSION || in[5] != FLIGHT_ENTRY)
+            return false;
+
+        hdr.entries  = get16(in + 6);
+        hdr.frozenUs = get32(in + 8);
+        hdr.recorded = get32(in + 12);
+        return true;
+    }
+
+    // Written by the acquisition side only; frozen by it or on request from
+    // the transport side, which then dumps it a few entries at a time and
+    // restarts it. While frozen new entries are dropped, the sampling goes on.
+    template<size_t N>
+    class FlightRecorder{
+
+        static_assert(N >= 2 && N <= 0xFFFF && (N & (N - 1)) == 0, "FlightRecorder size must be a power of two, up to 32768");
+
+        public:
+
+            // Acquisition side.
+            void       record(const FlightEntry& entry)               noexcept;
+            void       freeze(uint32_t nowUs)                         noexcept;
+
+            // Any side: the acquisition side freezes at its next record().
+            void       requestFreeze(void)                            noexcept;
+            bool       busy(void)                               const noexcept { return state.load(std::memory_order_acquire) != REC_RUNNING; }
+            bool       frozen(void)                             const noexcept { return state.load(std::memory_order_acquire) == REC_FROZEN; }
+
+            // Transport side: writes at most 'maxEntries' more of the dump of a
+            // frozen recorder and restarts it after the last. False when idle.
+            bool       dump(Transport& out, size_t maxEntries)        noexcept;
+
+        private:
+
+            enum STATE : uint8_t { REC_RUNNING=0, REC_FREEZE_REQUESTED=1, REC_FROZEN=2 };
+
+            std::atomic<uint8_t>   state      { REC_RUNNING };
+            uint8_t                slots[N][FLIGHT_ENTRY] {};
+            uint32_t               recorded   { 0 };      // acquisition side, read once frozen
+            uint32_t               frozenUs   { 0 };
+
+            // Dump in progress, transport side.
+            bool                   dumping    { false };
+            size_t                 dumpFirst  { 0 },
+                                   dumpCount  { 0 },
+                                   dumpPos    { 0 };
+            uint16_t               dumpCrc    { 0 };
+    };
+
+    template<size_t N>
+    void FlightRecorder<N>::record(const FlightEntry& entry) noexcept{
+        const uint8_t current { state.load(std::memory_order_acquire) };
+
+        if(current == REC_FROZEN)
+            return;
+
+        encodeFlightEntry(entry, slots[recorded & (N - 1)]);
+        recorded++;
+
+        if(current == REC_FREEZE_REQUESTED)
+            freeze(entry.timestampUs);
+    }
+
+    template<size_t N>
+    void FlightRecorder<N>::freeze(uint32_t nowUs) noexcept{
+        if(state.load(std::memory_order_relaxed) == REC_FROZEN)
+            return;
+        frozenUs = nowUs;
+        state.store(REC_FROZEN, std::memory_order_release);
+    }
+
+    template<size_t N>
+    void FlightRecorder<N>::requestFreeze(void) noexcept{
+        uint8_t expected { REC_RUNNING };
+        state.compare_exchange_strong(expected, REC_FREEZE_REQUESTED, std::memory_order_acq_rel);
+    }
+
+    template<size_t N>
+    bool FlightRecorder<N>::dump(Transport& out, size_t maxEntries) noexcept{
+        if(state.load(std::memory_order_acquire) != REC_FROZEN)
+            return false;
+
+        if(!dumping){
+            uint8_t          header[FLIGHT_HEADER];
+            FlightDumpHeader hdr;
+
+            dumpCount    = recorded < N ? recorded : N;
+            dumpFirst    = recorded - dumpCount;
+            dumpPos      = 0;
+            hdr.entries  = static_cast<uint16_t>(dumpCount);
+            hdr.frozenUs = frozenUs;
+            hdr.recorded = recorded;
+            encodeFlightHeader(hdr, header);
+            dumpCrc      = crc16(header, sizeof(header));
+            dumping      = true;
+            out.write(header, sizeof(header));
+        }
+
+        for(size_t sent{0}; sent<maxEntries && dumpPos<dumpCount; sent++, dumpPos++){
+            const uint8_t* slot { slots[(dumpFirst + dumpPos) & (N - 1)] };
+            dumpCrc = crc16(slot, FLIGHT_ENTRY, dumpCrc);
+            out.write(slot, FLIGHT_ENTRY);
+        }
+
+        if(dumpPos == dumpCount){
+            uint8_t trailer[2];
+            put16(trailer, dumpCrc);
+            out.write(trailer, sizeof(trailer));
+            dumping = false;
+            state.store(REC_RUNNING, std::memory_order_release);
+        }
+        return true;
+    }
+
+    // Incremental reader of a dump inside a byte stream, for the host tools:
+    // skips whatever precedes the magic.
+    class FlightDumpDecoder{
+
+        public:
+
+            enum RESULT : uint8_t { FLIGHT_NONE=0, FLIGHT_HEADER_READY=1, FLIGHT_ENTRY_READY=2, FLIGHT_DONE=3 };
+
+            // FLIGHT_DONE carries the CRC outcome in crcOk().
+            RESULT     push(uint8_t byte)                             noexcept;
+
+            const FlightDumpHeader& header(void)                const noexcept { return hdr; }
+            const FlightEntry&      entry(void)                 const noexcept { return last; }
+            bool       crcOk(void)                              const noexcept { return goodCrc; }
+
+        private:
+
+            uint8_t           buffer[FLIGHT_ENTRY] {};
+            size_t            fill       { 0 },
+                              left       { 0 };
+            bool              inDump     { false },
+                              goodCrc    { false };
+            uint16_t          crc        { 0 };
+            FlightDumpHeader  hdr;
+            FlightEntry       last;
+    };
+
+    inline FlightDumpDecoder::RESULT FlightDumpDecoder::push(uint8_t byte) noexcept{
+        buffer[fill++] = byte;
+
+        if(!inDump){
+            if(fill <= 4 && byte != "GFLR"[fill - 1]){
+                fill = 0;
+                if(byte == 'G')
+                    buffer[fill++] = byte;
+                return FLIGHT_NONE;
+            }
+            if(fill < FLIGHT_HEADER)
+                return FLIGHT_NONE;
+
+            fill = 0;
+            if(!decodeFlightHeader(buffer, hdr))
+                return FLIGHT_NONE;
+            inDump = true;
+            left   = hdr.entries;
+            crc    = crc16(buffer, FLIGHT_HEADER);
+            return FLIGHT_HEADER_READY;
+        }
+
+        if(left > 0){
+            if(fill < FLIGHT_ENTRY)
+                return FLIGHT_NONE;
+            fill = 0;
+            left--;
+            crc  = crc16(buffer, FLIGHT_ENTRY, crc);
+            decodeFlightEntry(buffer, last);
+            return FLIGHT_ENTRY_READY;
+        }
+
+        if(fill < 2)
+            return FLIGHT_NONE;
+        fill    = 0;
+        inDump  = false;
+        goodCrc = get16(buffer) == crc;
+        return FLIGHT_DONE;
+    }
+
+} // End namespace glove
@@ -0,0 +1,172 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+#include "hal.h"
+
+namespace glove {
+
+    // Accel and gyro fusion for the raw IMU mode, 6 axis: like the DMP, the
+    // heading is only held by the gyro and drifts.
+    //
+    // FILTER_COMPLEMENTARY  gyro integration, tilt pulled towards the
+    //                       gravity seen by the accelerometer (gain: 1/s)
+    // FILTER_MADGWICK       gradient descent step (gain: beta, rad/s)
+    //
+    // Float only: the ESP32 has a single precision FPU, a fixed point
+    // version would be slower there.
+
+    enum FILTER_KIND : uint8_t { FILTER_COMPLEMENTARY=0, FILTER_MADGWICK=1 };
+
+    // CMD_SET_FUSION gains, in thousandths.
+    const uint16_t FUSION_MIN_GAIN_MILLI  { 1 },
+                   FUSION_MAX_GAIN_MILLI  { 10000 };
+
+    // MPU-6050 registers in the ranges set by Imu::setRawMode().
+    const float   RAW_ACCEL_LSB_PER_G    { 8192.0f },    // +-4 g
+                  RAW_GYRO_LSB_PER_DPS   { 16.4f };      // +-2000 dps
+
+    class FusionFilter{
+
+        public:
+
+            void       configure(FILTER_KIND filterKind, float filterGain) noexcept { kind = filterKind; gain = filterGain; }
+            void       reset(const Quat& start=Quat{})                noexcept { q = start; }
+
+            // gyro in rad/s, accel in any unit (only its direction is used), dt in seconds.
+            void       update(const float* gyro, const float* accel, float dt) noexcept;
+            // Same, from the raw registers.
+            void       update(const RawImu& raw, float dt)            noexcept;
+
+            const Quat& quaternion(void)                        const noexcept { return q; }
+            FILTER_KIND filterKind(void)                        const noexcept { return kind; }
+            float      filterGain(void)                         const noexcept { return gain; }
+
+        private:
+
+            FILTER_KIND  kind               { FILTER_MADGWICK };
+            float        gain               { 0.1f };
+            Quat         q;
+
+            void       complementary(float gx, float gy, float gz,
+                                     float ax, float ay, float az, float dt) noexcept;
+            void       madgwick(float gx, float gy, float gz,
+                                float ax, float ay, float az, float dt) noexcept;
+            void       integrate(float qdw, float qdx, float qdy, float qdz, float dt) noexcept;
+    };
+
+    inline void FusionFilter::update(const RawImu& raw, float dt) noexcept{
+        const float toRad { static_cast<float>(M_PI / 180.0) / RAW_GYRO_LSB_PER_DPS };
+        const float gyro[3]  { raw.gyro[0] * toRad, raw.gyro[1] * toRad, raw.gyro[2] * toRad };
+        const float accel[3] { raw.accel[0] / RAW_ACCEL_LSB_PER_G, raw.accel[1] / RAW_ACCEL_LSB_PER_G,
+                               raw.accel[2] / RAW_ACCEL_LSB_PER_G };
+        update(gyro, accel, dt);
+    }
+
+    inline void FusionFilter::update(const float* gyro, const float* accel, float dt) noexcept{
+        if(dt <= 0.0f)
+            return;
+
+        float       ax   { accel[0] },
+                    ay   { accel[1] },
+                    az   { accel[2] };
+        const float norm { sqrtf(ax * ax + ay * ay + az * az) };
+
+        // Free fall or a bad read: gyro only.
+        if(norm > 0.0f){
+            ax /= norm;
+            ay /= norm;
+            az /= norm;
+        }
+
+        if(kind == FILTER_COMPLEMENTARY)
+            complementary(gyro[0], gyro[1], gyro[2], norm > 0.0f ? ax : 0.0f, ay, az, dt);
+        else
+            madgwick(gyro[0], gyro[1], gyro[2], norm > 0.0f ? ax : 0.0f, ay, az, dt);
+    }
+
+    inline void FusionFilter::integrate(float qdw, float qdx, float qdy, float qdz, float dt) noexcept{
+        q.w += qdw * dt;
+        q.x += qdx * dt;
+        q.y += qdy * dt;
+        q.z += qdz * dt;
+
+        const float inv { 1.0f / sqrtf(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z) };
+        q.w *= inv;
+        q.x *= inv;
+        q.y *= inv;
+        q.z *= inv;
+    }
+
+    // The tilt error, gravity measured x gravity estimated, is fed back into
+    // the rates (proportional only, no bias estimation).
+    inline void FusionFilter::complementary(float gx, float gy, float gz,
+                                            float ax, float ay, float az, float dt) noexcept{
+        if(ax != 0.0f || ay != 0.0f || az != 0.0f){
+            const float vx { 2.0f * (q.x * q.z - q.w * q.y) },
+                        vy { 2.0f * (q.w * q.x + q.y * q.z) },
+                        vz { q.w * q.w - q.x * q.x - q.y * q.y + q.z * q.z };
+
+            gx += gain * (ay * vz - az * vy);
+            gy += gain * (az * vx - ax * vz);
+            gz += gain * (ax * vy - ay * vx);
+        }
+
+        integrate(0.5f * (-q.x * gx - q.y * gy - q.z * gz),
+                  0.5f * ( q.w * gx + q.y * gz - q.z * gy),
+                  0.5f * ( q.w * gy - q.x * gz + q.z * gx),
+                  0.5f * ( q.w * gz + q.x * gy - q.y * gx), dt);
+    }
+
+    // Madgwick, "An efficient orientation filter for inertial and
+    // inertial/magnetic sensor arrays", IMU variant.
+    inline void FusionFilter::madgwick(float gx, float gy, float gz,
+                                       float ax, float ay, float az, float dt) noexcept{
+        float qdw { 0.5f * (-q.x * gx - q.y * gy - q.z * gz) },
+              qdx { 0.5f * ( q.w * gx + q.y * gz - q.z * gy) },
+              qdy { 0.5f * ( q.w * gy - q.x * gz + q.z * gx) },
+              qdz { 0.5f * ( q.w * gz + q.x * gy - q.y * gx) };
+
+        if(ax != 0.0f || ay != 0.0f || az != 0.0f){
+            const float w2 { 2.0f * q.w }, x2 { 2.0f * q.x }, y2 { 2.0f * q.y }, z2 { 2.0f * q.z },
+                        w4 { 4.0f * q.w }, x4 { 4.0f * q.x }, y4 { 4.0f * q.y },
+                        x8 { 8.0f * q.x }, y8 { 8.0f * q.y },
+                        ww { q.w * q.w }, xx { q.x * q.x }, yy { q.y * q.y }, zz { q.z * q.z };
+
+            float sw { w4 * yy + y2 * ax + w4 * xx - x2 * ay },
+                  sx { x4 * zz - z2 * ax + 4.0f * ww * q.x - w2 * ay - x4 + x8 * xx + x8 * yy + x4 * az },
+                  sy { 4.0f * ww * q.y + w2 * ax + y4 * zz - z2 * ay - y4 + y8 * xx + y8 * yy + y4 * az },
+                  sz { 4.0f * xx * q.z - x2 * ax + 4.0f * yy * q.z - y2 * ay };
+
+            const float norm { sqrtf(sw * sw + sx * sx + sy * sy + sz * sz) };
+            if(norm > 0.0f){
+                qdw -= gain * sw / norm;
+                qdx -= gain * sx / norm;
+                qdy -= gain * sy / norm;
+                qdz -= gain * sz / norm;
+            }
+        }
+
+        integrate(qdw, qdx, qdy, qdz, dt);
+    }
+
+} // End namespace glove
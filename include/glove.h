@@ -17,99 +17,154 @@
 
 #pragma once
 
-#include <Arduino.h>
-#include <TFT_eSPI.h> 
-#include <SPI.h>
-#include "BluetoothSerial.h"
-#include "I2Cdev.h"
-#include "MPU6050_6Axis_MotionApps612.h"
-
-TFT_eSPI tft{TFT_eSPI()};  
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "hal.h"
+#include "layout.h"
+#include "scheduler.h"
+#include "telemetry.h"
+#include "spsc_ring.h"
+#include "response_curve.h"
+#include "imu_events.h"
+#include "i2c_bus.h"
+#include "calibration.h"
+#include "kinematics.h"
+#include "fusion.h"
+#include "flight_recorder.h"
+#include "profiler.h"
+#include "status_view.h"
+#include "finger_filter.h"
+#include "buttons.h"
+#include "session.h"
+#include "delta_stream.h"
+#include "command.h"
+#include "identity.h"
 
 namespace glove {
 
-    auto stale = [](){ while(true) delay(1000); };
+    // Everything the transport side needs from one acquisition step.
+    struct Snapshot{
+        uint32_t     timestampUs          { 0 };
+        uint8_t      movement             { 0 };     // bit n: new packet from angles[n]
+        Quat         quaternion[GLOVE_IMUS] {},    // as read from the DMPs
+                     joints[GLOVE_IMUS]   {};      // see KinematicChain
+        float        euler[GLOVE_IMUS][3] {};
+        uint16_t     fingers[GLOVE_FINGERS] {};      // indexed by Glove::EVENTS
+        uint8_t      fingerStatus         { 0 };     // one bit per finger, same order
+        uint8_t      buttons              { 0 };     // FRAME_BUTTONS bits
+        bool         calibrating          { false };
+        SessionRecord session;                       // SESSION output only
+        bool         sessionFresh         { false }; // a sensor was read since the previous one
+    };
 
     class Glove{
 
         public:
 
-            Glove(void)                       noexcept;
+            explicit    Glove(const Board& brd)   noexcept;
             void        handleEvents(void)    noexcept;
+            void        acquireFingers(void)  noexcept;
+            void        acquireImus(void)     noexcept;
+            void        refreshFingers(void)  noexcept;
             void        sendMsg(void)         noexcept;
 
-        private:
-            
-            const uint8_t THUMB_PIN          { GPIO_NUM_32 },
-                          INDEX_PIN          { GPIO_NUM_39 }, 
-                          MIDDLE_PIN         { GPIO_NUM_38 },
-                          RING_PIN           { GPIO_NUM_37 },
-                          LITTLE_PIN         { GPIO_NUM_36 };
-
-            const uint8_t BUTTON_LEFT_PIN    { GPIO_NUM_33 },
-                          BUTTON_MIDDLE_PIN  { GPIO_NUM_25 },
-                          BUTTON_RIGHT_PIN   { GPIO_NUM_26 };
-
-            const uint16_t NORM_MAX          { 90 };
-            const uint16_t AVERAGE_ELEMS_NUM { 50 };
-            const uint16_t AVERAGE_CALC_WAIT { 40 };
+            // Dual core pipeline: publish() on the acquisition core queues a
+            // snapshot, drain() on the transport core sends the queued ones.
+            void        publish(void)         noexcept;
+            bool        drain(void)           noexcept;
+
+            // DELTA: full frames now and then, in between only the channels that
+            // moved, see delta_stream.h; the status line isn't sent on Bluetooth.
+            // SESSION: the session stream of session.h, with a tap only.
+            enum OUTPUT_FORMAT : uint8_t      { TEXT=0, BINARY=1, DELTA=2, SESSION=3 };
+            void        setOutputFormat(OUTPUT_FORMAT fmt) noexcept;
+            // The glove was built on tap->board(): publish() takes what the tap
+            // saw, SESSION sends it. Before the tasks start.
+            void        setSessionTap(SessionTap* tap)     noexcept { sessionTap = tap; }
+            void        setDeltaConfig(const DeltaConfig& conf) noexcept { deltaEncoder.configure(conf); }
+            const DeltaEncoder& deltaStats(void)     const noexcept { return deltaEncoder; }
+
+            void        setCurveShape(CURVE_SHAPE shape)   noexcept;
+            bool        setCurvePoints(const SplinePoint* pts, size_t n) noexcept;
+
+            // IMU_IRQ needs the INT lines wired, see layout.h: false if they can't be attached.
+            bool        setImuMode(IMU_MODE mode)          noexcept;
+            IMU_MODE    imuMode(void)                const noexcept { return imuReadMode; }
+            const ImuStats& imuStats(size_t idx)     const noexcept { return angles.stats[idx < GLOVE_IMUS ? idx : 0]; }
+            // Filter used by IMU_RAW, acquisition side: CMD_SET_FUSION changes it while running.
+            void        setFusion(FILTER_KIND kind, float gain) noexcept;
+
+            bool        setBusSpeed(uint32_t hz)           noexcept { return bus.setSpeed(hz); }
+
+            // Fingers converted in the background 'hz' times a second, each reading
+            // the mean of 'oversample' conversions; hz 0 goes back to a read per step.
+            // False, and read per step, if the board can't.
+            bool        setFingerSampling(uint32_t hz, uint16_t oversample) noexcept;
+            bool        fingerSampling(void)         const noexcept { return continuousAdc; }
+            // Filter of every finger channel, see finger_filter.h; from the acquisition core.
+            void        setFingerFilter(ADC_FILTER kind, float cutoffHz, float beta) noexcept;
+            const BusStats& busStats(void)           const noexcept { return bus.stats(); }
+            void        resetBusStats(void)                noexcept { bus.resetStats(); }
+
+            // Profiles are loaded at boot and saved after every calibration;
+            // the curve setters above need an explicit save.
+            bool        saveCalibration(void)              noexcept;
+            // Switches to the profile of 'usr', or stores the current calibration under it.
+            bool        selectUser(uint8_t usr)            noexcept;
+            uint8_t     calibrationUser(void)        const noexcept { return user; }
+            bool        isCalibrating(void)          const noexcept { return calibrating.load(); }
+
+            // Freezes the flight recorder, from either core; drain() then dumps
+            // it on the serial port. The LEFT + RIGHT chord out of calibration and
+            // FLIGHT_DUMP_REQUEST received on the serial port do the same.
+            void        requestFlightDump(void)            noexcept { recorder.requestFreeze(); }
+            bool        flightDumpActive(void)       const noexcept { return recorder.busy(); }
+
+            // Stage timings; STATS_REQUEST received on either transport gets
+            // a report back on it, see profiler.h.
+            Profiler&   profiler(void)                     noexcept { return profile; }
+
+            // Task periods asked with CMD_SET_RATE (command.h), for the loop
+            // running the task: true once per request.
+            bool        takeRate(RATE_TASK task, uint32_t& periodUs) noexcept;
+            const DeviceIdentity& identity(void) const noexcept { return ident; }
+            uint32_t    commandErrors(void)          const noexcept { return consoleCommands.crcErrors() + linkCommands.crcErrors(); }
+
+            // Press, release, long press and chord events, debounced and timed
+            // at the first edge, go out on Bluetooth in binary mode, see buttons.h.
+            const Buttons& buttonStats(void)         const noexcept { return buttons; }
 
-            const uint16_t SERIAL_SPEED      { 9600 };
-            const uint8_t  TCAADDR           { 0x70 };
-            const int      I2C_BUS_SPEED     { 100000 };
+        private:
 
-            const int      SDA_PIN           { 21 },
-                           SCL_PIN           { 22 };
+            Board          board;
+            I2cBus         bus               { board.mux, board.clock };
 
-            const float    DEGREE_CONV_FCTR  { 180.0 / PI };
+            static const uint16_t NORM_MAX   { 90 };
+            const uint16_t AVERAGE_ELEMS_NUM { 50 };
+            const uint16_t AVERAGE_CALC_WAIT { 40 };
 
-            const char* const SSID           { "GLOVE_ESP" };
+            const float    DEGREE_CONV_FCTR  { static_cast<float>(180.0 / M_PI) };
 
             enum EULER_IDX : size_t          { PSI=0, THETA=1, PHI=2 };
 
-            uint16_t indexMin                { 100 }, 
-                     indexMax                { 4095 },
-                     littleMin               { 100 },
-                     littleMax               { 4095 },
-                     ringMin                 { 100 },
-                     ringMax                 { 4095 },
-                     middleMin               { 100 },
-                     middleMax               { 4095 },
-                     thumbMin                { 1   },
-                     thumbMax                { 4095 },
-                     buttonLeftOn            { 4095 },
-                     buttonRightOn           { 4095 },
-                     buttonMiddleOn          { 4095 },
-                     indexCurrent            { 0 },
-                     littleCurrent           { 0 },
-                     ringCurrent             { 0 },
-                     middleCurrent           { 0 },
-                     thumbCurrent            { 0 },
-                     sensitivity             { 20 }, 
-                     indexNorm               { 0 },
-                     littleNorm              { 0 },
-                     ringNorm                { 0 },
-                     middleNorm              { 0 },
-                     thumbNorm               { 0 };
+            const uint16_t FINGER_MAX        { 4095 };
+
+            // One entry per GLOVE_TOPOLOGY finger, indexed by EVENTS.
+            uint16_t fingerMin[GLOVE_FINGERS]     {},      // from GLOVE_TOPOLOGY, then calibrated
+                     fingerMax[GLOVE_FINGERS]     {},
+                     fingerCurrent[GLOVE_FINGERS] {},      // filtered readings
+                     fingerNorm[GLOVE_FINGERS]    {},      // 0..NORM_MAX
+                     sensitivity                  { 20 };
+            bool     fingerOn[GLOVE_FINGERS]      {};
 
             bool    buttonLeft               { false },
                     buttonMiddle             { false },
-                    buttonRight              { false },
-                    indexStatus              { false },
-                    middleStatus             { false },
-                    ringStatus               { false },
-                    littleStatus             { false },
-                    thumbStatus              { false };
-
-            float   offsetX_ArmAngle         { 0.0 }, 
-                    offsetY_ArmAngle         { 0.0 }, 
-                    offsetZ_ArmAngle         { 0.0 },
-                    offsetX_ForearmAngle     { 0.0 }, 
-                    offsetY_ForearmAngle     { 0.0 }, 
-                    offsetZ_ForearmAngle     { 0.0 },
-                    offsetX_HandAngle        { 0.0 }, 
-                    offsetY_HandAngle        { 0.0 }, 
-                    offsetZ_HandAngle        { 0.0 };
+                    buttonRight              { false };
+
+            float   articulation[GLOVE_IMUS][3] {};        // mean Euler angles of the pose, EULER_IDX
 
             enum    EVENTS : uint8_t {
                 THUMB         = 0,
@@ -122,311 +177,750 @@ namespace glove {
                 BUTTON_RIGHT  = 7
             };
 
-            byte         xcolon              { 0 };
+            uint8_t      xcolon              { 0 };
             bool         initial             { true };
             unsigned int colour              { 0 };
 
-            BluetoothSerial bluetoothLink;
             char            statusForBt[9]   {};
 
-            uint8_t      errCode             { 0U };
-            MPU6050      mpu;
+            SpscRing<Snapshot, 8> snapshots;
+            Snapshot        current;                       // owned by the transport side
+            std::atomic<bool> calibrating    { false };
 
-            enum ACCEL_ADDRS : uint8_t       { HAND=0x0, FOREARM=0x6, ARM=0x7 };
+            OUTPUT_FORMAT   outputFormat     { BINARY };
+            SessionTap*     sessionTap       { nullptr };
+            bool            sessionHeaderDue { false };    // transport side
+            uint16_t        frameSeq         { 0 };
+            uint8_t         frame[DELTA_MAX_SIZE] {};
+            DeltaEncoder    deltaEncoder;                  // transport side
 
+            uint8_t      errCode             { 0U };
+
+            ResponseCurve  curves[GLOVE_FINGERS];          // indexed by EVENTS
+            FingerFilter   fingerFilters[GLOVE_FINGERS];   // indexed by EVENTS
+            uint16_t       fingerRaw[GLOVE_FINGERS] {};    // last unfiltered readings
+            static constexpr PinList<GLOVE_FINGERS> FINGER_PINS { fingerPins(GLOVE_TOPOLOGY) };
+            bool           continuousAdc     { false };
+            uint32_t       fingerSampleUs    { 0 };
+            CURVE_SHAPE    curveShape        { LEGACY_LOG };
+            SplinePoint    curvePoints[ResponseCurve::MAX_POINTS] {};
+            uint8_t        curvePointCount   { 0 };
+
+            CalibrationStore calibration     { board.store };
+            uint8_t        user              { 0 };
+
+            IMU_MODE       imuReadMode       { IMU_POLL };
+            uint32_t       imuPass           { 0 };
+            ImuEvents      imuEvents;
+
+            // One array per field, in GLOVE_TOPOLOGY order: the snapshot, the
+            // flight recorder and the chain take a field of every IMU in a row.
+            // Mux channels and INT lines are read from the table itself.
             struct Angles{
-                ACCEL_ADDRS  device;
-                bool         movement        {false};
-        
-                uint8_t      fifo_buffer[64] {} ; 
-                Quaternion   quaternion      {};
-                float        euler[3]        {};
+                bool         movement[GLOVE_IMUS]        {};
+                Quat         quaternion[GLOVE_IMUS]      {};
+                float        euler[GLOVE_IMUS][3]        {};
+                int16_t      offsets[GLOVE_IMUS][6]      {};   // accel and gyro, see Imu::getOffsets()
+                ImuStats     stats[GLOVE_IMUS];
+                FusionFilter filter[GLOVE_IMUS];               // IMU_RAW only
+                uint32_t     lastRawUs[GLOVE_IMUS]       {};
             };
 
-            Angles    angles[3];
-            enum COMPONENT : size_t   { ARMIDX=0, FOREARMIDX=1, HANDIDX=2 };
-
-            void           calibrateFingers(void)               noexcept;
-            void           calibrateArticulations(void)         noexcept;
-            void           setIndex(bool onOff)                 noexcept;
-            void           setMiddle(bool onOff)                noexcept;
-            void           setRing(bool onOff)                  noexcept;
-            void           setLittle(bool onOff)                noexcept;
-            void           setThumb(bool onOff)                 noexcept;
+            Angles    angles;
+
+            void           stale(void)                          noexcept;
+            void           delay(uint32_t ms)                   noexcept;
+
+            // Calibration runs as a state machine stepped by acquireFingers():
+            // the acquisition and the output go on meanwhile.
+            enum CALIB_STATE : uint8_t {
+                CAL_IDLE             = 0,
+                CAL_RELAX            = 1,     // fingers relaxed, waiting for LEFT
+                CAL_MIN_OK           = 2,
+                CAL_CONTRACT         = 3,     // fingers contracted, waiting for LEFT
+                CAL_MAX_OK           = 4,
+                CAL_FINGERS_OK       = 5,
+                CAL_POSE             = 6,     // arm horizontal, waiting for LEFT
+                CAL_SAMPLING         = 7,     // averaging the IMU angles
+                CAL_ACCEL_OK         = 8,
+                CAL_ARTICULATIONS_OK = 9
+            };
 
+            const uint32_t CONFIRM_HOLDOFF_MS { 1000 };
+            const uint32_t MESSAGE_MS        { 2000 };
+
+            CALIB_STATE    calibState        { CAL_IDLE };
+            // Text for the display task, the only one drawing on the TFT: the
+            // newest message, "" to clear the line, nullptr once drawn.
+            std::atomic<const char*> calibMessage { nullptr };
+            uint32_t       calibSinceUs      { 0 };
+            uint16_t       calibSamples      { 0 };
+            double         calibSums[GLOVE_IMUS][3] {};
+            Quat           calibQuatSums[GLOVE_IMUS] {};
+
+            KinematicChain chain;
+
+            // Entries written per drain(): about what 115200 baud carries in an output period.
+            const size_t   FLIGHT_DUMP_CHUNK { 3 };
+
+            FlightRecorder<FLIGHT_ENTRIES> recorder;
+            uint32_t       fingersStepUs     { 0 },
+                           imusStepUs        { 0 };
+            bool           dumpChord         { false };
+
+            void           recordStep(FlightEntry& entry, uint32_t startUs, uint32_t& lastUs,
+                                      uint32_t errors, uint32_t recoveries) noexcept;
+
+            Buttons        buttons;                        // polled by readStatus()
+
+            Profiler       profile;
+            StatusView     status            { board.display };   // transport side
+            bool           statsForConsole   { false },
+                           statsForLink      { false };
+            uint32_t       statsSinceUs      { 0 };
+
+            // Requests and responses of command.h, on the transport side; what
+            // belongs to the acquisition side waits in the atomics below.
+            const uint32_t MIN_PERIOD_US     { 250 },
+                           MAX_PERIOD_US     { 10000000 };
+
+            CommandParser  consoleCommands,
+                           linkCommands;
+            DeviceIdentity ident;
+            std::atomic<uint32_t> rateRequests[RATE_TASKS] {};
+            std::atomic<uint32_t> busSpeedRequest { 0 };
+            std::atomic<int16_t>  sensitivityRequest { -1 },
+                                  userRequest     { -1 };
+            std::atomic<uint8_t>  calibRequest    { CALIBRATE_NONE };
+            std::atomic<int32_t>  fusionRequest   { -1 };       // kind << 16 | gain / 1000
+            bool           hostConfirm       { false };
+
+            void           readCommands(Transport& from, CommandParser& parser,
+                                        bool& statsWanted)      noexcept;
+            void           execute(const Command& cmd, Transport& from) noexcept;
+            void           applyRequests(void)                  noexcept;
+            size_t         encodeStats(uint8_t* out)            noexcept;
+            void           sendStats(void)                      noexcept;
+            void           sendButtonEvents(void)               noexcept;
+
+            void           advanceCalibration(void)             noexcept;
+            void           enterCalibration(CALIB_STATE state,
+                                            const char* msg)    noexcept;
+            void           finishCalibration(void)              noexcept;
+            bool           calibrationElapsed(uint32_t ms) const noexcept;
+            bool           confirmed(void)                const noexcept;   // LEFT or CALIBRATE_CONFIRM
+            void           showCalibrationMessage(void)         noexcept;   // display task
+            void           accumulateMeans(void)                noexcept;
+            void           storeMeans(void)                     noexcept;
             void           setMin(void)                         noexcept;
-            void           setIndexMin(void)                    noexcept;
-            void           setMiddleMin(void)                   noexcept;
-            void           setRingMin(void)                     noexcept;
-            void           setLittleMin(void)                   noexcept;
-            void           setThumbMin(void)                    noexcept;
-
             void           setMax(void)                         noexcept;
-            void           setIndexMax(void)                    noexcept;
-            void           setMiddleMax(void)                   noexcept;
-            void           setRingMax(void)                     noexcept;
-            void           setLittleMax(void)                   noexcept;
-            void           setThumbMax(void)                    noexcept;
 
-            bool           checkRightButton(void)         const noexcept;
-            bool           checkLeftButton(void)          const noexcept;
-            bool           checkMiddleButton(void)        const noexcept;
-
-            void           waitConfirm(void)              const noexcept;
-
-            void           refreshFingers(void)                 noexcept;
             void           readStatus(void)                     noexcept;
+            void           sampleFingers(void)                  noexcept;
             void           printDebugStatus(void)         const noexcept;
             void           printDebugStatusNolimit(void)  const noexcept;
+            void           updateCurves(void)                   noexcept;
             uint16_t       normalizeStatus(uint16_t inf, 
                                            uint16_t sup, 
                                            uint16_t curr) const noexcept;   
-            void           updateStatusForBt(void)              noexcept;
-            void           selectAccel(uint8_t addr)            noexcept;
+            void           updateStatusForBt(const Snapshot& snap) noexcept;
+            void           takeSnapshot(Snapshot& snap)   const noexcept;
+            void           transmit(const Snapshot& snap)       noexcept;
+            void           sendText(const Snapshot& snap)       noexcept;
+            void           sendFrame(const Snapshot& snap)      noexcept;
+            void           sendSession(const Snapshot& snap)    noexcept;
+            void           readAccel(size_t idx)                noexcept;
+            bool           readPacket(size_t idx)               noexcept;
+            bool           readRaw(size_t idx)                  noexcept;
+            bool           switchRawMode(bool raw)              noexcept;
+            bool           switchRawMode(size_t idx, bool raw)  noexcept;
+            bool           selectAccel(uint8_t addr)            noexcept;
             void           printPortStats(bool block)           noexcept;
-            void           calculateMeans(void)                 noexcept;
+            void           fillProfile(CalibrationProfile& prof) const noexcept;
+            void           applyProfile(const CalibrationProfile& prof) noexcept;
+
+            // Host benchmark, src/host/glove_bench.cpp, times the private stages.
+            friend class   GloveBench;
     };
 
-    Glove::Glove(void) noexcept
+    // The frames, the flight recorder and the stored profiles have room for
+    // this glove: another topology needs new versions of those formats.
+    static_assert(GLOVE_IMUS == FRAME_IMUS && GLOVE_IMUS == FLIGHT_IMUS && GLOVE_IMUS == CALIB_IMUS,
+                  "GLOVE_TOPOLOGY: IMU count differs from the stored formats");
+    static_assert(GLOVE_FINGERS == FRAME_FINGERS && GLOVE_FINGERS == CALIB_FINGERS,
+                  "GLOVE_TOPOLOGY: finger count differs from the stored formats");
+
+    Glove::Glove(const Board& brd) noexcept
+        : board{brd}
     {
-        pinMode(INDEX_PIN,         INPUT);
-        pinMode(THUMB_PIN,         INPUT);
-        pinMode(MIDDLE_PIN,        INPUT);
-        pinMode(RING_PIN,          INPUT);
-        pinMode(LITTLE_PIN,        INPUT);
-        pinMode(BUTTON_LEFT_PIN,   INPUT_PULLDOWN);
-        pinMode(BUTTON_MIDDLE_PIN, INPUT_PULLDOWN);
-        pinMode(BUTTON_RIGHT_PIN,  INPUT_PULLDOWN);
+        static_assert(LITTLE + 1 == GLOVE_FINGERS, "EVENTS: one entry per GLOVE_TOPOLOGY finger");
+        static_assert(Buttons::COUNT == GLOVE_BUTTONS, "Buttons: one line per GLOVE_TOPOLOGY button");
 
-        Serial.begin(SERIAL_SPEED);
+        for(size_t idx{0}; idx<GLOVE_FINGERS; idx++){
+            board.adc.configure(GLOVE_TOPOLOGY.fingers[idx].adcPin, false);
+            fingerMin[idx] = GLOVE_TOPOLOGY.fingers[idx].restMin;
+            fingerMax[idx] = FINGER_MAX;
+        }
+        for(uint8_t pin: GLOVE_TOPOLOGY.buttonPins)
+            board.adc.configure(pin, true);
 
-        tft.init();
-        tft.setRotation(1);
-        tft.fillScreen(TFT_BLACK);
-        tft.setTextColor(TFT_YELLOW, TFT_BLACK); // Note: the new fonts do not draw the background colour
+        imuEvents.setClock(&board.clock);
 
-        bluetoothLink.begin(SSID);
+        // Without the interrupt a button is seen at the next poll, later but debounced all the same.
+        buttons.setClock(&board.clock);
+        for(size_t idx{0}; idx<Buttons::COUNT; idx++)
+            board.irq.attach(GLOVE_TOPOLOGY.buttonPins[idx], Buttons::onEdge, buttons.line(idx), IRQ_CHANGE);
 
-        angles[HANDIDX].device    = HAND;
-        angles[FOREARMIDX].device = FOREARM;
-        angles[ARMIDX].device     = ARM;
+        ident = loadIdentity(board.store);
 
-        Wire.begin(SDA_PIN, SCL_PIN ); 
-        Wire.setClock(I2C_BUS_SPEED);
+        // A stored profile saves the IMU self calibration, most of the boot time.
+        CalibrationProfile profile;
+        user = calibration.activeUser();
+        const bool stored { calibration.load(user, profile) };
+        if(stored)
+            for(size_t idx{0}; idx<GLOVE_IMUS; idx++)
+                memcpy(angles.offsets[idx], profile.imuOffsets[idx], sizeof(angles.offsets[idx]));
 
-        for (const auto& angle: angles){
+        for(size_t idx{0}; idx<GLOVE_IMUS; idx++){
 
-            selectAccel(angle.device);
+            selectAccel(GLOVE_TOPOLOGY.imus[idx].muxChannel);
 
-            Serial.println("");
-            mpu.initialize();
-            errCode = mpu.dmpInitialize();
+            board.console.print("\r\n");
+            errCode = board.imu.initialize();
             switch(errCode){
                 case 0U:
-                  Serial.println("MPU6050 config: OK.");
-                  if( ! mpu.testConnection()){
-                    Serial.println("Error: MPU6050 connection.");
+                  board.console.print("MPU6050 config: OK.\r\n");
+                  if( ! board.imu.testConnection()){
+                    board.console.print("Error: MPU6050 connection.\r\n");
                     stale();
                   }
                   break;
                 case 1U:
-                  Serial.println("Error: Memory Init Load.");
+                  board.console.print("Error: Memory Init Load.\r\n");
                   stale();
                   break;
                 case 2U:
-                  Serial.println("Error: DMP update.");
+                  board.console.print("Error: DMP update.\r\n");
                   stale();
                   break;
                 default:
-                  Serial.print("Error: unknown code :");
-                  Serial.println(errCode);
+                  board.console.printf("Error: unknown code :%u\r\n", errCode);
                   stale();
             }
 
-            mpu.setXGyroOffset(0);
-            mpu.setYGyroOffset(0);
-            mpu.setZGyroOffset(0);
-            mpu.setXAccelOffset(0);
-            mpu.setYAccelOffset(0);
-            mpu.setZAccelOffset(0);
+            if(stored){
+                board.imu.setOffsets(angles.offsets[idx]);
+            } else {
+                board.imu.calibrate(6);
+                board.imu.getOffsets(angles.offsets[idx]);
+            }
 
-            mpu.CalibrateAccel(6);
-            mpu.CalibrateGyro(6);
-    
-            mpu.setDMPEnabled(true);
+            board.console.print("\r\n");
+        }
 
-            Serial.println("");
+        if(stored){
+            applyProfile(profile);
+            board.console.printf("Calibration: profile %u loaded.\r\n", user);
+        } else {
+            updateCurves();
+            if(!saveCalibration())
+                board.console.print("Error: calibration not saved.\r\n");
+            board.console.printf("Calibration: new profile %u.\r\n", user);
         }
     }
 
-    void  Glove::setIndex(bool onOff)  noexcept {
-        indexStatus = onOff;
+    void  Glove::fillProfile(CalibrationProfile& prof) const noexcept{
+        prof      = CalibrationProfile{};
+        prof.user = user;
+
+        for(size_t idx{0}; idx<GLOVE_IMUS; idx++)
+            memcpy(prof.imuOffsets[idx], angles.offsets[idx], sizeof(prof.imuOffsets[idx]));
+
+        memcpy(prof.fingerMin,    fingerMin,    sizeof(prof.fingerMin));
+        memcpy(prof.fingerMax,    fingerMax,    sizeof(prof.fingerMax));
+        memcpy(prof.articulation, articulation, sizeof(prof.articulation));
+
+        for(size_t idx{0}; idx<GLOVE_IMUS; idx++)
+            prof.reference[idx] = chain.reference(idx);
+
+        prof.curveShape = curveShape;
+        prof.pointCount = curvePointCount;
+        memcpy(prof.points, curvePoints, sizeof(prof.points));
+    }
+
+    // Fingers, articulations and curves; the IMU offsets are applied at initialization.
+    void  Glove::applyProfile(const CalibrationProfile& prof) noexcept{
+        memcpy(fingerMin,    prof.fingerMin,    sizeof(fingerMin));
+        memcpy(fingerMax,    prof.fingerMax,    sizeof(fingerMax));
+        memcpy(articulation, prof.articulation, sizeof(articulation));
+        chain.setReference(prof.reference);
+
+        // Points a curve refuses, or a spline without points, leave the default
+        // shape: the curves may hold half of them, or the ones of another user.
+        const bool points { prof.pointCount >= 2 && setCurvePoints(prof.points, prof.pointCount) },
+                   broken { prof.pointCount >= 2 ? !points : prof.curveShape == SPLINE };
+        if(!points)
+            curvePointCount = 0;
+        curveShape = broken ? LEGACY_LOG : prof.curveShape;
+        updateCurves();
+    }
+
+    bool  Glove::saveCalibration(void) noexcept{
+        CalibrationProfile prof;
+        fillProfile(prof);
+        return calibration.save(prof) && calibration.setActiveUser(user);
     }
-    void  Glove::setMiddle(bool onOff) noexcept {
-        middleStatus = onOff;
+
+    bool  Glove::selectUser(uint8_t usr) noexcept{
+        if(usr >= CALIB_USERS)
+            return false;
+
+        CalibrationProfile prof;
+        user = usr;
+        if(!calibration.load(usr, prof))
+            return saveCalibration();
+
+        for(size_t idx{0}; idx<GLOVE_IMUS; idx++){
+            memcpy(angles.offsets[idx], prof.imuOffsets[idx], sizeof(angles.offsets[idx]));
+            if(selectAccel(GLOVE_TOPOLOGY.imus[idx].muxChannel))
+                board.imu.setOffsets(angles.offsets[idx]);
+        }
+        applyProfile(prof);
+        return calibration.setActiveUser(usr);
+    }
+
+    void  Glove::updateCurves(void) noexcept{
+        for(size_t idx{0}; idx<GLOVE_FINGERS; idx++)
+            curves[idx].configure(curveShape, fingerMin[idx], fingerMax[idx], NORM_MAX);
     }
-    void  Glove::setRing(bool onOff)   noexcept {
-        ringStatus = onOff;
+
+    void  Glove::setCurveShape(CURVE_SHAPE shape) noexcept{
+        curveShape = shape;
+        updateCurves();
     }
-    void  Glove::setLittle(bool onOff)   noexcept {
-        littleStatus = onOff;
+
+    bool  Glove::setCurvePoints(const SplinePoint* pts, size_t n) noexcept{
+        for(auto& curve: curves)
+            if(!curve.setSplinePoints(pts, n))
+                return false;
+        memmove(curvePoints, pts, n * sizeof(SplinePoint));
+        curvePointCount = static_cast<uint8_t>(n);
+        curveShape      = SPLINE;
+        return true;
     }
-    void  Glove::setThumb(bool onOff)  noexcept {
-        thumbStatus = onOff;
+
+    void  Glove::stale(void) noexcept{
+        while(true) 
+            delay(1000);
     }
 
+    void  Glove::delay(uint32_t ms) noexcept{
+        board.clock.sleepUs(ms * 1000);
+    }
+
+    // The current readings become the relaxed or the contracted end of each
+    // curve; only the curves whose end moved are rebuilt.
     void  Glove::setMin(void)  noexcept{
-        setIndexMin();
-        setMiddleMin();
-        setRingMin();
-        setLittleMin();
-        setThumbMin();
+        for(size_t idx{0}; idx<GLOVE_FINGERS; idx++){
+            if(fingerMin[idx] == fingerCurrent[idx])
+                continue;
+            fingerMin[idx] = fingerCurrent[idx];
+            curves[idx].setRange(fingerMin[idx], fingerMax[idx]);
+        }
     }
 
     void  Glove::setMax(void)  noexcept{
-        setIndexMax();
-        setMiddleMax();
-        setRingMax();
-        setLittleMax();
-        setThumbMax();
+        for(size_t idx{0}; idx<GLOVE_FINGERS; idx++){
+            if(fingerMax[idx] == fingerCurrent[idx])
+                continue;
+            fingerMax[idx] = fingerCurrent[idx];
+            curves[idx].setRange(fingerMin[idx], fingerMax[idx]);
+        }
     }
 
-    void  Glove::setIndexMin(void)  noexcept {
-        indexMin = indexCurrent;
+    void Glove::printDebugStatus(void) const noexcept {
+          static uint8_t  limit { 0 };
+          if(limit == 50){
+               printDebugStatusNolimit();
+               limit = 0;
+          }
+
+          limit++;
     }
 
-    void  Glove::setMiddleMin(void) noexcept {
-            middleMin = middleCurrent;
+    void  Glove::setOutputFormat(OUTPUT_FORMAT fmt) noexcept{
+         outputFormat     = fmt;
+         sessionHeaderDue = fmt == SESSION;
+         deltaEncoder.restart();
     }
 
-    void  Glove::setRingMin(void)   noexcept {
-            ringMin = ringCurrent;
+    void  Glove::sendMsg(void) noexcept{
+         takeSnapshot(current);
+         transmit(current);
     }
 
-    void  Glove::setLittleMin(void) noexcept {
-            littleMin = littleCurrent;
+    void  Glove::publish(void) noexcept{
+         StageProbe probe { profile, STAGE_PUBLISH };
+         Snapshot   snap;
+         takeSnapshot(snap);
+         if(sessionTap != nullptr)
+             snap.sessionFresh = sessionTap->take(snap.session);
+         snapshots.push(snap);
     }
 
-    void  Glove::setThumbMin(void)  noexcept {
-            thumbMin = thumbCurrent;
+    bool  Glove::drain(void) noexcept{
+         bool sent { false };
+
+         readCommands(board.console, consoleCommands, statsForConsole);
+         readCommands(board.link,    linkCommands,    statsForLink);
+
+         while(snapshots.pop(current)){
+             transmit(current);
+             sent = true;
+         }
+
+         sendButtonEvents();
+
+         // The dump owns the serial port until it ends, Bluetooth keeps the frames.
+         recorder.dump(board.console, FLIGHT_DUMP_CHUNK);
+         sendStats();
+         return sent;
     }
 
-    void  Glove::setIndexMax(void)  noexcept {
-            indexMax = indexCurrent;
+    void  Glove::readCommands(Transport& from, CommandParser& parser, bool& statsWanted) noexcept{
+         for(int in{from.read()}; in >= 0; in = from.read()){
+             // A bad frame may release several good ones at once.
+             CommandParser::RESULT result { parser.push(static_cast<uint8_t>(in)) };
+             for(; result != CommandParser::PARSE_MORE; result = parser.next()){
+                 switch(result){
+                     case CommandParser::PARSE_READY:
+                         execute(parser.command(), from);
+                         break;
+                     case CommandParser::PARSE_LOOSE:
+                         if(parser.loose() == FLIGHT_DUMP_REQUEST)
+                             recorder.requestFreeze();
+                         else if(parser.loose() == STATS_REQUEST)
+                             statsWanted = true;
+                         break;
+                     default:
+                         break;
+                 }
+             }
+         }
     }
 
-    void  Glove::setMiddleMax(void) noexcept {
-            middleMax = middleCurrent;
+    // Runs on the transport side: anything the acquisition owns is left in a
+    // request for applyRequests() and takeRate(), and acknowledged at once.
+    void  Glove::execute(const Command& cmd, Transport& from) noexcept{
+         static_assert(STATS_MAX_SIZE <= CMD_MAX_PAYLOAD && CALIB_MAX_SIZE <= CMD_MAX_PAYLOAD,
+                       "responses must fit a command payload");
+
+         const uint32_t rxUs   { board.clock.nowUs() };
+         const uint8_t* args   { cmd.payload };
+         COMMAND_STATUS status { CMD_OK };
+         uint8_t        reply[CMD_MAX_PAYLOAD];
+         size_t         replyLen { 0 };
+
+         switch(cmd.id){
+             case CMD_PING:
+                 memcpy(reply, args, cmd.length);
+                 replyLen = cmd.length;
+                 break;
+             case CMD_TIME_SYNC:
+                 // Same clock as the snapshots: the host maps the frame timestamps with it.
+                 if(cmd.length != 4){
+                     status = CMD_BAD_ARGS;
+                     break;
+                 }
+                 memcpy(reply, args, 4);
+                 put32(reply + 4, rxUs);
+                 replyLen = 12;
+                 break;
+             case CMD_SET_RATE: {
+                 const uint32_t period { cmd.length == 5 ? get32(args + 1) : 0 };
+                 if(cmd.length != 5 || args[0] >= RATE_TASKS || period < MIN_PERIOD_US || period > MAX_PERIOD_US)
+                     status = CMD_BAD_ARGS;
+                 else
+                     rateRequests[args[0]].store(period);
+                 break;
+             }
+             case CMD_SET_FORMAT:
+                 if(cmd.length != 1 || args[0] > SESSION || (args[0] == SESSION && sessionTap == nullptr))
+                     status = CMD_BAD_ARGS;
+                 else
+                     setOutputFormat(static_cast<OUTPUT_FORMAT>(args[0]));
+                 break;
+             case CMD_SET_DELTA: {
+                 // A zero refresh would make every frame a full one, a huge deadband freeze the stream.
+                 const uint32_t stale { cmd.length == 11 ? get32(args + 3) : 0 },
+                                key   { cmd.length == 11 ? get32(args + 7) : 0 };
+                 if(stale < DELTA_MIN_REFRESH_US || stale > DELTA_MAX_REFRESH_US ||
+                    key < DELTA_MIN_REFRESH_US || key > DELTA_MAX_REFRESH_US ||
+                    get16(args) > DELTA_MAX_DEADBAND_CDEG || args[2] > DELTA_MAX_FINGER_DEADBAND){
+                     status = CMD_BAD_ARGS;
+                     break;
+                 }
+                 DeltaConfig conf;
+                 conf.quatDeadbandDeg = get16(args) / 100.0f;
+                 conf.fingerDeadband  = args[2];
+                 conf.maxStaleUs      = stale;
+                 conf.keyframeUs      = key;
+                 setDeltaConfig(conf);
+                 break;
+             }
+             case CMD_SET_SENSITIVITY:
+                 if(cmd.length != 1 || args[0] > 100)
+                     status = CMD_BAD_ARGS;
+                 else
+                     sensitivityRequest.store(args[0]);
+                 break;
+             case CMD_SET_BUS_SPEED: {
+                 const uint32_t hz { cmd.length == 4 ? get32(args) : 0 };
+                 if(hz < 10000 || hz > 1000000)
+                     status = CMD_BAD_ARGS;
+                 else
+                     busSpeedRequest.store(hz);
+                 break;
+             }
+             case CMD_SET_FUSION: {
+                 const uint16_t gain { cmd.length == 3 ? get16(args + 1) : static_cast<uint16_t>(0) };
+                 if(args[0] > FILTER_MADGWICK || gain < FUSION_MIN_GAIN_MILLI || gain > FUSION_MAX_GAIN_MILLI)
+                     status = CMD_BAD_ARGS;
+                 else
+                     fusionRequest.store(static_cast<int32_t>(args[0]) << 16 | gain);
+                 break;
+             }
+             case CMD_CALIBRATE:
+                 if(cmd.length != 1 || args[0] == CALIBRATE_NONE || args[0] > CALIBRATE_CONFIRM)
+                     status = CMD_BAD_ARGS;
+                 else
+                     calibRequest.store(args[0]);
+                 break;
+             case CMD_GET_STATS:
+                 replyLen = encodeStats(reply);
+                 break;
+             case CMD_FLIGHT_DUMP:
+                 recorder.requestFreeze();
+                 break;
+             case CMD_READ_CALIB: {
+                 // NVS locks itself: the acquisition side may be saving meanwhile.
+                 CalibrationProfile prof;
+                 if(cmd.length != 1 || args[0] >= CALIB_USERS)
+                     status = CMD_BAD_ARGS;
+                 else if(!calibration.load(args[0], prof))
+                     status = CMD_FAILED;
+                 else
+                     replyLen = encodeProfile(prof, reply);
+                 break;
+             }
+             case CMD_WRITE_CALIB: {
+                 CalibrationProfile prof;
+                 if(!decodeProfile(args, cmd.length, prof) || prof.user >= CALIB_USERS)
+                     status = CMD_BAD_ARGS;
+                 else if(!calibration.save(prof))
+                     status = CMD_FAILED;
+                 else if(prof.user == user)
+                     userRequest.store(prof.user);      // reloads it
+                 break;
+             }
+             case CMD_SELECT_USER:
+                 if(cmd.length != 1 || args[0] >= CALIB_USERS)
+                     status = CMD_BAD_ARGS;
+                 else
+                     userRequest.store(args[0]);
+                 break;
+             case CMD_GET_IDENTITY:
+                 replyLen = encodeIdentity(ident, reply);
+                 break;
+             case CMD_SET_IDENTITY: {
+                 DeviceIdentity id;
+                 if(!decodeIdentity(args, cmd.length, id))
+                     status = CMD_BAD_ARGS;
+                 else if(!saveIdentity(board.store, id))
+                     status = CMD_FAILED;
+                 else
+                     ident = loadIdentity(board.store);
+                 break;
+             }
+             default:
+                 status = CMD_UNKNOWN;
+         }
+
+         // Nothing goes in the middle of a dump on the serial port.
+         if(&from == &board.console && recorder.frozen())
+             return;
+
+         if(cmd.id == CMD_TIME_SYNC && status == CMD_OK)
+             put32(reply + 8, board.clock.nowUs());
+
+         uint8_t out[RSP_MAX_SIZE];
+         from.write(out, encodeResponse(cmd, status, reply, replyLen, out));
     }
 
-    void  Glove::setRingMax(void)   noexcept {
-            ringMax = ringCurrent;
+    bool  Glove::takeRate(RATE_TASK task, uint32_t& periodUs) noexcept{
+         if(task >= RATE_TASKS)
+             return false;
+         periodUs = rateRequests[task].exchange(0);
+         return periodUs != 0;
     }
 
-    void  Glove::setLittleMax(void) noexcept {
-            littleMax = littleCurrent;
+    // Acquisition side of the commands.
+    void  Glove::applyRequests(void) noexcept{
+         const int16_t  sens { sensitivityRequest.exchange(-1) },
+                        usr  { userRequest.exchange(-1) };
+         const uint32_t hz   { busSpeedRequest.exchange(0) };
+         const int32_t  fus  { fusionRequest.exchange(-1) };
+
+         if(sens >= 0)
+             sensitivity = static_cast<uint16_t>(sens);
+         if(hz != 0)
+             bus.setSpeed(hz);
+         if(fus >= 0)
+             setFusion(static_cast<FILTER_KIND>(fus >> 16), (fus & 0xFFFF) / 1000.0f);
+         if(usr >= 0 && !calibrating.load())
+             selectUser(static_cast<uint8_t>(usr));
     }
 
-    void  Glove::setThumbMax(void)  noexcept {
-            thumbMax = thumbCurrent;
+    // Binary and delta output only: the text consumers know nothing but the frames.
+    void  Glove::sendButtonEvents(void) noexcept{
+         ButtonEvent ev;
+         uint8_t     buffer[BUTTON_SIZE];
+
+         while(buttons.take(ev))
+             if(outputFormat != TEXT)
+                 board.link.write(buffer, encodeButtonEvent(ev, buffer));
     }
 
-    bool  Glove::checkRightButton(void)  const noexcept{
-        return   analogRead(BUTTON_RIGHT_PIN) > ( buttonRightOn - ( buttonRightOn * sensitivity / 100) )  ? true : false;
+    // One report for whoever asked; the serial port waits for the end of a dump.
+    void  Glove::sendStats(void) noexcept{
+         const bool toLink    { statsForLink },
+                    toConsole { statsForConsole && !recorder.frozen() };
+         if(!toLink && !toConsole)
+             return;
+
+         uint8_t        buffer[STATS_MAX_SIZE];
+         const size_t   len { encodeStats(buffer) };
+         if(toLink)
+             board.link.write(buffer, len);
+         if(toConsole)
+             board.console.write(buffer, len);
+
+         statsForLink    = false;
+         statsForConsole = statsForConsole && !toConsole;
     }
 
-    bool  Glove::checkLeftButton(void)  const noexcept{
-        return   analogRead(BUTTON_LEFT_PIN) > ( buttonLeftOn - ( buttonLeftOn * sensitivity / 100 ))  ? true : false;
+    // The stages start over after each report, whoever asked.
+    size_t  Glove::encodeStats(uint8_t* out) noexcept{
+         StatsReport    rep;
+         const uint32_t now { board.clock.nowUs() };
+
+#if !defined(GLOVE_NO_PROFILE)
+         rep.stageCount = STAGES;
+#endif
+         rep.windowUs   = now - statsSinceUs;
+         for(size_t idx{0}; idx<rep.stageCount; idx++)
+             rep.stages[idx] = profile.summary(static_cast<PROFILE_STAGE>(idx));
+
+         statsSinceUs   = now;
+         profile.requestReset();
+         return encodeStatsReport(rep, out);
     }
 
-    bool  Glove::checkMiddleButton(void)  const noexcept{
-        return   analogRead(BUTTON_MIDDLE_PIN) > ( buttonMiddleOn - ( buttonMiddleOn * sensitivity / 100) )  ? true : false;
+    void  Glove::takeSnapshot(Snapshot& snap) const noexcept{
+         snap.timestampUs = board.clock.nowUs();
+         snap.movement    = 0;
+
+         memcpy(snap.quaternion, angles.quaternion, sizeof(snap.quaternion));
+         memcpy(snap.euler, angles.euler, sizeof(snap.euler));
+         for(size_t idx{0}; idx<GLOVE_IMUS; idx++)
+             if(angles.movement[idx])
+                 snap.movement |= 1 << idx;
+
+         chain.solve(snap.quaternion, snap.joints);
+
+         memcpy(snap.fingers, fingerNorm, sizeof(snap.fingers));
+         snap.fingerStatus = 0;
+         for(size_t idx{0}; idx<GLOVE_FINGERS; idx++)
+             if(fingerOn[idx])
+                 snap.fingerStatus |= 1 << idx;
+
+         snap.buttons = ( buttonLeft   ? BTN_LEFT   : 0 ) |
+                        ( buttonMiddle ? BTN_MIDDLE : 0 ) |
+                        ( buttonRight  ? BTN_RIGHT  : 0 );
+
+         snap.calibrating = calibState != CAL_IDLE;
     }
 
-    void  Glove::waitConfirm(void) const noexcept{
-        delay(1000);
-        while(true){
-            if(checkLeftButton())
-                break;
-            delay(300);
-        }
+    void  Glove::transmit(const Snapshot& snap) noexcept{
+         StageProbe probe { profile, STAGE_SEND };
+
+         profile.mark(STAGE_FRAME);
+         switch(outputFormat){
+             case BINARY:
+             case DELTA:
+                 sendFrame(snap);
+                 break;
+             case SESSION:
+                 sendSession(snap);
+                 break;
+             default:
+                 sendText(snap);
+         }
     }
 
-    void Glove::printDebugStatus(void) const noexcept {
-          static uint8_t  limit { 0 };
-          if(limit == 50){
-               Serial.println("--- Fingers ----");
-               Serial.print("Index: ");
-               Serial.println(indexCurrent);
-               Serial.println(indexNorm);
-               Serial.print("Middle:");
-               Serial.println(middleCurrent);
-               Serial.println(middleNorm);
-               Serial.print("Ring:");
-               Serial.println(ringCurrent);
-               Serial.println(ringNorm);
-               Serial.print("Little:");
-               Serial.println(littleCurrent);
-               Serial.println(littleNorm);
-               Serial.print("Thumb:");
-               Serial.println(thumbCurrent);
-               Serial.println(thumbNorm);
-               Serial.print("Inf: ");
-               Serial.println(thumbMin);
-               Serial.print("Sup: ");
-               Serial.println(thumbMax);
-               Serial.print("Norm: ");
-               Serial.println(normalizeStatus(thumbMin, thumbMax, thumbCurrent));
-               Serial.println("--- Quaternions ----");
-
-               Serial.print("[");
-               for (const auto& angle: angles){
-                   Serial.print(angle.quaternion.w);Serial.print(", ");
-                   Serial.print(angle.quaternion.x);Serial.print(", ");
-                   Serial.print(angle.quaternion.y);Serial.print(", ");
-                   Serial.print(angle.quaternion.z);
-               }
-               Serial.println("]");
-               Serial.println("--- EULER ----");
-
-               Serial.print("[");
-               for (const auto& angle: angles){
-                   Serial.print(angle.euler[PSI]);   Serial.print(", ");
-                   Serial.print(angle.euler[THETA]); Serial.print(", ");
-                   Serial.print(angle.euler[PHI]);
-               }
-               Serial.println("]");
-
-               Serial.println("--- ANGLE OFFSETS ----");
-               Serial.print("{");
-               Serial.print(offsetX_ArmAngle);  Serial.print(", ");
-               Serial.print(offsetY_ArmAngle);  Serial.print(", ");
-               Serial.print(offsetZ_ArmAngle);  Serial.print(", ");
-               Serial.print(offsetX_ForearmAngle);  Serial.print(", ");
-               Serial.print(offsetY_ForearmAngle);  Serial.print(", ");
-               Serial.print(offsetZ_ForearmAngle);  Serial.print(", ");
-               Serial.print(offsetX_HandAngle);  Serial.print(", ");
-               Serial.print(offsetY_HandAngle);  Serial.print(", ");
-               Serial.print(offsetZ_HandAngle);
-               Serial.print("}");
-
-               Serial.println("--- EULER DEGREES ----");
-               Serial.print("<");
-               for (const auto& angle: angles){
-                   Serial.print(angle.euler[PSI]   * DEGREE_CONV_FCTR );  Serial.print(", ");
-                   Serial.print(angle.euler[THETA] * DEGREE_CONV_FCTR );  Serial.print(", ");
-                   Serial.print(angle.euler[PHI]   * DEGREE_CONV_FCTR );
-               }
-               Serial.println(">");
-               Serial.println("-------");
+    void  Glove::sendFrame(const Snapshot& snap) noexcept{
+         // See telemetry.h for the layout. Quaternions are the joint rotations,
+         // relative to the calibration pose.
+         TelemetrySample sample;
 
-               limit = 0;
-            }
+         sample.timestampUs = snap.timestampUs;
+         sample.flags       = snap.movement | FRAME_JOINTS | (snap.calibrating ? FRAME_CALIBRATING : 0);
+
+         for(size_t idx{0}; idx<FRAME_IMUS; idx++){
+             const Quat& quat { snap.joints[idx] };
+             sample.quat[idx][0] = quat.w;
+             sample.quat[idx][1] = quat.x;
+             sample.quat[idx][2] = quat.y;
+             sample.quat[idx][3] = quat.z;
+         }
+
+         for(size_t idx{0}; idx<FRAME_FINGERS; idx++)
+             sample.fingers[idx] = snap.fingers[idx];
 
-            limit++;
+         sample.buttons = snap.buttons;
+
+         sample.seq = frameSeq;
+         const size_t len { outputFormat == DELTA ? deltaEncoder.encode(sample, frame) : encodeFrame(sample, frame) };
+         if(len == 0)
+             return;
+
+         frameSeq++;
+         board.link.write(frame, len);
+         if(!recorder.frozen())
+             board.console.write(frame, len);
     }
 
-    void  Glove::sendMsg(void) noexcept{
+    // The header once after the switch, then a record whenever a sensor was read.
+    void  Glove::sendSession(const Snapshot& snap) noexcept{
+         uint8_t buffer[SESSION_HEADER > SESSION_FRAME ? SESSION_HEADER : SESSION_FRAME];
+
+         if(sessionHeaderDue && sessionTap != nullptr){
+             encodeSessionHeader(sessionTap->header(imuReadMode), buffer);
+             board.link.write(buffer, SESSION_HEADER);
+             if(!recorder.frozen())
+                 board.console.write(buffer, SESSION_HEADER);
+             sessionHeaderDue = false;
+         }
+         if(!snap.sessionFresh)
+             return;
+
+         const size_t len { encodeSessionFrame(snap.session, buffer) };
+         board.link.write(buffer, len);
+         if(!recorder.frozen())
+             board.console.write(buffer, len);
+    }
+
+    void  Glove::sendText(const Snapshot& snap) noexcept{
          // Format:
          //
          // <ax,ay,az,fx,fy,fz,hx,hy,hz,t,i,m,r,p>
@@ -442,345 +936,579 @@ namespace glove {
          // Note: Roll and Pitch in reality are inverted because the type of mounting on the device
          // but they won't be renamed to preserve the reverences to the directions printed on the PCB
          // of the MPU-6050 boards. 
+         //
+         // Bluetooth gets the joint rotations (arm, forearm relative to the arm, hand relative
+         // to the forearm) as angles, the serial port the raw angles of each IMU.
+         // Each line is formatted in one buffer and written with a single call.
+         char    line[160];
+         float   raw[GLOVE_IMUS * 3],
+                 cal[GLOVE_IMUS * 3];
+
+         for(size_t idx{0}; idx<GLOVE_IMUS; idx++){
+             eulerFromQuat(snap.joints[idx], cal + idx * 3);
+             for(size_t axis{PSI}; axis<=PHI; axis++){
+                 raw[idx * 3 + axis]  = snap.euler[idx][axis] * DEGREE_CONV_FCTR;
+                 cal[idx * 3 + axis] *= DEGREE_CONV_FCTR;
+             }
+         }
+
+         // "<" the angles of each IMU, then the fingers, in GLOVE_TOPOLOGY order ">".
+         auto send { [&](Transport& out, const float* eul){
+             size_t len  { 1 };
+             auto   grow { [&](int n){ len = n < 0 ? len : len + n < sizeof(line) ? len + n : sizeof(line) - 1; } };
+             line[0] = '<';
+             for(size_t idx{0}; idx<GLOVE_IMUS; idx++)
+                 grow(snprintf(line + len, sizeof(line) - len, "%.2f, %.2f, %.2f, ", eul[idx * 3], eul[idx * 3 + 1], eul[idx * 3 + 2]));
+             // Integers: cheaper by hand than through snprintf.
+             for(size_t idx{0}; idx<GLOVE_FINGERS && len + 8 < sizeof(line); idx++){
+                 char     digits[5];
+                 size_t   count { 0 };
+                 uint16_t val   { snap.fingers[idx] };
+                 do{
+                     digits[count++] = static_cast<char>('0' + val % 10);
+                     val /= 10;
+                 } while(val > 0);
+                 while(count > 0)
+                     line[len++] = digits[--count];
+                 line[len++] = idx + 1 < GLOVE_FINGERS ? ',' : '>';
+                 line[len++] = idx + 1 < GLOVE_FINGERS ? ' ' : '\r';
+             }
+             line[len++] = '\n';
+             out.write(reinterpret_cast<const uint8_t*>(line), len);
+         } };
+
+         send(board.link,    cal);
+         if(!recorder.frozen())
+             send(board.console, raw);
+    }
 
-         // Bluetooth
-         // HEADER
-         bluetoothLink.print("<");
-      
-         // Euler
+    void Glove::printDebugStatusNolimit(void) const noexcept{
+               Transport& out { board.console };
+
+               out.print("--- Fingers ----\r\n");
+               for(size_t idx{0}; idx<GLOVE_FINGERS; idx++)
+                   out.printf("%s: %u\r\n%u (inf %u, sup %u)\r\n", GLOVE_TOPOLOGY.fingers[idx].name,
+                              fingerCurrent[idx], fingerNorm[idx], fingerMin[idx], fingerMax[idx]);
+               out.print("--- Quaternions ----\r\n");
+
+               for(size_t idx{0}; idx<GLOVE_IMUS; idx++)
+                   out.printf("%s: [%.2f, %.2f, %.2f, %.2f]\r\n", GLOVE_TOPOLOGY.imus[idx].name,
+                              angles.quaternion[idx].w, angles.quaternion[idx].x,
+                              angles.quaternion[idx].y, angles.quaternion[idx].z);
+
+               out.print("--- EULER ----\r\n");
+               out.print("[");
+               for (const auto& euler: angles.euler)
+                   out.printf("%.2f, %.2f, %.2f", euler[PSI], euler[THETA], euler[PHI]);
+               out.print("]\r\n");
+
+               out.print("--- ANGLE OFFSETS ----\r\n");
+               out.print("{");
+               for (const auto& offsets: articulation)
+                   out.printf("%.2f, %.2f, %.2f", offsets[PSI], offsets[THETA], offsets[PHI]);
+               out.print("}");
+
+               out.print("--- EULER DEGREES ----\r\n");
+               out.print("<");
+               for (const auto& euler: angles.euler)
+                   out.printf("%.2f, %.2f, %.2f", euler[PSI]   * DEGREE_CONV_FCTR, 
+                                                  euler[THETA] * DEGREE_CONV_FCTR,
+                                                  euler[PHI]   * DEGREE_CONV_FCTR);
+               out.print(">\r\n");
+               out.print("-------\r\n");
+    }
 
-         bluetoothLink.print((angles[ARMIDX].euler[PSI]   - offsetX_ArmAngle ) * DEGREE_CONV_FCTR );  bluetoothLink.print(", ");
-         bluetoothLink.print((angles[ARMIDX].euler[THETA] - offsetY_ArmAngle ) * DEGREE_CONV_FCTR );  bluetoothLink.print(", ");
-         bluetoothLink.print((angles[ARMIDX].euler[PHI]   - offsetZ_ArmAngle ) * DEGREE_CONV_FCTR );  bluetoothLink.print(", ");
+    bool Glove::setFingerSampling(uint32_t hz, uint16_t oversample) noexcept{
+        board.adc.stopContinuous();
+        continuousAdc = hz > 0 && board.adc.startContinuous(FINGER_PINS.pins, GLOVE_FINGERS, hz, oversample);
+        for(auto& filter: fingerFilters)
+            filter.reset();
+        return continuousAdc || hz == 0;
+    }
+
+    void Glove::setFingerFilter(ADC_FILTER kind, float cutoffHz, float beta) noexcept{
+        for(auto& filter: fingerFilters)
+            filter.configure(kind, cutoffHz, beta);
+    }
+
+    // Every reading goes through the filters with the time measured since the
+    // one before: the continuous ones carry their own, a step may take none
+    // or several, and the ADC may deliver them at another rate than asked.
+    void Glove::sampleFingers(void) noexcept{
+        if(continuousAdc){
+            uint32_t atUs;
+            while(board.adc.readContinuous(fingerRaw, atUs)){
+                const float dt { (atUs - fingerSampleUs) * 1e-6f };
+                fingerSampleUs = atUs;
+                for(size_t idx{0}; idx<GLOVE_FINGERS; idx++)
+                    fingerFilters[idx].update(fingerRaw[idx], dt);
+            }
+        } else {
+            const uint32_t now { board.clock.nowUs() };
+            const float    dt  { (now - fingerSampleUs) * 1e-6f };
+            fingerSampleUs = now;
+            for(size_t idx{0}; idx<GLOVE_FINGERS; idx++){
+                fingerRaw[idx] = board.adc.read(FINGER_PINS.pins[idx]);
+                fingerFilters[idx].update(fingerRaw[idx], dt);
+            }
+        }
 
-         bluetoothLink.print((angles[FOREARMIDX].euler[PSI]   - offsetX_ForearmAngle ) * DEGREE_CONV_FCTR );  bluetoothLink.print(", ");
-         bluetoothLink.print((angles[FOREARMIDX].euler[THETA] - offsetY_ForearmAngle ) * DEGREE_CONV_FCTR );  bluetoothLink.print(", ");
-         bluetoothLink.print((angles[FOREARMIDX].euler[PHI]   - offsetZ_ForearmAngle ) * DEGREE_CONV_FCTR );  bluetoothLink.print(", ");
+        for(size_t idx{0}; idx<GLOVE_FINGERS; idx++)
+            fingerCurrent[idx] = fingerFilters[idx].value();
+    }
+
+    void Glove::readStatus(void) noexcept{
+            sampleFingers();
+            for(size_t idx{0}; idx<GLOVE_FINGERS; idx++){
+                fingerNorm[idx] = curves[idx](fingerCurrent[idx]);
+                fingerOn[idx]   = fingerCurrent[idx] > ( fingerMin[idx] + ( fingerMin[idx] * ( sensitivity / 100) ));
+            }
 
-         bluetoothLink.print((angles[HANDIDX].euler[PSI]   - offsetX_HandAngle ) * DEGREE_CONV_FCTR );  bluetoothLink.print(", ");
-         bluetoothLink.print((angles[HANDIDX].euler[THETA] - offsetY_HandAngle ) * DEGREE_CONV_FCTR );   bluetoothLink.print(", ");
-         bluetoothLink.print((angles[HANDIDX].euler[PHI]   - offsetZ_HandAngle ) * DEGREE_CONV_FCTR );  bluetoothLink.print(", ");
+            // Debounced levels, the events go out with drain().
+            uint8_t levels { 0 };
+            for(size_t idx{0}; idx<Buttons::COUNT; idx++)
+                if(board.irq.level(GLOVE_TOPOLOGY.buttonPins[idx]))
+                    levels |= static_cast<uint8_t>(1 << idx);
+            buttons.poll(board.clock.nowUs(), levels);
 
-         bluetoothLink.print(thumbNorm);  bluetoothLink.print(", ");
-         bluetoothLink.print(indexNorm);  bluetoothLink.print(", ");
-         bluetoothLink.print(middleNorm); bluetoothLink.print(", ");
-         bluetoothLink.print(ringNorm);   bluetoothLink.print(", ");
-         bluetoothLink.print(littleNorm);  
+            buttonLeft   = buttons.held() & BTN_LEFT;
+            buttonMiddle = buttons.held() & BTN_MIDDLE;
+            buttonRight  = buttons.held() & BTN_RIGHT;
+    }
 
-         // FOOTER
-         bluetoothLink.println(">");
+    void  Glove::refreshFingers(void)  noexcept{
+      // The calibration messages go over the glyphs, which wait for its end.
+      showCalibrationMessage();
+      if(calibrating.load())
+          return;
 
-         // Serial Port 
-         // HEADER
-         Serial.print("<");
+      StageProbe probe { profile, STAGE_DISPLAY };
       
-         // Euler
-         Serial.print(angles[ARMIDX].euler[PSI]   * DEGREE_CONV_FCTR );  Serial.print(", ");
-         Serial.print(angles[ARMIDX].euler[THETA] * DEGREE_CONV_FCTR );  Serial.print(", ");
-         Serial.print(angles[ARMIDX].euler[PHI]   * DEGREE_CONV_FCTR );  Serial.print(", ");
+      // The delta stream carries the fingers already, the status line would only cost bandwidth.
+      if(outputFormat != DELTA){
+          updateStatusForBt(current);
+          board.link.write(reinterpret_cast<const uint8_t*>(statusForBt), strlen(statusForBt));
+          board.link.print("\r\n");
+      }
+      
+      #ifdef DEBUG_GLOVE
+      if(!recorder.frozen())
+          printDebugStatusNolimit();
+      #endif
+
+      // Only the glyphs whose finger changed go over SPI.
+      status.render(current.fingerStatus);
+    }
+          
+    void  Glove::updateStatusForBt(const Snapshot& snap)  noexcept {
+          for(size_t idx{0}; idx<GLOVE_FINGERS; idx++)
+              statusForBt[idx] = snap.fingers[idx] > 0 ? snap.fingers[idx] - 1 : 0;
+          statusForBt[EVENTS::BUTTON_LEFT]   = snap.buttons & BTN_LEFT   ? '1' : '0';
+          statusForBt[EVENTS::BUTTON_MIDDLE] = snap.buttons & BTN_MIDDLE ? '1' : '0';
+          statusForBt[EVENTS::BUTTON_RIGHT]  = snap.buttons & BTN_RIGHT  ? '1' : '0';
+    }
 
-         Serial.print(angles[FOREARMIDX].euler[PSI]   * DEGREE_CONV_FCTR );  Serial.print(", ");
-         Serial.print(angles[FOREARMIDX].euler[THETA] * DEGREE_CONV_FCTR );  Serial.print(", ");
-         Serial.print(angles[FOREARMIDX].euler[PHI]   * DEGREE_CONV_FCTR );  Serial.print(", ");
+    bool Glove::calibrationElapsed(uint32_t ms) const noexcept{
+         return board.clock.nowUs() - calibSinceUs >= ms * 1000;
+    }
 
-         Serial.print(angles[HANDIDX].euler[PSI]   * DEGREE_CONV_FCTR );  Serial.print(", ");
-         Serial.print(angles[HANDIDX].euler[THETA] * DEGREE_CONV_FCTR );   Serial.print(", ");
-         Serial.print(angles[HANDIDX].euler[PHI]   * DEGREE_CONV_FCTR );  Serial.print(", ");
+    // LEFT counts only after a pause, the chord that started the calibration may still be held.
+    bool Glove::confirmed(void) const noexcept{
+         return calibrationElapsed(CONFIRM_HOLDOFF_MS) && (buttonLeft || hostConfirm);
+    }
 
-         Serial.print(thumbNorm);  Serial.print(", ");
-         Serial.print(indexNorm);  Serial.print(", ");
-         Serial.print(middleNorm); Serial.print(", ");
-         Serial.print(ringNorm);   Serial.print(", ");
-         Serial.print(littleNorm);  
+    // The message waits for the display task; nullptr keeps the one shown.
+    void Glove::enterCalibration(CALIB_STATE state, const char* msg) noexcept{
+         if(msg != nullptr)
+             calibMessage.store(msg);
+         calibState   = state;
+         calibSinceUs = board.clock.nowUs();
+         hostConfirm  = false;
+    }
 
-         // FOOTER
-         Serial.println(">");
+    // Display task: the line is cleared and the newest message drawn, the
+    // glyphs it covers are drawn again after the calibration.
+    void Glove::showCalibrationMessage(void) noexcept{
+         const char* msg { calibMessage.exchange(nullptr) };
+         if(msg == nullptr)
+             return;
+
+         board.display.drawCentreString("                         ",116,48,2, COL_RED); // Next size up font 2
+         if(msg[0] != '\0')
+             board.display.drawCentreString(msg,120,48,2, COL_RED);
+         status.invalidate();
     }
 
-    void Glove::printDebugStatusNolimit(void) const noexcept{
-               Serial.println("--- Fingers ----");
-               Serial.print("Index: ");
-               Serial.println(indexCurrent);
-               Serial.println(indexNorm);
-               Serial.print("Middle:");
-               Serial.println(middleCurrent);
-               Serial.println(middleNorm);
-               Serial.print("Ring:");
-               Serial.println(ringCurrent);
-               Serial.println(ringNorm);
-               Serial.print("Little:");
-               Serial.println(littleCurrent);
-               Serial.println(littleNorm);
-               Serial.print("Thumb:");
-               Serial.println(thumbCurrent);
-               Serial.println(thumbNorm);
-               Serial.print("Inf: ");
-               Serial.println(thumbMin);
-               Serial.print("Sup: ");
-               Serial.println(thumbMax);
-               Serial.print("Norm: ");
-               Serial.println(normalizeStatus(thumbMin, thumbMax, thumbCurrent));
-               Serial.println("--- Quaternions ----");
-                   
-               Serial.print("[");
-               for (const auto& angle: angles){
-                   Serial.print(angle.quaternion.w);Serial.print(", ");
-                   Serial.print(angle.quaternion.x);Serial.print(", ");
-                   Serial.print(angle.quaternion.y);Serial.print(", ");
-                   Serial.print(angle.quaternion.z);
-               }
-               Serial.println("]");
-
-               Serial.println("--- EULER ----");
-               Serial.print("[");
-               for (const auto& angle: angles){
-                   Serial.print(angle.euler[PSI]);   Serial.print(", ");
-                   Serial.print(angle.euler[THETA]); Serial.print(", ");
-                   Serial.print(angle.euler[PHI]);
-               }
-               Serial.println("]");
-
-               Serial.println("--- ANGLE OFFSETS ----");
-               Serial.print("{");
-               Serial.print(offsetX_ArmAngle);  Serial.print(", ");
-               Serial.print(offsetY_ArmAngle);  Serial.print(", ");
-               Serial.print(offsetZ_ArmAngle);  Serial.print(", ");
-               Serial.print(offsetX_ForearmAngle);  Serial.print(", ");
-               Serial.print(offsetY_ForearmAngle);  Serial.print(", ");
-               Serial.print(offsetZ_ForearmAngle);  Serial.print(", ");
-               Serial.print(offsetX_HandAngle);  Serial.print(", ");
-               Serial.print(offsetY_HandAngle);  Serial.print(", ");
-               Serial.print(offsetZ_HandAngle);
-               Serial.print("}");
-
-               Serial.println("--- EULER DEGREES ----");
-               Serial.print("<");
-               for (const auto& angle: angles){
-                   Serial.print(angle.euler[PSI]   * DEGREE_CONV_FCTR );  Serial.print(", ");
-                   Serial.print(angle.euler[THETA] * DEGREE_CONV_FCTR );  Serial.print(", ");
-                   Serial.print(angle.euler[PHI]   * DEGREE_CONV_FCTR );
-               }
-               Serial.println(">");
-               Serial.println("-------");
+    void Glove::finishCalibration(void) noexcept{
+         calibMessage.store("");
+         calibState = CAL_IDLE;
+         calibrating.store(false);
     }
 
-    void Glove::readStatus(void) noexcept{
-            indexCurrent  = analogRead(INDEX_PIN);
-            indexNorm     = normalizeStatus( indexMin, indexMax, indexCurrent);
-            indexStatus   = indexCurrent > ( indexMin + ( indexMin * ( sensitivity / 100) ))  ? true : false;
-            middleCurrent = analogRead(MIDDLE_PIN);
-            middleStatus  = middleCurrent > ( middleMin + ( middleMin * ( sensitivity / 100) ))  ? true : false;
-            middleNorm    = normalizeStatus( middleMin, middleMax, middleCurrent);
-            littleCurrent = analogRead(LITTLE_PIN);
-            littleStatus  = littleCurrent > ( middleMin + ( middleMin * ( sensitivity / 100) ))  ? true : false;
-            littleNorm    = normalizeStatus( littleMin, littleMax, littleCurrent);
-            ringCurrent   = analogRead(RING_PIN);
-            ringStatus    = ringCurrent > ( ringMin + ( ringMin * ( sensitivity / 100) ))  ? true : false;
-            ringNorm      = normalizeStatus( ringMin, ringMax, ringCurrent);
-            thumbCurrent  = analogRead(THUMB_PIN);
-            thumbStatus   = thumbCurrent > ( thumbMin + ( thumbMin * ( sensitivity / 100) ))  ? true : false;
-            thumbNorm     = normalizeStatus( thumbMin, thumbMax, thumbCurrent);
-
-            buttonLeft   = checkLeftButton();
-            buttonMiddle = checkMiddleButton();
-            buttonRight  = checkRightButton();
-
-            updateStatusForBt();
+    void Glove::accumulateMeans(void) noexcept{
+         for(size_t idx{0}; idx<GLOVE_IMUS; idx++){
+             for(size_t axis{PSI}; axis<=PHI; axis++)
+                 calibSums[idx][axis] += angles.euler[idx][axis];
+
+             // q and -q are the same rotation: keep the samples in one hemisphere.
+             const Quat&  q    { angles.quaternion[idx] };
+             Quat&        sum  { calibQuatSums[idx] };
+             const float  sign { sum.w * q.w + sum.x * q.x + sum.y * q.y + sum.z * q.z < 0.0f ? -1.0f : 1.0f };
+             sum.w += sign * q.w;
+             sum.x += sign * q.x;
+             sum.y += sign * q.y;
+             sum.z += sign * q.z;
+         }
+         calibSamples++;
     }
 
-    void  Glove::refreshFingers(void)  noexcept{
-      byte xpos { 36 },
-           ypos { 0 };
-      
-      readStatus();
-      bluetoothLink.println(statusForBt);
-      
-      #ifdef DEBUG_GLOVE
-      printDebugStatusNolimit();
-      #endif
+    void Glove::storeMeans(void) noexcept{
+         for(size_t idx{0}; idx<GLOVE_IMUS; idx++)
+             for(size_t axis{PSI}; axis<=PHI; axis++)
+                 articulation[idx][axis] = calibSums[idx][axis] / AVERAGE_ELEMS_NUM;
 
-      tft.setTextColor(indexStatus ? TFT_BLUE : TFT_ORANGE, TFT_BLACK); 
-      tft.drawString("1",xpos,ypos,7); 
-      xpos = 64;
-      tft.setTextColor(middleStatus ? TFT_BLUE : TFT_ORANGE, TFT_BLACK); 
-      tft.drawString("1",xpos,ypos,7); 
-      xpos = 92;
-      tft.setTextColor(ringStatus ? TFT_BLUE : TFT_ORANGE, TFT_BLACK); 
-      tft.drawString("1",xpos,ypos,7); 
-      xpos = 120;
-      tft.setTextColor(littleStatus ? TFT_BLUE : TFT_ORANGE, TFT_BLACK); 
-      tft.drawString("1",xpos,ypos,7); 
-      xpos = 10;
-      ypos = 24;
-      tft.setTextColor(thumbStatus ? TFT_BLUE : TFT_ORANGE, TFT_BLACK); 
-      tft.drawString("1",xpos,ypos,7); 
-      
+         // Normalized sum: a good enough mean for samples this close together.
+         chain.setReference(calibQuatSums);
     }
-          
-    void  Glove::updateStatusForBt(void)  noexcept {
-          statusForBt[EVENTS::THUMB]         = thumbNorm  > 0  ? thumbNorm  - 1 : 0;
-          statusForBt[EVENTS::INDEX]         = indexNorm  > 0  ? indexNorm  - 1 : 0;
-          statusForBt[EVENTS::MIDDLE]        = middleNorm > 0  ? middleNorm - 1 : 0;
-          statusForBt[EVENTS::RING]          = ringNorm   > 0  ? ringNorm   - 1 : 0;
-          statusForBt[EVENTS::LITTLE]        = littleNorm > 0  ? littleNorm - 1 : 0;
-          statusForBt[EVENTS::BUTTON_LEFT]   = buttonLeft   ? '1' : '0';
-          statusForBt[EVENTS::BUTTON_MIDDLE] = buttonMiddle ? '1' : '0';
-          statusForBt[EVENTS::BUTTON_RIGHT]  = buttonRight  ? '1' : '0';
-    }
-
-    void  Glove::calculateMeans(void)  noexcept{
-
-        double  sumAccX_ArmAngle     { 0.0 }, 
-                sumAccY_ArmAngle     { 0.0 }, 
-                sumAccZ_ArmAngle     { 0.0 },
-                sumAccX_ForearmAngle { 0.0 }, 
-                sumAccY_ForearmAngle { 0.0 }, 
-                sumAccZ_ForearmAngle { 0.0 },
-                sumAccX_HandAngle    { 0.0 }, 
-                sumAccY_HandAngle    { 0.0 }, 
-                sumAccZ_HandAngle    { 0.0 };
-
-        for(int i{0}; i<AVERAGE_ELEMS_NUM; i++){
-                handleEvents();
-
-                sumAccX_ArmAngle += angles[ARMIDX].euler[PSI];
-                sumAccY_ArmAngle += angles[ARMIDX].euler[THETA];
-                sumAccZ_ArmAngle += angles[ARMIDX].euler[PHI];
-          
-                sumAccX_ForearmAngle += angles[FOREARMIDX].euler[PSI];
-                sumAccY_ForearmAngle += angles[FOREARMIDX].euler[THETA];
-                sumAccZ_ForearmAngle += angles[FOREARMIDX].euler[PHI];
-          
-                sumAccX_HandAngle += angles[HANDIDX].euler[PSI];
-                sumAccY_HandAngle += angles[HANDIDX].euler[THETA];
-                sumAccZ_HandAngle += angles[HANDIDX].euler[PHI];
 
-                delay(AVERAGE_CALC_WAIT);
-        }
+    // One step per call, never waits: LEFT + CENTER calibrates the fingers,
+    // RIGHT + CENTER the arm position.
+    void Glove::advanceCalibration(void) noexcept{
+         // CMD_CALIBRATE stands for the buttons: the chords to start, LEFT to confirm.
+         const uint8_t req { calibRequest.exchange(CALIBRATE_NONE) };
+         if(req == CALIBRATE_CONFIRM && calibState != CAL_IDLE)
+             hostConfirm = true;
+
+         switch(calibState){
+             case CAL_IDLE:
+                 if( (buttonLeft && buttonMiddle) || req == CALIBRATE_FINGERS ){
+                     calibrating.store(true);
+                     enterCalibration(CAL_RELAX, "Relax all");
+                 } else if( (buttonRight && buttonMiddle) || req == CALIBRATE_ARM ){
+                     calibrating.store(true);
+                     enterCalibration(CAL_POSE, "Put Arm Orizontal pos.");
+                 }
+                 break;
+
+             case CAL_RELAX:
+                 if(confirmed()){
+                     setMin();
+                     enterCalibration(CAL_MIN_OK, "Min ok   ");
+                 }
+                 break;
+             case CAL_MIN_OK:
+                 if(calibrationElapsed(MESSAGE_MS))
+                     enterCalibration(CAL_CONTRACT, "Contract all");
+                 break;
+             case CAL_CONTRACT:
+                 if(confirmed()){
+                     setMax();
+                     enterCalibration(CAL_MAX_OK, "Max ok      ");
+                 }
+                 break;
+             case CAL_MAX_OK:
+                 if(calibrationElapsed(MESSAGE_MS)){
+                     saveCalibration();
+                     enterCalibration(CAL_FINGERS_OK, "Fingers Calibrated  ");
+                 }
+                 break;
+             case CAL_FINGERS_OK:
+                 if(calibrationElapsed(MESSAGE_MS))
+                     finishCalibration();
+                 break;
+
+             case CAL_POSE:
+                 if(confirmed()){
+                     memset(calibSums, 0, sizeof(calibSums));
+                     for(auto& sum: calibQuatSums)
+                         sum = Quat{ 0.0f, 0.0f, 0.0f, 0.0f };
+                     calibSamples = 0;
+                     enterCalibration(CAL_SAMPLING, nullptr);
+                 }
+                 break;
+             case CAL_SAMPLING:
+                 // Same spacing as before, from the angles acquireImus() read last.
+                 if(calibrationElapsed(static_cast<uint32_t>(calibSamples) * AVERAGE_CALC_WAIT))
+                     accumulateMeans();
+                 if(calibSamples == AVERAGE_ELEMS_NUM){
+                     storeMeans();
+                     enterCalibration(CAL_ACCEL_OK, "Accelerometer ok");
+                 }
+                 break;
+             case CAL_ACCEL_OK:
+                 if(calibrationElapsed(MESSAGE_MS)){
+                     saveCalibration();
+                     enterCalibration(CAL_ARTICULATIONS_OK, "Calibrated  ");
+                 }
+                 break;
+             case CAL_ARTICULATIONS_OK:
+                 if(calibrationElapsed(MESSAGE_MS))
+                     finishCalibration();
+                 break;
+         }
+    }
 
-        offsetX_ArmAngle     = sumAccX_ArmAngle     / AVERAGE_ELEMS_NUM;
-        offsetY_ArmAngle     = sumAccY_ArmAngle     / AVERAGE_ELEMS_NUM;
-        offsetZ_ArmAngle     = sumAccZ_ArmAngle     / AVERAGE_ELEMS_NUM;
-        offsetX_ForearmAngle = sumAccX_ForearmAngle / AVERAGE_ELEMS_NUM;
-        offsetY_ForearmAngle = sumAccY_ForearmAngle / AVERAGE_ELEMS_NUM;
-        offsetZ_ForearmAngle = sumAccZ_ForearmAngle / AVERAGE_ELEMS_NUM;
-        offsetX_HandAngle    = sumAccX_HandAngle    / AVERAGE_ELEMS_NUM;
-        offsetY_HandAngle    = sumAccY_HandAngle    / AVERAGE_ELEMS_NUM;
-        offsetZ_HandAngle    = sumAccZ_HandAngle    / AVERAGE_ELEMS_NUM;
-
-    }
-
-    void Glove::calibrateFingers(void) noexcept{
-         tft.setTextColor(TFT_RED, TFT_BLACK); 
-         tft.drawCentreString("Relax all",120,48,2); // Next size up font 2
-         waitConfirm();
-         setMin();
-         tft.drawCentreString("Min ok   ",120,48,2); // Next size up font 2
-         delay(2000);
-         tft.drawCentreString("Contract all",120,48,2); // Next size up font 2
-         waitConfirm();
-         setMax();
-         tft.drawCentreString("Max ok      ",120,48,2); // Next size up font 2
-         delay(2000);
-         tft.drawCentreString("Fingers Calibrated  ",120,48,2); // Next size up font 2
-         delay(2000);
-         tft.drawCentreString("                     ",116,48,2); // Next size up font 2
-    }
-
-    void Glove::calibrateArticulations(void) noexcept{
-         tft.setTextColor(TFT_RED, TFT_BLACK); 
-         tft.drawCentreString("Put Arm Orizontal pos.",120,48,2); // Next size up font 2
-         waitConfirm();
-         calculateMeans();
-         tft.drawCentreString("                         ",116,48,2); // Next size up font 2
-         tft.drawCentreString("Accelerometer ok",120,48,2); // Next size up font 2
-         delay(2000);
-         tft.drawCentreString("                         ",116,48,2); // Next size up font 2
-         tft.drawCentreString("Calibrated  ",120,48,2); // Next size up font 2
-         delay(2000);
-         tft.drawCentreString("                         ",116,48,2); // Next size up font 2
-    }
-
-    uint16_t Glove::normalizeStatus(uint16_t inf, uint16_t sup, uint16_t curr) const noexcept{   
-            assert(NORM_MAX == 90);
+    // Reference formula, tabulated by ResponseCurve as LEGACY_LOG; the
+    // relaxed end, 'inf', doesn't take part in it.
+    uint16_t Glove::normalizeStatus(uint16_t /* inf */, uint16_t sup, uint16_t curr) const noexcept{
+            static_assert(NORM_MAX == 90, "the formula was tuned for 0 - 90");
 
             return  NORM_MAX - abs(( log10(curr < 1 ? 1 : curr) * NORM_MAX) / log10(sup > 20 ? sup : 20));
     }
 
     void Glove::handleEvents(void) noexcept{
+        acquireFingers();
+        refreshFingers();
+        acquireImus();
+    }
+
+    void Glove::acquireFingers(void) noexcept{
+        StageProbe     probe      { profile, STAGE_FINGERS };
+        const uint32_t start      { board.clock.nowUs() },
+                       errors     { bus.stats().errors },
+                       recoveries { bus.stats().recoveries };
+
         if (initial) 
           initial = false;
 
-        refreshFingers();
+        applyRequests();
+        const bool idle { calibState == CAL_IDLE };
+        readStatus();
+        advanceCalibration();
+
+        FlightEntry entry;
+        entry.kind         = FLIGHT_FINGERS_STEP;
+        entry.flags        = ( buttonLeft   ? BTN_LEFT   : 0 ) |
+                             ( buttonMiddle ? BTN_MIDDLE : 0 ) |
+                             ( buttonRight  ? BTN_RIGHT  : 0 );
+        memcpy(entry.adc, fingerRaw, sizeof(fingerRaw));
+        recordStep(entry, start, fingersStepUs, errors, recoveries);
+
+        // LEFT + RIGHT freezes the flight recorder, once per press; not during
+        // a calibration, where LEFT confirms the steps.
+        const bool chord { buttonLeft && buttonRight && !buttonMiddle };
+        if(chord && !dumpChord && idle)
+            recorder.freeze(start);
+        dumpChord = chord;
+    }
 
-        if( buttonLeft && buttonMiddle )
-            calibrateFingers();
+    void Glove::recordStep(FlightEntry& entry, uint32_t startUs, uint32_t& lastUs,
+                           uint32_t errors, uint32_t recoveries) noexcept{
+        const BusStats& now { bus.stats() };
+
+        entry.timestampUs   = startUs;
+        entry.periodUs      = saturate16(startUs - lastUs);
+        entry.runUs         = saturate16(board.clock.nowUs() - startUs);
+        entry.busErrors     = saturate8(now.errors - errors);
+        entry.busRecoveries = saturate8(now.recoveries - recoveries);
+        lastUs              = startUs;
+        recorder.record(entry);
+    }
 
-        if( buttonRight && buttonMiddle )
-            calibrateArticulations();
+    bool Glove::setImuMode(IMU_MODE mode) noexcept{
+        if(mode == imuReadMode)
+            return true;
 
-        selectAccel(angles[ARMIDX].device);
+        if((mode == IMU_RAW) != (imuReadMode == IMU_RAW) && !switchRawMode(mode == IMU_RAW))
+            return false;
 
-        if (mpu.dmpGetCurrentFIFOPacket(angles[ARMIDX].fifo_buffer)) {
-               angles[ARMIDX].movement = true;
-               mpu.dmpGetQuaternion(&(angles[ARMIDX].quaternion), angles[ARMIDX].fifo_buffer);
-               mpu.dmpGetEuler(angles[ARMIDX].euler, &(angles[ARMIDX].quaternion));
-        } else  {
-               angles[ARMIDX].movement = false;
+        if(mode == IMU_IRQ){
+            for(size_t idx{0}; idx<GLOVE_IMUS; idx++){
+                if(!board.irq.attach(GLOVE_TOPOLOGY.imus[idx].intPin, ImuEvents::onDataReady, imuEvents.line(idx), IRQ_RISING)){
+                    for(size_t prev{0}; prev<idx; prev++)
+                        board.irq.detach(GLOVE_TOPOLOGY.imus[prev].intPin);
+                    return false;
+                }
+            }
+        } else if(imuReadMode == IMU_IRQ){
+            for(size_t idx{0}; idx<GLOVE_IMUS; idx++)
+                board.irq.detach(GLOVE_TOPOLOGY.imus[idx].intPin);
         }
 
-        selectAccel(angles[FOREARMIDX].device);
+        // Forget the interrupts counted before the switch.
+        uint32_t when { 0 };
+        for(size_t idx{0}; idx<GLOVE_IMUS; idx++)
+            imuEvents.take(idx, when);
 
-        if (mpu.dmpGetCurrentFIFOPacket(angles[FOREARMIDX].fifo_buffer)) {
-               angles[FOREARMIDX].movement = true;
-               mpu.dmpGetQuaternion(&(angles[FOREARMIDX].quaternion), angles[FOREARMIDX].fifo_buffer);
-               mpu.dmpGetEuler(angles[FOREARMIDX].euler, &(angles[FOREARMIDX].quaternion));
-        } else  {
-               angles[FOREARMIDX].movement = false;
+        imuReadMode = mode;
+        return true;
+    }
+
+    // Every other pass goes backwards, so the channel left selected by the
+    // last IMU is the first one needed: one mux write in three is saved.
+    void Glove::acquireImus(void) noexcept{
+        const uint32_t start      { board.clock.nowUs() },
+                       errors     { bus.stats().errors },
+                       recoveries { bus.stats().recoveries };
+        const bool     backwards  { (imuPass++ & 1) != 0 };
+
+        for(size_t step{0}; step<GLOVE_IMUS; step++){
+            const size_t idx   { backwards ? GLOVE_IMUS - 1 - step : step };
+            StageProbe   probe { profile, static_cast<PROFILE_STAGE>(STAGE_IMU + idx) };
+
+            switch(imuReadMode){
+                case IMU_IRQ: {
+                    uint32_t       when  { 0 };
+                    const uint32_t fired { imuEvents.take(idx, when) };
+
+                    angles.movement[idx] = false;
+                    if(fired == 0)
+                        break;
+                    if(fired > 1)
+                        angles.stats[idx].missed += fired - 1;
+
+                    if(!selectAccel(GLOVE_TOPOLOGY.imus[idx].muxChannel))
+                        break;
+                    if(!readPacket(idx)){
+                        angles.stats[idx].spurious++;
+                        break;
+                    }
+                    angles.stats[idx].lastLatencyUs = board.clock.nowUs() - when;
+                    if(angles.stats[idx].lastLatencyUs > angles.stats[idx].maxLatencyUs)
+                        angles.stats[idx].maxLatencyUs = angles.stats[idx].lastLatencyUs;
+                    break;
+                }
+                case IMU_FIFO: {
+                    uint16_t pending { 0 };
+
+                    angles.movement[idx] = false;
+                    if(!selectAccel(GLOVE_TOPOLOGY.imus[idx].muxChannel))
+                        break;
+                    bus.timed([&]{ pending = board.imu.pendingPackets(); return true; });
+                    if(pending == 0)
+                        break;
+                    if(pending > 1)
+                        angles.stats[idx].missed += pending - 1;
+                    readPacket(idx);
+                    break;
+                }
+                case IMU_RAW:
+                    if(selectAccel(GLOVE_TOPOLOGY.imus[idx].muxChannel))
+                        readRaw(idx);
+                    else
+                        angles.movement[idx] = false;
+                    break;
+                default:
+                    readAccel(idx);
+            }
+        }
+
+        FlightEntry entry;
+        entry.kind = FLIGHT_IMUS_STEP;
+        for(size_t idx{0}; idx<GLOVE_IMUS; idx++){
+            entry.quat[idx] = angles.quaternion[idx];
+            if(angles.movement[idx])
+                entry.flags |= 1 << idx;
         }
+        recordStep(entry, start, imusStepUs, errors, recoveries);
+    }
+
+    // All or none: if an IMU refuses, the ones already switched go back, so
+    // they all stay in the mode setImuMode() keeps.
+    bool Glove::switchRawMode(bool raw) noexcept{
+        for(size_t idx{0}; idx<GLOVE_IMUS; idx++){
+            if(switchRawMode(idx, raw))
+                continue;
+            for(size_t prev{0}; prev<idx; prev++)
+                switchRawMode(prev, !raw);
+            return false;
+        }
+        return true;
+    }
+
+    // Leaving the raw mode reloads the DMP firmware, which forgets the offsets.
+    bool Glove::switchRawMode(size_t idx, bool raw) noexcept{
+        if(!selectAccel(GLOVE_TOPOLOGY.imus[idx].muxChannel) || !board.imu.setRawMode(raw))
+            return false;
+
+        if(raw){
+            // From the last DMP orientation: no convergence transient.
+            angles.filter[idx].reset(angles.quaternion[idx]);
+            angles.lastRawUs[idx] = board.clock.nowUs();
+        } else {
+            board.imu.setOffsets(angles.offsets[idx]);
+        }
+        return true;
+    }
+
+    void Glove::setFusion(FILTER_KIND kind, float gain) noexcept{
+        for(auto& filter: angles.filter)
+            filter.configure(kind, gain);
+    }
+
+    // Reads from the IMU already selected on the mux.
+    bool Glove::readRaw(size_t idx) noexcept{
+        // Longer gaps (a stalled task) are not integrated as a single step.
+        const float  MAX_STEP_S { 0.02f };
+        RawImu       raw;
 
-        selectAccel(angles[HANDIDX].device);
+        if(!bus.timed([&]{ return board.imu.readRaw(raw); })){
+            angles.movement[idx] = false;
+            angles.stats[idx].empty++;
+            return false;
+        }
+
+        const uint32_t now  { board.clock.nowUs() };
+        const float    step { (now - angles.lastRawUs[idx]) / 1000000.0f };
+
+        angles.lastRawUs[idx] = now;
+        angles.filter[idx].update(raw, step < MAX_STEP_S ? step : MAX_STEP_S);
+        angles.quaternion[idx] = angles.filter[idx].quaternion();
+        eulerFromQuat(angles.quaternion[idx], angles.euler[idx]);
+        angles.movement[idx] = true;
+        angles.stats[idx].packets++;
+        return true;
+    }
+
+    void Glove::readAccel(size_t idx) noexcept{
+        if(selectAccel(GLOVE_TOPOLOGY.imus[idx].muxChannel))
+            readPacket(idx);
+        else
+            angles.movement[idx] = false;
+    }
+
+    // Reads from the IMU already selected on the mux.
+    bool Glove::readPacket(size_t idx) noexcept{
+        const Quat previous { angles.quaternion[idx] };
 
-        if (mpu.dmpGetCurrentFIFOPacket(angles[HANDIDX].fifo_buffer)) {
-               angles[HANDIDX].movement = true;
-               mpu.dmpGetQuaternion(&(angles[HANDIDX].quaternion), angles[HANDIDX].fifo_buffer);
-               mpu.dmpGetEuler(angles[HANDIDX].euler, &(angles[HANDIDX].quaternion));
+        if (bus.timed([&]{ return board.imu.readQuaternion(angles.quaternion[idx]); })) {
+               angles.movement[idx] = true;
+               angles.stats[idx].packets++;
+               if(memcmp(&previous, &angles.quaternion[idx], sizeof(Quat)) == 0)
+                   angles.stats[idx].duplicates++;
+               eulerFromQuat(angles.quaternion[idx], angles.euler[idx]);
         } else  {
-               angles[HANDIDX].movement = false;
+               angles.movement[idx] = false;
+               angles.stats[idx].empty++;
         }
+
+        return angles.movement[idx];
     }
 
-    void   Glove::selectAccel(uint8_t addr)  noexcept{
+    // A failed switch has already been through a bus recovery: the caller
+    // just skips this device until the next pass.
+    bool   Glove::selectAccel(uint8_t addr)  noexcept{
        if(addr > 0x7) {
-           Serial.print("Error: invalid multiplexer subaddr: ");
-           Serial.println(addr);
+           board.console.printf("Error: invalid multiplexer subaddr: %u\r\n", addr);
            stale();
        }
 
-       Wire.beginTransmission(TCAADDR);
-       Wire.write(1 << addr);
-       Wire.endTransmission();  
+       return bus.select(addr);
     }
   
     void   Glove::printPortStats(bool block) noexcept{
-        Serial.println("-------------");
+        board.console.print("-------------\r\n");
         for (uint8_t t=0; t<8; t++) {
             selectAccel(t);
-            Serial.print("TCA9548 Port #"); 
-            Serial.println(t);
+            board.console.printf("TCA9548 Port #%u\r\n", t);
 
             for (uint8_t addr = 0; addr <= 0x7F; addr++) {
-                 if (addr == TCAADDR) continue;
-
-                 Wire.beginTransmission(addr);
-                 if (!Wire.endTransmission()) {
-                    Serial.print("Found I2C with addr 0x");  
-                    Serial.println(addr,HEX);
-                 }
+                 if (board.mux.probe(addr))
+                    board.console.printf("Found I2C with addr 0x%X\r\n", addr);
             }
         }
-        Serial.println("\nScan Complete.");
-        Serial.println("-------------");
+        board.console.print("\r\nScan Complete.\r\n");
+        board.console.print("-------------\r\n");
 
         if(block) stale();
     }
@@ -0,0 +1,189 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+#include "scheduler.h"
+
+// Hardware abstraction: Glove only talks to these interfaces. The ESP32
+// implementations are in hal_esp32.h, the simulated ones in hal_sim.h.
+
+namespace glove {
+
+    struct Quat{
+        float  w  { 1.0f },
+               x  { 0.0f },
+               y  { 0.0f },
+               z  { 0.0f };
+    };
+
+    // Same convention as MPU6050::dmpGetEuler(): psi, theta, phi in radians.
+    inline void eulerFromQuat(const Quat& q, float* euler) noexcept{
+        euler[0] = atan2f(2 * q.x * q.y - 2 * q.w * q.z, 2 * q.w * q.w + 2 * q.x * q.x - 1);
+        euler[1] = -asinf(2 * q.x * q.z + 2 * q.w * q.y);
+        euler[2] = atan2f(2 * q.y * q.z - 2 * q.w * q.x, 2 * q.w * q.w + 2 * q.z * q.z - 1);
+    }
+
+    // Raw MPU-6050 registers, in the ranges set by Imu::setRawMode().
+    struct RawImu{
+        int16_t  accel[3]  {},
+                 gyro[3]   {};
+    };
+
+    // RGB565, same values as TFT_eSPI.
+    enum COLOURS : uint16_t { COL_BLACK=0x0000, COL_BLUE=0x001F, COL_RED=0xF800, COL_GREEN=0x07E0,
+                              COL_YELLOW=0xFFE0, COL_ORANGE=0xFDA0, COL_WHITE=0xFFFF };
+
+    class Adc{
+        public:
+            virtual            ~Adc(void)                               = default;
+            virtual void       configure(uint8_t pin, bool pulldown)    noexcept = 0;
+            virtual uint16_t   read(uint8_t pin)                        noexcept = 0;   // 12 bit
+
+            // Background conversion of 'pins' (DMA on the ESP32): a reading per pin
+            // 'hz' times a second, each the mean of 'oversample' conversions.
+            // False if the board can't, read() is the only way then.
+            virtual bool       startContinuous(const uint8_t* pins, size_t count,
+                                               uint32_t hz, uint16_t oversample) noexcept;
+            virtual void       stopContinuous(void)                     noexcept {}
+            // Oldest reading not taken yet, in startContinuous() order, and the
+            // clock time its last conversion ended; false if none.
+            virtual bool       readContinuous(uint16_t* values, uint32_t& atUs) noexcept;
+    };
+
+    inline bool Adc::startContinuous(const uint8_t*, size_t, uint32_t, uint16_t) noexcept{
+        return false;
+    }
+
+    inline bool Adc::readContinuous(uint16_t*, uint32_t&) noexcept{
+        return false;
+    }
+
+    // TCA9548A style multiplexer: one channel at a time is connected to the bus.
+    class I2cMux{
+        public:
+            virtual            ~I2cMux(void)                            = default;
+            virtual bool       select(uint8_t channel)                  noexcept = 0;
+            virtual bool       probe(uint8_t addr)                      noexcept = 0;
+            virtual bool       setSpeed(uint32_t hz)                    noexcept = 0;
+            // Frees a slave holding SDA low and restarts the controller; false if the bus stays stuck.
+            virtual bool       recover(void)                            noexcept = 0;
+    };
+
+    // The IMU answering on the currently selected mux channel.
+    class Imu{
+        public:
+            virtual            ~Imu(void)                               = default;
+            virtual uint8_t    initialize(void)                         noexcept = 0;   // 0: ok, else DMP error code
+            virtual bool       testConnection(void)                     noexcept = 0;
+            virtual void       calibrate(uint8_t loops)                 noexcept = 0;
+            virtual bool       readQuaternion(Quat& quat)               noexcept = 0;   // false: no new packet
+            virtual uint16_t   pendingPackets(void)                     noexcept = 0;   // packets waiting in the FIFO
+            // Accel x,y,z then gyro x,y,z; setOffsets() replaces calibrate() and enables the DMP as well.
+            virtual void       getOffsets(int16_t* offsets)             noexcept = 0;
+            virtual void       setOffsets(const int16_t* offsets)       noexcept = 0;
+            // DMP off, accel and gyro at the full sample rate; leaving it needs initialize() again.
+            virtual bool       setRawMode(bool raw)                     noexcept = 0;
+            virtual bool       readRaw(RawImu& raw)                     noexcept = 0;   // false: bus error
+    };
+
+    using IrqHandler = void (*)(void* ctx);
+
+    // IRQ_RISING for pulses (the IMU INT lines), IRQ_CHANGE for levels (the buttons).
+    enum IRQ_EDGE : uint8_t { IRQ_RISING=0, IRQ_CHANGE=1 };
+
+    // Edge interrupts on GPIO lines, the handler runs in interrupt context.
+    class GpioIrq{
+        public:
+            virtual            ~GpioIrq(void)                           = default;
+            virtual bool       attach(uint8_t pin, IrqHandler handler, void* ctx,
+                                      IRQ_EDGE edge)                    noexcept = 0;
+            virtual void       detach(uint8_t pin)                      noexcept = 0;
+            // Level of an input line, true if high.
+            virtual bool       level(uint8_t pin)                       noexcept = 0;
+    };
+
+    // Small persistent records, survive a reset.
+    class KvStore{
+        public:
+            virtual            ~KvStore(void)                           = default;
+            // Bytes copied, 0 if the key is missing or the record is larger than 'len'.
+            virtual size_t     get(const char* key, uint8_t* data, size_t len) noexcept = 0;
+            virtual bool       put(const char* key, const uint8_t* data, size_t len) noexcept = 0;
+            virtual bool       erase(const char* key)                   noexcept = 0;
+    };
+
+    class Display{
+        public:
+            virtual            ~Display(void)                           = default;
+            virtual void       clear(void)                              noexcept = 0;
+            virtual void       drawString(const char* text, int16_t x, int16_t y,
+                                          uint8_t font, uint16_t colour) noexcept = 0;
+            virtual void       drawCentreString(const char* text, int16_t x, int16_t y,
+                                                uint8_t font, uint16_t colour) noexcept = 0;
+            // Pushes what was drawn since the previous call, for displays drawing in RAM first.
+            virtual void       flush(void)                              noexcept {}
+    };
+
+    class Transport{
+        public:
+            virtual            ~Transport(void)                         = default;
+            virtual size_t     write(const uint8_t* data, size_t len)   noexcept = 0;
+            virtual int        read(void)                               noexcept { return -1; }
+
+            size_t             print(const char* text)                  noexcept;
+            size_t             printf(const char* fmt, ...)             noexcept __attribute__((format(printf, 2, 3)));
+    };
+
+    inline size_t Transport::print(const char* text) noexcept{
+        return write(reinterpret_cast<const uint8_t*>(text), strlen(text));
+    }
+
+    inline size_t Transport::printf(const char* fmt, ...) noexcept{
+        char    line[160];
+        va_list args;
+
+        va_start(args, fmt);
+        const int len { vsnprintf(line, sizeof(line), fmt, args) };
+        va_end(args);
+
+        if(len <= 0)
+            return 0;
+        return write(reinterpret_cast<const uint8_t*>(line), static_cast<size_t>(len) < sizeof(line) ? len : sizeof(line) - 1);
+    }
+
+    // Everything Glove needs from the board it runs on.
+    struct Board{
+        Clock&       clock;
+        Adc&         adc;
+        I2cMux&      mux;
+        Imu&         imu;
+        GpioIrq&     irq;
+        KvStore&     store;       // calibration profiles
+        Display&     display;
+        Transport&   console;     // USB serial
+        Transport&   link;        // Bluetooth
+    };
+
+} // End namespace glove
@@ -0,0 +1,599 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <Arduino.h>
+#include <TFT_eSPI.h>
+#include <SPI.h>
+#include "BluetoothSerial.h"
+#include "I2Cdev.h"
+#include "MPU6050_6Axis_MotionApps612.h"
+#include <Preferences.h>
+#if ESP_ARDUINO_VERSION_MAJOR < 3
+#include <driver/adc.h>
+#endif
+#include "hal.h"
+#include "identity.h"
+#include "layout.h"
+
+namespace glove {
+
+    class ArduinoClock : public Clock{
+        public:
+            uint32_t   nowUs(void)              const noexcept override { return micros(); }
+            void       sleepUs(uint32_t us)           noexcept override;
+    };
+
+    inline void ArduinoClock::sleepUs(uint32_t us) noexcept{
+        // Sleep with delay() when possible so the idle task can feed the watchdog.
+        if(us >= 1000)
+            delay(us / 1000);
+        else if(us > 0)
+            delayMicroseconds(us);
+    }
+
+    // Background conversion through the ADC DMA: the Arduino core from 3.0
+    // wraps it, with the 2.x cores it's the ESP-IDF 4.4 digital controller.
+    class EspAdc : public Adc{
+        public:
+            void       configure(uint8_t pin, bool pulldown)  noexcept override { pinMode(pin, pulldown ? INPUT_PULLDOWN : INPUT); }
+            uint16_t   read(uint8_t pin)                      noexcept override { return analogRead(pin); }
+            // ADC1 pins only: ADC2 is shared with the radio.
+            bool       startContinuous(const uint8_t* pins, size_t count,
+                                       uint32_t hz, uint16_t oversample) noexcept override;
+            void       stopContinuous(void)                   noexcept override;
+            bool       readContinuous(uint16_t* values, uint32_t& atUs) noexcept override;
+
+        private:
+            // Lowest scan rate of the ESP32 ADC DMA.
+            static const uint32_t MIN_SCAN_HZ  { 20000 };
+
+            size_t     contCount                              { 0 };
+#if ESP_ARDUINO_VERSION_MAJOR < 3
+            static const size_t   MAX_PINS     { 8 },
+                                  FRAME_BYTES  { 256 };
+
+            uint8_t    contChannels[MAX_PINS]                 {};
+            uint16_t   contOversample                         { 0 },
+                       contTaken[MAX_PINS]                    {};
+            uint32_t   contSums[MAX_PINS]                     {},
+                       contScanHz                             { 0 },
+                       frameUs                                { 0 },
+                       frameLen                               { 0 },
+                       framePos                               { 0 };
+            uint8_t    frame[FRAME_BYTES]                     {};
+#endif
+    };
+
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    inline bool EspAdc::startContinuous(const uint8_t* pins, size_t count, uint32_t hz, uint16_t oversample) noexcept{
+        stopContinuous();
+
+        // The core averages 'oversample' conversions per pin into each reading;
+        // the scan rate is the total over the pins, raised to what the DMA accepts.
+        const uint32_t scanHz { max(MIN_SCAN_HZ, static_cast<uint32_t>(hz * oversample * count)) };
+        if(!analogContinuous(pins, count, oversample, scanHz, nullptr) || !analogContinuousStart()){
+            analogContinuousDeinit();
+            return false;
+        }
+        contCount = count;
+        return true;
+    }
+
+    inline void EspAdc::stopContinuous(void) noexcept{
+        if(contCount == 0)
+            return;
+        analogContinuousStop();
+        analogContinuousDeinit();
+        contCount = 0;
+    }
+
+    // The core keeps the last complete reading only, older ones are lost: it
+    // is dated when taken, so the spacing follows the reads.
+    inline bool EspAdc::readContinuous(uint16_t* values, uint32_t& atUs) noexcept{
+        adc_continuous_data_t* data { nullptr };
+        if(contCount == 0 || !analogContinuousRead(&data, 0))
+            return false;
+
+        for(size_t idx{0}; idx<contCount; idx++)
+            values[idx] = static_cast<uint16_t>(data[idx].avg_read_raw);
+        atUs = micros();
+        return true;
+    }
+#else
+    inline bool EspAdc::startContinuous(const uint8_t* pins, size_t count, uint32_t hz, uint16_t oversample) noexcept{
+        stopContinuous();
+        if(count == 0 || count > MAX_PINS || hz == 0 || oversample == 0)
+            return false;
+
+        adc_digi_pattern_config_t pattern[MAX_PINS];
+        uint32_t                  mask { 0 };
+        for(size_t idx{0}; idx<count; idx++){
+            const int  chan { digitalPinToAnalogChannel(pins[idx]) };
+            if(chan < 0 || chan >= 8)
+                return false;
+            contChannels[idx]     = static_cast<uint8_t>(chan);
+            mask                 |= 1u << chan;
+            pattern[idx].atten     = ADC_ATTEN_DB_11;
+            pattern[idx].channel   = static_cast<uint8_t>(chan);
+            pattern[idx].unit      = 0;
+            pattern[idx].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+        }
+
+        // The readings are averaged here from the raw conversions; the scan
+        // rate is the total over the pins, raised to what the DMA accepts.
+        contScanHz = max(MIN_SCAN_HZ, static_cast<uint32_t>(hz * oversample * count));
+        adc_digi_init_config_t    init  { };
+        init.max_store_buf_size = 4 * FRAME_BYTES;
+        init.conv_num_each_intr = FRAME_BYTES;
+        init.adc1_chan_mask     = mask;
+        adc_digi_configuration_t  config { };
+        config.conv_limit_en  = true;
+        config.conv_limit_num = 250;
+        config.pattern_num    = count;
+        config.adc_pattern    = pattern;
+        config.sample_freq_hz = contScanHz;
+        config.conv_mode      = ADC_CONV_SINGLE_UNIT_1;
+        config.format         = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+        if(adc_digi_initialize(&init) != ESP_OK)
+            return false;
+        if(adc_digi_controller_configure(&config) != ESP_OK || adc_digi_start() != ESP_OK){
+            adc_digi_deinitialize();
+            return false;
+        }
+
+        contCount      = count;
+        contOversample = oversample;
+        frameLen       = 0;
+        framePos       = 0;
+        for(size_t idx{0}; idx<count; idx++){
+            contSums[idx]  = 0;
+            contTaken[idx] = 0;
+        }
+        return true;
+    }
+
+    inline void EspAdc::stopContinuous(void) noexcept{
+        if(contCount == 0)
+            return;
+        adc_digi_stop();
+        adc_digi_deinitialize();
+        contCount = 0;
+    }
+
+    // Walks the conversions of the last frame taken from the DMA, fetching the
+    // next one when it's over, until every pin has 'oversample' of them. A
+    // frame ends when it's fetched, the conversions before are dated back
+    // at the scan rate.
+    inline bool EspAdc::readContinuous(uint16_t* values, uint32_t& atUs) noexcept{
+        if(contCount == 0)
+            return false;
+
+        while(true){
+            if(framePos >= frameLen){
+                framePos = 0;
+                // ESP_ERR_INVALID_STATE: the ring overflowed, the oldest are lost.
+                const esp_err_t err { adc_digi_read_bytes(frame, FRAME_BYTES, &frameLen, 0) };
+                if(err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+                    frameLen = 0;
+                if(frameLen == 0)
+                    return false;
+                frameUs = micros();
+            }
+
+            const adc_digi_output_data_t* conv { reinterpret_cast<const adc_digi_output_data_t*>(frame + framePos) };
+            framePos += sizeof(adc_digi_output_data_t);
+            for(size_t idx{0}; idx<contCount; idx++){
+                if(contChannels[idx] != conv->type1.channel || contTaken[idx] >= contOversample)
+                    continue;
+                contSums[idx] += conv->type1.data;
+                contTaken[idx]++;
+                break;
+            }
+
+            bool complete { true };
+            for(size_t idx{0}; idx<contCount && complete; idx++)
+                complete = contTaken[idx] >= contOversample;
+            if(!complete)
+                continue;
+
+            for(size_t idx{0}; idx<contCount; idx++){
+                values[idx]    = static_cast<uint16_t>((contSums[idx] + contOversample / 2) / contOversample);
+                contSums[idx]  = 0;
+                contTaken[idx] = 0;
+            }
+            const uint32_t after { (frameLen - framePos) / sizeof(adc_digi_output_data_t) };
+            atUs = frameUs - static_cast<uint32_t>(static_cast<uint64_t>(after) * 1000000 / contScanHz);
+            return true;
+        }
+    }
+#endif
+
+    class EspI2cMux : public I2cMux{
+        public:
+            void       begin(int sda, int scl, uint32_t speed) noexcept;
+            bool       select(uint8_t channel)                 noexcept override;
+            bool       probe(uint8_t addr)                     noexcept override;
+            bool       setSpeed(uint32_t hz)                   noexcept override;
+            bool       recover(void)                           noexcept override;
+
+        private:
+            const uint8_t  TCAADDR           { 0x70 };
+            const uint16_t TIMEOUT_MS        { 10 };
+
+            int            sdaPin            { -1 },
+                           sclPin            { -1 };
+            uint32_t       busSpeed          { 100000 };
+    };
+
+    inline void EspI2cMux::begin(int sda, int scl, uint32_t speed) noexcept{
+        sdaPin   = sda;
+        sclPin   = scl;
+        busSpeed = speed;
+        Wire.begin(sda, scl, speed);
+        Wire.setTimeOut(TIMEOUT_MS);
+    }
+
+    // The TCA9548A and the MPU-6050 are rated for 400 kHz, 1 MHz is out of spec.
+    inline bool EspI2cMux::setSpeed(uint32_t hz) noexcept{
+        if(hz == 0 || hz > 1000000)
+            return false;
+        busSpeed = hz;
+        Wire.setClock(hz);
+        return true;
+    }
+
+    // Standard recovery: up to nine SCL pulses until the slave releases SDA, then a STOP.
+    inline bool EspI2cMux::recover(void) noexcept{
+        Wire.end();
+
+        pinMode(sdaPin, INPUT_PULLUP);
+        pinMode(sclPin, OUTPUT_OPEN_DRAIN);
+        digitalWrite(sclPin, HIGH);
+        for(int pulse{0}; pulse<9 && digitalRead(sdaPin) == LOW; pulse++){
+            digitalWrite(sclPin, LOW);
+            delayMicroseconds(5);
+            digitalWrite(sclPin, HIGH);
+            delayMicroseconds(5);
+        }
+
+        pinMode(sdaPin, OUTPUT_OPEN_DRAIN);
+        digitalWrite(sdaPin, LOW);
+        delayMicroseconds(5);
+        digitalWrite(sdaPin, HIGH);
+        delayMicroseconds(5);
+
+        const bool released { digitalRead(sdaPin) == HIGH };
+        begin(sdaPin, sclPin, busSpeed);
+        return released;
+    }
+
+    inline bool EspI2cMux::select(uint8_t channel) noexcept{
+        if(channel > 0x7)
+            return false;
+
+        Wire.beginTransmission(TCAADDR);
+        Wire.write(1 << channel);
+        return Wire.endTransmission() == 0;
+    }
+
+    inline bool EspI2cMux::probe(uint8_t addr) noexcept{
+        if(addr == TCAADDR)
+            return false;
+
+        Wire.beginTransmission(addr);
+        return Wire.endTransmission() == 0;
+    }
+
+    class EspImu : public Imu{
+        public:
+            uint8_t    initialize(void)                   noexcept override;
+            bool       testConnection(void)               noexcept override { return mpu.testConnection(); }
+            void       calibrate(uint8_t loops)           noexcept override;
+            bool       readQuaternion(Quat& quat)         noexcept override;
+            uint16_t   pendingPackets(void)               noexcept override;
+            void       getOffsets(int16_t* offsets)       noexcept override;
+            void       setOffsets(const int16_t* offsets) noexcept override;
+            bool       setRawMode(bool raw)               noexcept override;
+            bool       readRaw(RawImu& raw)               noexcept override;
+
+        private:
+            static const uint16_t NO_COUNT   { 0xFFFF };
+            const uint16_t FIFO_SIZE         { 1024 };
+
+            MPU6050      mpu;
+            uint8_t      fifo_buffer[64]     {};
+            uint16_t     fifoCount           { NO_COUNT };   // from pendingPackets(), used by the next read
+    };
+
+    inline uint8_t EspImu::initialize(void) noexcept{
+        mpu.initialize();
+        return mpu.dmpInitialize();
+    }
+
+    inline void EspImu::calibrate(uint8_t loops) noexcept{
+        mpu.setXGyroOffset(0);
+        mpu.setYGyroOffset(0);
+        mpu.setZGyroOffset(0);
+        mpu.setXAccelOffset(0);
+        mpu.setYAccelOffset(0);
+        mpu.setZAccelOffset(0);
+
+        mpu.CalibrateAccel(loops);
+        mpu.CalibrateGyro(loops);
+
+        mpu.setDMPEnabled(true);
+    }
+
+    inline void EspImu::getOffsets(int16_t* offsets) noexcept{
+        offsets[0] = mpu.getXAccelOffset();
+        offsets[1] = mpu.getYAccelOffset();
+        offsets[2] = mpu.getZAccelOffset();
+        offsets[3] = mpu.getXGyroOffset();
+        offsets[4] = mpu.getYGyroOffset();
+        offsets[5] = mpu.getZGyroOffset();
+    }
+
+    inline void EspImu::setOffsets(const int16_t* offsets) noexcept{
+        mpu.setXAccelOffset(offsets[0]);
+        mpu.setYAccelOffset(offsets[1]);
+        mpu.setZAccelOffset(offsets[2]);
+        mpu.setXGyroOffset(offsets[3]);
+        mpu.setYGyroOffset(offsets[4]);
+        mpu.setZGyroOffset(offsets[5]);
+
+        mpu.setDMPEnabled(true);
+    }
+
+    // 1 kHz accel and gyro (DLPF at 42 Hz, divider 0), +-4 g and +-2000 dps,
+    // data ready on INT; the offset registers still apply.
+    inline bool EspImu::setRawMode(bool raw) noexcept{
+        if(!raw)
+            return initialize() == 0;
+
+        mpu.setDMPEnabled(false);
+        mpu.setIntDMPEnabled(false);
+        mpu.setDLPFMode(MPU6050_DLPF_BW_42);
+        mpu.setRate(0);
+        mpu.setFullScaleGyroRange(MPU6050_GYRO_FS_2000);
+        mpu.setFullScaleAccelRange(MPU6050_ACCEL_FS_4);
+        mpu.setIntDataReadyEnabled(true);
+        fifoCount = NO_COUNT;
+        return true;
+    }
+
+    // The library doesn't report bus errors here.
+    inline bool EspImu::readRaw(RawImu& raw) noexcept{
+        mpu.getMotion6(&raw.accel[0], &raw.accel[1], &raw.accel[2],
+                       &raw.gyro[0],  &raw.gyro[1],  &raw.gyro[2]);
+        return true;
+    }
+
+    // Skips the stale packets and reads the newest one in a single burst.
+    inline bool EspImu::readQuaternion(Quat& quat) noexcept{
+        const uint16_t size  { mpu.dmpGetFIFOPacketSize() };
+        uint16_t       count { fifoCount != NO_COUNT ? fifoCount : mpu.getFIFOCount() };
+
+        fifoCount = NO_COUNT;
+        if(size == 0 || count < size)
+            return false;
+        if(count % size != 0 || count >= FIFO_SIZE){
+            // Overflowed or misaligned: the packet boundaries are lost.
+            mpu.resetFIFO();
+            return false;
+        }
+
+        const uint16_t maxChunk { static_cast<uint16_t>(sizeof(fifo_buffer)) };
+        while(count > size){
+            const uint16_t chunk { static_cast<uint16_t>(count - size < maxChunk ? count - size : maxChunk) };
+            mpu.getFIFOBytes(fifo_buffer, static_cast<uint8_t>(chunk));
+            count -= chunk;
+        }
+        mpu.getFIFOBytes(fifo_buffer, static_cast<uint8_t>(size));
+
+        Quaternion raw;
+        mpu.dmpGetQuaternion(&raw, fifo_buffer);
+        quat.w = raw.w;
+        quat.x = raw.x;
+        quat.y = raw.y;
+        quat.z = raw.z;
+        return true;
+    }
+
+    // One FIFO count read, remembered so that readQuaternion() doesn't repeat it.
+    inline uint16_t EspImu::pendingPackets(void) noexcept{
+        const uint16_t size { mpu.dmpGetFIFOPacketSize() };
+        const uint16_t count { mpu.getFIFOCount() };
+
+        // Kept only when a read is bound to follow.
+        fifoCount = size != 0 && count >= size ? count : NO_COUNT;
+        return size == 0 ? 0 : count / size;
+    }
+
+    // dmpInitialize() already routes the DMP interrupt to INT, as a 50us high pulse.
+    class EspIrq : public GpioIrq{
+        public:
+            bool       attach(uint8_t pin, IrqHandler handler, void* ctx,
+                              IRQ_EDGE edge)                 noexcept override;
+            void       detach(uint8_t pin)                   noexcept override { detachInterrupt(digitalPinToInterrupt(pin)); }
+            bool       level(uint8_t pin)                    noexcept override { return digitalRead(pin) == HIGH; }
+    };
+
+    inline bool EspIrq::attach(uint8_t pin, IrqHandler handler, void* ctx, IRQ_EDGE edge) noexcept{
+        if(digitalPinToInterrupt(pin) < 0)
+            return false;
+
+        // The buttons keep the pull down set by Adc::configure().
+        if(edge == IRQ_RISING)
+            pinMode(pin, INPUT);
+        attachInterruptArg(digitalPinToInterrupt(pin), handler, ctx, edge == IRQ_CHANGE ? CHANGE : RISING);
+        return true;
+    }
+
+    // Records in the "glove" NVS namespace.
+    class NvsStore : public KvStore{
+        public:
+            void       begin(void)                                   noexcept { prefs.begin(NAMESPACE, false); }
+            size_t     get(const char* key, uint8_t* data, size_t len) noexcept override;
+            bool       put(const char* key, const uint8_t* data, size_t len) noexcept override;
+            bool       erase(const char* key)                        noexcept override;
+
+        private:
+            const char* const NAMESPACE      { "glove" };
+
+            Preferences  prefs;
+    };
+
+    inline size_t NvsStore::get(const char* key, uint8_t* data, size_t len) noexcept{
+        if(!prefs.isKey(key) || prefs.getBytesLength(key) > len)
+            return 0;
+        return prefs.getBytes(key, data, len);
+    }
+
+    inline bool NvsStore::put(const char* key, const uint8_t* data, size_t len) noexcept{
+        return prefs.putBytes(key, data, len) == len;
+    }
+
+    inline bool NvsStore::erase(const char* key) noexcept{
+        return !prefs.isKey(key) || prefs.remove(key);
+    }
+
+    // Built with -DGLOVE_TFT_SPRITE, strings starting inside STATUS_AREA are
+    // drawn in a 23 KB sprite, sent by flush() with a single DMA transfer.
+    class TftDisplay : public Display{
+        public:
+            void       begin(void)                                   noexcept;
+            void       clear(void)                                   noexcept override { tft.fillScreen(TFT_BLACK); }
+            void       drawString(const char* text, int16_t x, int16_t y,
+                                  uint8_t font, uint16_t colour)     noexcept override;
+            void       drawCentreString(const char* text, int16_t x, int16_t y,
+                                        uint8_t font, uint16_t colour) noexcept override;
+            void       flush(void)                                   noexcept override;
+
+        private:
+            TFT_eSPI   tft;
+#if defined(GLOVE_TFT_SPRITE)
+            TFT_eSprite sprite               { &tft };
+            bool       spriteReady           { false },
+                       spriteDirty           { false };
+
+            bool       inSprite(int16_t x, int16_t y)          const noexcept;
+#endif
+    };
+
+    inline void TftDisplay::begin(void) noexcept{
+        tft.init();
+        tft.setRotation(1);
+        tft.fillScreen(TFT_BLACK);
+        tft.setTextColor(TFT_YELLOW, TFT_BLACK); // Note: the new fonts do not draw the background colour
+#if defined(GLOVE_TFT_SPRITE)
+        // Without the memory the strings go straight to the TFT, as before.
+        sprite.setColorDepth(16);
+        spriteReady = sprite.createSprite(STATUS_W, STATUS_H) != nullptr && tft.initDMA();
+        if(spriteReady)
+            sprite.fillSprite(TFT_BLACK);
+#endif
+    }
+
+#if defined(GLOVE_TFT_SPRITE)
+    inline bool TftDisplay::inSprite(int16_t x, int16_t y) const noexcept{
+        return spriteReady && x >= STATUS_X && x < STATUS_X + STATUS_W && y >= STATUS_Y && y < STATUS_Y + STATUS_H;
+    }
+#endif
+
+    inline void TftDisplay::drawString(const char* text, int16_t x, int16_t y, uint8_t font, uint16_t colour) noexcept{
+#if defined(GLOVE_TFT_SPRITE)
+        if(inSprite(x, y)){
+            sprite.setTextColor(colour, TFT_BLACK);
+            sprite.drawString(text, x - STATUS_X, y - STATUS_Y, font);
+            spriteDirty = true;
+            return;
+        }
+#endif
+        tft.setTextColor(colour, TFT_BLACK);
+        tft.drawString(text, x, y, font);
+    }
+
+    inline void TftDisplay::flush(void) noexcept{
+#if defined(GLOVE_TFT_SPRITE)
+        if(!spriteDirty)
+            return;
+        // The sprite buffer is already in the panel byte order.
+        tft.startWrite();
+        tft.pushImageDMA(STATUS_X, STATUS_Y, STATUS_W, STATUS_H, static_cast<uint16_t*>(sprite.getPointer()));
+        tft.dmaWait();
+        tft.endWrite();
+        spriteDirty = false;
+#endif
+    }
+
+    inline void TftDisplay::drawCentreString(const char* text, int16_t x, int16_t y, uint8_t font, uint16_t colour) noexcept{
+        tft.setTextColor(colour, TFT_BLACK);
+        tft.drawCentreString(text, x, y, font);
+    }
+
+    // Both HardwareSerial and BluetoothSerial are Arduino Streams.
+    class StreamTransport : public Transport{
+        public:
+            explicit   StreamTransport(Stream& strm)                 noexcept : stream{strm} {}
+            size_t     write(const uint8_t* data, size_t len)        noexcept override { return stream.write(data, len); }
+            int        read(void)                                    noexcept override { return stream.available() > 0 ? stream.read() : -1; }
+
+        private:
+            Stream&    stream;
+    };
+
+    // The TTGO board: owns the ESP32 implementations and hands them to Glove.
+    class EspBoard{
+        public:
+                       EspBoard(void)                                noexcept;
+            Board      board(void)                                   noexcept;
+
+        private:
+            const uint32_t SERIAL_SPEED      { 115200 };
+            const uint32_t I2C_BUS_SPEED     { 400000 };
+
+            const int      SDA_PIN           { 21 },
+                           SCL_PIN           { 22 };
+
+            ArduinoClock    clock;
+            EspAdc          adc;
+            EspI2cMux       mux;
+            EspImu          imu;
+            EspIrq          irq;
+            NvsStore        store;
+            TftDisplay      display;
+            BluetoothSerial bluetoothLink;
+            StreamTransport console          { Serial };
+            StreamTransport link             { bluetoothLink };
+    };
+
+    inline EspBoard::EspBoard(void) noexcept{
+        Serial.begin(SERIAL_SPEED);
+        display.begin();
+        store.begin();
+        // One name per glove, set with CMD_SET_IDENTITY: DEFAULT_GLOVE_NAME until then.
+        bluetoothLink.begin(loadIdentity(store).name);
+        mux.begin(SDA_PIN, SCL_PIN, I2C_BUS_SPEED);
+    }
+
+    inline Board EspBoard::board(void) noexcept{
+        return Board{ clock, adc, mux, imu, irq, store, display, console, link };
+    }
+
+} // End namespace glove
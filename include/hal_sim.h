@@ -0,0 +1,755 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include "hal.h"
+#include "layout.h"
+
+// Simulated board for host builds: sensors either replay recorded traces or
+// produce synthetic waves, all timed by the (usually fake) board clock.
+
+namespace glove {
+
+    class SimAdc : public Adc{
+        public:
+            explicit   SimAdc(const Clock& clk)                       noexcept : clock{clk} {}
+
+            void       configure(uint8_t pin, bool pulldown)          noexcept override;
+            uint16_t   read(uint8_t pin)                              noexcept override;
+
+            // Sine between lo and hi.
+            void       setWave(uint8_t pin, uint16_t lo, uint16_t hi,
+                               uint32_t periodUs, uint32_t phaseUs=0) noexcept;
+            void       setConstant(uint8_t pin, uint16_t val)         noexcept { setWave(pin, val, val, 1); }
+            // Replays 'len' samples spaced 'periodUs', looping.
+            void       setTrace(uint8_t pin, const uint16_t* samples,
+                                size_t len, uint32_t periodUs)        noexcept;
+            // Uniform noise of +-'amplitude' counts on every conversion.
+            void       setNoise(uint16_t amplitude)                   noexcept { noise = amplitude; }
+            // Lowest total conversion rate, as the ESP32 DMA has: below it the
+            // readings come faster than asked. Taken at the next start.
+            void       setMinScanHz(uint32_t hz)                      noexcept { minScanHz = hz; }
+
+            // The conversions of a reading are spread over its period; at most
+            // BACKLOG readings wait, the older ones are lost like in a DMA ring.
+            bool       startContinuous(const uint8_t* pins, size_t count,
+                                       uint32_t hz, uint16_t oversample) noexcept override;
+            void       stopContinuous(void)                           noexcept override { contCount = 0; }
+            bool       readContinuous(uint16_t* values, uint32_t& atUs) noexcept override;
+
+            uint32_t   reads(void)                              const noexcept { return readCount; }
+            uint32_t   conversions(void)                        const noexcept { return convCount; }
+            // Value of 'pin' now, noise free and not counted as a read.
+            uint16_t   peek(uint8_t pin)                        const noexcept { return wave(pin, clock.nowUs()); }
+
+        private:
+            static const size_t  PINS        { 40 },
+                                 CONT_PINS   { 8 },
+                                 BACKLOG     { 32 };
+
+            struct Channel{
+                uint16_t         lo          { 0 },
+                                 hi          { 0 };
+                uint32_t         periodUs    { 1 },
+                                 phaseUs     { 0 };
+                const uint16_t*  trace       { nullptr };
+                size_t           traceLen    { 0 };
+                bool             pulldown    { false };
+            };
+
+            const Clock&     clock;
+            Channel          channels[PINS];
+            uint32_t         readCount       { 0 },
+                             convCount       { 0 },
+                             noiseSeed       { 1 };
+            uint16_t         noise           { 0 };
+            uint32_t         minScanHz       { 0 };
+
+            uint8_t          contPins[CONT_PINS] {};
+            size_t           contCount       { 0 };
+            uint16_t         contOversample  { 1 };
+            uint32_t         contPeriodUs    { 0 },
+                             contNextUs      { 0 };
+
+            uint16_t   convert(uint8_t pin, uint32_t atUs)            noexcept;
+            uint16_t   wave(uint8_t pin, uint32_t atUs)         const noexcept;
+    };
+
+    inline void SimAdc::configure(uint8_t pin, bool pulldown) noexcept{
+        if(pin < PINS)
+            channels[pin].pulldown = pulldown;
+    }
+
+    inline void SimAdc::setWave(uint8_t pin, uint16_t lo, uint16_t hi, uint32_t periodUs, uint32_t phaseUs) noexcept{
+        if(pin >= PINS || periodUs == 0)
+            return;
+        channels[pin] = Channel{ lo, hi, periodUs, phaseUs, nullptr, 0, channels[pin].pulldown };
+    }
+
+    inline void SimAdc::setTrace(uint8_t pin, const uint16_t* samples, size_t len, uint32_t periodUs) noexcept{
+        if(pin >= PINS || periodUs == 0 || len == 0)
+            return;
+        channels[pin].trace    = samples;
+        channels[pin].traceLen = len;
+        channels[pin].periodUs = periodUs;
+    }
+
+    inline uint16_t SimAdc::read(uint8_t pin) noexcept{
+        readCount++;
+        return convert(pin, clock.nowUs());
+    }
+
+    inline uint16_t SimAdc::wave(uint8_t pin, uint32_t atUs) const noexcept{
+        if(pin >= PINS)
+            return 0;
+
+        const Channel& chan { channels[pin] };
+        if(chan.trace != nullptr)
+            return chan.trace[(atUs / chan.periodUs) % chan.traceLen];
+
+        const float    pos  { static_cast<float>((atUs + chan.phaseUs) % chan.periodUs) / chan.periodUs };
+        const float    wave { 0.5f - 0.5f * cosf(2.0f * static_cast<float>(M_PI) * pos) };
+        return static_cast<uint16_t>(chan.lo + wave * (chan.hi - chan.lo));
+    }
+
+    inline uint16_t SimAdc::convert(uint8_t pin, uint32_t atUs) noexcept{
+        convCount++;
+        if(pin >= PINS)
+            return 0;
+
+        int32_t        val  { wave(pin, atUs) };
+        if(noise > 0){
+            noiseSeed = noiseSeed * 1103515245 + 12345;
+            val      += static_cast<int32_t>((noiseSeed >> 16) % (2 * noise + 1)) - noise;
+        }
+        return static_cast<uint16_t>(val < 0 ? 0 : val > 4095 ? 4095 : val);
+    }
+
+    inline bool SimAdc::startContinuous(const uint8_t* pins, size_t count, uint32_t hz, uint16_t oversample) noexcept{
+        if(count == 0 || count > CONT_PINS || hz == 0 || oversample == 0)
+            return false;
+
+        memcpy(contPins, pins, count);
+        contCount      = count;
+        contOversample = oversample;
+        const uint64_t conversions { static_cast<uint64_t>(oversample) * count },
+                       scanHz      { std::max<uint64_t>(minScanHz, hz * conversions) };
+        contPeriodUs   = static_cast<uint32_t>(1000000 * conversions / scanHz);
+        contNextUs     = clock.nowUs() + contPeriodUs;
+        return true;
+    }
+
+    inline bool SimAdc::readContinuous(uint16_t* values, uint32_t& atUs) noexcept{
+        const uint32_t now { clock.nowUs() };
+
+        if(contCount == 0 || static_cast<int32_t>(now - contNextUs) < 0)
+            return false;
+        if(now - contNextUs > BACKLOG * contPeriodUs)
+            contNextUs = now - BACKLOG * contPeriodUs;
+
+        const uint32_t start { contNextUs - contPeriodUs };
+        for(size_t idx{0}; idx<contCount; idx++){
+            uint32_t sum { 0 };
+            for(uint16_t conv{0}; conv<contOversample; conv++)
+                sum += convert(contPins[idx], start + conv * contPeriodUs / contOversample);
+            values[idx] = static_cast<uint16_t>((sum + contOversample / 2) / contOversample);
+        }
+
+        atUs        = contNextUs;
+        contNextUs += contPeriodUs;
+        return true;
+    }
+
+    class SimMux : public I2cMux{
+        public:
+            bool       select(uint8_t channel)               noexcept override;
+            bool       probe(uint8_t addr)                   noexcept override;
+            bool       setSpeed(uint32_t hz)                 noexcept override;
+            bool       recover(void)                         noexcept override;
+
+            void       setPresent(uint8_t mask)              noexcept { present = mask; }
+            // The next 'count' selects are NACKed; 'stuck' makes recover() fail as well.
+            void       setFailures(uint32_t count, bool stuck=false) noexcept { failures = count; stuckBus = stuck; }
+            // Every transfer advances 'clk' by its duration on the wire.
+            void       setBusClock(FakeClock* clk)           noexcept { busClock = clk; }
+            void       transfer(uint32_t bytes)              noexcept;
+
+            uint8_t    selected(void)                  const noexcept { return channel; }
+            uint32_t   switches(void)                  const noexcept { return switchCount; }
+            uint32_t   recoveries(void)                const noexcept { return recoverCount; }
+            uint32_t   speed(void)                     const noexcept { return busSpeed; }
+
+        private:
+            const uint8_t  MPU_ADDR          { 0x68 };
+
+            uint8_t        present           { 1 << HAND | 1 << FOREARM | 1 << ARM };
+            uint8_t        channel           { 0 };
+            uint32_t       switchCount       { 0 },
+                           recoverCount      { 0 },
+                           failures          { 0 },
+                           busSpeed          { 100000 };
+            bool           stuckBus          { false };
+            FakeClock*     busClock          { nullptr };
+    };
+
+    inline bool SimMux::select(uint8_t chan) noexcept{
+        if(chan > 0x7)
+            return false;
+        transfer(2);
+        if(failures > 0){
+            failures--;
+            return false;
+        }
+        channel = chan;
+        switchCount++;
+        return true;
+    }
+
+    inline bool SimMux::probe(uint8_t addr) noexcept{
+        transfer(1);
+        return addr == MPU_ADDR && (present & (1 << channel));
+    }
+
+    inline bool SimMux::setSpeed(uint32_t hz) noexcept{
+        if(hz == 0 || hz > 1000000)
+            return false;
+        busSpeed = hz;
+        return true;
+    }
+
+    inline bool SimMux::recover(void) noexcept{
+        recoverCount++;
+        return !stuckBus;
+    }
+
+    // 9 clocks per byte, start and stop included in the rounding up.
+    inline void SimMux::transfer(uint32_t bytes) noexcept{
+        if(busClock != nullptr)
+            busClock->advanceUs((bytes * 9 + 2) * 1000000 / busSpeed + 1);
+    }
+
+    // Interrupt lines fired by hand, or by SimImu::raiseInterrupts(). The
+    // levels are set by hand too, or follow the ADC lines (the buttons).
+    class SimIrq : public GpioIrq{
+        public:
+            bool       attach(uint8_t pin, IrqHandler handler, void* ctx,
+                              IRQ_EDGE edge)                 noexcept override;
+            void       detach(uint8_t pin)                   noexcept override;
+            bool       level(uint8_t pin)                    noexcept override { return pin < PINS && levels[pin]; }
+
+            void       fire(uint8_t pin)                     noexcept;
+            // Fires the line on a change, or on a rising edge for IRQ_RISING.
+            void       setLevel(uint8_t pin, bool high)      noexcept;
+            // Levels of the IRQ_CHANGE lines from 'adc', high from half scale.
+            void       follow(const SimAdc& adc)             noexcept;
+            uint32_t   fired(void)                     const noexcept { return fireCount; }
+
+        private:
+            static const size_t  PINS        { 40 };
+
+            struct Line{
+                IrqHandler   handler         { nullptr };
+                void*        ctx             { nullptr };
+                IRQ_EDGE     edge            { IRQ_RISING };
+            };
+
+            Line       lines[PINS];
+            bool       levels[PINS]          {};
+            uint32_t   fireCount             { 0 };
+    };
+
+    inline bool SimIrq::attach(uint8_t pin, IrqHandler handler, void* ctx, IRQ_EDGE edge) noexcept{
+        if(pin >= PINS || handler == nullptr)
+            return false;
+        lines[pin] = Line{ handler, ctx, edge };
+        return true;
+    }
+
+    inline void SimIrq::setLevel(uint8_t pin, bool high) noexcept{
+        if(pin >= PINS || levels[pin] == high)
+            return;
+        levels[pin] = high;
+        if(high || lines[pin].edge == IRQ_CHANGE)
+            fire(pin);
+    }
+
+    inline void SimIrq::follow(const SimAdc& adc) noexcept{
+        for(uint8_t pin{0}; pin<PINS; pin++)
+            if(lines[pin].handler != nullptr && lines[pin].edge == IRQ_CHANGE)
+                setLevel(pin, adc.peek(pin) >= 2048);
+    }
+
+    inline void SimIrq::detach(uint8_t pin) noexcept{
+        if(pin < PINS)
+            lines[pin] = Line{};
+    }
+
+    inline void SimIrq::fire(uint8_t pin) noexcept{
+        if(pin >= PINS || lines[pin].handler == nullptr)
+            return;
+        fireCount++;
+        lines[pin].handler(lines[pin].ctx);
+    }
+
+    // One IMU per mux channel, each producing DMP-like packets at a fixed rate,
+    // or in raw mode the accel and gyro samples of the same motion at 1 kHz.
+    class SimImu : public Imu{
+        public:
+                       SimImu(const Clock& clk, SimMux& mx)            noexcept : clock{clk}, mux{mx} {}
+
+            uint8_t    initialize(void)                                noexcept override { return initError; }
+            bool       testConnection(void)                            noexcept override { return true; }
+            void       calibrate(uint8_t loops)                        noexcept override;
+            bool       readQuaternion(Quat& quat)                      noexcept override;
+            uint16_t   pendingPackets(void)                            noexcept override;
+            void       getOffsets(int16_t* offsets)                    noexcept override;
+            void       setOffsets(const int16_t* offsets)              noexcept override;
+            bool       setRawMode(bool raw)                            noexcept override;
+            bool       readRaw(RawImu& raw)                            noexcept override;
+
+            // Synthetic rotation around 'axis' (0 x, 1 y, 2 z) at 'radPerSec'.
+            void       setMotion(uint8_t channel, uint8_t axis, float radPerSec) noexcept;
+            void       setTrace(uint8_t channel, const Quat* samples, size_t len) noexcept;
+            void       setPacketPeriod(uint32_t periodUs)              noexcept { packetPeriodUs = periodUs; }
+            void       setInitError(uint8_t err)                       noexcept { initError = err; }
+            // setRawMode() fails on 'channel', as an IMU that stopped answering.
+            void       setRawRefused(uint8_t channel, bool refused)    noexcept;
+            bool       rawMode(uint8_t channel)                  const noexcept { return channel < CHANNELS && channels[channel].raw; }
+            // Pulses 'pin' once per packet produced by 'channel' from now on.
+            void       setIntPin(uint8_t channel, uint8_t pin)         noexcept;
+            // Fires the INT lines of the packets produced since the previous call.
+            void       raiseInterrupts(SimIrq& irq)                    noexcept;
+
+            uint32_t   reads(void)                               const noexcept { return readCount; }
+            uint32_t   packets(void)                             const noexcept { return packetCount; }
+            uint32_t   calibrationRuns(void)                     const noexcept { return calibrations; }
+
+        private:
+            static const size_t  CHANNELS    { 8 };
+            static const uint16_t FIFO_PACKETS { 1024 / 28 };   // 1 KB FIFO, 28 byte packets
+            static const uint8_t NO_PIN      { 0xFF };
+            static const uint32_t RAW_PERIOD_US { 1000 };
+
+            struct Channel{
+                uint8_t      axis            { 2 };
+                float        radPerSec       { 0.0f };
+                const Quat*  trace           { nullptr };
+                size_t       traceLen        { 0 };
+                uint32_t     lastPacket      { 0 };
+                size_t       tracePos        { 0 };
+                uint8_t      intPin          { NO_PIN };
+                uint32_t     lastSlot        { 0 };
+                int16_t      offsets[6]      {};
+                bool         raw             { false },
+                             rawRefused      { false };
+            };
+
+            const Clock&     clock;
+            SimMux&          mux;
+            Channel          channels[CHANNELS];
+            uint32_t         packetPeriodUs  { 10000 };   // MotionApps 6.12 default, 100 Hz
+            uint8_t          initError       { 0 };
+            uint32_t         calibrations    { 0 },
+                             readCount       { 0 },
+                             packetCount     { 0 };
+
+            uint32_t   period(const Channel& chan)               const noexcept { return chan.raw ? RAW_PERIOD_US : packetPeriodUs; }
+    };
+
+    inline void SimImu::setMotion(uint8_t channel, uint8_t axis, float radPerSec) noexcept{
+        if(channel < CHANNELS){
+            channels[channel].axis      = axis;
+            channels[channel].radPerSec = radPerSec;
+        }
+    }
+
+    inline void SimImu::setTrace(uint8_t channel, const Quat* samples, size_t len) noexcept{
+        if(channel < CHANNELS){
+            channels[channel].trace    = samples;
+            channels[channel].traceLen = len;
+            channels[channel].tracePos = 0;
+        }
+    }
+
+    // Offsets derived from the channel, so that a restored profile can be told apart.
+    inline void SimImu::calibrate(uint8_t loops) noexcept{
+        Channel& chan { channels[mux.selected()] };
+
+        for(int16_t idx{0}; idx<6; idx++)
+            chan.offsets[idx] = static_cast<int16_t>(mux.selected() * 100 + idx * 10 + loops);
+        calibrations++;
+    }
+
+    inline void SimImu::getOffsets(int16_t* offsets) noexcept{
+        memcpy(offsets, channels[mux.selected()].offsets, sizeof(channels[0].offsets));
+    }
+
+    inline void SimImu::setOffsets(const int16_t* offsets) noexcept{
+        memcpy(channels[mux.selected()].offsets, offsets, sizeof(channels[0].offsets));
+    }
+
+    inline void SimImu::setRawRefused(uint8_t channel, bool refused) noexcept{
+        if(channel < CHANNELS)
+            channels[channel].rawRefused = refused;
+    }
+
+    inline void SimImu::setIntPin(uint8_t channel, uint8_t pin) noexcept{
+        if(channel < CHANNELS){
+            channels[channel].intPin   = pin;
+            channels[channel].lastSlot = clock.nowUs() / period(channels[channel]);
+        }
+    }
+
+    inline bool SimImu::setRawMode(bool raw) noexcept{
+        Channel& chan { channels[mux.selected()] };
+
+        mux.transfer(8 * 3);   // a few register writes
+        if(chan.rawRefused)
+            return false;
+        chan.raw      = raw;
+        chan.lastSlot = clock.nowUs() / period(chan);
+        return raw || initError == 0;
+    }
+
+    // Traces carry no rates: only the synthetic motion is available raw.
+    inline bool SimImu::readRaw(RawImu& raw) noexcept{
+        readCount++;
+
+        const Channel& chan  { channels[mux.selected()] };
+        const float    angle { chan.radPerSec * clock.nowUs() / 1000000.0f },
+                       gyro  { chan.radPerSec * static_cast<float>(180.0 / M_PI) * 16.4f };
+        const uint8_t  axis  { static_cast<uint8_t>(chan.axis < 2 ? chan.axis : 2) };
+
+        mux.transfer(3 + 14);   // ACCEL_XOUT_H .. GYRO_ZOUT_L
+        packetCount++;
+
+        // Gravity, world z up, seen from the sensor rotated by 'angle' around 'axis'.
+        float up[3] { 0.0f, 0.0f, 1.0f };
+        if(axis == 0){
+            up[1] = sinf(angle);
+            up[2] = cosf(angle);
+        }else if(axis == 1){
+            up[0] = -sinf(angle);
+            up[2] = cosf(angle);
+        }
+
+        raw = RawImu{};
+        for(size_t idx{0}; idx<3; idx++)
+            raw.accel[idx] = static_cast<int16_t>(lroundf(up[idx] * 8192.0f));
+        raw.gyro[axis] = static_cast<int16_t>(lroundf(gyro));
+        return true;
+    }
+
+    inline void SimImu::raiseInterrupts(SimIrq& irq) noexcept{
+        for(auto& chan: channels){
+            if(chan.intPin == NO_PIN)
+                continue;
+            const uint32_t slot { clock.nowUs() / period(chan) };
+            for(; chan.lastSlot != slot; chan.lastSlot++)
+                irq.fire(chan.intPin);
+        }
+    }
+
+    inline uint16_t SimImu::pendingPackets(void) noexcept{
+        const Channel& chan { channels[mux.selected()] };
+        const uint32_t ready { (clock.nowUs() - chan.lastPacket) / packetPeriodUs };
+
+        mux.transfer(5);   // FIFO_COUNT_H/L
+
+        return ready < FIFO_PACKETS ? static_cast<uint16_t>(ready) : FIFO_PACKETS;
+    }
+
+    inline bool SimImu::readQuaternion(Quat& quat) noexcept{
+        readCount++;
+
+        Channel&       chan { channels[mux.selected()] };
+        const uint32_t now  { clock.nowUs() };
+
+        mux.transfer(5);
+        if(static_cast<int32_t>(now - chan.lastPacket) < static_cast<int32_t>(packetPeriodUs))
+            return false;
+        mux.transfer(3 + 28);   // one burst of the whole packet
+        chan.lastPacket = now - (now % packetPeriodUs);
+        packetCount++;
+
+        if(chan.trace != nullptr && chan.traceLen > 0){
+            quat = chan.trace[chan.tracePos++ % chan.traceLen];
+            return true;
+        }
+
+        const float half { 0.5f * chan.radPerSec * now / 1000000.0f };
+        quat = Quat{ cosf(half), 0.0f, 0.0f, 0.0f };
+        switch(chan.axis){
+            case 0:  quat.x = sinf(half); break;
+            case 1:  quat.y = sinf(half); break;
+            default: quat.z = sinf(half);
+        }
+        return true;
+    }
+
+    // In memory records, optionally loaded from and saved to a file to
+    // survive between runs of the host tools.
+    class SimKvStore : public KvStore{
+        public:
+            size_t     get(const char* key, uint8_t* data, size_t len) noexcept override;
+            bool       put(const char* key, const uint8_t* data, size_t len) noexcept override;
+            bool       erase(const char* key)                        noexcept override;
+
+            bool       load(const char* path)                        noexcept;
+            bool       save(const char* path)                  const noexcept;
+            uint32_t   puts(void)                              const noexcept { return putCount; }
+
+        private:
+            static const size_t  RECORDS     { 8 },
+                                 KEY_LEN     { 16 },
+                                 DATA_LEN    { 256 };
+
+            struct Record{
+                char       key[KEY_LEN]      {};
+                uint8_t    data[DATA_LEN]    {};
+                size_t     len               { 0 };
+            };
+
+            Record     records[RECORDS];
+            uint32_t   putCount              { 0 };
+
+            Record*    find(const char* key)                         noexcept;
+    };
+
+    inline SimKvStore::Record* SimKvStore::find(const char* key) noexcept{
+        for(auto& rec: records)
+            if(rec.len > 0 && strncmp(rec.key, key, KEY_LEN) == 0)
+                return &rec;
+        return nullptr;
+    }
+
+    inline size_t SimKvStore::get(const char* key, uint8_t* data, size_t len) noexcept{
+        const Record* rec { find(key) };
+        if(rec == nullptr || rec->len > len)
+            return 0;
+        memcpy(data, rec->data, rec->len);
+        return rec->len;
+    }
+
+    inline bool SimKvStore::put(const char* key, const uint8_t* data, size_t len) noexcept{
+        if(len == 0 || len > DATA_LEN || strlen(key) >= KEY_LEN)
+            return false;
+
+        Record* rec { find(key) };
+        for(size_t idx{0}; rec == nullptr && idx<RECORDS; idx++)
+            if(records[idx].len == 0)
+                rec = &records[idx];
+        if(rec == nullptr)
+            return false;
+
+        strncpy(rec->key, key, KEY_LEN - 1);
+        memcpy(rec->data, data, len);
+        rec->len = len;
+        putCount++;
+        return true;
+    }
+
+    inline bool SimKvStore::erase(const char* key) noexcept{
+        Record* rec { find(key) };
+        if(rec != nullptr)
+            *rec = Record{};
+        return true;
+    }
+
+    // File format: per record, the key NUL terminated, a 16 bit length and the data.
+    // Loading stands for what the flash held at boot: it counts no writes.
+    inline bool SimKvStore::load(const char* path) noexcept{
+        FILE* in { fopen(path, "rb") };
+        if(in == nullptr)
+            return false;
+
+        char    key[KEY_LEN];
+        uint8_t data[DATA_LEN],
+                len[2];
+        bool    ok { true };
+        while(ok){
+            size_t pos { 0 };
+            int    chr { 0 };
+            while(pos < KEY_LEN && (chr = fgetc(in)) != EOF && chr != '\0')
+                key[pos++] = static_cast<char>(chr);
+            if(chr == EOF && pos == 0)
+                break;
+            key[pos < KEY_LEN ? pos : KEY_LEN - 1] = '\0';
+
+            ok = chr == '\0' && fread(len, 1, 2, in) == 2;
+            const size_t size { ok ? static_cast<size_t>(len[0] | len[1] << 8) : 0 };
+            ok = ok && size <= DATA_LEN && fread(data, 1, size, in) == size && put(key, data, size);
+            putCount -= ok ? 1 : 0;
+        }
+
+        fclose(in);
+        return ok;
+    }
+
+    inline bool SimKvStore::save(const char* path) const noexcept{
+        FILE* out { fopen(path, "wb") };
+        if(out == nullptr)
+            return false;
+
+        for(const auto& rec: records){
+            if(rec.len == 0)
+                continue;
+            const uint8_t len[2] { static_cast<uint8_t>(rec.len & 0xFF), static_cast<uint8_t>(rec.len >> 8) };
+            fwrite(rec.key, 1, strlen(rec.key) + 1, out);
+            fwrite(len, 1, 2, out);
+            fwrite(rec.data, 1, rec.len, out);
+        }
+
+        return fclose(out) == 0;
+    }
+
+    class SimDisplay : public Display{
+        public:
+            void       clear(void)                                   noexcept override { clears++; }
+            void       drawString(const char* text, int16_t x, int16_t y,
+                                  uint8_t font, uint16_t colour)     noexcept override;
+            void       drawCentreString(const char* text, int16_t x, int16_t y,
+                                        uint8_t font, uint16_t colour) noexcept override;
+            void       flush(void)                                   noexcept override { flushCount++; }
+
+            uint32_t   draws(void)                             const noexcept { return drawCount; }
+            uint32_t   chars(void)                             const noexcept { return charCount; }
+            uint32_t   flushes(void)                           const noexcept { return flushCount; }
+
+        private:
+            uint32_t   clears                { 0 },
+                       drawCount             { 0 },
+                       charCount             { 0 },
+                       flushCount            { 0 };
+    };
+
+    inline void SimDisplay::drawString(const char* text, int16_t x, int16_t y, uint8_t font, uint16_t colour) noexcept{
+        (void)x; (void)y; (void)font; (void)colour;
+        drawCount++;
+        charCount += strlen(text);
+    }
+
+    inline void SimDisplay::drawCentreString(const char* text, int16_t x, int16_t y, uint8_t font, uint16_t colour) noexcept{
+        drawString(text, x, y, font, colour);
+    }
+
+    // Counts the output, keeps the first CAPTURE bytes since the last reset()
+    // and optionally copies everything to a FILE. read() serves feed() data.
+    class SimTransport : public Transport{
+        public:
+            size_t     write(const uint8_t* data, size_t len)        noexcept override;
+            int        read(void)                                    noexcept override;
+
+            void       setSink(FILE* out)                            noexcept { sink = out; }
+            void       feed(const uint8_t* data, size_t len)         noexcept;
+            void       reset(void)                                   noexcept { captured = 0; }
+
+            const uint8_t* capture(void)                       const noexcept { return buffer; }
+            size_t     captureSize(void)                       const noexcept { return captured; }
+            uint32_t   writes(void)                            const noexcept { return writeCount; }
+            uint64_t   bytes(void)                             const noexcept { return byteCount; }
+
+        private:
+            static const size_t  CAPTURE     { 4096 },
+                                 INPUT       { 256 };
+
+            uint8_t    buffer[CAPTURE]       {};
+            size_t     captured              { 0 };
+            uint8_t    input[INPUT]          {};
+            size_t     inputHead             { 0 },
+                       inputTail             { 0 };
+            FILE*      sink                  { nullptr };
+            uint32_t   writeCount            { 0 };
+            uint64_t   byteCount             { 0 };
+    };
+
+    inline size_t SimTransport::write(const uint8_t* data, size_t len) noexcept{
+        writeCount++;
+        byteCount += len;
+
+        const size_t room { CAPTURE - captured };
+        const size_t copy { len < room ? len : room };
+        memcpy(buffer + captured, data, copy);
+        captured += copy;
+
+        if(sink != nullptr)
+            fwrite(data, 1, len, sink);
+        return len;
+    }
+
+    inline void SimTransport::feed(const uint8_t* data, size_t len) noexcept{
+        for(size_t i{0}; i<len && inputHead - inputTail < INPUT; i++)
+            input[inputHead++ % INPUT] = data[i];
+    }
+
+    inline int SimTransport::read(void) noexcept{
+        return inputTail == inputHead ? -1 : input[inputTail++ % INPUT];
+    }
+
+    class SimBoard{
+        public:
+                       SimBoard(void)                                noexcept;
+            Board      board(void)                                   noexcept;
+            // Moves the clock forward, raises the IMU interrupts due meanwhile
+            // and moves the button lines to the ADC values.
+            void       advanceUs(uint32_t us)                        noexcept;
+
+            FakeClock      clock;
+            SimAdc         adc               { clock };
+            SimMux         mux;
+            SimImu         imu               { clock, mux };
+            SimIrq         irq;
+            SimKvStore     store;
+            SimDisplay     display;
+            SimTransport   console,
+                           link;
+    };
+
+    // Wired as GLOVE_TOPOLOGY. Fingers sweep between relaxed and contracted
+    // at slightly different rates, the IMUs turn slowly around different axes.
+    inline SimBoard::SimBoard(void) noexcept{
+        mux.setBusClock(&clock);
+        for(uint32_t idx{0}; idx<GLOVE_FINGERS; idx++){
+            const FingerChannel& finger { GLOVE_TOPOLOGY.fingers[idx] };
+            adc.setWave(finger.adcPin, finger.restMin, 4095, 2100000 - idx * 200000, idx * 200000);
+        }
+        for(uint8_t pin: GLOVE_TOPOLOGY.buttonPins)
+            adc.setConstant(pin, 0);
+
+        uint8_t present { 0 };
+        for(size_t idx{0}; idx<GLOVE_IMUS; idx++){
+            const ImuChannel& chan { GLOVE_TOPOLOGY.imus[idx] };
+            imu.setMotion(chan.muxChannel, static_cast<uint8_t>(idx % 3), 0.5f + 0.2f * idx);
+            imu.setIntPin(chan.muxChannel, chan.intPin);
+            present |= static_cast<uint8_t>(1 << chan.muxChannel);
+        }
+        mux.setPresent(present);
+    }
+
+    inline void SimBoard::advanceUs(uint32_t us) noexcept{
+        clock.advanceUs(us);
+        imu.raiseInterrupts(irq);
+        irq.follow(adc);
+    }
+
+    inline Board SimBoard::board(void) noexcept{
+        return Board{ clock, adc, mux, imu, irq, store, display, console, link };
+    }
+
+} // End namespace glove
@@ -0,0 +1,219 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "telemetry.h"
+
+namespace glove {
+
+    // Multi-glove frame sent by the host hub (src/host/glove_hub.cpp) to its
+    // subscribers: the state of every glove at one host time. Little endian:
+    //
+    // off size
+    //  0   4   magic 'G' 'H' 'U' 'B'
+    //  4   1   version
+    //  5   1   gloves
+    //  6   2   sequence number
+    //  8   4   host time of the frame, monotonic microseconds
+    // 12       per glove, HUB_SLOT bytes:
+    //          0   2   device id, see identity.h
+    //          2   1   wearer
+    //          3   1   hand
+    //          4   1   state, see HUB_SLOT_STATE
+    //          5   4   host time of the sample, its device time moved to the host clock
+    //          9  42   the sample as a binary frame, see above
+    //  end 2   CRC-16/CCITT of everything before
+    //
+    // A glove's sample is the last one taken by the frame time, held while
+    // none newer arrives: the slots of one frame are aligned in time.
+
+    const uint8_t  HUB_VERSION       { 1 };
+
+    const size_t   HUB_HEADER        { 12 },
+                   HUB_SLOT          { 9 + FRAME_SIZE },
+                   HUB_MAX_GLOVES    { 16 },
+                   HUB_MAX_SIZE      { HUB_HEADER + HUB_MAX_GLOVES * HUB_SLOT + 2 };
+
+    enum HUB_SLOT_STATE : uint8_t {
+        HUB_FRESH  = 0x1,     // sample newer than in the previous frame
+        HUB_STALE  = 0x2,     // nothing from the glove for longer than the hub tolerates
+        HUB_EMPTY  = 0x4      // no sample yet, the frame bytes are zero
+    };
+
+    struct HubSlot{
+        uint16_t         deviceId                 { 0 };
+        uint8_t          wearer                   { 0 },
+                         hand                     { 0 },
+                         state                    { HUB_EMPTY };
+        uint32_t         sampleUs                 { 0 };
+        TelemetrySample  sample;
+    };
+
+    struct HubFrame{
+        uint16_t         seq                      { 0 };
+        uint32_t         hostUs                   { 0 };
+        uint8_t          gloves                   { 0 };
+        HubSlot          slots[HUB_MAX_GLOVES];
+    };
+
+    inline size_t hubFrameSize(size_t gloves) noexcept{
+        return HUB_HEADER + gloves * HUB_SLOT + 2;
+    }
+
+    // 'out' takes hubFrameSize(frame.gloves) bytes.
+    inline size_t encodeHubFrame(const HubFrame& frame, uint8_t* out) noexcept{
+        memcpy(out, "GHUB", 4);
+        out[4] = HUB_VERSION;
+        out[5] = frame.gloves;
+        put16(out + 6, frame.seq);
+        put32(out + 8, frame.hostUs);
+
+        uint8_t* pos { out + HUB_HEADER };
+        for(size_t idx{0}; idx<frame.gloves; idx++, pos += HUB_SLOT){
+            const HubSlot& slot { frame.slots[idx] };
+            put16(pos, slot.deviceId);
+            pos[2] = slot.wearer;
+            pos[3] = slot.hand;
+            pos[4] = slot.state;
+            put32(pos + 5, slot.sampleUs);
+            if(slot.state & HUB_EMPTY)
+                memset(pos + 9, 0, FRAME_SIZE);
+            else
+                encodeFrame(slot.sample, pos + 9);
+        }
+
+        put16(pos, crc16(out, static_cast<size_t>(pos - out)));
+        return static_cast<size_t>(pos - out) + 2;
+    }
+
+    // Incremental reader of the hub frames in a byte stream, for the subscribers.
+    class HubFrameDecoder{
+
+        public:
+
+            // True when 'byte' completes a frame with a good CRC.
+            bool       push(uint8_t byte, HubFrame& frame)          noexcept;
+
+            uint32_t   frames(void)                           const noexcept { return frameCount; }
+            uint32_t   crcErrors(void)                        const noexcept { return crcCount; }
+            uint32_t   lostFrames(void)                       const noexcept { return lostCount; }
+
+        private:
+
+            uint8_t    buffer[HUB_MAX_SIZE]   {};
+            size_t     fill                   { 0 };
+            bool       haveSeq                { false };
+            uint16_t   lastSeq                { 0 };
+            uint32_t   frameCount             { 0 },
+                       crcCount               { 0 },
+                       lostCount              { 0 };
+    };
+
+    inline bool HubFrameDecoder::push(uint8_t byte, HubFrame& frame) noexcept{
+        buffer[fill++] = byte;
+
+        if(fill <= 4 && byte != "GHUB"[fill - 1]){
+            fill = 0;
+            if(byte == 'G')
+                buffer[fill++] = byte;
+            return false;
+        }
+        if(fill == 6 && (buffer[4] != HUB_VERSION || buffer[5] > HUB_MAX_GLOVES)){
+            fill = 0;
+            return false;
+        }
+        if(fill < 6 || fill < hubFrameSize(buffer[5]))
+            return false;
+
+        const size_t len { fill - 2 };
+        fill = 0;
+        if(get16(buffer + len) != crc16(buffer, len)){
+            crcCount++;
+            return false;
+        }
+
+        frame.gloves = buffer[5];
+        frame.seq    = get16(buffer + 6);
+        frame.hostUs = get32(buffer + 8);
+        for(size_t idx{0}; idx<frame.gloves; idx++){
+            const uint8_t* pos  { buffer + HUB_HEADER + idx * HUB_SLOT };
+            HubSlot&       slot { frame.slots[idx] };
+            slot.deviceId = get16(pos);
+            slot.wearer   = pos[2];
+            slot.hand     = pos[3];
+            slot.state    = pos[4];
+            slot.sampleUs = get32(pos + 5);
+            if(slot.state & HUB_EMPTY || !decodeFrame(pos + 9, slot.sample))
+                slot.sample = TelemetrySample{};
+        }
+
+        if(haveSeq)
+            lostCount += static_cast<uint16_t>(frame.seq - lastSeq - 1);
+        haveSeq = true;
+        lastSeq = frame.seq;
+        frameCount++;
+        return true;
+    }
+
+    // Moves a glove's device times to the host clock: the offset is the
+    // smallest (arrival - device time) seen, the sample that waited least
+    // in the radio and the buffers. It creeps up by DRIFT_PPM so a device
+    // clock running slower than the host's is followed too.
+    class ClockAligner{
+
+        public:
+
+            static const uint32_t DRIFT_PPM   { 200 };
+
+            // 'rxUs' is the host time 'deviceUs' arrived at.
+            uint32_t   toHost(uint32_t deviceUs, uint32_t rxUs)     noexcept;
+            void       reset(void)                                  noexcept { valid = false; }
+            int32_t    offsetUs(void)                         const noexcept { return offset; }
+
+        private:
+
+            bool       valid                  { false };
+            int32_t    offset                 { 0 };
+            uint32_t   lastRxUs               { 0 };
+            uint64_t   creep                  { 0 };       // us x 1e6, below one us
+    };
+
+    inline uint32_t ClockAligner::toHost(uint32_t deviceUs, uint32_t rxUs) noexcept{
+        const int32_t seen { static_cast<int32_t>(rxUs - deviceUs) };
+
+        if(!valid){
+            valid    = true;
+            offset   = seen;
+            lastRxUs = rxUs;
+        } else if(static_cast<int32_t>(rxUs - lastRxUs) > 0){
+            creep   += static_cast<uint64_t>(rxUs - lastRxUs) * DRIFT_PPM;
+            offset  += static_cast<int32_t>(creep / 1000000);
+            creep   %= 1000000;
+            lastRxUs = rxUs;
+        }
+        if(static_cast<int32_t>(static_cast<uint32_t>(seen) - static_cast<uint32_t>(offset)) < 0)
+            offset = seen;
+
+        return deviceUs + static_cast<uint32_t>(offset);
+    }
+
+} // End namespace glove
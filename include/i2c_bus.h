@@ -0,0 +1,124 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "hal.h"
+
+namespace glove {
+
+    struct BusStats{
+        uint32_t   transactions     { 0 },     // timed device accesses, mux writes included
+                   switches         { 0 },     // mux writes
+                   skippedSwitches  { 0 },     // channel already selected
+                   errors           { 0 },     // NACKs on the mux
+                   recoveries       { 0 },     // bus resets
+                   failedRecoveries { 0 },
+                   maxUs            { 0 };
+        uint64_t   busyUs           { 0 };     // time spent in transactions
+    };
+
+    // Owner of the I2C bus behind the multiplexer: remembers the selected
+    // channel, so the mux is written only when it changes, resets the bus
+    // when the mux stops answering and times every transaction.
+    class I2cBus{
+
+        public:
+
+            static const uint8_t  NO_CHANNEL  { 0xFF };
+
+                       I2cBus(I2cMux& mx, const Clock& clk)           noexcept : mux{mx}, clock{clk} {}
+
+            bool       select(uint8_t channel)                        noexcept;
+            bool       setSpeed(uint32_t hz)                          noexcept;
+            bool       recover(void)                                  noexcept;
+            void       invalidate(void)                               noexcept { current = NO_CHANNEL; }
+            uint8_t    selected(void)                           const noexcept { return current; }
+
+            // Runs one device access, 'access' returns its bool outcome.
+            template<typename F>
+            bool       timed(F&& access)                              noexcept;
+
+            const BusStats& stats(void)                         const noexcept { return counters; }
+            void       resetStats(void)                               noexcept { counters = BusStats{}; }
+
+        private:
+
+            I2cMux&        mux;
+            const Clock&   clock;
+            uint8_t        current           { NO_CHANNEL };
+            BusStats       counters;
+    };
+
+    template<typename F>
+    bool I2cBus::timed(F&& access) noexcept{
+        const uint32_t start { clock.nowUs() };
+        const bool     ok    { access() };
+        const uint32_t spent { clock.nowUs() - start };
+
+        counters.transactions++;
+        counters.busyUs += spent;
+        if(spent > counters.maxUs)
+            counters.maxUs = spent;
+        return ok;
+    }
+
+    inline bool I2cBus::select(uint8_t channel) noexcept{
+        if(channel == current){
+            counters.skippedSwitches++;
+            return true;
+        }
+
+        counters.switches++;
+        if(timed([&]{ return mux.select(channel); })){
+            current = channel;
+            return true;
+        }
+
+        // NACK or stuck bus: whatever the mux holds now is unknown.
+        counters.errors++;
+        current = NO_CHANNEL;
+        if(!recover())
+            return false;
+
+        counters.switches++;
+        if(!timed([&]{ return mux.select(channel); })){
+            counters.errors++;
+            return false;
+        }
+        current = channel;
+        return true;
+    }
+
+    inline bool I2cBus::setSpeed(uint32_t hz) noexcept{
+        invalidate();
+        return mux.setSpeed(hz);
+    }
+
+    inline bool I2cBus::recover(void) noexcept{
+        invalidate();
+        counters.recoveries++;
+        if(mux.recover())
+            return true;
+        counters.failedRecoveries++;
+        return false;
+    }
+
+} // End namespace glove
@@ -0,0 +1,108 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "hal.h"
+#include "telemetry.h"
+
+namespace glove {
+
+    // Who a glove is, so a host with several of them can tell the streams
+    // apart: stored in NVS, read with CMD_GET_IDENTITY, written with
+    // CMD_SET_IDENTITY (command.h). The name is the Bluetooth name from the
+    // next boot. Record, little endian:
+    //
+    // off size
+    //  0   2   magic 'G' 'I'
+    //  2   1   version
+    //  3   2   device id
+    //  5   1   wearer, the user of the rig
+    //  6   1   hand, see HAND_SIDE
+    //  7  16   name, NUL padded
+    // 23   2   CRC-16/CCITT of everything before
+
+    const uint8_t  IDENT_MAGIC0      { 'G' },
+                   IDENT_MAGIC1      { 'I' },
+                   IDENT_VERSION     { 1 };
+
+    const size_t   IDENT_NAME        { 16 },
+                   IDENT_SIZE        { 25 };
+
+    // Bluetooth name of a glove never configured, the one they all had.
+    inline const char* const DEFAULT_GLOVE_NAME { "GLOVE_ESP" };
+
+    enum HAND_SIDE : uint8_t { HAND_UNKNOWN=0, HAND_LEFT=1, HAND_RIGHT=2 };
+
+    struct DeviceIdentity{
+        uint16_t     deviceId                 { 0 };
+        uint8_t      wearer                   { 0 },
+                     hand                     { HAND_UNKNOWN };
+        char         name[IDENT_NAME + 1]     {};     // terminated
+    };
+
+    inline size_t encodeIdentity(const DeviceIdentity& id, uint8_t* out) noexcept{
+        out[0] = IDENT_MAGIC0;
+        out[1] = IDENT_MAGIC1;
+        out[2] = IDENT_VERSION;
+        put16(out + 3, id.deviceId);
+        out[5] = id.wearer;
+        out[6] = id.hand;
+        memset(out + 7, 0, IDENT_NAME);
+        memcpy(out + 7, id.name, strnlen(id.name, IDENT_NAME));
+        put16(out + 23, crc16(out, 23));
+        return IDENT_SIZE;
+    }
+
+    // False on bad magic, version, size or CRC, or a hand out of range.
+    inline bool decodeIdentity(const uint8_t* in, size_t len, DeviceIdentity& id) noexcept{
+        if(len != IDENT_SIZE || in[0] != IDENT_MAGIC0 || in[1] != IDENT_MAGIC1 || in[2] != IDENT_VERSION)
+            return false;
+        if(get16(in + 23) != crc16(in, 23) || in[6] > HAND_RIGHT)
+            return false;
+
+        id          = DeviceIdentity{};
+        id.deviceId = get16(in + 3);
+        id.wearer   = in[5];
+        id.hand     = in[6];
+        memcpy(id.name, in + 7, IDENT_NAME);
+        return true;
+    }
+
+    // The stored identity, or the defaults: id 0, DEFAULT_GLOVE_NAME.
+    inline DeviceIdentity loadIdentity(KvStore& store) noexcept{
+        DeviceIdentity id;
+        uint8_t        record[IDENT_SIZE];
+        if(store.get("ident", record, sizeof(record)) != IDENT_SIZE || !decodeIdentity(record, IDENT_SIZE, id)){
+            id = DeviceIdentity{};
+            strncpy(id.name, DEFAULT_GLOVE_NAME, IDENT_NAME);
+        }
+        if(id.name[0] == '\0')
+            strncpy(id.name, DEFAULT_GLOVE_NAME, IDENT_NAME);
+        return id;
+    }
+
+    inline bool saveIdentity(KvStore& store, const DeviceIdentity& id) noexcept{
+        uint8_t record[IDENT_SIZE];
+        return store.put("ident", record, encodeIdentity(id, record));
+    }
+
+} // End namespace glove
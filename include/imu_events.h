@@ -0,0 +1,103 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "scheduler.h"
+
+namespace glove {
+
+    // How the IMUs are read:
+    // IMU_POLL   every IMU, every time (the original behaviour)
+    // IMU_FIFO   one FIFO count per mux channel, the packet is read only if there's one
+    // IMU_IRQ    only the IMUs whose data ready line fired since the last pass
+    // IMU_RAW    DMP off, accel and gyro read every pass and fused here (fusion.h)
+    enum IMU_MODE : uint8_t { IMU_POLL=0, IMU_FIFO=1, IMU_IRQ=2, IMU_RAW=3 };
+
+    struct ImuStats{
+        uint32_t   packets          { 0 },     // packets read, raw samples in IMU_RAW
+                   empty            { 0 },     // reads that found nothing
+                   missed           { 0 },     // packets dropped before being read
+                   duplicates       { 0 },     // same quaternion read twice
+                   spurious         { 0 },     // interrupts with no packet behind
+                   lastLatencyUs    { 0 },     // interrupt to read, IMU_IRQ only
+                   maxLatencyUs     { 0 };
+    };
+
+    // Data ready bookkeeping shared by the interrupt handlers and the
+    // acquisition task: the handlers only bump a counter and store a time.
+    class ImuEvents{
+
+        public:
+
+            static const size_t  MAX_IMUS    { 8 };
+
+            void        setClock(const Clock* clk)                   noexcept { clock = clk; }
+
+            // Context to hand to the interrupt handler of IMU 'idx'.
+            void*       line(size_t idx)                             noexcept;
+            static void onDataReady(void* line)                      noexcept;
+
+            void        signal(size_t idx)                           noexcept;
+            // Interrupts received by 'idx' since the previous call, and the time of the last one.
+            uint32_t    take(size_t idx, uint32_t& whenUs)           noexcept;
+
+        private:
+
+            struct Line{
+                ImuEvents*   owner    { nullptr };
+                size_t       idx      { 0 };
+            };
+
+            const Clock*           clock               { nullptr };
+            Line                   lines[MAX_IMUS];
+            std::atomic<uint32_t>  irqCount[MAX_IMUS]  {};
+            std::atomic<uint32_t>  irqTime[MAX_IMUS]   {};
+            uint32_t               seen[MAX_IMUS]      {};
+    };
+
+    inline void* ImuEvents::line(size_t idx) noexcept{
+        lines[idx].owner = this;
+        lines[idx].idx   = idx;
+        return &lines[idx];
+    }
+
+    inline void ImuEvents::onDataReady(void* line) noexcept{
+        const Line* ln { static_cast<const Line*>(line) };
+        ln->owner->signal(ln->idx);
+    }
+
+    inline void ImuEvents::signal(size_t idx) noexcept{
+        if(clock != nullptr)
+            irqTime[idx].store(clock->nowUs(), std::memory_order_relaxed);
+        irqCount[idx].fetch_add(1, std::memory_order_release);
+    }
+
+    inline uint32_t ImuEvents::take(size_t idx, uint32_t& whenUs) noexcept{
+        const uint32_t count { irqCount[idx].load(std::memory_order_acquire) };
+        const uint32_t fresh { count - seen[idx] };
+
+        seen[idx] = count;
+        whenUs    = irqTime[idx].load(std::memory_order_relaxed);
+        return fresh;
+    }
+
+} // End namespace glove
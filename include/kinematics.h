@@ -0,0 +1,174 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+#include "hal.h"
+#include "layout.h"
+
+namespace glove {
+
+    inline Quat quatMul(const Quat& a, const Quat& b) noexcept{
+        return Quat{ a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z,
+                     a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                     a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+                     a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w };
+    }
+
+    inline Quat quatConj(const Quat& q) noexcept{
+        return Quat{ q.w, -q.x, -q.y, -q.z };
+    }
+
+    inline Quat quatNormalize(const Quat& q) noexcept{
+        const float norm { sqrtf(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z) };
+        return norm > 0.0f ? Quat{ q.w / norm, q.x / norm, q.y / norm, q.z / norm } : Quat{};
+    }
+
+    // Unit axis expected.
+    inline Quat quatFromAxisAngle(float ax, float ay, float az, float rad) noexcept{
+        const float half { sinf(rad / 2.0f) };
+        return Quat{ cosf(rad / 2.0f), ax * half, ay * half, az * half };
+    }
+
+    // Rotation angle between two orientations, radians.
+    inline float quatAngle(const Quat& a, const Quat& b) noexcept{
+        const float dot { fabsf(a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z) };
+        return 2.0f * acosf(dot < 1.0f ? dot : 1.0f);
+    }
+
+    // One quaternion per IMU, component by component, padded with
+    // identities to a multiple of four: every kernel below is a fixed
+    // iteration loop without dependencies, which the compiler turns into
+    // SIMD code on targets that have it (the ESP32 FPU is scalar, there it
+    // is just unrolled).
+    struct QuatLanes{
+        static const size_t  LANES   { (GLOVE_IMUS + 3) / 4 * 4 };
+
+        QuatLanes(void) noexcept { for(float& val: w) val = 1.0f; }
+
+        alignas(16) float   w[LANES],
+                            x[LANES]  {},
+                            y[LANES]  {},
+                            z[LANES]  {};
+    };
+
+    inline void mulLanes(const QuatLanes& a, const QuatLanes& b, QuatLanes& out) noexcept{
+        for(size_t i{0}; i<QuatLanes::LANES; i++){
+            const float w { a.w[i] * b.w[i] - a.x[i] * b.x[i] - a.y[i] * b.y[i] - a.z[i] * b.z[i] },
+                        x { a.w[i] * b.x[i] + a.x[i] * b.w[i] + a.y[i] * b.z[i] - a.z[i] * b.y[i] },
+                        y { a.w[i] * b.y[i] - a.x[i] * b.z[i] + a.y[i] * b.w[i] + a.z[i] * b.x[i] },
+                        z { a.w[i] * b.z[i] + a.x[i] * b.y[i] - a.y[i] * b.x[i] + a.z[i] * b.w[i] };
+            out.w[i] = w;
+            out.x[i] = x;
+            out.y[i] = y;
+            out.z[i] = z;
+        }
+    }
+
+    inline void normalizeLanes(QuatLanes& q) noexcept{
+        for(size_t i{0}; i<QuatLanes::LANES; i++){
+            const float inv { 1.0f / sqrtf(q.w[i] * q.w[i] + q.x[i] * q.x[i] + q.y[i] * q.y[i] + q.z[i] * q.z[i]) };
+            q.w[i] *= inv;
+            q.x[i] *= inv;
+            q.y[i] *= inv;
+            q.z[i] *= inv;
+        }
+    }
+
+    // The segments of GLOVE_TOPOLOGY.imus, each after its parent, each IMU
+    // giving its sensor to world rotation. The reference pose (calibration,
+    // segments aligned) holds the mounting rotation of every sensor:
+    //
+    //   segment[i] = sensor[i] * conj(reference[i])
+    //   joint[i]   = segment[i]                            a root, in the world
+    //   joint[i]   = conj(segment[parent]) * segment[i]    relative to the parent
+    //
+    // so a joint rotation doesn't change when the upstream segments move.
+    class KinematicChain{
+
+        public:
+
+            static const size_t  SEGMENTS    { GLOVE_IMUS };
+
+            void       setReference(const Quat* pose)                  noexcept;
+            void       clearReference(void)                            noexcept { setReference(nullptr); }
+            Quat       reference(size_t idx)                     const noexcept;
+
+            void       solve(const Quat* sensors, Quat* joints)  const noexcept;
+
+        private:
+
+            QuatLanes  referenceConj;
+    };
+
+    inline void KinematicChain::setReference(const Quat* pose) noexcept{
+        referenceConj = QuatLanes{};
+        if(pose == nullptr)
+            return;
+
+        for(size_t idx{0}; idx<SEGMENTS; idx++){
+            const Quat ref { quatNormalize(pose[idx]) };
+            referenceConj.w[idx] =  ref.w;
+            referenceConj.x[idx] = -ref.x;
+            referenceConj.y[idx] = -ref.y;
+            referenceConj.z[idx] = -ref.z;
+        }
+    }
+
+    inline Quat KinematicChain::reference(size_t idx) const noexcept{
+        return idx < SEGMENTS ? Quat{ referenceConj.w[idx], -referenceConj.x[idx], -referenceConj.y[idx], -referenceConj.z[idx] }
+                              : Quat{};
+    }
+
+    inline void KinematicChain::solve(const Quat* sensors, Quat* joints) const noexcept{
+        QuatLanes sensor,
+                  segment,
+                  parent,
+                  joint;
+
+        for(size_t idx{0}; idx<SEGMENTS; idx++){
+            sensor.w[idx] = sensors[idx].w;
+            sensor.x[idx] = sensors[idx].x;
+            sensor.y[idx] = sensors[idx].y;
+            sensor.z[idx] = sensors[idx].z;
+        }
+
+        mulLanes(sensor, referenceConj, segment);
+
+        // A root's parent is the world: identity, already in its lane.
+        for(size_t idx{0}; idx<SEGMENTS; idx++){
+            const uint8_t up { GLOVE_TOPOLOGY.imus[idx].parent };
+            if(up == NO_PARENT)
+                continue;
+            parent.w[idx] =  segment.w[up];
+            parent.x[idx] = -segment.x[up];
+            parent.y[idx] = -segment.y[up];
+            parent.z[idx] = -segment.z[up];
+        }
+
+        mulLanes(parent, segment, joint);
+        normalizeLanes(joint);
+
+        for(size_t idx{0}; idx<SEGMENTS; idx++)
+            joints[idx] = Quat{ joint.w[idx], joint.x[idx], joint.y[idx], joint.z[idx] };
+    }
+
+} // End namespace glove
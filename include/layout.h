@@ -0,0 +1,162 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Wiring of the glove, shared by the firmware and the simulated board.
+
+namespace glove {
+
+    enum PINS : uint8_t {
+        THUMB_PIN          = 32,
+        INDEX_PIN          = 39,
+        MIDDLE_PIN         = 38,
+        RING_PIN           = 37,
+        LITTLE_PIN         = 36,
+        BUTTON_LEFT_PIN    = 33,
+        BUTTON_MIDDLE_PIN  = 25,
+        BUTTON_RIGHT_PIN   = 26
+    };
+
+    // TCA9548A channels of the MPU-6050s.
+    enum ACCEL_ADDRS : uint8_t       { HAND=0x0, FOREARM=0x6, ARM=0x7 };
+
+    // INT (data ready) lines of the MPU-6050s, only needed by IMU_IRQ mode.
+    enum IMU_INT_PINS : uint8_t      { HAND_INT_PIN=13, FOREARM_INT_PIN=35, ARM_INT_PIN=34 };
+
+    // Part of the TFT holding the finger glyphs, see status_view.h.
+    enum STATUS_AREA : int16_t       { STATUS_X=0, STATUS_Y=0, STATUS_W=160, STATUS_H=72 };
+
+    // One flex sensor: its ADC pin, the reading of a relaxed finger used
+    // until the first calibration, its name on the console and where its
+    // glyph sits on the status display, inside STATUS_AREA.
+    struct FingerChannel{
+        uint8_t      adcPin;
+        uint16_t     restMin;
+        const char*  name;
+        int16_t      glyphX,
+                     glyphY;
+    };
+
+    // The IMU of the segment the chain hangs from: its rotation is relative to the world.
+    const uint8_t  NO_PARENT         { 0xFF };
+
+    // One MPU-6050: its TCA9548A channel, INT line, the IMU of the segment
+    // it hangs from in the kinematic chain and its name on the console.
+    struct ImuChannel{
+        uint8_t      muxChannel;
+        uint8_t      intPin;
+        uint8_t      parent;
+        const char*  name;
+    };
+
+    // The sensor layout, in output order: the fingers as Glove::EVENTS, the
+    // IMUs from the shoulder out as the frames and the kinematic chain take
+    // them, each after its parent, then the buttons as FRAME_BUTTONS. The
+    // glove, the chain, the profiler stages, the status display and the
+    // session files size their arrays and loops from here, at compile time.
+    const size_t   MUX_CHANNELS      { 8 },
+                   GLOVE_FINGERS     { 5 },
+                   GLOVE_IMUS        { 3 },
+                   GLOVE_BUTTONS     { 3 };
+
+    template<size_t FINGERS, size_t IMUS>
+    struct Topology{
+        static constexpr size_t FINGER_COUNT { FINGERS },
+                                IMU_COUNT    { IMUS };
+        FingerChannel  fingers[FINGERS];
+        ImuChannel     imus[IMUS];
+        uint8_t        buttonPins[GLOVE_BUTTONS];
+    };
+
+    constexpr Topology<GLOVE_FINGERS, GLOVE_IMUS> GLOVE_TOPOLOGY {
+        { { THUMB_PIN, 1, "Thumb", 10, 24 }, { INDEX_PIN, 100, "Index", 36, 0 }, { MIDDLE_PIN, 100, "Middle", 64, 0 },
+          { RING_PIN, 100, "Ring", 92, 0 }, { LITTLE_PIN, 100, "Little", 120, 0 } },
+        { { ARM, ARM_INT_PIN, NO_PARENT, "Arm" }, { FOREARM, FOREARM_INT_PIN, 0, "Forearm" },
+          { HAND, HAND_INT_PIN, 1, "Hand" } },
+        { BUTTON_LEFT_PIN, BUTTON_MIDDLE_PIN, BUTTON_RIGHT_PIN }
+    };
+
+    // The ADC pins alone, contiguous, as Adc::startContinuous() takes them.
+    template<size_t N>
+    struct PinList{
+        uint8_t        pins[N];
+    };
+
+    template<size_t F, size_t I>
+    constexpr PinList<F> fingerPins(const Topology<F, I>& topo) noexcept{
+        PinList<F> list {};
+        for(size_t idx{0}; idx<F; idx++)
+            list.pins[idx] = topo.fingers[idx].adcPin;
+        return list;
+    }
+
+    // ESP32 pins: ADC1 is GPIO 32 - 39, the one ADC free while the radio
+    // runs; 6 - 11 hold the flash, 20, 24 and 28 - 31 don't exist; 34 - 39
+    // are inputs without pull resistors.
+    constexpr bool adc1Pin(uint8_t pin) noexcept            { return pin >= 32 && pin <= 39; }
+    constexpr bool gpioPin(uint8_t pin) noexcept{
+        return pin <= 39 && !(pin >= 6 && pin <= 11) && pin != 20 && pin != 24 && !(pin >= 28 && pin <= 31);
+    }
+    constexpr bool pullDownPin(uint8_t pin) noexcept        { return gpioPin(pin) && pin < 34; }
+
+    // One TCA9548A: at most 8 IMUs, each on its own channel and after its
+    // parent; fingers on ADC1 with their glyph in STATUS_AREA, INT lines on GPIOs, buttons on GPIOs with a
+    // pull down (Adc::configure() sets it); no pin used twice, whether by a
+    // finger, an IMU INT line or a button.
+    template<size_t F, size_t I>
+    constexpr bool validTopology(const Topology<F, I>& topo) noexcept{
+        if(I == 0 || I > MUX_CHANNELS)
+            return false;
+        for(size_t idx{0}; idx<I; idx++){
+            if(topo.imus[idx].muxChannel >= MUX_CHANNELS || !gpioPin(topo.imus[idx].intPin))
+                return false;
+            if(topo.imus[idx].parent != NO_PARENT && topo.imus[idx].parent >= idx)
+                return false;
+            for(size_t other{idx + 1}; other<I; other++)
+                if(topo.imus[idx].muxChannel == topo.imus[other].muxChannel)
+                    return false;
+        }
+
+        uint8_t pins[F + I + GLOVE_BUTTONS] {};
+        size_t  count { 0 };
+        for(const auto& finger: topo.fingers){
+            if(!adc1Pin(finger.adcPin) || finger.glyphX < STATUS_X || finger.glyphX >= STATUS_X + STATUS_W ||
+               finger.glyphY < STATUS_Y || finger.glyphY >= STATUS_Y + STATUS_H)
+                return false;
+            pins[count++] = finger.adcPin;
+        }
+        for(const auto& imu: topo.imus)
+            pins[count++] = imu.intPin;
+        for(uint8_t pin: topo.buttonPins){
+            if(!pullDownPin(pin))
+                return false;
+            pins[count++] = pin;
+        }
+        for(size_t idx{0}; idx<count; idx++)
+            for(size_t other{idx + 1}; other<count; other++)
+                if(pins[idx] == pins[other])
+                    return false;
+        return true;
+    }
+
+    static_assert(validTopology(GLOVE_TOPOLOGY), "GLOVE_TOPOLOGY: bad mux channel, parent, pin or glyph, or one used twice");
+
+} // End namespace glove
@@ -0,0 +1,191 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+#include "hal.h"
+#include "telemetry.h"
+#include "kinematics.h"
+
+namespace glove {
+
+    // Host side: the pose of a glove at the time a frame will be on the
+    // display, from the decoded frames. Each quaternion turns on at its
+    // last angular rate, measured between its two latest packets and
+    // smoothed; each finger goes on at its last speed. The stream carries
+    // no gyro, the rates come from the quaternions themselves.
+    //
+    // The frame times and the display times only have to share a clock:
+    // the device one (TelemetrySample::timestampUs) or the host one given
+    // by ClockAligner (hub_frame.h), wrapping every 71 minutes.
+
+    const float    PREDICT_FINGER_MAX { 90.0f };           // normalized finger range, telemetry.h
+
+    struct PredictorConfig{
+        uint32_t   horizonUs              { 100000 };      // furthest past the newest data
+        float      rateAlpha              { 0.5f },        // weight of the newest rate, 1: no smoothing
+                   fingerAlpha            { 0.5f };
+        uint32_t   maxGapUs               { 200000 };      // longer without a packet: rate back to 0
+    };
+
+    struct PosePrediction{
+        Quat       quat[FRAME_IMUS]       {};              // as in the frames: joints or raw, see FRAME_JOINTS
+        float      fingers[FRAME_FINGERS] {};              // 0 - 90
+        uint32_t   aheadUs                { 0 };           // extrapolated past the newest packet, at most
+    };
+
+    class PosePredictor{
+
+        public:
+
+            void       configure(const PredictorConfig& conf)        noexcept { config = conf; }
+            const PredictorConfig& settings(void)              const noexcept { return config; }
+            void       reset(void)                                   noexcept;
+
+            // 'timeUs': when the sample was taken, on the clock of the queries.
+            void       update(const TelemetrySample& sample, uint32_t timeUs) noexcept;
+            void       update(const TelemetrySample& sample)         noexcept { update(sample, sample.timestampUs); }
+
+            // The pose at 'displayUs', false before the first frame. Times
+            // before the newest data give the newest data.
+            bool       predict(uint32_t displayUs, PosePrediction& out) const noexcept;
+
+        private:
+
+            struct Channel{
+                Quat       quat;
+                float      rate[3]            {};        // rad/s, axis times speed, in the channel frame
+                uint32_t   timeUs             { 0 };
+                bool       haveRate           { false };
+            };
+
+            PredictorConfig config;
+            bool       valid                  { false };
+            Channel    imus[FRAME_IMUS];
+            float      fingers[FRAME_FINGERS] {},
+                       fingerRate[FRAME_FINGERS] {};     // units/s
+            uint32_t   fingerUs               { 0 };
+
+            uint32_t   ahead(uint32_t displayUs, uint32_t fromUs) const noexcept;
+    };
+
+    // Rotation vector (axis times angle) of a unit quaternion, shortest way.
+    inline void quatToRotation(const Quat& q, float* rot) noexcept{
+        const float sign { q.w < 0.0f ? -1.0f : 1.0f },
+                    len  { sqrtf(q.x * q.x + q.y * q.y + q.z * q.z) };
+        // 2 atan2(len, w) / len, 2 / w near 0 where the division fails.
+        const float scale { len > 1e-6f ? 2.0f * atan2f(len, sign * q.w) / len : 2.0f };
+        rot[0] = sign * q.x * scale;
+        rot[1] = sign * q.y * scale;
+        rot[2] = sign * q.z * scale;
+    }
+
+    inline Quat quatFromRotation(const float* rot) noexcept{
+        const float angle { sqrtf(rot[0] * rot[0] + rot[1] * rot[1] + rot[2] * rot[2]) };
+        if(angle < 1e-6f)
+            return quatNormalize(Quat{ 1.0f, rot[0] * 0.5f, rot[1] * 0.5f, rot[2] * 0.5f });
+        const float half { sinf(angle * 0.5f) / angle };
+        return Quat{ cosf(angle * 0.5f), rot[0] * half, rot[1] * half, rot[2] * half };
+    }
+
+    inline void PosePredictor::reset(void) noexcept{
+        valid = false;
+        for(auto& imu: imus)
+            imu = Channel{};
+        for(size_t finger{0}; finger<FRAME_FINGERS; finger++)
+            fingerRate[finger] = 0.0f;
+    }
+
+    // A quaternion is new when its IMU sent a packet; a joint rotation also
+    // when the parent segment did, it is measured from it (kinematics.h).
+    inline void PosePredictor::update(const TelemetrySample& sample, uint32_t timeUs) noexcept{
+        const bool joints { (sample.flags & FRAME_JOINTS) != 0 };
+
+        for(size_t idx{0}; idx<FRAME_IMUS; idx++){
+            Channel&   chan  { imus[idx] };
+            const Quat quat  { sample.quat[idx][0], sample.quat[idx][1], sample.quat[idx][2], sample.quat[idx][3] };
+            const bool fresh { (sample.flags & (1 << idx)) != 0 || (joints && idx > 0 && (sample.flags & (1 << (idx - 1))) != 0) };
+
+            if(valid && !fresh)
+                continue;
+
+            const int32_t dt { static_cast<int32_t>(timeUs - chan.timeUs) };
+            if(!valid || dt <= 0 || static_cast<uint32_t>(dt) > config.maxGapUs){
+                chan.rate[0] = chan.rate[1] = chan.rate[2] = 0.0f;
+                chan.haveRate = false;
+            } else {
+                float rot[3];
+                quatToRotation(quatMul(quatConj(chan.quat), quat), rot);
+                const float alpha { chan.haveRate ? config.rateAlpha : 1.0f };
+                for(size_t axis{0}; axis<3; axis++)
+                    chan.rate[axis] += alpha * (rot[axis] * 1e6f / dt - chan.rate[axis]);
+                chan.haveRate = true;
+            }
+            chan.quat   = quat;
+            chan.timeUs = timeUs;
+        }
+
+        const int32_t dt { static_cast<int32_t>(timeUs - fingerUs) };
+        for(size_t finger{0}; finger<FRAME_FINGERS; finger++){
+            if(valid && dt > 0 && static_cast<uint32_t>(dt) <= config.maxGapUs)
+                fingerRate[finger] += config.fingerAlpha * ((sample.fingers[finger] - fingers[finger]) * 1e6f / dt - fingerRate[finger]);
+            else
+                fingerRate[finger] = 0.0f;
+            fingers[finger] = sample.fingers[finger];
+        }
+        fingerUs = timeUs;
+        valid    = true;
+    }
+
+    inline uint32_t PosePredictor::ahead(uint32_t displayUs, uint32_t fromUs) const noexcept{
+        const int32_t dt { static_cast<int32_t>(displayUs - fromUs) };
+        if(dt <= 0)
+            return 0;
+        return static_cast<uint32_t>(dt) < config.horizonUs ? static_cast<uint32_t>(dt) : config.horizonUs;
+    }
+
+    inline bool PosePredictor::predict(uint32_t displayUs, PosePrediction& out) const noexcept{
+        if(!valid)
+            return false;
+
+        out.aheadUs = 0;
+        for(size_t idx{0}; idx<FRAME_IMUS; idx++){
+            const Channel& chan { imus[idx] };
+            const uint32_t us   { ahead(displayUs, chan.timeUs) };
+            const float    dt   { us * 1e-6f },
+                           rot[3] { chan.rate[0] * dt, chan.rate[1] * dt, chan.rate[2] * dt };
+            out.quat[idx] = quatNormalize(quatMul(chan.quat, quatFromRotation(rot)));
+            if(us > out.aheadUs)
+                out.aheadUs = us;
+        }
+
+        const uint32_t us { ahead(displayUs, fingerUs) };
+        const float    dt { us * 1e-6f };
+        for(size_t finger{0}; finger<FRAME_FINGERS; finger++){
+            const float val { fingers[finger] + fingerRate[finger] * dt };
+            out.fingers[finger] = val < 0.0f ? 0.0f : (val > PREDICT_FINGER_MAX ? PREDICT_FINGER_MAX : val);
+        }
+        if(us > out.aheadUs)
+            out.aheadUs = us;
+        return true;
+    }
+
+} // End namespace glove
@@ -0,0 +1,354 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+#include "layout.h"
+#include "telemetry.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <Arduino.h>
+#include <xtensa/hal.h>
+#else
+#include <chrono>
+#endif
+
+// Per stage timing of the hot path. -DGLOVE_NO_PROFILE turns the probes
+// into nothing, glove_bench built that way shows what they cost.
+
+namespace glove {
+
+#if defined(ARDUINO_ARCH_ESP32)
+    // CCOUNT of the core running the caller: a stage must start and end on the same core.
+    inline uint32_t profileTicks(void) noexcept       { return xthal_get_ccount(); }
+    inline uint32_t profileTicksPerUs(void) noexcept  { return getCpuFrequencyMhz(); }
+#else
+    inline uint32_t profileTicks(void) noexcept{
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+    inline uint32_t profileTicksPerUs(void) noexcept  { return 1000; }
+#endif
+
+    enum PROFILE_STAGE : uint8_t {
+        STAGE_FINGERS     = 0,                         // acquireFingers(): ADC reads, normalization, calibration step
+        STAGE_IMU         = 1,                         // one IMU read, mux switch included, one stage per IMU
+        STAGE_PUBLISH     = STAGE_IMU + GLOVE_IMUS,    // snapshot, kinematic chain, queue
+        STAGE_SEND,                                    // frame or text line, both transports
+        STAGE_DISPLAY,                                 // refreshFingers(), TFT drawing
+        STAGE_FRAME,                                   // interval between two frames sent
+        STAGE_IDLE,                                    // acquisition core asleep between tasks
+        STAGES
+    };
+
+    // The IMU stages take the lower case names of GLOVE_TOPOLOGY.imus.
+    struct StageNames{
+        static const size_t  NAME_MAX    { 16 };
+
+        char       names[STAGES][NAME_MAX]   {};
+    };
+
+    constexpr StageNames stageNames(void) noexcept{
+        const char* const fixed[STAGES - GLOVE_IMUS] { "fingers", "publish", "send", "display", "frame interval", "idle" };
+        StageNames table {};
+
+        for(size_t stage{0}, other{0}; stage<STAGES; stage++){
+            const bool  imu  { stage >= STAGE_IMU && stage < STAGE_PUBLISH };
+            const char* from { imu ? GLOVE_TOPOLOGY.imus[stage - STAGE_IMU].name : fixed[other++] };
+            size_t      len  { 0 };
+
+            if(imu)
+                for(const char* prefix{"imu "}; *prefix != '\0'; prefix++)
+                    table.names[stage][len++] = *prefix;
+            for(; *from != '\0' && len < StageNames::NAME_MAX - 1; from++)
+                table.names[stage][len++] = imu && *from >= 'A' && *from <= 'Z' ? static_cast<char>(*from - 'A' + 'a') : *from;
+        }
+        return table;
+    }
+
+    inline constexpr StageNames STAGE_NAMES { stageNames() };
+
+    inline const char* stageName(size_t stage) noexcept{
+        return stage < STAGES ? STAGE_NAMES.names[stage] : "?";
+    }
+
+    struct StageSummary{
+        uint32_t   count                { 0 };
+        uint32_t   minNs                { 0 },
+                   meanNs               { 0 },
+                   p99Ns                { 0 },
+                   maxNs                { 0 };
+    };
+
+    // Log-linear histogram of tick counts: four buckets per power of two,
+    // so a percentile is off by 25% at most. Written by one core only; a
+    // reset asked from the other one is done by the writer at its next add().
+    class StageHistogram{
+
+        public:
+
+            static const size_t  BUCKETS     { 124 };
+
+            void       add(uint32_t ticks)                          noexcept;
+            void       requestReset(void)                           noexcept { resetPending.store(true, std::memory_order_relaxed); }
+            // Approximate while the writer runs.
+            StageSummary summary(uint32_t ticksPerUs)         const noexcept;
+
+            static size_t   bucket(uint32_t ticks)                  noexcept;
+            static uint32_t bucketTop(size_t idx)                   noexcept;
+
+        private:
+
+            std::atomic<bool>  resetPending   { false };
+            uint32_t           count          { 0 },
+                               minTicks       { UINT32_MAX },
+                               maxTicks       { 0 };
+            uint64_t           sumTicks       { 0 };
+            uint32_t           buckets[BUCKETS] {};
+
+            void       clear(void)                                  noexcept;
+    };
+
+    inline size_t StageHistogram::bucket(uint32_t ticks) noexcept{
+        if(ticks < 4)
+            return ticks;
+        const uint32_t msb { 31u - static_cast<uint32_t>(__builtin_clz(ticks)) };
+        return (msb - 1) * 4 + ((ticks >> (msb - 2)) & 3);
+    }
+
+    inline uint32_t StageHistogram::bucketTop(size_t idx) noexcept{
+        if(idx < 4)
+            return static_cast<uint32_t>(idx);
+        const uint32_t msb   { static_cast<uint32_t>(idx / 4 + 1) },
+                       width { 1u << (msb - 2) };
+        return (4 + static_cast<uint32_t>(idx % 4)) * width + (width - 1);
+    }
+
+    inline void StageHistogram::clear(void) noexcept{
+        count    = 0;
+        minTicks = UINT32_MAX;
+        maxTicks = 0;
+        sumTicks = 0;
+        memset(buckets, 0, sizeof(buckets));
+    }
+
+    inline void StageHistogram::add(uint32_t ticks) noexcept{
+        if(resetPending.load(std::memory_order_relaxed)){
+            clear();
+            resetPending.store(false, std::memory_order_relaxed);
+        }
+
+        count++;
+        sumTicks += ticks;
+        if(ticks < minTicks)
+            minTicks = ticks;
+        if(ticks > maxTicks)
+            maxTicks = ticks;
+        buckets[bucket(ticks)]++;
+    }
+
+    inline StageSummary StageHistogram::summary(uint32_t ticksPerUs) const noexcept{
+        StageSummary sum;
+        const auto   toNs { [&](uint64_t ticks){
+                                const uint64_t ns { ticks * 1000 / ticksPerUs };
+                                return ns > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(ns);
+                            } };
+
+        sum.count = count;
+        if(count == 0)
+            return sum;
+
+        // The p99 bucket is reported by its upper bound, never past the maximum.
+        const uint32_t rank { count - count / 100 };
+        uint32_t       seen { 0 },
+                       p99  { maxTicks };
+        for(size_t idx{0}; idx<BUCKETS; idx++){
+            seen += buckets[idx];
+            if(seen >= rank){
+                p99 = bucketTop(idx) < maxTicks ? bucketTop(idx) : maxTicks;
+                break;
+            }
+        }
+
+        sum.minNs  = toNs(minTicks);
+        sum.meanNs = toNs(sumTicks / count);
+        sum.p99Ns  = toNs(p99);
+        sum.maxNs  = toNs(maxTicks);
+        return sum;
+    }
+
+    class Profiler{
+
+        public:
+
+                       Profiler(void)                               noexcept : ticksPerUs{profileTicksPerUs()} {}
+
+            void       add(PROFILE_STAGE stage, uint32_t ticks)     noexcept;
+            // Interval since the previous mark of the same stage.
+            void       mark(PROFILE_STAGE stage)                    noexcept;
+            StageSummary summary(PROFILE_STAGE stage)         const noexcept { return stages[stage].summary(ticksPerUs); }
+            void       requestReset(void)                           noexcept;
+
+        private:
+
+            uint32_t        ticksPerUs;
+            StageHistogram  stages[STAGES];
+            uint32_t        lastMark[STAGES]  {};
+            bool            marked[STAGES]    {};
+    };
+
+    inline void Profiler::add(PROFILE_STAGE stage, uint32_t ticks) noexcept{
+#if !defined(GLOVE_NO_PROFILE)
+        stages[stage].add(ticks);
+#else
+        (void)stage;
+        (void)ticks;
+#endif
+    }
+
+    inline void Profiler::mark(PROFILE_STAGE stage) noexcept{
+#if !defined(GLOVE_NO_PROFILE)
+        const uint32_t now { profileTicks() };
+        if(marked[stage])
+            stages[stage].add(now - lastMark[stage]);
+        lastMark[stage] = now;
+        marked[stage]   = true;
+#else
+        (void)stage;
+#endif
+    }
+
+    inline void Profiler::requestReset(void) noexcept{
+        for(auto& stage: stages)
+            stage.requestReset();
+    }
+
+    // Times the enclosing scope.
+#if !defined(GLOVE_NO_PROFILE)
+    class StageProbe{
+        public:
+                       StageProbe(Profiler& prof, PROFILE_STAGE stg) noexcept : profiler{prof}, stage{stg}, start{profileTicks()} {}
+                       ~StageProbe(void)                             noexcept { profiler.add(stage, profileTicks() - start); }
+        private:
+            Profiler&       profiler;
+            PROFILE_STAGE   stage;
+            uint32_t        start;
+    };
+#else
+    class StageProbe{
+        public:
+                       StageProbe(Profiler&, PROFILE_STAGE)          noexcept {}
+    };
+#endif
+
+    // Stats report, sent on the transport that asked with STATS_REQUEST.
+    // Little endian:
+    //
+    // off size
+    //  0   4   magic 'G' 'S' 'T' 'A'
+    //  4   1   version
+    //  5   1   stages that follow, see PROFILE_STAGE; 0 in a -DGLOVE_NO_PROFILE build
+    //  6   4   us since the previous report, the window the stages cover
+    // 10  20   per stage: count, min, mean, p99, max, the times in ns
+    //  .   2   CRC-16/CCITT of the bytes before
+    //
+    // The stages start over after each report.
+
+    const uint8_t  STATS_VERSION     { 1 },
+                   STATS_REQUEST     { 'S' };
+
+    const size_t   STATS_HEADER      { 10 },
+                   STATS_STAGE       { 20 },
+                   STATS_MAX_SIZE    { STATS_HEADER + STAGES * STATS_STAGE + 2 };
+
+    struct StatsReport{
+        uint8_t        stageCount             { 0 };
+        uint32_t       windowUs               { 0 };
+        StageSummary   stages[STAGES]         {};
+    };
+
+    inline size_t encodeStatsReport(const StatsReport& rep, uint8_t* out) noexcept{
+        memcpy(out, "GSTA", 4);
+        out[4] = STATS_VERSION;
+        out[5] = rep.stageCount;
+        put32(out + 6, rep.windowUs);
+
+        uint8_t* pos { out + STATS_HEADER };
+        for(size_t idx{0}; idx<rep.stageCount; idx++, pos += STATS_STAGE){
+            const StageSummary& st { rep.stages[idx] };
+            put32(pos,      st.count);
+            put32(pos + 4,  st.minNs);
+            put32(pos + 8,  st.meanNs);
+            put32(pos + 12, st.p99Ns);
+            put32(pos + 16, st.maxNs);
+        }
+
+        put16(pos, crc16(out, static_cast<size_t>(pos - out)));
+        return static_cast<size_t>(pos - out) + 2;
+    }
+
+    // Incremental reader of the reports inside a byte stream, for the host tools.
+    class StatsDecoder{
+
+        public:
+
+            // True when 'byte' completes a report with a good CRC.
+            bool       push(uint8_t byte, StatsReport& rep)         noexcept;
+
+        private:
+
+            uint8_t    buffer[STATS_MAX_SIZE] {};
+            size_t     fill                   { 0 };
+    };
+
+    inline bool StatsDecoder::push(uint8_t byte, StatsReport& rep) noexcept{
+        buffer[fill++] = byte;
+
+        if(fill <= 4 && byte != "GSTA"[fill - 1]){
+            fill = 0;
+            if(byte == 'G')
+                buffer[fill++] = byte;
+            return false;
+        }
+        if(fill == 6 && (buffer[4] == 0 || buffer[4] > STATS_VERSION || buffer[5] > STAGES)){
+            fill = 0;
+            return false;
+        }
+        if(fill < 6 || fill < STATS_HEADER + buffer[5] * STATS_STAGE + 2)
+            return false;
+
+        const size_t len { fill - 2 };
+        fill = 0;
+        if(get16(buffer + len) != crc16(buffer, len))
+            return false;
+
+        rep            = StatsReport{};
+        rep.stageCount = buffer[5];
+        rep.windowUs   = get32(buffer + 6);
+        for(size_t idx{0}; idx<rep.stageCount; idx++){
+            const uint8_t* pos { buffer + STATS_HEADER + idx * STATS_STAGE };
+            rep.stages[idx] = StageSummary{ get32(pos), get32(pos + 4), get32(pos + 8), get32(pos + 12), get32(pos + 16) };
+        }
+        return true;
+    }
+
+} // End namespace glove
@@ -0,0 +1,200 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
+
+namespace glove {
+
+    // Finger response: maps a 12 bit potentiometer reading to 0 - normMax,
+    // normMax being the relaxed finger. The whole curve is tabulated when the
+    // calibration changes, so a sample costs one lookup. The shapes but SPLINE
+    // never rise with the reading: their table is filled level by level, from
+    // where the curve crosses each one, which takes a few hundred float
+    // logarithms instead of one per reading.
+    //
+    // LEGACY_LOG  the original formula, normMax * (1 - log(raw) / log(sup)), inf unused
+    // LOG         logarithmic between inf and sup
+    // LINEAR      linear between inf and sup
+    // SPLINE      monotone cubic through user points, x and y as fractions of [inf, sup] and [0, normMax]
+
+    enum CURVE_SHAPE : uint8_t { LEGACY_LOG=0, LOG=1, LINEAR=2, SPLINE=3 };
+
+    struct SplinePoint{
+        float   x    { 0.0f },
+                y    { 0.0f };
+    };
+
+    class ResponseCurve{
+
+        public:
+
+            static const size_t   ADC_STEPS      { 4096 };
+            static const size_t   MAX_POINTS     { 8 };
+
+            void       configure(CURVE_SHAPE shape, uint16_t inf,
+                                 uint16_t sup, uint8_t normMax)          noexcept;
+            void       setRange(uint16_t inf, uint16_t sup)              noexcept { configure(curveShape, inf, sup, maxNorm); }
+            void       setShape(CURVE_SHAPE shape)                       noexcept { configure(shape, lower, upper, maxNorm); }
+            // Points must have increasing x in [0, 1]; the shape switches to SPLINE.
+            bool       setSplinePoints(const SplinePoint* pts, size_t n) noexcept;
+
+            uint8_t    operator()(uint16_t raw)                    const noexcept { return table[raw & (ADC_STEPS - 1)]; }
+            CURVE_SHAPE shape(void)                                const noexcept { return curveShape; }
+
+        private:
+
+            uint8_t       table[ADC_STEPS]  {};
+            CURVE_SHAPE   curveShape        { LEGACY_LOG };
+            uint16_t      lower             { 0 },
+                          upper             { ADC_STEPS - 1 };
+            uint8_t       maxNorm           { 90 };
+            SplinePoint   points[MAX_POINTS] {};
+            float         slopes[MAX_POINTS] {};
+            size_t        pointCount        { 0 };
+
+            float      evaluate(uint16_t raw)                      const noexcept;
+            float      crossing(uint8_t level)                     const noexcept;
+            float      spline(float x)                             const noexcept;
+    };
+
+    inline void ResponseCurve::configure(CURVE_SHAPE shape, uint16_t inf, uint16_t sup, uint8_t normMax) noexcept{
+        curveShape = shape == SPLINE && pointCount < 2 ? LINEAR : shape;
+        lower      = inf;
+        upper      = sup;
+        maxNorm    = normMax;
+
+        if(curveShape == SPLINE){
+            for(size_t raw{0}; raw<ADC_STEPS; raw++){
+                const float val { evaluate(static_cast<uint16_t>(raw)) };
+                table[raw] = val <= 0.0f ? 0 : val >= maxNorm ? maxNorm : static_cast<uint8_t>(val);
+            }
+            return;
+        }
+
+        // [start, end) reads 'level': end is the first reading below it, the
+        // crossing settled on evaluate() so the table is the one it gives.
+        size_t start { 0 };
+        for(uint8_t level{maxNorm}; level>0; level--){
+            const float cross { crossing(level) };
+            size_t      end   { cross < start ? start : cross >= ADC_STEPS ? ADC_STEPS : static_cast<size_t>(cross) + 1 };
+            while(end > start && evaluate(static_cast<uint16_t>(end - 1)) < level)
+                end--;
+            while(end < ADC_STEPS && evaluate(static_cast<uint16_t>(end)) >= level)
+                end++;
+            memset(table + start, level, end - start);
+            start = end;
+        }
+        memset(table + start, 0, ADC_STEPS - start);
+    }
+
+    inline float ResponseCurve::evaluate(uint16_t raw) const noexcept{
+        const float span { upper > lower ? static_cast<float>(upper - lower) : 1.0f };
+        const float pos  { raw <= lower ? 0.0f : raw >= upper ? 1.0f : (raw - lower) / span };
+
+        switch(curveShape){
+            case LEGACY_LOG:
+                return maxNorm - fabsf((log10f(raw < 1 ? 1 : raw) * maxNorm) / log10f(upper > 20 ? upper : 20));
+            case LOG:
+                return maxNorm * (1.0f - log1pf(pos * span) / log1pf(span));
+            case SPLINE:
+                return maxNorm * spline(pos);
+            default:
+                return maxNorm * (1.0f - pos);
+        }
+    }
+
+    // Reading where a monotone shape comes down to 'level', near enough for
+    // configure() to settle it in a step or two.
+    inline float ResponseCurve::crossing(uint8_t level) const noexcept{
+        const float span { upper > lower ? static_cast<float>(upper - lower) : 1.0f },
+                    left { 1.0f - static_cast<float>(level) / maxNorm };
+
+        switch(curveShape){
+            case LEGACY_LOG:
+                return powf(upper > 20 ? upper : 20, left);
+            case LOG:
+                return lower + expm1f(left * log1pf(span));
+            default:
+                return lower + left * span;
+        }
+    }
+
+    // Fritsch - Carlson tangents keep the interpolation monotone between points.
+    inline bool ResponseCurve::setSplinePoints(const SplinePoint* pts, size_t n) noexcept{
+        if(n < 2 || n > MAX_POINTS)
+            return false;
+        for(size_t i{1}; i<n; i++)
+            if(pts[i].x <= pts[i - 1].x)
+                return false;
+
+        for(size_t i{0}; i<n; i++)
+            points[i] = pts[i];
+        pointCount = n;
+
+        float secant[MAX_POINTS] {};
+        for(size_t i{0}; i<n - 1; i++)
+            secant[i] = (points[i + 1].y - points[i].y) / (points[i + 1].x - points[i].x);
+
+        slopes[0]     = secant[0];
+        slopes[n - 1] = secant[n - 2];
+        for(size_t i{1}; i<n - 1; i++)
+            slopes[i] = secant[i - 1] * secant[i] <= 0.0f ? 0.0f : (secant[i - 1] + secant[i]) / 2.0f;
+
+        for(size_t i{0}; i<n - 1; i++){
+            if(secant[i] == 0.0f){
+                slopes[i] = slopes[i + 1] = 0.0f;
+                continue;
+            }
+            const float alpha { slopes[i]     / secant[i] },
+                        beta  { slopes[i + 1] / secant[i] },
+                        norm  { alpha * alpha + beta * beta };
+            if(norm > 9.0f){
+                const float tau { 3.0f / sqrtf(norm) };
+                slopes[i]     = tau * alpha * secant[i];
+                slopes[i + 1] = tau * beta  * secant[i];
+            }
+        }
+
+        configure(SPLINE, lower, upper, maxNorm);
+        return true;
+    }
+
+    inline float ResponseCurve::spline(float x) const noexcept{
+        if(x <= points[0].x)
+            return points[0].y;
+        if(x >= points[pointCount - 1].x)
+            return points[pointCount - 1].y;
+
+        size_t seg { 0 };
+        while(x > points[seg + 1].x)
+            seg++;
+
+        const float h   { points[seg + 1].x - points[seg].x },
+                    t   { (x - points[seg].x) / h },
+                    t2  { t * t },
+                    t3  { t2 * t };
+
+        return (2 * t3 - 3 * t2 + 1) * points[seg].y + (t3 - 2 * t2 + t) * h * slopes[seg] +
+               (-2 * t3 + 3 * t2)    * points[seg + 1].y + (t3 - t2)    * h * slopes[seg + 1];
+    }
+
+} // End namespace glove
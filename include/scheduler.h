@@ -0,0 +1,211 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace glove {
+
+    // Time source in microseconds. It wraps around after ~71 minutes: all the
+    // comparisons below are done on the signed difference, so that's harmless.
+    class Clock{
+        public:
+            virtual            ~Clock(void)                 = default;
+            virtual uint32_t   nowUs(void)            const noexcept = 0;
+            virtual void       sleepUs(uint32_t us)         noexcept = 0;
+    };
+
+    // Clock driven by hand, used to run the scheduler on a host.
+    class FakeClock : public Clock{
+        public:
+            uint32_t   nowUs(void)              const noexcept override { return current; }
+            void       sleepUs(uint32_t us)           noexcept override { current += us; }
+            void       setUs(uint32_t us)             noexcept          { current = us; }
+            void       advanceUs(uint32_t us)         noexcept          { current += us; }
+
+        private:
+            uint32_t   current                  { 0 };
+    };
+
+    using TaskCallback = void (*)(void* ctx);
+
+    struct TaskStats{
+        uint32_t     runs                { 0 },
+                     overruns            { 0 },   // deadlines missed by at least a whole period
+                     skipped             { 0 },   // periods dropped to resync after an overrun
+                     maxLatenessUs       { 0 },
+                     maxRunUs            { 0 };
+    };
+
+    // Cooperative rate-monotonic loop: every task has its own period and
+    // absolute deadline. A deadline advances by exactly one period per run,
+    // so the average rate doesn't drift with the time spent in the tasks.
+    template<size_t MAX_TASKS>
+    class Scheduler{
+
+        public:
+
+            explicit   Scheduler(const Clock& clk)                         noexcept;
+
+            int        addTask(TaskCallback cb, void* ctx, uint32_t periodUs) noexcept;
+            bool       setPeriod(int id, uint32_t periodUs)                noexcept;
+            bool       setEnabled(int id, bool onOff)                      noexcept;
+            uint32_t   period(int id)                                const noexcept;
+
+            uint32_t   runPending(void)                                    noexcept;
+            uint32_t   untilNextUs(void)                             const noexcept;
+
+            const TaskStats& stats(int id)                           const noexcept;
+            void       resetStats(void)                                    noexcept;
+            size_t     size(void)                                    const noexcept { return count; }
+
+        private:
+
+            struct Task{
+                TaskCallback cb              { nullptr };
+                void*        ctx             { nullptr };
+                uint32_t     periodUs        { 0 },
+                             deadline        { 0 };
+                bool         enabled         { false };
+                TaskStats    stats;
+            };
+
+            const Clock&     clock;
+            Task             tasks[MAX_TASKS];
+            size_t           count           { 0 };
+
+            bool             valid(int id)                           const noexcept;
+    };
+
+    template<size_t MAX_TASKS>
+    Scheduler<MAX_TASKS>::Scheduler(const Clock& clk) noexcept
+        : clock{clk}
+    {}
+
+    template<size_t MAX_TASKS>
+    bool Scheduler<MAX_TASKS>::valid(int id) const noexcept{
+        return id >= 0 && static_cast<size_t>(id) < count;
+    }
+
+    template<size_t MAX_TASKS>
+    int Scheduler<MAX_TASKS>::addTask(TaskCallback cb, void* ctx, uint32_t periodUs) noexcept{
+        if(count == MAX_TASKS || cb == nullptr || periodUs == 0)
+            return -1;
+
+        Task& task    { tasks[count] };
+        task.cb       = cb;
+        task.ctx      = ctx;
+        task.periodUs = periodUs;
+        task.deadline = clock.nowUs();
+        task.enabled  = true;
+
+        return static_cast<int>(count++);
+    }
+
+    template<size_t MAX_TASKS>
+    bool Scheduler<MAX_TASKS>::setPeriod(int id, uint32_t periodUs) noexcept{
+        if(!valid(id) || periodUs == 0)
+            return false;
+
+        tasks[id].periodUs = periodUs;
+        tasks[id].deadline = clock.nowUs();
+        return true;
+    }
+
+    template<size_t MAX_TASKS>
+    bool Scheduler<MAX_TASKS>::setEnabled(int id, bool onOff) noexcept{
+        if(!valid(id))
+            return false;
+
+        if(onOff && !tasks[id].enabled)
+            tasks[id].deadline = clock.nowUs();
+        tasks[id].enabled = onOff;
+        return true;
+    }
+
+    template<size_t MAX_TASKS>
+    uint32_t Scheduler<MAX_TASKS>::period(int id) const noexcept{
+        return valid(id) ? tasks[id].periodUs : 0;
+    }
+
+    template<size_t MAX_TASKS>
+    const TaskStats& Scheduler<MAX_TASKS>::stats(int id) const noexcept{
+        static const TaskStats none;
+        return valid(id) ? tasks[id].stats : none;
+    }
+
+    template<size_t MAX_TASKS>
+    void Scheduler<MAX_TASKS>::resetStats(void) noexcept{
+        for(size_t i{0}; i<count; i++)
+            tasks[i].stats = TaskStats{};
+    }
+
+    // Runs every task whose deadline is due, in registration order, and returns
+    // the microseconds left before the next one.
+    template<size_t MAX_TASKS>
+    uint32_t Scheduler<MAX_TASKS>::runPending(void) noexcept{
+        for(size_t i{0}; i<count; i++){
+            Task&          task  { tasks[i] };
+            const uint32_t start { clock.nowUs() };
+            const int32_t  late  { static_cast<int32_t>(start - task.deadline) };
+
+            if(!task.enabled || late < 0)
+                continue;
+
+            task.cb(task.ctx);
+
+            const uint32_t spent { clock.nowUs() - start };
+            if(spent > task.stats.maxRunUs)
+                task.stats.maxRunUs = spent;
+            if(static_cast<uint32_t>(late) > task.stats.maxLatenessUs)
+                task.stats.maxLatenessUs = static_cast<uint32_t>(late);
+            task.stats.runs++;
+
+            task.deadline += task.periodUs;
+            if(static_cast<uint32_t>(late) >= task.periodUs){
+                // Too late to catch up: drop the lost periods instead of bursting.
+                const uint32_t lost { static_cast<uint32_t>(late) / task.periodUs };
+                task.stats.overruns++;
+                task.stats.skipped  += lost;
+                task.deadline       += lost * task.periodUs;
+            }
+        }
+
+        return untilNextUs();
+    }
+
+    template<size_t MAX_TASKS>
+    uint32_t Scheduler<MAX_TASKS>::untilNextUs(void) const noexcept{
+        const uint32_t now  { clock.nowUs() };
+        uint32_t       wait { UINT32_MAX };
+
+        for(size_t i{0}; i<count; i++){
+            if(!tasks[i].enabled)
+                continue;
+            const int32_t left { static_cast<int32_t>(tasks[i].deadline - now) };
+            if(left <= 0)
+                return 0;
+            if(static_cast<uint32_t>(left) < wait)
+                wait = static_cast<uint32_t>(left);
+        }
+
+        return wait;
+    }
+
+} // End namespace glove
@@ -0,0 +1,499 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include "hal.h"
+#include "layout.h"
+#include "telemetry.h"
+#include "calibration.h"
+#include "imu_events.h"
+
+namespace glove {
+
+    // Session log: what the glove read from its sensors, to be replayed
+    // through the same processing later. Little endian, a fixed size header
+    // followed by fixed size records, so that a file can be mapped and
+    // indexed directly.
+    //
+    // Header
+    // off size
+    //  0   4   magic 'G' 'S' 'E' 'S'
+    //  4   1   version
+    //  5   1   IMU mode, see IMU_MODE
+    //  6   2   record size
+    //  8   4   timestamp of the start, device microseconds
+    // 12   1   ADC lines recorded, A: the fingers then the buttons of GLOVE_TOPOLOGY
+    // 13   A   their pins, in record order
+    // 13+A I   mux channels of the I IMUs of GLOVE_TOPOLOGY, in its order
+    // 24   2   calibration record length, 0 if none
+    // 26 214   calibration record, see calibration.h
+    // 240  4   I2C bus speed, Hz, 0 if unknown
+    // 244 10   zero
+    // 254  2   CRC-16/CCITT of bytes 0 - 253
+    //
+    // Record, 72 bytes for the 8 ADC lines and 3 IMUs of the glove
+    //  0   4   timestamp, device microseconds
+    //  4 16I   last quaternion read from each IMU, w,x,y,z float
+    //  .  2A   last raw value read from each ADC line, 12 bit (the buttons too, 0 or 4095)
+    //  .   1   bit n: IMU n delivered a new quaternion since the previous record
+    //  .   .   zero up to a multiple of 4 bytes
+
+    const uint8_t  SESSION_VERSION   { 1 };
+
+    const size_t   SESSION_ADCS      { GLOVE_FINGERS + GLOVE_BUTTONS },
+                   SESSION_IMUS      { GLOVE_IMUS },
+                   SESSION_HEADER    { 256 },
+                   SESSION_RECORD    { (4 + 16 * SESSION_IMUS + 2 * SESSION_ADCS + 1 + 3) / 4 * 4 };
+
+    static_assert(26 + CALIB_MAX_SIZE <= SESSION_HEADER - 2, "calibration record too large for the session header");
+    static_assert(13 + SESSION_ADCS + SESSION_IMUS <= 24 && SESSION_IMUS <= 8, "GLOVE_TOPOLOGY too large for the session header");
+
+    // What SessionTap records, in record order: the finger then the button
+    // pins, and the mux channels of the IMUs.
+    struct SessionLayout{
+        uint8_t    adcPins[SESSION_ADCS]         {};
+        uint8_t    imuChannels[SESSION_IMUS]     {};
+    };
+
+    template<size_t F, size_t I>
+    constexpr SessionLayout sessionLayout(const Topology<F, I>& topo) noexcept{
+        SessionLayout layout {};
+        size_t        count  { 0 };
+
+        for(const auto& finger: topo.fingers)
+            layout.adcPins[count++] = finger.adcPin;
+        for(uint8_t pin: topo.buttonPins)
+            layout.adcPins[count++] = pin;
+        for(size_t idx{0}; idx<I; idx++)
+            layout.imuChannels[idx] = topo.imus[idx].muxChannel;
+        return layout;
+    }
+
+    struct SessionHeader{
+        uint8_t    imuMode                       { IMU_POLL };
+        uint32_t   startUs                       { 0 };
+        uint8_t    adcCount                      { 0 };
+        uint8_t    adcPins[SESSION_ADCS]         {};
+        uint8_t    imuChannels[SESSION_IMUS]     {};
+        uint16_t   calibrationLen                { 0 };
+        uint8_t    calibration[CALIB_MAX_SIZE]   {};
+        uint32_t   busHz                         { 0 };
+    };
+
+    struct SessionRecord{
+        uint32_t   timestampUs                   { 0 };
+        Quat       quat[SESSION_IMUS]            {};
+        uint16_t   adc[SESSION_ADCS]             {};
+        uint8_t    movement                      { 0 };
+    };
+
+    inline void encodeSessionHeader(const SessionHeader& hdr, uint8_t* out) noexcept{
+        memset(out, 0, SESSION_HEADER);
+        memcpy(out, "GSES", 4);
+        out[4] = SESSION_VERSION;
+        out[5] = hdr.imuMode;
+        put16(out + 6, SESSION_RECORD);
+        put32(out + 8, hdr.startUs);
+        out[12] = hdr.adcCount;
+        memcpy(out + 13, hdr.adcPins, SESSION_ADCS);
+        memcpy(out + 13 + SESSION_ADCS, hdr.imuChannels, SESSION_IMUS);
+        put16(out + 24, hdr.calibrationLen);
+        memcpy(out + 26, hdr.calibration, hdr.calibrationLen);
+        put32(out + 240, hdr.busHz);
+        put16(out + SESSION_HEADER - 2, crc16(out, SESSION_HEADER - 2));
+    }
+
+    // False on bad magic, CRC or layout and on versions newer than this code.
+    inline bool decodeSessionHeader(const uint8_t* in, SessionHeader& hdr) noexcept{
+        if(memcmp(in, "GSES", 4) != 0 || in[4] == 0 || in[4] > SESSION_VERSION)
+            return false;
+        if(get16(in + SESSION_HEADER - 2) != crc16(in, SESSION_HEADER - 2))
+            return false;
+        if(get16(in + 6) != SESSION_RECORD || in[12] > SESSION_ADCS || get16(in + 24) > CALIB_MAX_SIZE)
+            return false;
+
+        hdr                = SessionHeader{};
+        hdr.imuMode        = in[5];
+        hdr.startUs        = get32(in + 8);
+        hdr.adcCount       = in[12];
+        memcpy(hdr.adcPins, in + 13, SESSION_ADCS);
+        memcpy(hdr.imuChannels, in + 13 + SESSION_ADCS, SESSION_IMUS);
+        hdr.calibrationLen = get16(in + 24);
+        memcpy(hdr.calibration, in + 26, hdr.calibrationLen);
+        hdr.busHz          = get32(in + 240);
+        return true;
+    }
+
+    inline void encodeSessionRecord(const SessionRecord& rec, uint8_t* out) noexcept{
+        put32(out, rec.timestampUs);
+
+        uint8_t* pos { out + 4 };
+        for(const auto& q: rec.quat){
+            pos = putFloat(pos, q.w);
+            pos = putFloat(pos, q.x);
+            pos = putFloat(pos, q.y);
+            pos = putFloat(pos, q.z);
+        }
+        for(uint16_t val: rec.adc){
+            put16(pos, val);
+            pos += 2;
+        }
+        *pos++ = rec.movement;
+        memset(pos, 0, out + SESSION_RECORD - pos);
+    }
+
+    inline void decodeSessionRecord(const uint8_t* in, SessionRecord& rec) noexcept{
+        rec.timestampUs = get32(in);
+
+        const uint8_t* pos { in + 4 };
+        for(auto& q: rec.quat){
+            q    = Quat{ getFloat(pos), getFloat(pos + 4), getFloat(pos + 8), getFloat(pos + 12) };
+            pos += 16;
+        }
+        for(uint16_t& val: rec.adc){
+            val  = get16(pos);
+            pos += 2;
+        }
+        rec.movement = *pos;
+    }
+
+    // Session stream: a glove built with a SessionTap and switched to the
+    // SESSION output format sends the header above once, as it is, then a
+    // record frame per output period in which a sensor was read; glove_record
+    // writes them to a session file. Little endian:
+    //
+    // Record frame
+    // off size
+    //  0   4   magic 'G' 'S' 'R' 'C'
+    //  4   R   record, as in the file
+    //  .   2   CRC-16/CCITT of the bytes before
+
+    const size_t   SESSION_FRAME     { 4 + SESSION_RECORD + 2 };
+
+    inline size_t encodeSessionFrame(const SessionRecord& rec, uint8_t* out) noexcept{
+        memcpy(out, "GSRC", 4);
+        encodeSessionRecord(rec, out + 4);
+        put16(out + 4 + SESSION_RECORD, crc16(out, 4 + SESSION_RECORD));
+        return SESSION_FRAME;
+    }
+
+    // Incremental reader of the session headers and record frames inside a
+    // byte stream, for the host tools.
+    class SessionStreamDecoder{
+
+        public:
+
+            enum SESSION_PART : uint8_t { SESSION_NONE=0, SESSION_HEADER_READY=1, SESSION_RECORD_READY=2 };
+
+            SESSION_PART push(uint8_t byte)                           noexcept;
+
+            const SessionHeader& header(void)                   const noexcept { return hdr; }
+            const SessionRecord& record(void)                   const noexcept { return rec; }
+            uint32_t   crcErrors(void)                          const noexcept { return crcCount; }
+
+        private:
+
+            uint8_t        buffer[SESSION_HEADER] {};
+            size_t         fill                   { 0 };
+            SessionHeader  hdr;
+            SessionRecord  rec;
+            uint32_t       crcCount               { 0 };
+    };
+
+    inline SessionStreamDecoder::SESSION_PART SessionStreamDecoder::push(uint8_t byte) noexcept{
+        buffer[fill++] = byte;
+
+        if(fill <= 4 && byte != "GSES"[fill - 1] && byte != "GSRC"[fill - 1]){
+            fill = 0;
+            if(byte == 'G')
+                buffer[fill++] = byte;
+            return SESSION_NONE;
+        }
+        if(fill == 4 && memcmp(buffer, "GSES", 4) != 0 && memcmp(buffer, "GSRC", 4) != 0){
+            fill = 0;
+            return SESSION_NONE;
+        }
+
+        const bool   header { fill >= 4 && buffer[2] == 'E' };
+        if(fill < (header ? SESSION_HEADER : SESSION_FRAME))
+            return SESSION_NONE;
+
+        fill = 0;
+        if(header){
+            if(decodeSessionHeader(buffer, hdr))
+                return SESSION_HEADER_READY;
+        } else if(get16(buffer + 4 + SESSION_RECORD) == crc16(buffer, 4 + SESSION_RECORD)){
+            decodeSessionRecord(buffer + 4, rec);
+            return SESSION_RECORD_READY;
+        }
+        crcCount++;
+        return SESSION_NONE;
+    }
+
+    // A whole session in memory, usually a mapped file: nothing is copied,
+    // records are decoded on access. A truncated last record is ignored.
+    class SessionView{
+
+        public:
+
+                       SessionView(const uint8_t* data, size_t len)  noexcept;
+
+            bool       valid(void)                             const noexcept { return ok; }
+            const SessionHeader& header(void)                  const noexcept { return hdr; }
+            size_t     records(void)                           const noexcept { return count; }
+            bool       record(size_t idx, SessionRecord& rec)  const noexcept;
+
+        private:
+
+            const uint8_t*  base;
+            SessionHeader   hdr;
+            bool            ok            { false };
+            size_t          count         { 0 };
+    };
+
+    inline SessionView::SessionView(const uint8_t* data, size_t len) noexcept
+        : base{data}
+    {
+        ok    = data != nullptr && len >= SESSION_HEADER && decodeSessionHeader(data, hdr);
+        count = ok ? (len - SESSION_HEADER) / SESSION_RECORD : 0;
+    }
+
+    inline bool SessionView::record(size_t idx, SessionRecord& rec) const noexcept{
+        if(idx >= count)
+            return false;
+        decodeSessionRecord(base + SESSION_HEADER + idx * SESSION_RECORD, rec);
+        return true;
+    }
+
+    // Appends records to a session file.
+    class SessionWriter{
+
+        public:
+
+                       ~SessionWriter(void)                           noexcept { close(); }
+
+            bool       open(const char* path, const SessionHeader& hdr) noexcept;
+            bool       append(const SessionRecord& rec)               noexcept;
+            bool       close(void)                                    noexcept;
+            uint32_t   records(void)                            const noexcept { return count; }
+
+        private:
+
+            FILE*      out                   { nullptr };
+            uint32_t   count                 { 0 };
+    };
+
+    inline bool SessionWriter::open(const char* path, const SessionHeader& hdr) noexcept{
+        uint8_t buffer[SESSION_HEADER];
+
+        close();
+        out = fopen(path, "wb");
+        if(out == nullptr)
+            return false;
+
+        encodeSessionHeader(hdr, buffer);
+        count = 0;
+        return fwrite(buffer, 1, sizeof(buffer), out) == sizeof(buffer);
+    }
+
+    inline bool SessionWriter::append(const SessionRecord& rec) noexcept{
+        uint8_t buffer[SESSION_RECORD];
+
+        if(out == nullptr)
+            return false;
+        encodeSessionRecord(rec, buffer);
+        if(fwrite(buffer, 1, sizeof(buffer), out) != sizeof(buffer))
+            return false;
+        count++;
+        return true;
+    }
+
+    inline bool SessionWriter::close(void) noexcept{
+        if(out == nullptr)
+            return true;
+        const bool ok { fclose(out) == 0 };
+        out = nullptr;
+        return ok;
+    }
+
+    // Sits between a board and the glove and remembers the last value of
+    // every sensor read: board() is the one to hand to the glove.
+    class SessionTap{
+
+        public:
+
+            static constexpr SessionLayout  LAYOUT { sessionLayout(GLOVE_TOPOLOGY) };
+
+            explicit   SessionTap(const Board& target)                noexcept;
+            Board      board(void)                                    noexcept;
+
+            // Layout and calibration of the session; the active profile is read from the store.
+            SessionHeader header(IMU_MODE mode)                       noexcept;
+            // True when something was read since the previous call; clears the movement bits.
+            bool       take(SessionRecord& rec)                       noexcept;
+
+        private:
+
+            class TapAdc : public Adc{
+                public:
+                    explicit   TapAdc(SessionTap& tp)                 noexcept : tap{tp} {}
+                    void       configure(uint8_t pin, bool pulldown)  noexcept override { tap.target.adc.configure(pin, pulldown); }
+                    uint16_t   read(uint8_t pin)                      noexcept override;
+                private:
+                    SessionTap&  tap;
+            };
+
+            // The buttons are read as GPIO levels: recorded in their ADC slots as 0 or 4095.
+            class TapIrq : public GpioIrq{
+                public:
+                    explicit   TapIrq(SessionTap& tp)                 noexcept : tap{tp} {}
+                    bool       attach(uint8_t pin, IrqHandler handler, void* ctx,
+                                      IRQ_EDGE edge)                  noexcept override { return tap.target.irq.attach(pin, handler, ctx, edge); }
+                    void       detach(uint8_t pin)                    noexcept override { tap.target.irq.detach(pin); }
+                    bool       level(uint8_t pin)                     noexcept override;
+                private:
+                    SessionTap&  tap;
+            };
+
+            class TapMux : public I2cMux{
+                public:
+                    explicit   TapMux(SessionTap& tp)                 noexcept : tap{tp} {}
+                    bool       select(uint8_t channel)                noexcept override;
+                    bool       probe(uint8_t addr)                    noexcept override { return tap.target.mux.probe(addr); }
+                    bool       setSpeed(uint32_t hz)                  noexcept override;
+                    bool       recover(void)                          noexcept override { return tap.target.mux.recover(); }
+                private:
+                    SessionTap&  tap;
+            };
+
+            class TapImu : public Imu{
+                public:
+                    explicit   TapImu(SessionTap& tp)                 noexcept : tap{tp} {}
+                    uint8_t    initialize(void)                       noexcept override { return tap.target.imu.initialize(); }
+                    bool       testConnection(void)                   noexcept override { return tap.target.imu.testConnection(); }
+                    void       calibrate(uint8_t loops)               noexcept override { tap.target.imu.calibrate(loops); }
+                    bool       readQuaternion(Quat& quat)             noexcept override;
+                    uint16_t   pendingPackets(void)                   noexcept override { return tap.target.imu.pendingPackets(); }
+                    void       getOffsets(int16_t* offsets)           noexcept override { tap.target.imu.getOffsets(offsets); }
+                    void       setOffsets(const int16_t* offsets)     noexcept override { tap.target.imu.setOffsets(offsets); }
+                    bool       setRawMode(bool raw)                   noexcept override { return tap.target.imu.setRawMode(raw); }
+                    bool       readRaw(RawImu& raw)                   noexcept override { return tap.target.imu.readRaw(raw); }
+                private:
+                    SessionTap&  tap;
+            };
+
+            Board          target;
+            TapAdc         adc               { *this };
+            TapMux         mux               { *this };
+            TapImu         imu               { *this };
+            TapIrq         irq               { *this };
+            uint8_t        channel           { 0xFF };
+            std::atomic<uint32_t> busHz      { 0 };     // header() may run on the other core
+            bool           dirty             { false };
+            SessionRecord  last;
+    };
+
+    inline SessionTap::SessionTap(const Board& brd) noexcept
+        : target{brd}
+    {}
+
+    inline Board SessionTap::board(void) noexcept{
+        return Board{ target.clock, adc, mux, imu, irq, target.store, target.display, target.console, target.link };
+    }
+
+    inline SessionHeader SessionTap::header(IMU_MODE mode) noexcept{
+        SessionHeader      hdr;
+        CalibrationStore   calibration { target.store };
+        CalibrationProfile profile;
+
+        hdr.imuMode  = mode;
+        hdr.startUs  = target.clock.nowUs();
+        hdr.busHz    = busHz.load(std::memory_order_relaxed);
+        hdr.adcCount = SESSION_ADCS;
+        memcpy(hdr.adcPins, LAYOUT.adcPins, SESSION_ADCS);
+        memcpy(hdr.imuChannels, LAYOUT.imuChannels, SESSION_IMUS);
+        if(calibration.load(calibration.activeUser(), profile))
+            hdr.calibrationLen = static_cast<uint16_t>(encodeProfile(profile, hdr.calibration));
+        return hdr;
+    }
+
+    inline bool SessionTap::take(SessionRecord& rec) noexcept{
+        const bool fresh { dirty };
+
+        last.timestampUs = target.clock.nowUs();
+        rec              = last;
+        last.movement    = 0;
+        dirty            = false;
+        return fresh;
+    }
+
+    inline uint16_t SessionTap::TapAdc::read(uint8_t pin) noexcept{
+        const uint16_t val { tap.target.adc.read(pin) };
+
+        for(size_t idx{0}; idx<SESSION_ADCS; idx++)
+            if(LAYOUT.adcPins[idx] == pin){
+                tap.last.adc[idx] = val;
+                tap.dirty         = true;
+            }
+        return val;
+    }
+
+    inline bool SessionTap::TapIrq::level(uint8_t pin) noexcept{
+        const bool high { tap.target.irq.level(pin) };
+
+        for(size_t idx{0}; idx<SESSION_ADCS; idx++)
+            if(LAYOUT.adcPins[idx] == pin){
+                tap.last.adc[idx] = high ? 4095 : 0;
+                tap.dirty         = true;
+            }
+        return high;
+    }
+
+    inline bool SessionTap::TapMux::select(uint8_t channel) noexcept{
+        const bool ok { tap.target.mux.select(channel) };
+        tap.channel = ok ? channel : 0xFF;
+        return ok;
+    }
+
+    inline bool SessionTap::TapMux::setSpeed(uint32_t hz) noexcept{
+        const bool ok { tap.target.mux.setSpeed(hz) };
+        if(ok)
+            tap.busHz.store(hz, std::memory_order_relaxed);
+        return ok;
+    }
+
+    inline bool SessionTap::TapImu::readQuaternion(Quat& quat) noexcept{
+        if(!tap.target.imu.readQuaternion(quat))
+            return false;
+
+        for(size_t idx{0}; idx<SESSION_IMUS; idx++)
+            if(LAYOUT.imuChannels[idx] == tap.channel){
+                tap.last.quat[idx]  = quat;
+                tap.last.movement  |= static_cast<uint8_t>(1 << idx);
+                tap.dirty           = true;
+            }
+        return true;
+    }
+
+} // End namespace glove
@@ -0,0 +1,130 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <chrono>
+#include <thread>
+
+#include "hal_sim.h"
+#include "session.h"
+
+// Host only: feeds a session log back into a simulated board.
+
+namespace glove {
+
+    class SessionPlayer{
+
+        public:
+
+                       SessionPlayer(const SessionView& session, SimBoard& board) noexcept;
+
+            // Before the glove is built: stores the recorded calibration as
+            // the active profile and points the sensors at the replayed values.
+            bool       prepare(void)                                  noexcept;
+
+            // Runs the schedule over the whole session, 'speed' times real
+            // time or as fast as possible if 0. Returns the records replayed.
+            template<typename S>
+            size_t     play(S& scheduler, float speed, uint32_t tickUs) noexcept;
+
+            uint32_t   sessionUs(void)                          const noexcept { return spanUs; }
+
+        private:
+
+            const SessionView&  view;
+            SimBoard&           sim;
+            Quat                held[SESSION_IMUS];
+            uint32_t            spanUs       { 0 };
+
+            void       apply(const SessionRecord& rec)                noexcept;
+    };
+
+    inline SessionPlayer::SessionPlayer(const SessionView& session, SimBoard& board) noexcept
+        : view{session}, sim{board}
+    {
+        SessionRecord first,
+                      last;
+        if(view.record(0, first) && view.record(view.records() - 1, last))
+            spanUs = last.timestampUs - first.timestampUs;
+    }
+
+    inline bool SessionPlayer::prepare(void) noexcept{
+        const SessionHeader& hdr { view.header() };
+
+        if(hdr.calibrationLen > 0){
+            CalibrationProfile profile;
+            CalibrationStore   calibration { sim.store };
+            if(!decodeProfile(hdr.calibration, hdr.calibrationLen, profile) ||
+               !calibration.save(profile) || !calibration.setActiveUser(profile.user))
+                return false;
+        }
+
+        // One sample traces: every DMP packet returns the value held last.
+        for(size_t idx{0}; idx<SESSION_IMUS; idx++)
+            sim.imu.setTrace(hdr.imuChannels[idx], &held[idx], 1);
+
+        SessionRecord first;
+        if(view.record(0, first))
+            apply(first);
+        return true;
+    }
+
+    inline void SessionPlayer::apply(const SessionRecord& rec) noexcept{
+        const SessionHeader& hdr { view.header() };
+
+        for(size_t idx{0}; idx<hdr.adcCount; idx++)
+            sim.adc.setConstant(hdr.adcPins[idx], rec.adc[idx]);
+        for(size_t idx{0}; idx<SESSION_IMUS; idx++)
+            held[idx] = rec.quat[idx];
+    }
+
+    // The board clock follows the record timestamps, shifted to start from
+    // its current value; between records it moves by 'tickUs' like glove_sim.
+    template<typename S>
+    size_t SessionPlayer::play(S& scheduler, float speed, uint32_t tickUs) noexcept{
+        using WallClock = std::chrono::steady_clock;
+
+        const auto     wallStart  { WallClock::now() };
+        const uint32_t boardStart { sim.clock.nowUs() };
+        SessionRecord  rec;
+        uint32_t       firstUs    { 0 };
+        size_t         idx        { 0 };
+
+        for(; view.record(idx, rec); idx++){
+            if(idx == 0)
+                firstUs = rec.timestampUs;
+            const uint32_t due { boardStart + (rec.timestampUs - firstUs) };
+
+            while(static_cast<int32_t>(due - sim.clock.nowUs()) > 0){
+                const uint32_t left { due - sim.clock.nowUs() };
+                scheduler.runPending();
+                sim.advanceUs(left < tickUs ? left : tickUs);
+            }
+
+            if(speed > 0.0f)
+                std::this_thread::sleep_until(wallStart + std::chrono::microseconds(
+                                              static_cast<int64_t>((rec.timestampUs - firstUs) / speed)));
+
+            apply(rec);
+            scheduler.runPending();
+        }
+
+        return idx;
+    }
+
+} // End namespace glove
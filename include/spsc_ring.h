@@ -0,0 +1,84 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace glove {
+
+    // Lock-free ring for exactly one producer and one consumer thread (or core).
+    // Indexes run freely and are masked on access, so all N slots are usable.
+    // A full ring rejects the new element: the producer never blocks.
+    template<typename T, size_t N>
+    class SpscRing{
+
+        static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+        public:
+
+            bool       push(const T& elem)              noexcept;
+            bool       pop(T& elem)                     noexcept;
+
+            size_t     size(void)                 const noexcept;
+            bool       empty(void)                const noexcept { return size() == 0; }
+            uint32_t   drops(void)                const noexcept { return dropCount.load(std::memory_order_relaxed); }
+
+        private:
+
+            static const size_t   CACHE_LINE    { 64 };
+
+            alignas(CACHE_LINE) std::atomic<size_t>   head      { 0 };   // written by the producer
+            alignas(CACHE_LINE) std::atomic<size_t>   tail      { 0 };   // written by the consumer
+            alignas(CACHE_LINE) std::atomic<uint32_t> dropCount { 0 };
+            T                                         slots[N];
+    };
+
+    template<typename T, size_t N>
+    bool SpscRing<T, N>::push(const T& elem) noexcept{
+        const size_t pos { head.load(std::memory_order_relaxed) };
+
+        if(pos - tail.load(std::memory_order_acquire) == N){
+            dropCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        slots[pos & (N - 1)] = elem;
+        head.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    template<typename T, size_t N>
+    bool SpscRing<T, N>::pop(T& elem) noexcept{
+        const size_t pos { tail.load(std::memory_order_relaxed) };
+
+        if(pos == head.load(std::memory_order_acquire))
+            return false;
+
+        elem = slots[pos & (N - 1)];
+        tail.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    template<typename T, size_t N>
+    size_t SpscRing<T, N>::size(void) const noexcept{
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+} // End namespace glove
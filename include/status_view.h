@@ -0,0 +1,72 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "hal.h"
+#include "layout.h"
+
+namespace glove {
+
+    // The finger glyphs of the status display, one per GLOVE_TOPOLOGY finger
+    // where the table puts it, blue when the finger is bent.
+    // Remembers what is on the screen and draws only the glyphs that changed,
+    // then flushes once; no hardware behind it, glove_bench checks it.
+    class StatusView{
+
+        public:
+
+            static const size_t  GLYPHS      { GLOVE_FINGERS };
+
+            explicit   StatusView(Display& dsp)                       noexcept : display{dsp} {}
+
+            // 'fingerStatus' as in Snapshot: bit n for finger n. Returns the glyphs drawn.
+            size_t     render(uint8_t fingerStatus)                   noexcept;
+            // Something else drew over the glyphs: the next render() draws them all.
+            void       invalidate(void)                               noexcept { valid = false; }
+
+        private:
+
+            Display&   display;
+            uint16_t   shown[GLYPHS]         {};
+            bool       valid                 { false };
+    };
+
+    inline size_t StatusView::render(uint8_t fingerStatus) noexcept{
+        size_t drawn { 0 };
+
+        for(size_t idx{0}; idx<GLYPHS; idx++){
+            const FingerChannel& finger { GLOVE_TOPOLOGY.fingers[idx] };
+            const uint16_t       colour { fingerStatus & (1 << idx) ? COL_BLUE : COL_ORANGE };
+
+            if(valid && shown[idx] == colour)
+                continue;
+            display.drawString("1", finger.glyphX, finger.glyphY, 7, colour);
+            shown[idx] = colour;
+            drawn++;
+        }
+
+        valid = true;
+        if(drawn > 0)
+            display.flush();
+        return drawn;
+    }
+
+} // End namespace glove
@@ -0,0 +1,214 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace glove {
+
+    // Binary frame, little endian, fixed size:
+    //
+    // off size
+    //  0   2   sync 0xA5 0x5A
+    //  2   1   version
+    //  3   1   flags (bit n: new packet from IMU n, bit 6: joint rotations, bit 7: calibration running)
+    //  4   2   sequence number
+    //  6   4   timestamp, device microseconds
+    // 10  24   quaternions w,x,y,z for arm, forearm, hand, Q14 signed
+    // 34   5   fingers t,i,m,r,p, normalized 0 - 90
+    // 39   1   buttons (bit 0 left, bit 1 middle, bit 2 right)
+    // 40   2   CRC-16/CCITT of bytes 2 - 39
+
+    const uint8_t  FRAME_SYNC0       { 0xA5 },
+                   FRAME_SYNC1       { 0x5A },
+                   FRAME_VERSION     { 1 };
+
+    const size_t   FRAME_IMUS        { 3 },
+                   FRAME_FINGERS     { 5 },
+                   FRAME_SIZE        { 42 };
+
+    const float    QUAT_SCALE        { 16384.0f };
+
+    enum FRAME_BUTTONS : uint8_t     { BTN_LEFT=0x1, BTN_MIDDLE=0x2, BTN_RIGHT=0x4 };
+
+    const uint8_t  FRAME_JOINTS      { 0x40 },    // quaternions relative to the parent segment, see kinematics.h
+                   FRAME_CALIBRATING { 0x80 };
+
+    struct TelemetrySample{
+        uint16_t   seq                        { 0 };
+        uint32_t   timestampUs                { 0 };
+        uint8_t    flags                      { 0 };
+        float      quat[FRAME_IMUS][4]        {};
+        uint8_t    fingers[FRAME_FINGERS]     {};
+        uint8_t    buttons                    { 0 };
+    };
+
+    // 'crc' continues a previous call, for data written in pieces.
+    inline uint16_t crc16(const uint8_t* data, size_t len, uint16_t crc = 0xFFFF) noexcept{
+        for(size_t i{0}; i<len; i++){
+            crc ^= static_cast<uint16_t>(data[i]) << 8;
+            for(uint8_t bit{0}; bit<8; bit++)
+                crc = crc & 0x8000 ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+        }
+        return crc;
+    }
+
+    inline void put16(uint8_t* out, uint16_t val) noexcept{
+        out[0] = val & 0xFF;
+        out[1] = val >> 8;
+    }
+
+    inline void put32(uint8_t* out, uint32_t val) noexcept{
+        put16(out, val & 0xFFFF);
+        put16(out + 2, val >> 16);
+    }
+
+    inline uint16_t get16(const uint8_t* in) noexcept{
+        return static_cast<uint16_t>(in[0] | (in[1] << 8));
+    }
+
+    inline uint32_t get32(const uint8_t* in) noexcept{
+        return get16(in) | (static_cast<uint32_t>(get16(in + 2)) << 16);
+    }
+
+    inline int16_t quantizeQuat(float val) noexcept{
+        const float scaled { val * QUAT_SCALE };
+        if(scaled >=  32767.0f) return  32767;
+        if(scaled <= -32768.0f) return -32768;
+        return static_cast<int16_t>(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+    }
+
+    inline size_t encodeFrame(const TelemetrySample& sample, uint8_t* out) noexcept{
+        out[0] = FRAME_SYNC0;
+        out[1] = FRAME_SYNC1;
+        out[2] = FRAME_VERSION;
+        out[3] = sample.flags;
+        put16(out + 4, sample.seq);
+        put32(out + 6, sample.timestampUs);
+
+        uint8_t* pos { out + 10 };
+        for(size_t imu{0}; imu<FRAME_IMUS; imu++)
+            for(size_t comp{0}; comp<4; comp++, pos += 2)
+                put16(pos, static_cast<uint16_t>(quantizeQuat(sample.quat[imu][comp])));
+
+        memcpy(pos, sample.fingers, FRAME_FINGERS);
+        pos   += FRAME_FINGERS;
+        *pos++ = sample.buttons;
+
+        put16(pos, crc16(out + 2, static_cast<size_t>(pos - out - 2)));
+        return FRAME_SIZE;
+    }
+
+    // Expects a whole frame at 'in'; returns false on bad sync, version or CRC.
+    inline bool decodeFrame(const uint8_t* in, TelemetrySample& sample) noexcept{
+        if(in[0] != FRAME_SYNC0 || in[1] != FRAME_SYNC1 || in[2] != FRAME_VERSION)
+            return false;
+        if(get16(in + FRAME_SIZE - 2) != crc16(in + 2, FRAME_SIZE - 4))
+            return false;
+
+        sample.flags       = in[3];
+        sample.seq         = get16(in + 4);
+        sample.timestampUs = get32(in + 6);
+
+        const uint8_t* pos { in + 10 };
+        for(size_t imu{0}; imu<FRAME_IMUS; imu++)
+            for(size_t comp{0}; comp<4; comp++, pos += 2)
+                sample.quat[imu][comp] = static_cast<int16_t>(get16(pos)) / QUAT_SCALE;
+
+        memcpy(sample.fingers, pos, FRAME_FINGERS);
+        sample.buttons = pos[FRAME_FINGERS];
+        return true;
+    }
+
+    // Incremental decoder for a byte stream: it resynchronizes on the sync
+    // bytes after garbage or a corrupted frame.
+    class FrameDecoder{
+
+        public:
+
+            // Returns true when 'byte' completes a valid frame, copied to 'sample'.
+            bool        push(uint8_t byte, TelemetrySample& sample)  noexcept;
+
+            uint32_t    frames(void)                           const noexcept { return frameCount; }
+            uint32_t    crcErrors(void)                        const noexcept { return crcCount; }
+            uint32_t    droppedBytes(void)                     const noexcept { return dropCount; }
+            uint32_t    lostFrames(void)                       const noexcept { return lostCount; }
+
+        private:
+
+            uint8_t     buffer[FRAME_SIZE]     {};
+            size_t      fill                   { 0 };
+            bool        haveSeq                { false };
+            uint16_t    lastSeq                { 0 };
+            uint32_t    frameCount             { 0 },
+                        crcCount               { 0 },
+                        dropCount              { 0 },
+                        lostCount              { 0 };
+
+            void        resync(size_t from)          noexcept;
+    };
+
+    inline bool FrameDecoder::push(uint8_t byte, TelemetrySample& sample) noexcept{
+        buffer[fill++] = byte;
+
+        if(fill == 1 && buffer[0] != FRAME_SYNC0){
+            fill = 0;
+            dropCount++;
+            return false;
+        }
+        // What's left after a bad frame may hold the start of a good one, or all of it.
+        while(true){
+            if(fill == 0)
+                return false;
+            if((fill >= 2 && buffer[1] != FRAME_SYNC1) || (fill >= 3 && buffer[2] != FRAME_VERSION)){
+                resync(1);
+                continue;
+            }
+            if(fill < FRAME_SIZE)
+                return false;
+            if(decodeFrame(buffer, sample))
+                break;
+            crcCount++;
+            resync(1);
+        }
+
+        if(haveSeq)
+            lostCount += static_cast<uint16_t>(sample.seq - lastSeq - 1);
+        haveSeq = true;
+        lastSeq = sample.seq;
+        frameCount++;
+        fill   -= FRAME_SIZE;
+        memmove(buffer, buffer + FRAME_SIZE, fill);
+        return true;
+    }
+
+    // Drops bytes up to the next sync candidate found after position 'from'.
+    inline void FrameDecoder::resync(size_t from) noexcept{
+        size_t next { from };
+        while(next < fill && ( buffer[next] != FRAME_SYNC0 || 
+                               ( next + 1 < fill && buffer[next + 1] != FRAME_SYNC1 )))
+            next++;
+
+        dropCount += next;
+        fill      -= next;
+        memmove(buffer, buffer + next, fill);
+    }
+
+} // End namespace glove
@@ -0,0 +1,323 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace glove {
+
+    // Host reader of the text output (Glove::sendText()), for the programs
+    // that still take it:
+    //
+    //   <ax, ay, az, fx, fy, fz, hx, hy, hz, t, i, m, r, p>\r\n
+    //
+    // nine angles in degrees, "%.2f", then the five fingers 0 - 90. On
+    // Bluetooth refreshFingers() puts the status line between them: the
+    // fingers minus one as raw bytes, cut at the first zero, then the
+    // buttons as '0' / '1', then "\r\n". Those bytes can be '<', '>' or a
+    // digit, so a frame is only taken between a '<' and the first '>' after
+    // it with no other '<' in between, and only if all 14 fields parse.
+    // A whole status line is handed back too, the rest outside the frames
+    // is dropped.
+    //
+    // No allocation, any split of the input; a frame inside one input
+    // chunk is parsed where it is, without copying.
+
+    const size_t   TEXT_ANGLES       { 9 },
+                   TEXT_FINGERS      { 5 },
+                   TEXT_MAX_LINE     { 192 },      // '<' to '>', longer is garbage
+                   TEXT_STATUS       { 8 };        // status line without "\r\n"
+
+    struct TextSample{
+        float        angles[TEXT_ANGLES]      {};  // arm, forearm, hand x 3
+        uint8_t      fingers[TEXT_FINGERS]    {};  // t, i, m, r, p
+    };
+
+    struct TextStatus{
+        uint8_t      fingers[TEXT_FINGERS]    {};  // as in the frames
+        uint8_t      buttons                  { 0 };   // FRAME_BUTTONS bits
+    };
+
+    // Decimal float: sign, digits, optional fraction and exponent, or nan /
+    // inf. Up to 19 significant digits and a power of ten up to 22 the result
+    // is the correctly rounded double, made a float; beyond that it is
+    // within a few ulps. Advances 'pos' past it; false if no number is there.
+    inline bool parseTextFloat(const char*& pos, const char* end, float& out) noexcept{
+        static const double POW10[] { 1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+        const char* p    { pos };
+        const bool  neg  { p < end && *p == '-' };
+        if(p < end && (*p == '-' || *p == '+'))
+            p++;
+
+        if(end - p >= 3 && (memcmp(p, "nan", 3) == 0 || memcmp(p, "inf", 3) == 0)){
+            out = p[0] == 'n' ? __builtin_nanf("") : (neg ? -__builtin_inff() : __builtin_inff());
+            pos = p + 3;
+            return true;
+        }
+
+        uint64_t mant   { 0 };
+        int      digits { 0 },
+                 exp10  { 0 };
+        bool     any    { false };
+        for(; p < end && static_cast<unsigned>(*p - '0') < 10; p++, any = true){
+            if(digits < 19){
+                mant = mant * 10 + static_cast<unsigned>(*p - '0');
+                digits += mant != 0;
+            } else {
+                exp10++;
+            }
+        }
+        if(p < end && *p == '.'){
+            for(p++; p < end && static_cast<unsigned>(*p - '0') < 10; p++, any = true){
+                if(digits < 19){
+                    mant = mant * 10 + static_cast<unsigned>(*p - '0');
+                    digits += mant != 0;
+                    exp10--;
+                }
+            }
+        }
+        if(!any)
+            return false;
+
+        if(p < end && (*p == 'e' || *p == 'E')){
+            const char* q    { p + 1 };
+            const bool  eneg { q < end && *q == '-' };
+            if(q < end && (*q == '-' || *q == '+'))
+                q++;
+            int  val  { 0 };
+            bool edig { false };
+            for(; q < end && static_cast<unsigned>(*q - '0') < 10; q++, edig = true)
+                val = val < 1000 ? val * 10 + (*q - '0') : val;
+            if(edig){
+                exp10 += eneg ? -val : val;
+                p      = q;
+            }
+        }
+
+        double val { static_cast<double>(mant) };
+        for(; exp10 > 22;  exp10 -= 22) val *= POW10[22];
+        for(; exp10 < -22; exp10 += 22) val /= POW10[22];
+        val = exp10 < 0 ? val / POW10[-exp10] : val * POW10[exp10];
+
+        out = static_cast<float>(neg ? -val : val);
+        pos = p;
+        return true;
+    }
+
+    class TextParser{
+
+        public:
+
+            using SampleCallback = void (*)(const TextSample& sample, void* ctx);
+            using StatusCallback = void (*)(const TextStatus& status, void* ctx);
+
+            // Callback API: every frame and status line completed by 'data'.
+            void       feed(const uint8_t* data, size_t len, SampleCallback onSample, void* ctx,
+                            StatusCallback onStatus = nullptr)       noexcept;
+
+            // Batch API: up to 'max' samples into 'out'; 'consumed' tells
+            // where to go on from when 'out' filled up before the end.
+            size_t     parse(const uint8_t* data, size_t len, TextSample* out, size_t max,
+                             size_t& consumed)                       noexcept;
+
+            uint32_t   frames(void)                           const noexcept { return frameCount; }
+            uint32_t   statusLines(void)                      const noexcept { return statusCount; }
+            uint32_t   badFrames(void)                        const noexcept { return badCount; }
+            uint64_t   droppedBytes(void)                     const noexcept { return dropCount; }
+
+        private:
+
+            char       line[TEXT_MAX_LINE]    {};    // a frame across input chunks, after '<'
+            size_t     fill                   { 0 };
+            bool       inFrame                { false };
+            uint8_t    tail[TEXT_STATUS + 1]  {};    // bytes since the last '\n' outside frames
+            size_t     tailFill               { 0 };
+            uint32_t   frameCount             { 0 },
+                       statusCount            { 0 },
+                       badCount               { 0 };
+            uint64_t   dropCount              { 0 };
+
+            bool       parseFrame(const char* pos, const char* end, TextSample& sample) noexcept;
+            bool       endOfLine(TextStatus& status)                 noexcept;
+
+            // Stops after a sample when 'onSample' returns false; returns the bytes used.
+            template<typename OnSample, typename OnStatus>
+            size_t     run(const uint8_t* data, size_t len, OnSample&& onSample, OnStatus&& onStatus) noexcept;
+    };
+
+    // Between '<' and '>': 9 floats and 5 integers separated by commas, spaces allowed.
+    inline bool TextParser::parseFrame(const char* pos, const char* end, TextSample& sample) noexcept{
+        for(size_t field{0}; field<TEXT_ANGLES + TEXT_FINGERS; field++){
+            while(pos < end && *pos == ' ')
+                pos++;
+            if(field > 0){
+                if(pos == end || *pos != ',')
+                    return false;
+                pos++;
+                while(pos < end && *pos == ' ')
+                    pos++;
+            }
+
+            if(field < TEXT_ANGLES){
+                if(!parseTextFloat(pos, end, sample.angles[field]))
+                    return false;
+                continue;
+            }
+
+            unsigned val    { 0 },
+                     digits { 0 };
+            for(; pos < end && static_cast<unsigned>(*pos - '0') < 10 && digits < 4; pos++, digits++)
+                val = val * 10 + static_cast<unsigned>(*pos - '0');
+            if(digits == 0 || val > 255)
+                return false;
+            sample.fingers[field - TEXT_ANGLES] = static_cast<uint8_t>(val);
+        }
+
+        while(pos < end && *pos == ' ')
+            pos++;
+        return pos == end;
+    }
+
+    // A line outside the frames just ended: true when it was a status line.
+    inline bool TextParser::endOfLine(TextStatus& status) noexcept{
+        const size_t len { tailFill };
+        tailFill = 0;
+        if(len <= 1 && (len == 0 || tail[0] == '\r'))      // the end of a frame line
+            return false;
+        if(len != TEXT_STATUS + 1 || tail[TEXT_STATUS] != '\r'){
+            dropCount += len + 1;
+            return false;
+        }
+        for(size_t idx{0}; idx<TEXT_FINGERS; idx++)
+            if(tail[idx] == 0 || tail[idx] >= 90){
+                dropCount += len + 1;
+                return false;
+            }
+        status.buttons = 0;
+        for(size_t idx{0}; idx<3; idx++){
+            const uint8_t btn { tail[TEXT_FINGERS + idx] };
+            if(btn != '0' && btn != '1'){
+                dropCount += len + 1;
+                return false;
+            }
+            status.buttons |= static_cast<uint8_t>((btn == '1') << idx);
+        }
+        for(size_t idx{0}; idx<TEXT_FINGERS; idx++)
+            status.fingers[idx] = static_cast<uint8_t>(tail[idx] + 1);
+        statusCount++;
+        return true;
+    }
+
+    template<typename OnSample, typename OnStatus>
+    size_t TextParser::run(const uint8_t* data, size_t len, OnSample&& onSample, OnStatus&& onStatus) noexcept{
+        const uint8_t* pos { data };
+        const uint8_t* end { data + len };
+        TextSample     sample;
+        TextStatus     status;
+
+        while(pos < end){
+            if(!inFrame){
+                const uint8_t byte { *pos++ };
+                if(byte == '<'){
+                    dropCount += tailFill;
+                    tailFill   = 0;
+                    inFrame    = true;
+                    fill       = 0;
+                } else if(byte == '\n'){
+                    if(endOfLine(status))
+                        onStatus(status);
+                } else if(tailFill < sizeof(tail)){
+                    tail[tailFill++] = byte;
+                } else {
+                    dropCount++;
+                }
+                continue;
+            }
+
+            // In a frame: up to its '>', or to a '<' that starts another one.
+            const size_t   span  { static_cast<size_t>(end - pos) };
+            const uint8_t* close { static_cast<const uint8_t*>(memchr(pos, '>', span)) };
+            const uint8_t* stop  { close != nullptr ? close : end };
+            const uint8_t* again { static_cast<const uint8_t*>(memchr(pos, '<', static_cast<size_t>(stop - pos))) };
+
+            if(again != nullptr){
+                badCount++;
+                dropCount += fill + static_cast<size_t>(again - pos) + 1;
+                fill = 0;
+                pos  = again + 1;
+                continue;
+            }
+            if(fill + static_cast<size_t>(stop - pos) > TEXT_MAX_LINE){
+                badCount++;
+                dropCount += fill + static_cast<size_t>(stop - pos) + 1;
+                inFrame = false;
+                pos     = close != nullptr ? close + 1 : end;
+                continue;
+            }
+            if(close == nullptr){
+                memcpy(line + fill, pos, span);
+                fill += span;
+                break;
+            }
+
+            bool good;
+            if(fill == 0){
+                good = parseFrame(reinterpret_cast<const char*>(pos), reinterpret_cast<const char*>(close), sample);
+            } else {
+                memcpy(line + fill, pos, static_cast<size_t>(close - pos));
+                fill += static_cast<size_t>(close - pos);
+                good  = parseFrame(line, line + fill, sample);
+            }
+            inFrame = false;
+            pos     = close + 1;
+
+            if(!good){
+                badCount++;
+                dropCount += fill + 2;
+                continue;
+            }
+            frameCount++;
+            if(!onSample(sample))
+                break;
+        }
+
+        return static_cast<size_t>(pos - data);
+    }
+
+    inline void TextParser::feed(const uint8_t* data, size_t len, SampleCallback onSample, void* ctx,
+                                 StatusCallback onStatus) noexcept{
+        run(data, len, [&](const TextSample& sample){ onSample(sample, ctx); return true; },
+                       [&](const TextStatus& status){ if(onStatus != nullptr) onStatus(status, ctx); });
+    }
+
+    inline size_t TextParser::parse(const uint8_t* data, size_t len, TextSample* out, size_t max,
+                                    size_t& consumed) noexcept{
+        size_t count { 0 };
+        if(max == 0){
+            consumed = 0;
+            return 0;
+        }
+        consumed = run(data, len, [&](const TextSample& sample){ out[count++] = sample; return count < max; },
+                                  [](const TextStatus&){});
+        return count;
+    }
+
+} // End namespace glove
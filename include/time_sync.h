@@ -0,0 +1,167 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+namespace glove {
+
+    // Host side: the device clock against the host one, NTP style, from
+    // CMD_TIME_SYNC exchanges (command.h). Each exchange gives four times,
+    // host send t1, device receive t2, device send t3, host receive t4:
+    //
+    //   offset = ((t1 - t2) + (t4 - t3)) / 2     host minus device
+    //   delay  =  (t4 - t1) - (t3 - t2)          round trip on the link
+    //
+    // The offset is off by half the difference between the two ways, which
+    // only the quick exchanges keep small: of the last WINDOW ones the best
+    // quarter by delay is kept, their mean offset at their mean time is one
+    // point of the offset line. The drift is its slope from a point at
+    // least DRIFT_SPAN_US older, a short window is too noisy for it; the
+    // older point moves on every 2 x DRIFT_SPAN_US, to follow temperature.
+    // Both clocks are microseconds, wrapping.
+
+    const size_t   SYNC_REQUEST_SIZE  { 4 },
+                   SYNC_RESPONSE_SIZE { 12 };
+
+    class TimeSync{
+
+        public:
+
+            static const size_t   WINDOW        { 64 };
+            static const uint32_t MAX_DELAY_US  { 1000000 },    // slower exchanges are dropped
+                                  DRIFT_SPAN_US { 30000000 };
+            static constexpr double MAX_DRIFT   { 500e-6 };     // crystals, with margin
+
+            // False if the exchange was dropped.
+            bool       add(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4) noexcept;
+            void       reset(void)                                  noexcept { count = next = 0; total = 0; drift = 0.0; anchored = false; }
+
+            bool       valid(void)                            const noexcept { return count > 0; }
+            // Host time of 'deviceUs', within a few minutes of the last exchange.
+            uint32_t   toHost(uint32_t deviceUs)              const noexcept;
+
+            // Positive when the device clock runs fast.
+            double     driftPpm(void)                         const noexcept { return -drift * 1e6; }
+            int32_t    offsetUs(void)                         const noexcept { return static_cast<int32_t>(refBase + static_cast<uint32_t>(static_cast<int32_t>(refOffset))); }
+            uint32_t   delayUs(void)                          const noexcept { return bestDelay; }
+            uint32_t   exchanges(void)                        const noexcept { return total; }
+
+        private:
+
+            struct Exchange{
+                uint32_t deviceUs;                             // mid point of t2, t3
+                uint32_t offsetUs;                             // host minus device, wrapping
+                uint32_t delayUs;
+            };
+
+            Exchange   window[WINDOW]         {};
+            size_t     count                  { 0 },
+                       next                   { 0 };
+            uint32_t   total                  { 0 },
+                       bestDelay              { 0 },
+                       refDevice              { 0 },           // the line goes through refDevice + refBase + refOffset
+                       refBase                { 0 };
+            double     refOffset              { 0.0 },
+                       drift                  { 0.0 };
+            bool       anchored               { false };
+            uint32_t   anchorDevice           { 0 },
+                       anchorBase             { 0 };
+            double     anchorX                { 0.0 },         // the older point, from anchorDevice and anchorBase
+                       anchorY                { 0.0 };
+
+            void       fit(void)                                    noexcept;
+    };
+
+    inline bool TimeSync::add(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4) noexcept{
+        const int32_t hostSpan   { static_cast<int32_t>(t4 - t1) },
+                      deviceSpan { static_cast<int32_t>(t3 - t2) };
+        if(hostSpan < 0 || deviceSpan < 0 || deviceSpan > hostSpan || static_cast<uint32_t>(hostSpan) > MAX_DELAY_US)
+            return false;
+
+        // The clocks are unrelated: the offset is a wrapping value, only the
+        // difference between the two ways is small.
+        const uint32_t up   { t1 - t2 },
+                       down { t4 - t3 };
+        Exchange& ex { window[next] };
+        ex.deviceUs = t2 + static_cast<uint32_t>(deviceSpan / 2);
+        ex.offsetUs = up + static_cast<uint32_t>(static_cast<int32_t>(down - up) / 2);
+        ex.delayUs  = static_cast<uint32_t>(hostSpan - deviceSpan);
+
+        next = (next + 1) % WINDOW;
+        if(count < WINDOW)
+            count++;
+        total++;
+        fit();
+        return true;
+    }
+
+    // Mean of the quickest exchanges, relative to the newest one.
+    inline void TimeSync::fit(void) noexcept{
+        const Exchange& newest { window[(next + WINDOW - 1) % WINDOW] };
+
+        uint32_t delays[WINDOW] {};
+        for(size_t idx{0}; idx<count; idx++)
+            delays[idx] = window[idx].delayUs;
+        const size_t keep { count < 8 ? (count + 1) / 2 : count / 4 };
+        std::nth_element(delays, delays + keep - 1, delays + count);
+        const uint32_t limit { delays[keep - 1] };
+        bestDelay = *std::min_element(delays, delays + count);
+
+        double sumX { 0.0 }, sumY { 0.0 };
+        size_t used { 0 };
+        for(size_t idx{0}; idx<count; idx++){
+            const Exchange& ex { window[idx] };
+            if(ex.delayUs > limit)
+                continue;
+            sumX += static_cast<int32_t>(ex.deviceUs - newest.deviceUs);
+            sumY += static_cast<int32_t>(ex.offsetUs - newest.offsetUs);
+            used++;
+        }
+        const double meanX { sumX / used },
+                     meanY { sumY / used };
+
+        // A full window before the first point, the offsets are rough until then.
+        if(count == WINDOW){
+            const double span { static_cast<int32_t>(newest.deviceUs - anchorDevice) + meanX - anchorX },
+                         rise { static_cast<int32_t>(newest.offsetUs - anchorBase)   + meanY - anchorY };
+            if(anchored && span >= DRIFT_SPAN_US)
+                drift = std::min(MAX_DRIFT, std::max(-MAX_DRIFT, rise / span));
+            if(!anchored || span >= 2.0 * DRIFT_SPAN_US){
+                anchored     = true;
+                anchorDevice = newest.deviceUs;
+                anchorBase   = newest.offsetUs;
+                anchorX      = meanX;
+                anchorY      = meanY;
+            }
+        }
+
+        refDevice = newest.deviceUs;
+        refBase   = newest.offsetUs;
+        refOffset = meanY - drift * meanX;
+    }
+
+    inline uint32_t TimeSync::toHost(uint32_t deviceUs) const noexcept{
+        const double since { static_cast<double>(static_cast<int32_t>(deviceUs - refDevice)) },
+                     shift { refOffset + drift * since };
+        return deviceUs + refBase + static_cast<uint32_t>(static_cast<int32_t>(shift < 0.0 ? shift - 0.5 : shift + 0.5));
+    }
+
+} // End namespace glove
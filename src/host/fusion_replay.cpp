@@ -0,0 +1,255 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+// Host tool: replays raw accel and gyro samples through the IMU_RAW fusion
+// filters and compares their orientation with the DMP one recorded at the
+// same time, for a range of gains. Prints the tilt error (gravity direction,
+// what the DMP and the filters can both observe), the total error (heading
+// included, which drifts on both sides) and the CPU time per update.
+//
+// Usage: fusion_replay [recording] [-r hz] [-w out]
+//
+// A recording has one sample per line, '#' starts a comment:
+//
+//   t_us ax ay az gx gy gz qw qx qy qz
+//
+// raw registers in the ranges of Imu::setRawMode() then the DMP quaternion.
+// Without one, 60 s of synthetic motion with sensor noise and gyro bias are
+// used, -w saves them in the same format. -r decimates the input to 'hz'.
+
+#include <fusion.h>
+#include <kinematics.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+    struct Sample{
+        uint32_t        tUs;
+        glove::RawImu   raw;
+        glove::Quat     dmp;
+    };
+
+    struct Candidate{
+        glove::FILTER_KIND  kind;
+        float               gain;
+        const char*         name;
+    };
+
+    const Candidate CANDIDATES[] {
+        { glove::FILTER_COMPLEMENTARY, 0.5f,   "complementary" },
+        { glove::FILTER_COMPLEMENTARY, 2.0f,   "complementary" },
+        { glove::FILTER_COMPLEMENTARY, 5.0f,   "complementary" },
+        { glove::FILTER_MADGWICK,      0.01f,  "madgwick"      },
+        { glove::FILTER_MADGWICK,      0.033f, "madgwick"      },
+        { glove::FILTER_MADGWICK,      0.1f,   "madgwick"      },
+        { glove::FILTER_MADGWICK,      0.3f,   "madgwick"      }
+    };
+
+    const float    DEG               { static_cast<float>(180.0 / M_PI) };
+
+    bool load(const char* path, std::vector<Sample>& samples){
+        FILE* in { fopen(path, "r") };
+        if(in == nullptr){
+            perror(path);
+            return false;
+        }
+
+        char line[256];
+        while(fgets(line, sizeof(line), in) != nullptr){
+            if(line[0] == '#' || line[0] == '\n')
+                continue;
+
+            unsigned long tUs;
+            int           a[3], g[3];
+            float         q[4];
+            if(sscanf(line, "%lu %d %d %d %d %d %d %f %f %f %f", &tUs, &a[0], &a[1], &a[2],
+                      &g[0], &g[1], &g[2], &q[0], &q[1], &q[2], &q[3]) != 11){
+                fprintf(stderr, "Error: bad line %zu in %s\n", samples.size() + 1, path);
+                fclose(in);
+                return false;
+            }
+
+            Sample smp{ static_cast<uint32_t>(tUs), {}, glove::quatNormalize(glove::Quat{ q[0], q[1], q[2], q[3] }) };
+            for(size_t idx{0}; idx<3; idx++){
+                smp.raw.accel[idx] = static_cast<int16_t>(a[idx]);
+                smp.raw.gyro[idx]  = static_cast<int16_t>(g[idx]);
+            }
+            samples.push_back(smp);
+        }
+
+        fclose(in);
+        return true;
+    }
+
+    int16_t toRegister(float val){
+        const float rounded { roundf(val) };
+        return static_cast<int16_t>(rounded > 32767.0f ? 32767.0f : rounded < -32768.0f ? -32768.0f : rounded);
+    }
+
+    // Sensor to world rotation of 'q' applied backwards to world 'up'.
+    void gravity(const glove::Quat& q, float* up){
+        up[0] = 2.0f * (q.x * q.z - q.w * q.y);
+        up[1] = 2.0f * (q.w * q.x + q.y * q.z);
+        up[2] = q.w * q.w - q.x * q.x - q.y * q.y + q.z * q.z;
+    }
+
+    // A wrist waving on three axes at different rates, sampled at 1 kHz; the
+    // recorded "DMP" is the true orientation.
+    void synthesize(std::vector<Sample>& samples){
+        const uint32_t PERIOD_US   { 1000 },
+                       SECONDS     { 60 },
+                       SUBSTEPS    { 10 };
+        const float    GYRO_LSB    { glove::RAW_GYRO_LSB_PER_DPS * DEG },   // per rad/s
+                       ACCEL_LSB   { glove::RAW_ACCEL_LSB_PER_G },
+                       BIAS[3]     { 0.6f / DEG, -0.4f / DEG, 0.3f / DEG };
+
+        std::mt19937                     rng{ 2023 };
+        std::normal_distribution<float>  gyroNoise{ 0.0f, 0.05f / DEG },     // MPU-6050: 0.005 dps/sqrt(Hz)
+                                         accelNoise{ 0.0f, 0.004f };         // 400 ug/sqrt(Hz)
+        glove::Quat                      truth;
+
+        for(uint32_t tUs{0}; tUs<SECONDS * 1000000; tUs+=PERIOD_US){
+            const float t      { tUs / 1000000.0f },
+                        rate[3] { 1.5f * sinf(1.1f * t), 2.5f * sinf(0.7f * t + 1.0f), 4.0f * sinf(2.3f * t) };
+
+            float up[3];
+            gravity(truth, up);
+
+            Sample smp{ tUs, {}, truth };
+            for(size_t idx{0}; idx<3; idx++){
+                smp.raw.gyro[idx]  = toRegister((rate[idx] + BIAS[idx] + gyroNoise(rng)) * GYRO_LSB);
+                smp.raw.accel[idx] = toRegister((up[idx] + accelNoise(rng)) * ACCEL_LSB);
+            }
+            samples.push_back(smp);
+
+            // The rates are held until the next sample, integrated finely.
+            const float dt { PERIOD_US / 1000000.0f / SUBSTEPS };
+            for(uint32_t sub{0}; sub<SUBSTEPS; sub++){
+                const float norm { sqrtf(rate[0] * rate[0] + rate[1] * rate[1] + rate[2] * rate[2]) };
+                if(norm > 0.0f)
+                    truth = glove::quatMul(truth, glove::quatFromAxisAngle(rate[0] / norm, rate[1] / norm,
+                                                                           rate[2] / norm, norm * dt));
+            }
+            truth = glove::quatNormalize(truth);
+        }
+    }
+
+    bool save(const char* path, const std::vector<Sample>& samples){
+        FILE* out { fopen(path, "w") };
+        if(out == nullptr){
+            perror(path);
+            return false;
+        }
+
+        fprintf(out, "# t_us ax ay az gx gy gz qw qx qy qz\n");
+        for(const auto& smp: samples)
+            fprintf(out, "%u %d %d %d %d %d %d %.6f %.6f %.6f %.6f\n", smp.tUs,
+                    smp.raw.accel[0], smp.raw.accel[1], smp.raw.accel[2],
+                    smp.raw.gyro[0],  smp.raw.gyro[1],  smp.raw.gyro[2],
+                    smp.dmp.w, smp.dmp.x, smp.dmp.y, smp.dmp.z);
+        return fclose(out) == 0;
+    }
+
+} // End anonymous namespace
+
+int main(int argc, char** argv){
+    const char* input  { nullptr };
+    const char* output { nullptr };
+    uint32_t    hz     { 0 };
+
+    for(int i{1}; i<argc; i++){
+        if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            hz = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if(strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+            output = argv[++i];
+        else
+            input = argv[i];
+    }
+
+    std::vector<Sample> all;
+    if(input != nullptr ? !load(input, all) : (synthesize(all), false))
+        return 1;
+    if(output != nullptr && !save(output, all))
+        return 1;
+    if(all.size() < 2){
+        fprintf(stderr, "Error: not enough samples\n");
+        return 1;
+    }
+
+    std::vector<Sample> samples;
+    const uint32_t      stepUs { hz > 0 ? 1000000 / hz : 0 };
+    for(const auto& smp: all)
+        if(samples.empty() || smp.tUs - samples.back().tUs >= stepUs)
+            samples.push_back(smp);
+
+    const double span { (samples.back().tUs - samples.front().tUs) / 1000000.0 };
+    printf("%zu samples, %.1f s, %.0f Hz\n", samples.size(), span, (samples.size() - 1) / span);
+    printf("%-14s %6s  %9s %9s  %9s %9s  %8s\n", "filter", "gain", "tilt avg", "tilt max",
+           "total avg", "total max", "ns/upd");
+
+    for(const auto& cand: CANDIDATES){
+        glove::FusionFilter filter;
+        double              tiltSum   { 0.0 },
+                            totalSum  { 0.0 };
+        float               tiltMax   { 0.0f },
+                            totalMax  { 0.0f };
+
+        filter.configure(cand.kind, cand.gain);
+        filter.reset(samples.front().dmp);
+        for(size_t idx{1}; idx<samples.size(); idx++){
+            filter.update(samples[idx].raw, (samples[idx].tUs - samples[idx - 1].tUs) / 1000000.0f);
+
+            float est[3], ref[3];
+            gravity(filter.quaternion(), est);
+            gravity(samples[idx].dmp, ref);
+            const float dot   { est[0] * ref[0] + est[1] * ref[1] + est[2] * ref[2] },
+                        tilt  { acosf(dot < 1.0f ? dot : 1.0f) * DEG },
+                        total { glove::quatAngle(filter.quaternion(), samples[idx].dmp) * DEG };
+
+            tiltSum  += tilt;
+            totalSum += total;
+            if(tilt > tiltMax)
+                tiltMax = tilt;
+            if(total > totalMax)
+                totalMax = total;
+        }
+
+        // Timed on its own, without the error bookkeeping.
+        volatile float sink { 0.0f };
+        filter.reset(samples.front().dmp);
+        const auto start { std::chrono::steady_clock::now() };
+        for(size_t idx{1}; idx<samples.size(); idx++)
+            filter.update(samples[idx].raw, (samples[idx].tUs - samples[idx - 1].tUs) / 1000000.0f);
+        sink = filter.quaternion().w;
+        (void)sink;
+        const double ns { static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                              std::chrono::steady_clock::now() - start).count()) };
+
+        const size_t updates { samples.size() - 1 };
+        printf("%-14s %6.3f  %8.2f° %8.2f°  %8.2f° %8.2f°  %8.1f\n", cand.name, cand.gain,
+               tiltSum / updates, tiltMax, totalSum / updates, totalMax, ns / updates);
+    }
+
+    return 0;
+}
@@ -0,0 +1,1876 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+// Host micro benchmarks of the per-sample processing path, run on the
+// simulated board. For each stage it prints ns per call, heap allocations
+// per call and output bytes per call; with a baseline file it also prints
+// the change against it.
+//
+// Before the timings it runs self checks of the host and firmware code
+// against reference models; it exits with 1 if any of them fails.
+//
+// Usage: glove_bench [-b baseline_file] [-w]   (-w rewrites the baseline)
+
+#include <hal_sim.h>
+#include <glove.h>
+#include <hub_frame.h>
+#include <text_protocol.h>
+#include <pose_predictor.h>
+#include <time_sync.h>
+#include <delay_line.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+
+namespace {
+
+    size_t allocations { 0 };
+
+} // End anonymous namespace
+
+void* operator new(size_t size){
+    allocations++;
+    void* ptr { malloc(size ? size : 1) };
+    if(ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept              { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept      { free(ptr); }
+
+namespace glove {
+
+    class GloveBench{
+
+        public:
+
+            struct Result{
+                const char*  name;
+                double       nsPerCall;
+                double       allocsPerCall;
+                double       bytesPerCall;
+            };
+
+            static const size_t  STAGES      { 19 };
+
+            explicit   GloveBench(uint32_t iterations)         noexcept;
+            size_t     run(Result* results)                    noexcept;
+            int        curveDeviation(void)                    noexcept;
+            float      chainDeviation(void)              const noexcept;
+            uint32_t   topologyMismatches(void)          const noexcept;
+            uint32_t   statusMismatches(void)            const noexcept;
+            uint32_t   schedulerMismatches(void)         const noexcept;
+            uint32_t   ringMismatches(uint32_t& popped, uint32_t& dropped) const noexcept;
+            uint32_t   profileMismatches(uint32_t& rejected)   const noexcept;
+            uint32_t   frameMismatches(float& worstSteps, uint32_t& crcErrors, uint32_t& lost) const noexcept;
+            float      filterError(ADC_FILTER kind)      const noexcept;
+            float      continuousStepShare(void)         const noexcept;
+            uint32_t   debounceMismatches(uint32_t& worstDelayUs) const noexcept;
+            uint32_t   deltaMismatches(float& worstDeg, float& bytesRatio) const noexcept;
+            uint32_t   commandMismatches(uint32_t& answered, uint32_t& crcErrors) const noexcept;
+            uint32_t   calibrationMismatches(uint32_t& steps, uint32_t& calibFrames) const noexcept;
+            uint32_t   rawSwitchMismatches(void)         const noexcept;
+            uint32_t   sessionStreamMismatches(uint32_t& records, uint32_t& crcErrors) const noexcept;
+            uint32_t   alignmentError(int32_t driftPpm)  const noexcept;
+            uint32_t   textMismatches(uint32_t& clean, uint32_t& corrupted, uint32_t& rejected,
+                                      uint32_t& worstUlp) const noexcept;
+            float      predictionError(uint32_t horizonUs, float& holdDeg) const noexcept;
+            uint32_t   syncError(int32_t driftPpm, float& driftErrPpm) const noexcept;
+            uint32_t   delayLineMismatches(uint32_t& delivered) const noexcept;
+
+        private:
+
+            SimBoard   sim;
+            Glove      gl;
+            uint32_t   iters;
+
+            template<typename F>
+            Result     measure(const char* name, F&& stage)    noexcept;
+    };
+
+    GloveBench::GloveBench(uint32_t iterations) noexcept
+        : gl{sim.board()}, iters{iterations}
+    {}
+
+    template<typename F>
+    GloveBench::Result GloveBench::measure(const char* name, F&& stage) noexcept{
+        for(uint32_t i{0}; i<iters / 10; i++)       // warm up
+            stage(i);
+
+        const size_t   allocs { allocations };
+        const uint64_t bytes  { sim.link.bytes() + sim.console.bytes() };
+        const auto     start  { std::chrono::steady_clock::now() };
+
+        for(uint32_t i{0}; i<iters; i++)
+            stage(i);
+
+        const double   ns     { static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                    std::chrono::steady_clock::now() - start).count()) };
+
+        return Result{ name, ns / iters,
+                       static_cast<double>(allocations - allocs) / iters,
+                       static_cast<double>(sim.link.bytes() + sim.console.bytes() - bytes) / iters };
+    }
+
+    size_t GloveBench::run(Result* results) noexcept{
+        volatile uint32_t sink { 0 };
+        size_t            idx  { 0 };
+
+        results[idx++] = measure("readStatus", [&](uint32_t i){
+            sim.clock.advanceUs(i % 7 + 1);
+            gl.readStatus();
+            sink = sink + gl.fingerNorm[Glove::INDEX];
+        });
+
+        results[idx++] = measure("normalizeStatus", [&](uint32_t i){
+            sink = sink + gl.normalizeStatus(gl.fingerMin[Glove::INDEX], gl.fingerMax[Glove::INDEX], i & 0xFFF);
+        });
+
+        results[idx++] = measure("eulerFromQuat", [&](uint32_t i){
+            const float   ang  { (i & 0x3FF) / 1024.0f };
+            const Quat    quat { cosf(ang), sinf(ang) * 0.6f, sinf(ang) * 0.8f, 0.0f };
+            float         euler[3];
+            eulerFromQuat(quat, euler);
+            sink = sink + static_cast<uint32_t>(euler[0] * 100);
+        });
+
+        results[idx++] = measure("kinematic chain", [&](uint32_t i){
+            const float   ang  { (i & 0x3FF) / 1024.0f };
+            const Quat    sensors[KinematicChain::SEGMENTS] { quatFromAxisAngle(0.0f, 0.0f, 1.0f, ang),
+                                                              quatFromAxisAngle(0.0f, 1.0f, 0.0f, ang),
+                                                              quatFromAxisAngle(1.0f, 0.0f, 0.0f, ang) };
+            Quat          joints[KinematicChain::SEGMENTS];
+            gl.chain.solve(sensors, joints);
+            sink = sink + static_cast<uint32_t>(joints[2].w * 100);
+        });
+
+        results[idx++] = measure("curve lookup", [&](uint32_t i){
+            sink = sink + gl.curves[Glove::INDEX](i & 0xFFF);
+        });
+
+        results[idx++] = measure("curve rebuild", [&](uint32_t i){
+            gl.curves[Glove::RING].setRange(100 + (i & 0x3F), 4095);
+        });
+
+        gl.takeSnapshot(gl.current);
+        results[idx++] = measure("updateStatusForBt", [&](uint32_t i){
+            gl.current.fingers[Glove::INDEX] = i % 90;
+            gl.updateStatusForBt(gl.current);
+            sink = sink + gl.statusForBt[Glove::INDEX];
+        });
+
+        results[idx++] = measure("sendMsg text", [&](uint32_t){
+            sim.link.reset();
+            sim.console.reset();
+            gl.sendText(gl.current);
+        });
+
+        results[idx++] = measure("sendMsg binary", [&](uint32_t){
+            sim.link.reset();
+            sim.console.reset();
+            gl.sendFrame(gl.current);
+        });
+
+        results[idx++] = measure("acquireImus", [&](uint32_t){
+            sim.clock.advanceUs(5000);
+            gl.acquireImus();
+        });
+
+        results[idx++] = measure("flight record", [&](uint32_t i){
+            FlightEntry entry;
+            entry.kind = FLIGHT_IMUS_STEP;
+            memcpy(entry.quat, gl.angles.quaternion, sizeof(entry.quat));
+            gl.recordStep(entry, i, gl.imusStepUs, 0, 0);
+        });
+
+        // Zero in a -DGLOVE_NO_PROFILE build.
+        results[idx++] = measure("stage probe", [&](uint32_t i){
+            StageProbe probe { gl.profile, STAGE_PUBLISH };
+            sink = sink + i;
+        });
+
+        static const char* const FILTER_STAGES[] { "filter lowpass", "filter median", "filter one euro" };
+        static const ADC_FILTER  FILTER_KINDS[]  { ADC_FILTER_LOWPASS, ADC_FILTER_MEDIAN, ADC_FILTER_ONE_EURO };
+        for(size_t kind{0}; kind<3; kind++){
+            FingerFilter filter;
+            filter.configure(FILTER_KINDS[kind], 5.0f, 0.01f);
+            results[idx++] = measure(FILTER_STAGES[kind], [&](uint32_t i){
+                sink = sink + filter.update(static_cast<uint16_t>(i * 2654435761u >> 20), 0.001f);
+            });
+        }
+
+        DeltaEncoder    delta;
+        TelemetrySample sample;
+        uint8_t         out[DELTA_MAX_SIZE];
+        results[idx++] = measure("delta encode", [&](uint32_t i){
+            const float ang { (i & 0x3FF) / 1024.0f };
+            sample.timestampUs    = i * 10000;
+            sample.quat[i % 3][0] = cosf(ang);
+            sample.quat[i % 3][1] = sinf(ang);
+            sample.fingers[i % 5] = static_cast<uint8_t>(i % 90);
+            sink = sink + delta.encode(sample, out);
+        });
+
+        // One line of the text output and a status line, as Bluetooth gets them.
+        char       textLines[8][128];
+        size_t     textLens[8];
+        TextParser text;
+        for(size_t line{0}; line<8; line++){
+            textLens[line] = static_cast<size_t>(snprintf(textLines[line], sizeof(textLines[line]),
+                             "<%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %u, %u, %u, %u, %u>\r\n%c%c%c%c%c010\r\n",
+                             -170.0 + line * 41.3, 12.25 * line, -3.5, 90.0 - line, 0.0, -45.75, 120.5, -0.25, line * 7.77,
+                             unsigned(line * 11), 90u, 45u, unsigned(line), 3u, 'A' + int(line), '<', '>', 10 + int(line), '0'));
+        }
+        results[idx++] = measure("text parse", [&](uint32_t i){
+            text.feed(reinterpret_cast<const uint8_t*>(textLines[i & 7]), textLens[i & 7],
+                      [](const TextSample& smp, void* ctx){ *static_cast<volatile uint32_t*>(ctx) += smp.fingers[0]; },
+                      const_cast<uint32_t*>(&sink));
+        });
+
+        // One frame in and the pose at the next display refresh out.
+        PosePredictor  predictor;
+        PosePrediction pose;
+        TelemetrySample moving;
+        moving.flags = 0x07;
+        results[idx++] = measure("pose predict", [&](uint32_t i){
+            const float half { (i & 0xFF) / 512.0f };
+            moving.timestampUs = i * 10000;
+            moving.quat[i % 3][0] = cosf(half);
+            moving.quat[i % 3][3] = sinf(half);
+            moving.fingers[i % 5] = static_cast<uint8_t>(i % 90);
+            predictor.update(moving);
+            predictor.predict(moving.timestampUs + 16667, pose);
+            sink = sink + static_cast<uint32_t>(pose.fingers[i % 5]);
+        });
+
+        results[idx++] = measure("full frame", [&](uint32_t){
+            sim.clock.advanceUs(10000);
+            sim.link.reset();
+            sim.console.reset();
+            gl.acquireFingers();
+            gl.acquireImus();
+            gl.publish();
+            gl.drain();
+        });
+
+        return idx;
+    }
+
+    // Largest difference between the LEGACY_LOG table and the reference
+    // formula, over every reading and a sweep of calibrated maximums.
+    int GloveBench::curveDeviation(void) noexcept{
+        ResponseCurve curve;
+        int           worst { 0 };
+
+        for(uint16_t sup{10}; sup<4096; sup += 97){
+            curve.configure(LEGACY_LOG, 100, sup, 90);
+            for(uint16_t raw{0}; raw<ResponseCurve::ADC_STEPS; raw++){
+                // The formula goes negative past max(sup, 20): the table clamps to 0.
+                const double val  { 90 - fabs(log10(raw < 1 ? 1 : raw) * 90 / log10(sup > 20 ? sup : 20)) };
+                const int    ref  { val < 0 ? 0 : gl.normalizeStatus(100, sup, raw) },
+                             diff { abs(ref - curve(raw)) };
+                if(diff > worst)
+                    worst = diff;
+            }
+        }
+
+        return worst;
+    }
+
+    // Builds sensor readings from known joint rotations and mounting
+    // rotations, down the parents of GLOVE_TOPOLOGY, and returns the largest
+    // error of the solved joints, degrees.
+    float GloveBench::chainDeviation(void) const noexcept{
+        const float    AXES[3][3] { { 0.0f, 0.0f, 1.0f }, { 0.6f, 0.0f, 0.8f }, { 1.0f, 0.0f, 0.0f } },
+                       JOINTS[3][3] { { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.6f, 0.8f }, { 0.8f, 0.6f, 0.0f } },
+                       MOUNT_RAD[3] { 0.3f, -1.1f, 2.5f },
+                       RATE[3] { 1.0f, 1.7f, -2.3f };
+        Quat           mounts[KinematicChain::SEGMENTS];
+        KinematicChain chain;
+        float          worst { 0.0f };
+
+        for(size_t idx{0}; idx<KinematicChain::SEGMENTS; idx++)
+            mounts[idx] = quatFromAxisAngle(AXES[idx % 3][0], AXES[idx % 3][1], AXES[idx % 3][2], MOUNT_RAD[idx % 3]);
+
+        chain.setReference(mounts);
+        for(int step{0}; step<1000; step++){
+            const float ang { step * 0.0123f };
+            Quat        expected[KinematicChain::SEGMENTS],
+                        segments[KinematicChain::SEGMENTS],
+                        sensors[KinematicChain::SEGMENTS],
+                        joints[KinematicChain::SEGMENTS];
+
+            for(size_t idx{0}; idx<KinematicChain::SEGMENTS; idx++){
+                const uint8_t up { GLOVE_TOPOLOGY.imus[idx].parent };
+                expected[idx] = quatFromAxisAngle(JOINTS[idx % 3][0], JOINTS[idx % 3][1], JOINTS[idx % 3][2], ang * RATE[idx % 3]);
+                segments[idx] = up == NO_PARENT ? expected[idx] : quatMul(segments[up], expected[idx]);
+                sensors[idx]  = quatMul(segments[idx], mounts[idx]);
+            }
+
+            chain.solve(sensors, joints);
+            for(size_t idx{0}; idx<KinematicChain::SEGMENTS; idx++){
+                const float err { quatAngle(joints[idx], expected[idx]) * static_cast<float>(180.0 / M_PI) };
+                if(err > worst)
+                    worst = err;
+            }
+        }
+
+        return worst;
+    }
+
+    // Tables validTopology() must refuse, one fault each, and the names of
+    // the IMU stages, from GLOVE_TOPOLOGY.
+    uint32_t GloveBench::topologyMismatches(void) const noexcept{
+        using Small = Topology<1, 2>;
+        const Small GOOD { { { 36, 1, "F", 10, 24 } },
+                           { { 0, 34, NO_PARENT, "Upper" }, { 1, 35, 0, "Lower" } },
+                           { 25, 26, 27 } };
+        Small    bad[8] { GOOD, GOOD, GOOD, GOOD, GOOD, GOOD, GOOD, GOOD };
+        uint32_t mismatches { !validTopology(GOOD) };
+
+        bad[0].fingers[0].adcPin   = 4;             // ADC2
+        bad[1].imus[1].intPin      = 7;             // flash
+        bad[2].buttonPins[1]       = 39;            // no pull down
+        bad[3].imus[0].parent      = 1;             // parent after its child
+        bad[4].imus[1].muxChannel  = 0;             // channel twice
+        bad[5].imus[1].intPin      = 36;            // the finger pin
+        bad[6].fingers[0].glyphX   = STATUS_X + STATUS_W;
+        bad[7].imus[1].muxChannel  = MUX_CHANNELS;
+        for(const Small& topo: bad)
+            mismatches += validTopology(topo);
+
+        for(size_t idx{0}; idx<GLOVE_IMUS; idx++){
+            char expected[StageNames::NAME_MAX];
+            snprintf(expected, sizeof(expected), "imu %s", GLOVE_TOPOLOGY.imus[idx].name);
+            for(char* pos{expected}; *pos != '\0'; pos++)
+                *pos = static_cast<char>(tolower(*pos));
+            mismatches += strcmp(stageName(STAGE_IMU + idx), expected) != 0;
+        }
+        mismatches += strcmp(stageName(STAGE_FINGERS), "fingers") != 0 || strcmp(stageName(STAGE_PUBLISH), "publish") != 0 ||
+                      strcmp(stageName(STAGE_IDLE), "idle") != 0 || strcmp(stageName(STAGES), "?") != 0;
+        return mismatches;
+    }
+
+    // Random calibration profiles written in every schema version: each must
+    // read back with the fields of its version and the defaults for the newer
+    // ones (the original curve, no spline points, identity reference pose),
+    // and a glove applying it must take its curve, or the original one if
+    // its spline points are refused or missing.
+    // Every record with a flipped bit, a wrong size, a payload length not of
+    // its version or a newer version (CRC fixed) must be refused; 'rejected'
+    // counts them.
+    uint32_t GloveBench::profileMismatches(uint32_t& rejected) const noexcept{
+        SimBoard* board      { new SimBoard() };
+        Glove*    dut        { new Glove(board->board()) };
+        uint32_t  seed       { 31337 },
+                  mismatches { 0 };
+
+        auto rnd      = [&seed](void){ seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+        auto rndFloat = [&rnd](void){ return static_cast<float>(static_cast<int32_t>(rnd() % 20001) - 10000) / 1000.0f; };
+        auto same     = [](const void* a, const void* b, size_t len){ return memcmp(a, b, len) == 0; };
+        auto refused  = [&](uint8_t* record, size_t len){
+            CalibrationProfile got;
+            const bool ok { !decodeProfile(record, len, got) };
+            rejected += ok;
+            return ok;
+        };
+
+        rejected = 0;
+        for(uint32_t trial{0}; trial<300; trial++){
+            CalibrationProfile prof;
+            prof.user = static_cast<uint8_t>(rnd() % CALIB_USERS);
+            for(auto& imu: prof.imuOffsets)
+                for(int16_t& off: imu)
+                    off = static_cast<int16_t>(rnd());
+            for(size_t idx{0}; idx<CALIB_FINGERS; idx++){
+                prof.fingerMin[idx] = static_cast<uint16_t>(rnd() % 4096);
+                prof.fingerMax[idx] = static_cast<uint16_t>(rnd() % 4096);
+            }
+            for(auto& joint: prof.articulation)
+                for(float& angle: joint)
+                    angle = rndFloat();
+            prof.curveShape = static_cast<CURVE_SHAPE>(rnd() % (SPLINE + 1));
+            prof.pointCount = static_cast<uint8_t>(rnd() % (ResponseCurve::MAX_POINTS + 1));
+            for(size_t idx{0}; idx<ResponseCurve::MAX_POINTS; idx++)
+                prof.points[idx] = trial % 2 == 0 ? SplinePoint{ rndFloat(), rndFloat() } :
+                                   SplinePoint{ (idx + 0.5f) / ResponseCurve::MAX_POINTS, rnd() % 1001 / 1000.0f };
+            for(auto& ref: prof.reference)
+                ref = Quat{ rndFloat(), rndFloat(), rndFloat(), rndFloat() };
+
+            for(uint8_t version{1}; version<=CALIB_VERSION; version++){
+                uint8_t            record[CALIB_MAX_SIZE + 1];
+                CalibrationProfile got,
+                                   fresh;
+                const size_t       len { encodeProfile(prof, record, version) };
+                if(len != CALIB_HEADER + payloadSize(version) + 2 || !decodeProfile(record, len, got)){
+                    mismatches++;
+                    continue;
+                }
+
+                const CalibrationProfile& v2 { version >= 2 ? prof : fresh },
+                                         &v3 { version >= 3 ? prof : fresh };
+                mismatches += got.user != prof.user || !same(got.imuOffsets, prof.imuOffsets, sizeof(got.imuOffsets)) ||
+                              !same(got.fingerMin, prof.fingerMin, sizeof(got.fingerMin)) ||
+                              !same(got.fingerMax, prof.fingerMax, sizeof(got.fingerMax)) ||
+                              !same(got.articulation, prof.articulation, sizeof(got.articulation)) ||
+                              got.curveShape != v2.curveShape || got.pointCount != v2.pointCount ||
+                              !same(got.points, v2.points, sizeof(got.points)) ||
+                              !same(got.reference, v3.reference, sizeof(got.reference));
+
+                ResponseCurve probe;
+                const bool    points { got.pointCount >= 2 && probe.setSplinePoints(got.points, got.pointCount) },
+                              broken { got.pointCount >= 2 ? !points : got.curveShape == SPLINE };
+                const CURVE_SHAPE shape { broken ? LEGACY_LOG : got.curveShape };
+                dut->applyProfile(got);
+                mismatches += dut->curveShape != shape || dut->curvePointCount != (points ? got.pointCount : 0);
+                for(const auto& curve: dut->curves)
+                    mismatches += curve.shape() != shape;
+
+                if(trial % 20 == 0)
+                    for(size_t bit{0}; bit<len * 8; bit++){
+                        record[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+                        mismatches     += !refused(record, len);
+                        record[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+                    }
+                record[len] = 0;
+                mismatches += !refused(record, len - 1) || !refused(record, len + 1);
+
+                // A valid CRC over a length of another version, then over a newer version.
+                put16(record + 4, static_cast<uint16_t>(payloadSize(version % CALIB_VERSION + 1)));
+                put16(record + len - 2, crc16(record, len - 2));
+                mismatches += !refused(record, len);
+                put16(record + 4, static_cast<uint16_t>(payloadSize(version)));
+                record[2] = CALIB_VERSION + 1;
+                put16(record + len - 2, crc16(record, len - 2));
+                mismatches += !refused(record, len);
+            }
+        }
+
+        delete dut;
+        delete board;
+        return mismatches;
+    }
+
+    // Runs StatusView through a sequence of finger states and counts the
+    // renders that didn't draw exactly the glyphs whose finger changed.
+    uint32_t GloveBench::statusMismatches(void) const noexcept{
+        SimDisplay display;
+        StatusView view { display };
+        uint8_t    shown      { 0 };
+        uint32_t   mismatches { 0 },
+                   seed       { 12345 };
+
+        for(int step{0}; step<10000; step++){
+            seed = seed * 1103515245 + 12345;
+            const uint8_t state { static_cast<uint8_t>((seed >> 16) & 0x1F) };
+            const bool    full  { step == 0 || step % 97 == 0 };
+            if(full && step > 0)
+                view.invalidate();
+
+            const uint32_t before   { display.draws() };
+            const size_t   drawn    { view.render(state) };
+            const int      expected { full ? static_cast<int>(StatusView::GLYPHS) : __builtin_popcount(state ^ shown) };
+
+            if(static_cast<int>(drawn) != expected || display.draws() - before != drawn)
+                mismatches++;
+            shown = state;
+        }
+
+        return mismatches;
+    }
+
+    // Runs two tasks, 1 ms and 3 ms, on a FakeClock started 30 ms before the
+    // 32 bit microseconds wrap, polled every 100 us for 200 ms. The first one
+    // takes 3.5 ms once at 10 ms and is disabled from 50 to 60 ms, the second
+    // goes to 5 ms at 40 ms. Counts the runs away from the expected times, the
+    // wrong stats, and the polls where untilNextUs() was not the time left
+    // before the run it announced.
+    uint32_t GloveBench::schedulerMismatches(void) const noexcept{
+        const uint32_t START  { 0u - 30000u },
+                       STEP   { 100 },
+                       SPAN   { 200000 },
+                       MAX    { 256 };
+        struct Probe{
+            FakeClock* clock;
+            uint32_t   startUs,
+                       stallAtUs;                  // since START, UINT32_MAX for never
+            uint32_t   times[MAX];                 // of the runs, since START
+            size_t     runs;
+        };
+        FakeClock      clock;
+        clock.setUs(START);
+        Scheduler<2>   sched  { clock };
+        Probe          fast   { &clock, START, 10000, {}, 0 },
+                       slow   { &clock, START, UINT32_MAX, {}, 0 };
+        uint32_t       mismatches { 0 };
+
+        const TaskCallback record { [](void* ctx){
+            Probe& probe { *static_cast<Probe*>(ctx) };
+            const uint32_t at { probe.clock->nowUs() - probe.startUs };
+            if(probe.runs < MAX)
+                probe.times[probe.runs++] = at;
+            if(at == probe.stallAtUs)
+                probe.clock->advanceUs(3500);
+        } };
+        const int      fastId { sched.addTask(record, &fast, 1000) },
+                       slowId { sched.addTask(record, &slow, 3000) };
+        uint32_t       nextDue { clock.nowUs() };
+
+        while(clock.nowUs() - START < SPAN){
+            const uint32_t now  { clock.nowUs() },
+                           at   { now - START };
+            const int32_t  left { static_cast<int32_t>(nextDue - now) };
+            if(sched.untilNextUs() != static_cast<uint32_t>(left > 0 ? left : 0))
+                mismatches++;
+
+            if(at == 40000 && !sched.setPeriod(slowId, 5000))
+                mismatches++;
+            if((at == 50000 || at == 60000) && !sched.setEnabled(fastId, at == 60000))
+                mismatches++;
+
+            const bool   due    { sched.untilNextUs() == 0 };
+            const size_t before { fast.runs + slow.runs };
+            sched.runPending();
+            if(due != (fast.runs + slow.runs > before))
+                mismatches++;
+            nextDue = clock.nowUs() + sched.untilNextUs();
+            clock.advanceUs(STEP);
+        }
+
+        // The overrun drops two periods instead of bursting; the slow task,
+        // held up behind it, runs late without an overrun.
+        uint32_t fastTimes[MAX], slowTimes[MAX];
+        size_t   fastCount { 0 }, slowCount { 0 };
+        for(uint32_t t{0}; t<=10000; t += 1000)       fastTimes[fastCount++] = t;
+        fastTimes[fastCount++] = 13600;
+        for(uint32_t t{14000}; t<50000; t += 1000)    fastTimes[fastCount++] = t;
+        for(uint32_t t{60000}; t<SPAN; t += 1000)     fastTimes[fastCount++] = t;
+        for(uint32_t t{0}; t<12000; t += 3000)        slowTimes[slowCount++] = t;
+        slowTimes[slowCount++] = 13500;
+        for(uint32_t t{15000}; t<40000; t += 3000)    slowTimes[slowCount++] = t;
+        for(uint32_t t{40000}; t<SPAN; t += 5000)     slowTimes[slowCount++] = t;
+
+        mismatches += fast.runs != fastCount || memcmp(fast.times, fastTimes, fastCount * sizeof(uint32_t)) != 0;
+        mismatches += slow.runs != slowCount || memcmp(slow.times, slowTimes, slowCount * sizeof(uint32_t)) != 0;
+
+        const TaskStats& fastStats { sched.stats(fastId) };
+        const TaskStats& slowStats { sched.stats(slowId) };
+        mismatches += fastStats.runs != fastCount || fastStats.overruns != 1 || fastStats.skipped != 2 ||
+                      fastStats.maxRunUs != 3500 || fastStats.maxLatenessUs != 2600;
+        mismatches += slowStats.runs != slowCount || slowStats.overruns != 0 || slowStats.skipped != 0 ||
+                      slowStats.maxLatenessUs != 1500;
+        return mismatches;
+    }
+
+    // Two threads through the glove's snapshot ring, as the two cores use it:
+    // the producer pushes RING_PUSHES snapshots whose every field is derived
+    // from a sequence number, the consumer pops them and checks each one whole
+    // (no field from another push), in order, with the missing sequence numbers
+    // exactly the rejected pushes and drops() counting them.
+    uint32_t GloveBench::ringMismatches(uint32_t& popped, uint32_t& dropped) const noexcept{
+        const uint32_t                RING_PUSHES { 2000000 };
+        SpscRing<Snapshot, 8>*        ring        { new SpscRing<Snapshot, 8>() };
+        std::atomic<bool>             done        { false };
+        uint32_t                      rejected    { 0 },
+                                      mismatches  { 0 },
+                                      missing     { 0 };
+
+        auto stamp = [](Snapshot& snap, uint32_t seq){
+            snap.timestampUs = seq;
+            snap.movement    = static_cast<uint8_t>(seq);
+            for(size_t imu{0}; imu<GLOVE_IMUS; imu++){
+                snap.quaternion[imu] = Quat{ static_cast<float>(seq), static_cast<float>(imu), 0.0f, -static_cast<float>(seq) };
+                snap.joints[imu]     = snap.quaternion[imu];
+                for(float& angle: snap.euler[imu])
+                    angle = static_cast<float>(seq + imu);
+            }
+            for(size_t finger{0}; finger<GLOVE_FINGERS; finger++)
+                snap.fingers[finger] = static_cast<uint16_t>(seq * (finger + 1));
+            snap.fingerStatus = static_cast<uint8_t>(seq >> 8);
+            snap.buttons      = static_cast<uint8_t>(seq >> 16);
+            snap.calibrating  = seq & 1;
+        };
+
+        auto same = [](const Snapshot& a, const Snapshot& b){
+            bool equal { a.timestampUs == b.timestampUs && a.movement == b.movement && a.fingerStatus == b.fingerStatus &&
+                         a.buttons == b.buttons && a.calibrating == b.calibrating &&
+                         memcmp(a.fingers, b.fingers, sizeof(a.fingers)) == 0 && memcmp(a.euler, b.euler, sizeof(a.euler)) == 0 };
+            for(size_t imu{0}; imu<GLOVE_IMUS; imu++)
+                equal &= memcmp(&a.quaternion[imu], &b.quaternion[imu], sizeof(Quat)) == 0 &&
+                         memcmp(&a.joints[imu], &b.joints[imu], sizeof(Quat)) == 0;
+            return equal;
+        };
+
+        std::thread producer { [&](void){
+            Snapshot snap;
+            for(uint32_t seq{0}; seq<RING_PUSHES; seq++){
+                stamp(snap, seq);
+                // A full ring lets the consumer run, most times: some pushes still fail.
+                if(!ring->push(snap)){
+                    rejected++;
+                    if(seq % 4 != 0)
+                        std::this_thread::yield();
+                }
+            }
+            done.store(true, std::memory_order_release);
+        } };
+
+        Snapshot got,
+                 expected;
+        uint32_t next { 0 };
+        popped = 0;
+        for(;;){
+            const bool finished { done.load(std::memory_order_acquire) };
+            if(!ring->pop(got)){
+                if(finished)
+                    break;
+                std::this_thread::yield();
+                continue;
+            }
+            stamp(expected, got.timestampUs);
+            if(got.timestampUs < next || !same(got, expected))
+                mismatches++;
+            else
+                missing += got.timestampUs - next;
+            next = got.timestampUs + 1;
+            popped++;
+        }
+        producer.join();
+
+        missing += RING_PUSHES - next;
+        dropped  = ring->drops();
+        mismatches += popped + rejected != RING_PUSHES || missing != rejected || dropped != rejected;
+        delete ring;
+        return mismatches;
+    }
+
+    // Binary frames of random samples: each must decode to the same fields,
+    // the quaternions within half a Q14 step ('worstSteps' is the largest
+    // error in steps), and every single bit flip, a bad sync or a bad version
+    // must be turned down. Then a stream of them through FrameDecoder with
+    // random garbage in between (false syncs often included), one frame in
+    // eight damaged and sequence numbers skipping now and then: the good frames
+    // must all come out, in order, 'crcErrors' at least the damaged ones and
+    // 'lost' the sequence numbers missing.
+    uint32_t GloveBench::frameMismatches(float& worstSteps, uint32_t& crcErrors, uint32_t& lost) const noexcept{
+        const uint32_t  FRAMES     { 2000 };
+        uint32_t        seed       { 2024 },
+                        mismatches { 0 };
+
+        auto rnd = [&seed](void){ seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+        auto randomSample = [&](TelemetrySample& sample){
+            sample.seq         = static_cast<uint16_t>(rnd());
+            sample.timestampUs = rnd() * 509u;
+            sample.flags       = static_cast<uint8_t>(rnd());
+            for(auto& quat: sample.quat)
+                for(float& comp: quat)
+                    comp = static_cast<float>(static_cast<int32_t>(rnd() % 20001) - 10000) / 10000.0f;
+            for(uint8_t& finger: sample.fingers)
+                finger = static_cast<uint8_t>(rnd() % 91);
+            sample.buttons     = static_cast<uint8_t>(rnd() % 8);
+        };
+        auto same = [&](const TelemetrySample& got, const TelemetrySample& sent){
+            bool ok { got.seq == sent.seq && got.timestampUs == sent.timestampUs && got.flags == sent.flags &&
+                      got.buttons == sent.buttons && memcmp(got.fingers, sent.fingers, FRAME_FINGERS) == 0 };
+            for(size_t imu{0}; imu<FRAME_IMUS; imu++)
+                for(size_t comp{0}; comp<4; comp++){
+                    const float steps { fabsf(got.quat[imu][comp] - sent.quat[imu][comp]) * QUAT_SCALE };
+                    worstSteps = std::max(worstSteps, steps);
+                    ok &= steps <= 0.5f + 1e-3f;
+                }
+            return ok;
+        };
+
+        worstSteps = 0.0f;
+        for(uint32_t trial{0}; trial<FRAMES; trial++){
+            TelemetrySample sent, got;
+            uint8_t         frame[FRAME_SIZE];
+            randomSample(sent);
+            if(encodeFrame(sent, frame) != FRAME_SIZE || !decodeFrame(frame, got) || !same(got, sent))
+                mismatches++;
+
+            if(trial % 50 == 0)
+                for(size_t bit{0}; bit<FRAME_SIZE * 8; bit++){
+                    frame[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+                    mismatches    += decodeFrame(frame, got);
+                    frame[bit / 8] ^= static_cast<uint8_t>(1u << (bit % 8));
+                }
+            frame[2] = FRAME_VERSION + 1;
+            put16(frame + FRAME_SIZE - 2, crc16(frame + 2, FRAME_SIZE - 4));
+            mismatches += decodeFrame(frame, got);
+        }
+
+        TelemetrySample* sent     { new TelemetrySample[FRAMES] };
+        bool*            damaged  { new bool[FRAMES] };
+        uint8_t*         stream   { new uint8_t[FRAMES * (FRAME_SIZE + 32)] };
+        size_t           len      { 0 };
+        uint32_t         damages  { 0 };
+        uint16_t         seq      { 100 };
+        for(uint32_t idx{0}; idx<FRAMES; idx++){
+            const size_t noise { rnd() % 4 == 0 ? rnd() % 32 : 0 };
+            for(size_t pos{0}; pos<noise; pos++)
+                stream[len++] = static_cast<uint8_t>(rnd() % 4 == 0 ? (pos % 2 ? FRAME_SYNC1 : FRAME_SYNC0) : rnd());
+
+            randomSample(sent[idx]);
+            seq += rnd() % 20 == 0 ? static_cast<uint16_t>(2 + rnd() % 5) : 1;
+            sent[idx].seq = seq;
+            encodeFrame(sent[idx], stream + len);
+            damaged[idx]  = rnd() % 8 == 0;
+            if(damaged[idx]){
+                stream[len + 3 + rnd() % (FRAME_SIZE - 3)] ^= static_cast<uint8_t>(1 + rnd() % 255);
+                damages++;
+            }
+            len += FRAME_SIZE;
+        }
+
+        FrameDecoder    decoder;
+        TelemetrySample got;
+        uint32_t        next     { 0 },
+                        first    { FRAMES },
+                        last     { 0 },
+                        good     { 0 };
+        for(size_t pos{0}; pos<len; pos++){
+            if(!decoder.push(stream[pos], got))
+                continue;
+            while(next < FRAMES && damaged[next])
+                next++;
+            if(next == FRAMES || !same(got, sent[next]))
+                mismatches++;
+            first = std::min(first, next);
+            last  = next++;
+        }
+        for(uint32_t idx{0}; idx<FRAMES; idx++)
+            good += !damaged[idx];
+        while(next < FRAMES && damaged[next])
+            next++;
+
+        crcErrors = decoder.crcErrors();
+        lost      = decoder.lostFrames();
+        mismatches += next != FRAMES || decoder.frames() != good || crcErrors < damages ||
+                      lost != static_cast<uint16_t>(sent[last].seq - sent[first].seq + 1 - good);
+
+        delete[] stream;
+        delete[] damaged;
+        delete[] sent;
+        return mismatches;
+    }
+
+    // RMS error, in counts, of a filtered finger against the clean signal: a
+    // flex and release every second, read 0.5 to 1.5 ms after the reading
+    // before and filtered with that spacing, with uniform noise and a spike
+    // now and then, as a loose connector gives. Low pass at 20 Hz, 1 Euro
+    // from 5 Hz.
+    float GloveBench::filterError(ADC_FILTER kind) const noexcept{
+        FingerFilter filter;
+        uint32_t     seed  { 12345 };
+        double       sum   { 0.0 };
+        float        at    { 0.0f };
+        const int    STEPS { 10000 };
+
+        filter.configure(kind, kind == ADC_FILTER_LOWPASS ? 20.0f : 5.0f, 0.01f);
+        for(int step{0}; step<STEPS; step++){
+            seed = seed * 1103515245 + 12345;
+            const float dt    { 0.0005f + static_cast<float>((seed >> 4) % 1001) * 1e-6f };
+            at += dt;
+            const float clean { 2000.0f - 1500.0f * cosf(2.0f * static_cast<float>(M_PI) * at) };
+            seed = seed * 1103515245 + 12345;
+            float       raw   { clean + static_cast<float>((seed >> 16) % 161) - 80.0f };
+            if((seed >> 8) % 100 == 0)
+                raw = 4095.0f;
+
+            const float err   { filter.update(static_cast<uint16_t>(raw), dt) - clean };
+            sum += err * err;
+        }
+
+        return static_cast<float>(sqrt(sum / STEPS));
+    }
+
+    // A finger stepping from 1000 to 3000 counts, converted in the background
+    // with the scan rate floor of the ESP32 DMA: asked for 100 readings a
+    // second, it gives one every millisecond. Returns how much of the step
+    // the 20 Hz low pass shows one time constant after: 63% when it takes
+    // the readings with the spacing they have.
+    float GloveBench::continuousStepShare(void) const noexcept{
+        SimBoard*      board { new SimBoard() };
+        Glove*         dut   { new Glove(board->board()) };
+        const uint8_t  pin   { GLOVE_TOPOLOGY.fingers[0].adcPin };
+        const uint32_t TAU_US { static_cast<uint32_t>(1e6 / (2.0 * M_PI * 20.0)) };
+
+        board->adc.setMinScanHz(20000);
+        board->adc.setConstant(pin, 1000);
+        dut->setFingerSampling(100, 4);
+        dut->setFingerFilter(ADC_FILTER_LOWPASS, 20.0f, 0.0f);
+        for(int step{0}; step<50; step++){
+            board->advanceUs(2000);
+            dut->acquireFingers();
+        }
+        board->adc.setConstant(pin, 3000);
+        board->advanceUs(TAU_US);
+        dut->acquireFingers();
+
+        const float share { (dut->fingerCurrent[0] - 1000.0f) / 2000.0f };
+        delete dut;
+        delete board;
+        return share;
+    }
+
+    // Feeds Buttons synthetic edge traces, polled every millisecond: presses
+    // and releases bouncing for up to 2 ms, and lone 200 us spikes. Counts the
+    // events missing, extra, or not dated at the first edge, and returns the
+    // longest delay from the first edge to the event.
+    uint32_t GloveBench::debounceMismatches(uint32_t& worstDelayUs) const noexcept{
+        const uint32_t TICK_US    { 100 },
+                       POLL_US    { 1000 };
+        FakeClock      clock;
+        Buttons        buttons;
+        ButtonEvent    ev;
+        bool           level      { false };
+        uint32_t       seed       { 777 },
+                       mismatches { 0 };
+
+        const auto random { [&](uint32_t range){ seed = seed * 1103515245 + 12345; return (seed >> 16) % range; } };
+        const auto toggle { [&]{ level = !level; buttons.edge(0); } };
+        const auto run    { [&](uint32_t us){
+            for(uint32_t elapsed{0}; elapsed<us; elapsed += TICK_US){
+                clock.advanceUs(TICK_US);
+                if(clock.nowUs() % POLL_US == 0)
+                    buttons.poll(clock.nowUs(), level ? BTN_LEFT : 0);
+            }
+        } };
+
+        buttons.setClock(&clock);
+        worstDelayUs = 0;
+
+        for(int trial{0}; trial<500; trial++){
+            run(20000 + random(30) * 1000);
+
+            if(trial % 5 == 4){
+                toggle();
+                run(200);
+                toggle();
+                run(20000);
+                while(buttons.take(ev))
+                    mismatches++;
+                continue;
+            }
+
+            const uint32_t     start    { clock.nowUs() };
+            const BUTTON_EVENT expected { level ? BUTTON_RELEASE : BUTTON_PRESS };
+            toggle();
+            for(uint32_t bounce{random(6) * 2}; bounce>0; bounce--){
+                run(100 + random(4) * 100);
+                toggle();
+            }
+
+            bool seen { false };
+            for(uint32_t waited{0}; waited<20000 && !seen; waited += TICK_US){
+                run(TICK_US);
+                seen = buttons.take(ev);
+            }
+            if(!seen || ev.kind != expected || ev.buttons != BTN_LEFT || ev.atUs != start)
+                mismatches++;
+            if(seen && clock.nowUs() - start > worstDelayUs)
+                worstDelayUs = clock.nowUs() - start;
+            while(buttons.take(ev))
+                mismatches++;
+        }
+
+        return mismatches;
+    }
+
+    // Streams a minute of synthetic motion at 100 Hz, two seconds still and two
+    // moving in turn, through DeltaEncoder and DeltaDecoder. Counts the samples
+    // the decoded state is further from than the deadbands (plus the Q14 step
+    // for the quaternions), and gives the bytes against full frames.
+    uint32_t GloveBench::deltaMismatches(float& worstDeg, float& bytesRatio) const noexcept{
+        const DeltaConfig conf;
+        const float       QUANT_DEG  { 0.02f };
+        DeltaEncoder      encoder;
+        DeltaDecoder      decoder;
+        TelemetrySample   sample,
+                          decoded;
+        uint8_t           out[DELTA_MAX_SIZE];
+        uint32_t          mismatches { 0 };
+        size_t            bytes      { 0 };
+        float             phase      { 0.0f };
+        const int         STEPS      { 6000 };
+
+        encoder.configure(conf);
+        worstDeg = 0.0f;
+
+        for(int step{0}; step<STEPS; step++){
+            const bool moving { (step / 200) % 2 == 1 };
+            if(moving)
+                phase += 0.003f;
+
+            sample.timestampUs = static_cast<uint32_t>(step) * 10000;
+            for(size_t imu{0}; imu<FRAME_IMUS; imu++){
+                const float half { phase * (imu + 1) * 0.5f };
+                sample.quat[imu][0] = cosf(half);
+                sample.quat[imu][1] = imu == 0 ? sinf(half) : 0.0f;
+                sample.quat[imu][2] = imu == 1 ? sinf(half) : 0.0f;
+                sample.quat[imu][3] = imu == 2 ? sinf(half) : 0.0f;
+            }
+            for(size_t finger{0}; finger<FRAME_FINGERS; finger++)
+                sample.fingers[finger] = static_cast<uint8_t>(45 + 44 * sinf(phase * (finger + 1)));
+            sample.buttons = (step / 370) % 2 ? BTN_LEFT : 0;
+
+            const size_t len { encoder.encode(sample, out) };
+            sample.seq = static_cast<uint16_t>(sample.seq + (len > 0));
+            bytes     += len;
+            for(size_t pos{0}; pos<len; pos++)
+                decoder.push(out[pos], decoded);
+            if(decoder.keyframes() == 0)
+                continue;
+
+            bool bad { decoded.buttons != sample.buttons };
+            for(size_t imu{0}; imu<FRAME_IMUS; imu++){
+                double dot   { 0.0 },
+                       norms { 0.0 };
+                for(size_t comp{0}; comp<4; comp++){
+                    dot   += decoded.quat[imu][comp] * sample.quat[imu][comp];
+                    norms += decoded.quat[imu][comp] * decoded.quat[imu][comp];
+                }
+                const float deg { static_cast<float>(2.0 * acos(fmin(1.0, fabs(dot) / sqrt(norms))) * 180.0 / M_PI) };
+                if(deg > worstDeg)
+                    worstDeg = deg;
+                bad |= deg > conf.quatDeadbandDeg + QUANT_DEG;
+            }
+            for(size_t finger{0}; finger<FRAME_FINGERS; finger++)
+                bad |= abs(decoded.fingers[finger] - sample.fingers[finger]) > conf.fingerDeadband;
+            if(bad)
+                mismatches++;
+        }
+
+        bytesRatio = static_cast<float>(bytes) / (STEPS * FRAME_SIZE);
+        return mismatches + decoder.crcErrors() + decoder.lostFrames();
+    }
+
+    // Sends COMMAND_CHECKS pings with random payloads to a fresh glove on the
+    // link, each after random garbage that often holds a false sync, then a few
+    // commands with known answers, then two pings again behind a false frame
+    // ending with them. Counts the requests not answered or answered wrong;
+    // crcErrors are the false frames the glove had to skip.
+    uint32_t GloveBench::commandMismatches(uint32_t& answered, uint32_t& crcErrors) const noexcept{
+        const uint32_t    PINGS      { 200 };
+        SimBoard*         board      { new SimBoard() };
+        Glove*            dut        { new Glove(board->board()) };
+        CommandParser     responses  { true };
+        uint8_t           sent[PINGS][16];
+        uint8_t           sentLen[PINGS] {};
+        uint8_t           frame[CMD_OVERHEAD + CMD_MAX_PAYLOAD];
+        uint32_t          seed       { 12345 },
+                          mismatches { 0 };
+        bool              seen[PINGS] {};
+        answered = 0;
+
+        auto rnd = [&seed](void){ seed = seed * 1664525u + 1013904223u; return static_cast<uint8_t>(seed >> 24); };
+
+        // Answers the pings, returns the status of the last other response.
+        auto exchange = [&](const uint8_t* data, size_t len){
+            int last { -1 };
+            board->link.feed(data, len);
+            dut->drain();
+            for(size_t pos{0}; pos<board->link.captureSize(); pos++){
+                for(auto res{responses.push(board->link.capture()[pos])}; res != CommandParser::PARSE_MORE; res = responses.next()){
+                    if(res != CommandParser::PARSE_READY)
+                        continue;
+                    const Command& rsp { responses.command() };
+                    if(rsp.id != CMD_PING){
+                        last = rsp.status;
+                        continue;
+                    }
+                    answered++;
+                    if(rsp.tag >= PINGS || seen[rsp.tag] || rsp.length != sentLen[rsp.tag] ||
+                       memcmp(rsp.payload, sent[rsp.tag], rsp.length) != 0)
+                        mismatches++;
+                    else
+                        seen[rsp.tag] = true;
+                }
+            }
+            board->link.reset();
+            return last;
+        };
+
+        for(uint32_t req{0}; req<PINGS; req++){
+            uint8_t garbage[24];
+            const size_t noise { rnd() % sizeof(garbage) };
+            for(size_t pos{0}; pos<noise; pos++){
+                garbage[pos] = rnd();
+                if(garbage[pos] == FLIGHT_DUMP_REQUEST || garbage[pos] == STATS_REQUEST)
+                    garbage[pos] = 0;
+            }
+            if(noise >= 3 && rnd() % 2 == 0){
+                garbage[noise - 3] = CMD_SYNC0;
+                garbage[noise - 2] = CMD_SYNC1;
+            }
+            exchange(garbage, noise);
+
+            sentLen[req] = rnd() % sizeof(sent[req]);
+            for(size_t pos{0}; pos<sentLen[req]; pos++)
+                sent[req][pos] = rnd();
+            exchange(frame, encodeCommand(CMD_PING, static_cast<uint8_t>(req), sent[req], sentLen[req], frame));
+        }
+
+        uint8_t  args[5] { RATE_OUTPUT };
+        uint32_t period  { 0 };
+        put32(args + 1, 20000);
+        if(exchange(frame, encodeCommand(CMD_SET_RATE, 0, args, 5, frame)) != CMD_OK ||
+           !dut->takeRate(RATE_OUTPUT, period) || period != 20000 || dut->takeRate(RATE_OUTPUT, period))
+            mismatches++;
+        put32(args + 1, 100);
+        if(exchange(frame, encodeCommand(CMD_SET_RATE, 0, args, 5, frame)) != CMD_BAD_ARGS)
+            mismatches++;
+        if(exchange(frame, encodeCommand(0x7F, 0, nullptr, 0, frame)) != CMD_UNKNOWN)
+            mismatches++;
+        if(exchange(frame, encodeCommand(CMD_TIME_SYNC, 0, args, SYNC_REQUEST_SIZE, frame)) != CMD_OK ||
+           responses.command().length != SYNC_RESPONSE_SIZE || memcmp(responses.command().payload, args, SYNC_REQUEST_SIZE) != 0)
+            mismatches++;
+        if(exchange(frame, encodeCommand(CMD_TIME_SYNC, 0, args, 2, frame)) != CMD_BAD_ARGS)
+            mismatches++;
+
+        // Deadbands 1 degree and 2, refreshes 250 ms and 1 s, then each field out of range.
+        uint8_t delta[11];
+        auto setDelta = [&](uint16_t centiDeg, uint8_t finger, uint32_t staleUs, uint32_t keyUs){
+            put16(delta, centiDeg);
+            delta[2] = finger;
+            put32(delta + 3, staleUs);
+            put32(delta + 7, keyUs);
+            return exchange(frame, encodeCommand(CMD_SET_DELTA, 0, delta, sizeof(delta), frame));
+        };
+        mismatches += setDelta(100, 2, 250000, 1000000) != CMD_OK;
+        mismatches += setDelta(100, 2, 250000, 0) != CMD_BAD_ARGS || setDelta(100, 2, 0, 1000000) != CMD_BAD_ARGS ||
+                      setDelta(65500, 2, 250000, 1000000) != CMD_BAD_ARGS || setDelta(100, 200, 250000, 1000000) != CMD_BAD_ARGS ||
+                      setDelta(100, 2, 250000, 0xFFFFFFFF) != CMD_BAD_ARGS;
+        mismatches += exchange(frame, encodeCommand(CMD_SET_DELTA, 0, delta, 7, frame)) != CMD_BAD_ARGS;
+
+        // The fusion filter changes on the acquisition side, at its next step.
+        uint8_t fusion[3] { FILTER_COMPLEMENTARY };
+        auto setFusion = [&](uint8_t kind, uint16_t milli, size_t len){
+            fusion[0] = kind;
+            put16(fusion + 1, milli);
+            return exchange(frame, encodeCommand(CMD_SET_FUSION, 0, fusion, len, frame));
+        };
+        mismatches += setFusion(FILTER_COMPLEMENTARY, 2000, 3) != CMD_OK ||
+                      dut->angles.filter[0].filterKind() != FILTER_MADGWICK;
+        dut->applyRequests();
+        for(const auto& filter: dut->angles.filter)
+            mismatches += filter.filterKind() != FILTER_COMPLEMENTARY || filter.filterGain() != 2.0f;
+        mismatches += setFusion(FILTER_MADGWICK + 1, 100, 3) != CMD_BAD_ARGS || setFusion(FILTER_MADGWICK, 0, 3) != CMD_BAD_ARGS ||
+                      setFusion(FILTER_MADGWICK, FUSION_MAX_GAIN_MILLI + 1, 3) != CMD_BAD_ARGS ||
+                      setFusion(FILTER_MADGWICK, 100, 2) != CMD_BAD_ARGS;
+        dut->applyRequests();
+        mismatches += dut->angles.filter[0].filterKind() != FILTER_COMPLEMENTARY;
+
+        // A false frame still open holds the pings after it until the bytes
+        // it claims have come: the commands above bring them, and then every
+        // complete frame behind it must be out.
+        mismatches += PINGS - answered;
+
+        // A false header claiming just the two pings behind it: its CRC fails
+        // on their last byte, both must be answered with no byte after.
+        uint8_t held[5 + 2 * (CMD_OVERHEAD + sizeof(sent[0]))];
+        size_t  heldLen { 5 };
+        for(uint8_t tag{0}; tag<2; tag++){
+            heldLen  += encodeCommand(CMD_PING, tag, sent[tag], sentLen[tag], held + heldLen);
+            seen[tag] = false;
+        }
+        held[0] = CMD_SYNC0;
+        held[1] = CMD_SYNC1;
+        held[2] = CMD_PING;
+        held[3] = 0;
+        held[4] = static_cast<uint8_t>(heldLen - 7);
+        answered -= 2;
+        exchange(held, heldLen);
+        mismatches += !seen[0] || !seen[1];
+        crcErrors = dut->commandErrors();
+        delete dut;
+        delete board;
+        return mismatches;
+    }
+
+    // Both calibrations on a fresh glove, run on the firmware schedule (fingers
+    // every 2 ms, IMUs every 5, output every 10, display every 100): the
+    // fingers with the buttons, the LEFT + MIDDLE chord held 900 ms, less
+    // than the confirmation holdoff, then LEFT (with RIGHT, the recorder
+    // freeze chord) once relaxed and once contracted; the arm with
+    // CMD_CALIBRATE requests on the link, the IMUs
+    // still in known poses. Counts the steps out of the expected sequence,
+    // the ends and reference pose not stored (in the glove and in its
+    // profile), the frames missing or flagged FRAME_CALIBRATING when the
+    // calibration wasn't running or the other way round, the display draws
+    // made from the acquisition side, and a recorder frozen by the chord
+    // during the calibration or not frozen by it after.
+    uint32_t GloveBench::calibrationMismatches(uint32_t& steps, uint32_t& calibFrames) const noexcept{
+        static const Quat POSES[GLOVE_IMUS] { quatFromAxisAngle(0.0f, 0.0f, 1.0f, 0.4f),
+                                              quatFromAxisAngle(0.6f, 0.0f, 0.8f, -0.9f),
+                                              quatFromAxisAngle(1.0f, 0.0f, 0.0f, 1.3f) };
+        const Glove::CALIB_STATE EXPECTED[] { Glove::CAL_RELAX, Glove::CAL_MIN_OK, Glove::CAL_CONTRACT, Glove::CAL_MAX_OK,
+                                              Glove::CAL_FINGERS_OK, Glove::CAL_IDLE, Glove::CAL_POSE, Glove::CAL_SAMPLING,
+                                              Glove::CAL_ACCEL_OK, Glove::CAL_ARTICULATIONS_OK, Glove::CAL_IDLE };
+        const size_t       STEPS      { sizeof(EXPECTED) / sizeof(EXPECTED[0]) };
+        SimBoard*          board      { new SimBoard() };
+        Glove*             dut        { new Glove(board->board()) };
+        FrameDecoder       decoder;
+        TelemetrySample    sample;
+        Glove::CALIB_STATE last       { Glove::CAL_IDLE };
+        uint32_t           mismatches { 0 },
+                           published  { 0 },
+                           flagged    { 0 };
+        uint16_t           relaxed[GLOVE_FINGERS],
+                           contracted[GLOVE_FINGERS];
+
+        steps       = 0;
+        calibFrames = 0;
+        for(size_t idx{0}; idx<GLOVE_IMUS; idx++)
+            board->imu.setTrace(GLOVE_TOPOLOGY.imus[idx].muxChannel, &POSES[idx], 1);
+
+        auto fingers = [&](const uint16_t* values){
+            for(size_t idx{0}; idx<GLOVE_FINGERS; idx++)
+                board->adc.setConstant(GLOVE_TOPOLOGY.fingers[idx].adcPin, values[idx]);
+        };
+        auto press = [&](size_t button, bool down){
+            board->adc.setConstant(GLOVE_TOPOLOGY.buttonPins[button], down ? 4095 : 0);
+        };
+        auto request = [&](uint8_t action){
+            uint8_t frame[CMD_OVERHEAD + 1];
+            board->link.feed(frame, encodeCommand(CMD_CALIBRATE, 0, &action, 1, frame));
+        };
+        // On the board clock: the bus transfers move it as well.
+        const uint32_t begin  { board->clock.nowUs() };
+        uint32_t       due[4] { begin, begin, begin, begin };
+        auto runUntil = [&](uint32_t untilMs){
+            while(static_cast<int32_t>(board->clock.nowUs() - begin - untilMs * 1000) < 0){
+                const uint32_t now { board->clock.nowUs() };
+                if(static_cast<int32_t>(now - due[0]) >= 0){
+                    due[0] += 2000;
+                    const uint32_t draws { board->display.draws() };
+                    dut->acquireFingers();
+                    mismatches += board->display.draws() != draws || dut->flightDumpActive();
+                    if(dut->calibState != last){
+                        last = dut->calibState;
+                        mismatches += steps >= STEPS || EXPECTED[steps] != last;
+                        steps++;
+                    }
+                }
+                if(static_cast<int32_t>(now - due[1]) >= 0){
+                    due[1] += 5000;
+                    dut->acquireImus();
+                }
+                if(static_cast<int32_t>(now - due[2]) >= 0){
+                    due[2] += 10000;
+                    dut->publish();
+                    published++;
+                    flagged += dut->calibState != Glove::CAL_IDLE;
+                    dut->drain();
+                    for(size_t pos{0}; pos<board->link.captureSize(); pos++){
+                        if(!decoder.push(board->link.capture()[pos], sample))
+                            continue;
+                        calibFrames += (sample.flags & FRAME_CALIBRATING) != 0;
+                    }
+                    board->link.reset();
+                }
+                if(static_cast<int32_t>(now - due[3]) >= 0){
+                    due[3] += 100000;
+                    dut->refreshFingers();
+                }
+                board->advanceUs(100);
+            }
+        };
+
+        for(size_t idx{0}; idx<GLOVE_FINGERS; idx++){
+            relaxed[idx]    = static_cast<uint16_t>(300 + idx * 37);
+            contracted[idx] = static_cast<uint16_t>(3100 + idx * 53);
+        }
+        fingers(relaxed);
+
+        runUntil(100);
+        press(0, true);
+        press(1, true);
+        runUntil(1000);                  // the chord, still held, must not confirm
+        press(0, false);
+        press(1, false);
+        runUntil(1500);
+        mismatches += dut->calibState != Glove::CAL_RELAX;
+        press(0, true);                  // with RIGHT: a confirmation, not a recorder freeze
+        press(2, true);
+        runUntil(1600);
+        press(0, false);
+        press(2, false);
+        runUntil(4000);
+        mismatches += dut->calibState != Glove::CAL_CONTRACT;
+        fingers(contracted);
+        runUntil(5000);
+        press(0, true);
+        runUntil(5100);
+        press(0, false);
+        runUntil(10000);
+        mismatches += dut->calibState != Glove::CAL_IDLE || dut->isCalibrating();
+
+        request(CALIBRATE_ARM);
+        runUntil(11500);
+        request(CALIBRATE_CONFIRM);
+        runUntil(18500);
+        mismatches += steps != STEPS || dut->calibState != Glove::CAL_IDLE || dut->isCalibrating();
+
+        // What the glove uses and what it saved.
+        CalibrationProfile prof;
+        mismatches += !dut->calibration.load(dut->user, prof);
+        for(size_t idx{0}; idx<GLOVE_FINGERS; idx++)
+            mismatches += dut->fingerMin[idx] != relaxed[idx] || dut->fingerMax[idx] != contracted[idx] ||
+                          prof.fingerMin[idx] != relaxed[idx] || prof.fingerMax[idx] != contracted[idx];
+        for(size_t idx{0}; idx<GLOVE_IMUS; idx++){
+            float euler[3];
+            eulerFromQuat(POSES[idx], euler);
+            mismatches += quatAngle(dut->chain.reference(idx), POSES[idx]) > 1e-3f ||
+                          quatAngle(prof.reference[idx], POSES[idx]) > 1e-3f;
+            for(size_t axis{0}; axis<3; axis++)
+                mismatches += fabsf(dut->articulation[idx][axis] - euler[axis]) > 1e-4f ||
+                              fabsf(prof.articulation[idx][axis] - euler[axis]) > 1e-4f;
+        }
+
+        mismatches += decoder.frames() != published || decoder.lostFrames() != 0 || calibFrames != flagged;
+
+        // Out of calibration the chord freezes the recorder.
+        press(0, true);
+        press(2, true);
+        for(int step{0}; step<20; step++){
+            board->advanceUs(2000);
+            dut->acquireFingers();
+        }
+        mismatches += !dut->flightDumpActive();
+
+        delete dut;
+        delete board;
+        return mismatches;
+    }
+
+    // The raw mode switched with one IMU refusing it, each way, then with all
+    // of them answering. Counts the IMUs left in another mode than the one
+    // the glove reports, and the switches not refused or not done.
+    uint32_t GloveBench::rawSwitchMismatches(void) const noexcept{
+        SimBoard* board      { new SimBoard() };
+        Glove*    dut        { new Glove(board->board()) };
+        uint32_t  mismatches { 0 };
+
+        auto uniform = [&](bool raw){
+            uint32_t off { 0 };
+            for(const auto& imu: GLOVE_TOPOLOGY.imus)
+                off += board->imu.rawMode(imu.muxChannel) != raw;
+            return off;
+        };
+
+        const uint8_t last { GLOVE_TOPOLOGY.imus[GLOVE_IMUS - 1].muxChannel };
+        board->imu.setRawRefused(last, true);
+        mismatches += dut->setImuMode(IMU_RAW) || dut->imuMode() != IMU_POLL;
+        mismatches += uniform(false);
+        board->imu.setRawRefused(last, false);
+        mismatches += !dut->setImuMode(IMU_RAW) || dut->imuMode() != IMU_RAW;
+        mismatches += uniform(true);
+        board->imu.setRawRefused(last, true);
+        mismatches += dut->setImuMode(IMU_POLL) || dut->imuMode() != IMU_RAW;
+        mismatches += uniform(true);
+        board->imu.setRawRefused(last, false);
+        mismatches += !dut->setImuMode(IMU_POLL) || dut->imuMode() != IMU_POLL;
+        mismatches += uniform(false);
+
+        delete dut;
+        delete board;
+        return mismatches;
+    }
+
+    // A second of the schedule on a glove built on a SessionTap: CMD_SET_FORMAT
+    // must refuse SESSION before the tap is handed over and take it after,
+    // then the link must carry one header with the tap layout ahead of a
+    // record per output period, each with the quaternions the glove held.
+    // A record damaged on the way must be dropped alone.
+    uint32_t GloveBench::sessionStreamMismatches(uint32_t& records, uint32_t& crcErrors) const noexcept{
+        SimBoard*            board      { new SimBoard() };
+        SessionTap*          tap        { new SessionTap(board->board()) };
+        Glove*               dut        { new Glove(tap->board()) };
+        SessionStreamDecoder decoder;
+        CommandParser        responses  { true };
+        uint32_t             mismatches { 0 },
+                             headers    { 0 },
+                             published  { 0 };
+        Quat                 held[GLOVE_IMUS];
+        uint32_t             heldUs     { 0 };
+
+        auto setFormat = [&](uint8_t format){
+            uint8_t frame[CMD_OVERHEAD + 1];
+            int     status { -1 };
+            board->link.feed(frame, encodeCommand(CMD_SET_FORMAT, 0, &format, 1, frame));
+            dut->drain();
+            for(size_t pos{0}; pos<board->link.captureSize(); pos++)
+                for(auto res{responses.push(board->link.capture()[pos])}; res != CommandParser::PARSE_MORE; res = responses.next())
+                    if(res == CommandParser::PARSE_READY && responses.command().id == CMD_SET_FORMAT)
+                        status = responses.command().status;
+            board->link.reset();
+            return status;
+        };
+
+        records = 0;
+        mismatches += setFormat(Glove::SESSION) != CMD_BAD_ARGS;
+        dut->setSessionTap(tap);
+        mismatches += setFormat(Glove::SESSION) != CMD_OK;
+
+        const uint32_t begin  { board->clock.nowUs() };
+        uint32_t       due[3] { begin, begin, begin };
+        while(static_cast<int32_t>(board->clock.nowUs() - begin - 1000000) < 0){
+            const uint32_t now { board->clock.nowUs() };
+            if(static_cast<int32_t>(now - due[0]) >= 0){
+                due[0] += 2000;
+                dut->acquireFingers();
+            }
+            if(static_cast<int32_t>(now - due[1]) >= 0){
+                due[1] += 5000;
+                dut->acquireImus();
+            }
+            if(static_cast<int32_t>(now - due[2]) >= 0){
+                due[2] += 10000;
+                memcpy(held, dut->angles.quaternion, sizeof(held));
+                heldUs = board->clock.nowUs();
+                dut->publish();
+                published++;
+                dut->drain();
+
+                // One byte of the 50th record flipped on the way.
+                uint8_t      stream[SESSION_HEADER + SESSION_FRAME];
+                const size_t len { std::min(board->link.captureSize(), sizeof(stream)) };
+                memcpy(stream, board->link.capture(), len);
+                if(published == 50 && len >= SESSION_FRAME)
+                    stream[len - SESSION_FRAME / 2] ^= 0x10;
+                for(size_t pos{0}; pos<len; pos++){
+                    switch(decoder.push(stream[pos])){
+                        case SessionStreamDecoder::SESSION_HEADER_READY:
+                            headers++;
+                            mismatches += records > 0 || decoder.header().imuMode != dut->imuMode() ||
+                                          memcmp(decoder.header().adcPins, SessionTap::LAYOUT.adcPins, SESSION_ADCS) != 0 ||
+                                          memcmp(decoder.header().imuChannels, SessionTap::LAYOUT.imuChannels, SESSION_IMUS) != 0;
+                            break;
+                        case SessionStreamDecoder::SESSION_RECORD_READY:
+                            records++;
+                            mismatches += headers == 0 || decoder.record().timestampUs != heldUs ||
+                                          memcmp(decoder.record().quat, held, sizeof(held)) != 0;
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                board->link.reset();
+            }
+            board->advanceUs(100);
+        }
+
+        crcErrors   = decoder.crcErrors();
+        mismatches += headers != 1 || records + 1 != published || crcErrors != 1;
+
+        delete dut;
+        delete tap;
+        delete board;
+        return mismatches;
+    }
+
+    // A minute of samples at 100 Hz from a device clock off by 'driftPpm',
+    // arriving 2 ms after they are taken plus up to 30 ms of random radio
+    // and buffer delay, in order: the largest distance between the time ClockAligner
+    // gives them on the host and the time they were taken, past the first second.
+    uint32_t GloveBench::alignmentError(int32_t driftPpm) const noexcept{
+        const uint32_t BASE_US  { 2000 },
+                       DEVICE0  { 987654321 };
+        ClockAligner   aligner;
+        uint32_t       seed     { 777 },
+                       worst    { 0 },
+                       rx       { 0 };
+
+        for(uint32_t step{0}; step<6000; step++){
+            const uint32_t taken  { 5000000 + step * 10000 },
+                           device { DEVICE0 + taken + static_cast<uint32_t>(static_cast<int64_t>(taken) * driftPpm / 1000000) };
+            seed = seed * 1664525u + 1013904223u;
+            // In order, as on a serial link: a sample waits for the one before.
+            rx = std::max(rx, taken + BASE_US + (seed >> 8) % 30000);
+            const uint32_t host   { aligner.toHost(device, rx) };
+            const uint32_t err    { static_cast<uint32_t>(abs(static_cast<int32_t>(host - taken - BASE_US))) };
+            if(step >= 100 && err > worst)
+                worst = err;
+        }
+        return worst;
+    }
+
+    // Two minutes of CMD_TIME_SYNC exchanges every 250 ms with a device clock
+    // off by 'driftPpm': each way takes 1 ms plus up to 25 ms of random
+    // delay, drawn separately, the device up to 2 ms to answer. Past the
+    // first 60 s, once the drift is measured, the largest distance between TimeSync::toHost() of a
+    // device time up to a second after the last exchange and the host time
+    // it stands for, and in 'driftErrPpm' the worst error of the drift.
+    uint32_t GloveBench::syncError(int32_t driftPpm, float& driftErrPpm) const noexcept{
+        const uint32_t DEVICE0  { 3000000000u };
+        TimeSync       sync;
+        uint32_t       seed     { 99 },
+                       worst    { 0 };
+
+        auto rnd    = [&seed](uint32_t range){ seed = seed * 1664525u + 1013904223u; return (seed >> 8) % range; };
+        auto device = [&](uint32_t host){
+            return DEVICE0 + host + static_cast<uint32_t>(static_cast<int64_t>(host) * driftPpm / 1000000);
+        };
+
+        driftErrPpm = 0.0f;
+        for(uint32_t step{0}; step<480; step++){
+            const uint32_t t1 { 1000000 + step * 250000 },
+                           rx { t1 + 1000 + rnd(25000) },
+                           tx { rx + rnd(2000) },
+                           t4 { tx + 1000 + rnd(25000) };
+            sync.add(t1, device(rx), device(tx), t4);
+            if(step < 240)
+                continue;
+
+            const uint32_t host { t4 + rnd(1000000) },
+                           err  { static_cast<uint32_t>(abs(static_cast<int32_t>(sync.toHost(device(host)) - host))) };
+            worst       = std::max(worst, err);
+            driftErrPpm = std::max(driftErrPpm, static_cast<float>(fabs(sync.driftPpm() - driftPpm)));
+        }
+        return worst;
+    }
+
+    // The loopback links of glove_latency: bursts of writes into a fresh
+    // DelayLine, each due 5 to 15 ms later, polled every 10 us around the sign
+    // change of the 32 bit clock, around its wrap and well past the sign
+    // change, where a line used to hold its first write back for good. Counts
+    // the writes out of order,
+    // released before their time or more than a poll after the later of their
+    // time and the release of the one ahead, and the ones never released.
+    uint32_t GloveBench::delayLineMismatches(uint32_t& delivered) const noexcept{
+        const uint32_t      STEP_US   { 10 },
+                            SPAN_US   { 400000 },
+                            CAPACITY  { 1024 };
+        const uint32_t      STARTS[]  { 0x80000000u - SPAN_US / 2, 0u - SPAN_US / 2, 0xC0000000u };
+        uint32_t*           release   { new uint32_t[CAPACITY] };
+        uint32_t            seed      { 4711 },
+                            mismatches { 0 };
+
+        auto rnd = [&seed](uint32_t range){ seed = seed * 1664525u + 1013904223u; return (seed >> 8) % range; };
+
+        delivered = 0;
+        for(const uint32_t start: STARTS){
+            DelayLine<CAPACITY, 4>* line { new DelayLine<CAPACITY, 4>() };
+            uint32_t pushed  { 0 },
+                     popped  { 0 },
+                     ahead   { 0 };
+            for(uint32_t now{start}; now - start < SPAN_US + 50000; now += STEP_US){
+                // Writes in the first half of every 20 ms: the line runs empty in between.
+                if(now - start < SPAN_US && (now - start) % 20000 < 10000 && rnd(4) == 0){
+                    const uint32_t due  { now + 5000 + rnd(10000) };
+                    uint8_t        data[4];
+                    put32(data, pushed);
+                    if(!line->push(due, data, sizeof(data))){
+                        mismatches++;
+                        continue;
+                    }
+                    ahead = line->size() > 1 && static_cast<int32_t>(due - ahead) < 0 ? ahead : due;
+                    release[pushed++ % CAPACITY] = ahead;
+                }
+                for(const auto* out{line->due(now)}; out != nullptr; out = line->due(now)){
+                    const int32_t late { static_cast<int32_t>(now - release[popped % CAPACITY]) };
+                    mismatches += get32(out->data) != popped || late < 0 || late >= static_cast<int32_t>(STEP_US);
+                    line->pop();
+                    popped++;
+                }
+            }
+            mismatches += popped != pushed || line->size() != 0;
+            delivered  += popped;
+            delete line;
+        }
+
+        delete[] release;
+        return mismatches;
+    }
+
+    // A minute at 100 Hz of a hand turning back and forth (1.5 Hz, 35 degrees)
+    // on a forearm swinging slower, frames taken from the quantized stream:
+    // mean distance of the pose predicted 'horizonUs' ahead from the true
+    // one, in degrees, and in 'holdDeg' the same for the newest frame as it is.
+    float GloveBench::predictionError(uint32_t horizonUs, float& holdDeg) const noexcept{
+        const float   TWO_PI     { static_cast<float>(2.0 * M_PI) };
+        PosePredictor predictor;
+        double        predicted  { 0.0 },
+                      held       { 0.0 };
+        uint32_t      count      { 0 };
+
+        auto pose = [&](uint32_t us, size_t imu){
+            const float t { us * 1e-6f };
+            return imu == 2 ? quatFromAxisAngle(0.0f, 0.0f, 1.0f, 0.6f * sinf(TWO_PI * 1.5f * t))
+                            : quatFromAxisAngle(1.0f, 0.0f, 0.0f, 0.4f * sinf(TWO_PI * 0.7f * t + imu));
+        };
+
+        for(uint32_t step{0}; step<6000; step++){
+            TelemetrySample sample;
+            sample.timestampUs = step * 10000;
+            sample.flags       = 0x07;
+            uint8_t frame[FRAME_SIZE];
+            for(size_t imu{0}; imu<FRAME_IMUS; imu++){
+                const Quat q { pose(sample.timestampUs, imu) };
+                sample.quat[imu][0] = q.w;  sample.quat[imu][1] = q.x;
+                sample.quat[imu][2] = q.y;  sample.quat[imu][3] = q.z;
+            }
+            encodeFrame(sample, frame);
+            decodeFrame(frame, sample);
+            predictor.update(sample);
+
+            PosePrediction ahead;
+            predictor.predict(sample.timestampUs + horizonUs, ahead);
+            if(step < 100)
+                continue;
+            for(size_t imu{0}; imu<FRAME_IMUS; imu++){
+                const Quat truth { pose(sample.timestampUs + horizonUs, imu) },
+                           last  { quatNormalize(Quat{ sample.quat[imu][0], sample.quat[imu][1],
+                                                       sample.quat[imu][2], sample.quat[imu][3] }) };
+                predicted += quatAngle(ahead.quat[imu], truth);
+                held      += quatAngle(last, truth);
+                count++;
+            }
+        }
+        holdDeg = static_cast<float>(held / count * 180.0 / M_PI);
+        return static_cast<float>(predicted / count * 180.0 / M_PI);
+    }
+
+    // Five thousand lines of the text output with random angles and fingers,
+    // each often followed by a status line of random bytes ('<' and '>'
+    // included), one in ten damaged by a changed or missing byte, fed in
+    // random pieces. Counts the undamaged frames missed or read differently
+    // from strtof, the damaged ones the parser turned down, and the worst
+    // distance of parseTextFloat() from strtof on random decimals.
+    uint32_t GloveBench::textMismatches(uint32_t& clean, uint32_t& corrupted, uint32_t& rejected,
+                                        uint32_t& worstUlp) const noexcept{
+        const size_t  LINES      { 5000 };
+        TextSample*   expected   { new TextSample[LINES] };
+        bool*         damaged    { new bool[LINES] };
+        char*         stream     { new char[LINES * 200] };
+        size_t        len        { 0 };
+        uint32_t      seed       { 4242 },
+                      mismatches { 0 };
+
+        auto rnd = [&seed](void){ seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+
+        clean = corrupted = rejected = worstUlp = 0;
+        for(size_t line{0}; line<LINES; line++){
+            char  text[200];
+            float angles[TEXT_ANGLES];
+            for(float& angle: angles)
+                angle = static_cast<float>(static_cast<int32_t>(rnd() % 72000) - 36000) / 100.0f;
+            int n { snprintf(text, sizeof(text), "<%.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f, %.2f",
+                             angles[0], angles[1], angles[2], angles[3], angles[4], angles[5], angles[6], angles[7], angles[8]) };
+            for(size_t finger{0}; finger<TEXT_FINGERS; finger++){
+                expected[line].fingers[finger] = static_cast<uint8_t>(rnd() % 91);
+                n += snprintf(text + n, sizeof(text) - n, ", %u", expected[line].fingers[finger]);
+            }
+            n += snprintf(text + n, sizeof(text) - n, ">\r\n");
+
+            // What strtof makes of the printed angles.
+            const char* field { text + 1 };
+            for(float& angle: expected[line].angles){
+                char* next;
+                angle = strtof(field, &next);
+                field = next + 2;
+            }
+
+            damaged[line] = rnd() % 10 == 0;
+            if(damaged[line]){
+                const size_t at { rnd() % static_cast<size_t>(n - 2) };
+                if(rnd() % 2)
+                    text[at] = static_cast<char>(rnd());
+                else
+                    memmove(text + at, text + at + 1, static_cast<size_t>(n--) - at);
+            }
+            memcpy(stream + len, text, static_cast<size_t>(n));
+            len += static_cast<size_t>(n);
+
+            if(rnd() % 2){
+                const size_t fingers { 1 + rnd() % 5 };          // cut at a zero finger
+                for(size_t idx{0}; idx<fingers; idx++)
+                    stream[len++] = static_cast<char>(1 + rnd() % 89);
+                if(fingers == 5)
+                    for(size_t idx{0}; idx<3; idx++)
+                        stream[len++] = rnd() % 2 ? '1' : '0';
+                stream[len++] = '\r';
+                stream[len++] = '\n';
+            }
+        }
+
+        struct Collect{
+            TextSample* out;
+            size_t      count;
+        } got { new TextSample[LINES * 2], 0 };
+
+        TextParser parser;
+        for(size_t pos{0}; pos<len;){
+            const size_t piece { std::min<size_t>(1 + rnd() % 300, len - pos) };
+            parser.feed(reinterpret_cast<const uint8_t*>(stream + pos), piece, [](const TextSample& smp, void* ctx){
+                Collect& col { *static_cast<Collect*>(ctx) };
+                if(col.count < LINES * 2)
+                    col.out[col.count++] = smp;
+            }, &got);
+            pos += piece;
+        }
+
+        // In order: an undamaged line must be the next sample; a damaged one
+        // may be missing or read as something else.
+        auto same = [](const TextSample& a, const TextSample& b){
+            return memcmp(a.angles, b.angles, sizeof(a.angles)) == 0 && memcmp(a.fingers, b.fingers, sizeof(a.fingers)) == 0;
+        };
+        size_t next { 0 };
+        for(size_t line{0}; line<LINES; line++){
+            if(!damaged[line]){
+                clean++;
+                if(next < got.count && same(got.out[next], expected[line]))
+                    next++;
+                else
+                    mismatches++;
+                continue;
+            }
+            corrupted++;
+            size_t undamaged { line + 1 };
+            while(undamaged < LINES && damaged[undamaged])
+                undamaged++;
+            const bool taken { next < got.count && (undamaged == LINES || !same(got.out[next], expected[undamaged])) };
+            if(taken)
+                next++;
+            else
+                rejected++;
+        }
+        mismatches += static_cast<uint32_t>(got.count - next);
+
+        for(uint32_t trial{0}; trial<100000; trial++){
+            char        text[40];
+            const char* forms[] { "%.2f", "%.6f", "%.3e", "%.9g", "%.1f" };
+            const double val { (static_cast<double>(rnd()) - 8388608.0) * pow(10.0, static_cast<int>(rnd() % 16) - 8) };
+            snprintf(text, sizeof(text), forms[trial % 5], val);
+            const char* pos { text };
+            float       fast;
+            if(!parseTextFloat(pos, text + strlen(text), fast) || *pos != '\0'){
+                mismatches++;
+                continue;
+            }
+            const float ref { strtof(text, nullptr) };
+            int32_t a, b;
+            memcpy(&a, &fast, 4);
+            memcpy(&b, &ref, 4);
+            const uint32_t ulp { static_cast<uint32_t>(abs(a - b)) };
+            worstUlp = std::max(worstUlp, ulp);
+        }
+
+        delete[] got.out;
+        delete[] stream;
+        delete[] damaged;
+        delete[] expected;
+        return mismatches;
+    }
+
+} // End namespace glove
+
+namespace {
+
+    const size_t   NAME_LEN           { 32 };
+    const uint32_t ALIGN_TOLERANCE_US { 3000 },      // a tenth of the link jitter
+                   SYNC_TOLERANCE_US  { 3000 };
+
+    uint32_t failures { 0 };
+
+    // Prints the outcome of a self check, marked and counted when it fails.
+    __attribute__((format(printf, 2, 3)))
+    void check(bool passed, const char* format, ...){
+        va_list args;
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+        printf(passed ? "\n" : "  FAILED\n");
+        failures += passed ? 0 : 1;
+    }
+
+    struct Baseline{
+        char     name[NAME_LEN];
+        double   nsPerCall;
+    };
+
+    size_t loadBaseline(const char* path, Baseline* base, size_t max){
+        FILE* in { fopen(path, "r") };
+        if(in == nullptr)
+            return 0;
+
+        char   line[128];
+        size_t count { 0 };
+        while(count < max && fgets(line, sizeof(line), in) != nullptr){
+            if(line[0] == '#')
+                continue;
+            // "<name with spaces> <ns>": the number is the last field.
+            char* sep { strrchr(line, ' ') };
+            if(sep == nullptr)
+                continue;
+            *sep = '\0';
+            snprintf(base[count].name, NAME_LEN, "%.31s", line);
+            base[count].nsPerCall = strtod(sep + 1, nullptr);
+            count++;
+        }
+
+        fclose(in);
+        return count;
+    }
+
+} // End anonymous namespace
+
+int main(int argc, char** argv){
+    const char* baselinePath { "bench/baseline.txt" };
+    bool        writeBase    { false };
+
+    for(int i{1}; i<argc; i++){
+        if(strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if(strcmp(argv[i], "-w") == 0)
+            writeBase = true;
+    }
+
+    glove::GloveBench::Result results[glove::GloveBench::STAGES];
+    glove::GloveBench*        bench { new glove::GloveBench(200000) };
+    const size_t              count { bench->run(results) };
+
+    const int curveDiff { bench->curveDeviation() };
+    check(curveDiff <= 1, "LEGACY_LOG curve vs normalizeStatus(): max deviation %d", curveDiff);
+    const float chainDeg { bench->chainDeviation() };
+    check(chainDeg < 0.1f, "kinematic chain vs reference rotations: max error %.4f deg", chainDeg);
+    const uint32_t topologyErrors { bench->topologyMismatches() };
+    check(topologyErrors == 0, "topology checks vs faulty tables and stage names: %u mismatches", topologyErrors);
+    const uint32_t schedulerErrors { bench->schedulerMismatches() };
+    check(schedulerErrors == 0, "scheduler vs fake clock across the wrap: %u mismatches", schedulerErrors);
+    uint32_t ringPopped { 0 }, ringDropped { 0 };
+    const uint32_t ringErrors { bench->ringMismatches(ringPopped, ringDropped) };
+    check(ringErrors == 0, "snapshot ring vs two threads: %u mismatches, %u popped, %u dropped",
+          ringErrors, ringPopped, ringDropped);
+    float frameSteps { 0.0f };
+    uint32_t frameCrc { 0 }, frameLost { 0 };
+    const uint32_t frameErrors { bench->frameMismatches(frameSteps, frameCrc, frameLost) };
+    check(frameErrors == 0,
+          "binary frames vs random samples: %u mismatches, quaternions within %.3f Q14 step, %u CRC errors, %u lost counted",
+          frameErrors, frameSteps, frameCrc, frameLost);
+    uint32_t profileRejected { 0 };
+    const uint32_t profileErrors { bench->profileMismatches(profileRejected) };
+    check(profileErrors == 0, "calibration records vs every schema version: %u mismatches, %u damaged records refused",
+          profileErrors, profileRejected);
+    const uint32_t statusErrors { bench->statusMismatches() };
+    check(statusErrors == 0, "status view vs changed glyphs: %u mismatches", statusErrors);
+    uint32_t debounceDelay { 0 };
+    const uint32_t debounceErrors { bench->debounceMismatches(debounceDelay) };
+    check(debounceErrors == 0 && debounceDelay <= 10000,
+          "button debouncer vs bouncing edges: %u mismatches, event %u us after the first edge at most",
+          debounceErrors, debounceDelay);
+    float deltaDeg { 0.0f }, deltaBytes { 0.0f };
+    const uint32_t deltaErrors { bench->deltaMismatches(deltaDeg, deltaBytes) };
+    check(deltaErrors == 0 && deltaBytes < 0.5f,
+          "delta stream vs full state: %u samples past the deadband, worst %.3f deg, %.0f%% of the full frame bytes",
+          deltaErrors, deltaDeg, deltaBytes * 100.0f);
+    uint32_t commandAnswers { 0 }, commandCrc { 0 };
+    const uint32_t commandErrors { bench->commandMismatches(commandAnswers, commandCrc) };
+    check(commandErrors == 0, "command parser vs noisy link: %u mismatches, %u pings answered, %u false frames skipped",
+          commandErrors, commandAnswers, commandCrc);
+    uint32_t calibSteps { 0 }, calibFrames { 0 };
+    const uint32_t calibErrors { bench->calibrationMismatches(calibSteps, calibFrames) };
+    check(calibErrors == 0, "calibration state machine vs buttons and requests: %u mismatches, %u steps, %u frames flagged",
+          calibErrors, calibSteps, calibFrames);
+    const uint32_t rawSwitchErrors { bench->rawSwitchMismatches() };
+    check(rawSwitchErrors == 0, "raw mode switch vs an IMU refusing it: %u mismatches", rawSwitchErrors);
+    uint32_t sessionRecords, sessionCrc;
+    const uint32_t sessionErrors { bench->sessionStreamMismatches(sessionRecords, sessionCrc) };
+    check(sessionErrors == 0, "session stream vs the tap: %u mismatches, %u records, %u damaged",
+          sessionErrors, sessionRecords, sessionCrc);
+    const uint32_t alignSlow { bench->alignmentError(-100) },
+                   alignFast { bench->alignmentError(100) };
+    check(std::max(alignSlow, alignFast) <= ALIGN_TOLERANCE_US,
+          "hub clock alignment vs jittery link: worst %u us at -100 ppm, %u us at +100 ppm", alignSlow, alignFast);
+    uint32_t textClean { 0 }, textDamaged { 0 }, textRejected { 0 }, textUlp { 0 };
+    const uint32_t textErrors { bench->textMismatches(textClean, textDamaged, textRejected, textUlp) };
+    check(textErrors == 0 && textUlp <= 1,
+          "text parser vs strtof: %u mismatches on %u clean frames, %u of %u damaged turned down, floats within %u ulp",
+          textErrors, textClean, textRejected, textDamaged, textUlp);
+    float driftErr[2] { 0.0f, 0.0f };
+    const uint32_t syncSlow { bench->syncError(-100, driftErr[0]) },
+                   syncFast { bench->syncError(100, driftErr[1]) };
+    check(std::max(syncSlow, syncFast) <= SYNC_TOLERANCE_US && std::max(driftErr[0], driftErr[1]) <= 30.0f,
+          "time sync vs asymmetric link: worst %u us at -100 ppm, %u us at +100 ppm, drift within %.1f ppm",
+          syncSlow, syncFast, std::max(driftErr[0], driftErr[1]));
+    uint32_t delayDelivered { 0 };
+    const uint32_t delayErrors { bench->delayLineMismatches(delayDelivered) };
+    check(delayErrors == 0 && delayDelivered > 0,
+          "latency loopback delay line vs clock sign change and wrap: %u mismatches, %u writes released",
+          delayErrors, delayDelivered);
+    float holdDeg { 0.0f };
+    const float predictDeg { bench->predictionError(50000, holdDeg) };
+    check(predictDeg < 2.5f && predictDeg < holdDeg / 2.0f,
+          "pose predictor vs swinging hand: mean %.2f deg 50 ms ahead, %.2f deg showing the newest frame",
+          predictDeg, holdDeg);
+    const float rawRms { bench->filterError(glove::ADC_FILTER_NONE) },
+                filtered[3] { bench->filterError(glove::ADC_FILTER_LOWPASS), bench->filterError(glove::ADC_FILTER_MEDIAN),
+                              bench->filterError(glove::ADC_FILTER_ONE_EURO) };
+    // Each must take at least this share of the error away.
+    const float minCut[3] { 0.5f, 0.75f, 0.3f };
+    bool        cut       { true };
+    for(size_t idx{0}; idx<3; idx++)
+        cut = cut && filtered[idx] <= rawRms * (1.0f - minCut[idx]);
+    check(cut, "finger filters vs clean flex: rms none %.1f, lowpass %.1f, median %.1f, one euro %.1f counts",
+          rawRms, filtered[0], filtered[1], filtered[2]);
+    const float stepShare { bench->continuousStepShare() };
+    check(fabsf(stepShare - 0.632f) < 0.1f,
+          "continuous finger readings faster than asked, 20 Hz low pass: %.0f%% of a step after one time constant",
+          stepShare * 100.0f);
+
+    Baseline     base[glove::GloveBench::STAGES];
+    const size_t baseCount { loadBaseline(baselinePath, base, glove::GloveBench::STAGES) };
+
+    printf("%-20s %12s %10s %12s %10s\n", "stage", "ns/call", "allocs", "bytes/call", "vs base");
+    for(size_t i{0}; i<count; i++){
+        const glove::GloveBench::Result& res { results[i] };
+        printf("%-20s %12.1f %10.2f %12.1f", res.name, res.nsPerCall, res.allocsPerCall, res.bytesPerCall);
+        for(size_t b{0}; b<baseCount; b++)
+            if(strcmp(base[b].name, res.name) == 0 && base[b].nsPerCall > 0)
+                printf(" %+9.1f%%", (res.nsPerCall - base[b].nsPerCall) * 100.0 / base[b].nsPerCall);
+        printf("\n");
+    }
+
+    if(writeBase){
+        FILE* out { fopen(baselinePath, "w") };
+        if(out == nullptr){
+            perror("fopen");
+            return 1;
+        }
+        fprintf(out, "# glove_bench baseline: stage ns/call\n");
+        for(size_t i{0}; i<count; i++)
+            fprintf(out, "%s %.1f\n", results[i].name, results[i].nsPerCall);
+        fclose(out);
+    }
+
+    delete bench;
+    if(failures > 0){
+        fprintf(stderr, "%u self checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,271 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+// Host tool: sends one command of include/command.h to the glove on a serial
+// port or an RFCOMM device, waits for its response among the telemetry and
+// prints it. Requests are retried on timeout, as a bad CRC gets no answer.
+//
+// Usage: glove_ctl device command [args]
+//
+//   ping [text]                         round trip time
+//   rate fingers|imus|output|display us task period
+//   format text|binary|delta|session    output format; session needs -DGLOVE_SESSION_STREAM
+//   delta deg counts stale_us key_us    delta stream deadbands and refreshes
+//   sensitivity percent                 finger closed threshold
+//   bus hz                              I2C clock
+//   fusion complementary|madgwick gain  IMU_RAW filter and gain
+//   calibrate fingers|arm|confirm       start a calibration or confirm its step
+//   stats                               stage timings, see glove_decode -s
+//   dump                                flight recorder dump on the serial port
+//   read-calib user [file]              prints the profile, saves the record to 'file'
+//   write-calib file                    stores a record saved by read-calib
+//   user n                              switches to profile 'n'
+//   identity                            device id, wearer, hand, name
+//   set-identity id wearer left|right name  Bluetooth name from the next boot
+
+#include <command.h>
+#include <profiler.h>
+#include <calibration.h>
+#include <identity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+    const int      RETRIES    { 3 },
+                   TIMEOUT_MS { 500 };
+
+    int find(const char* name, const char* const* names, int count){
+        for(int idx{0}; idx<count; idx++)
+            if(strcmp(name, names[idx]) == 0)
+                return idx;
+        return -1;
+    }
+
+    // Builds the payload of 'verb' from the arguments; false on bad usage.
+    bool request(const char* verb, int argc, char** argv, uint8_t& id, uint8_t* payload, size_t& len){
+        static const char* const TASKS[]   { "fingers", "imus", "output", "display" };
+        static const char* const FORMATS[] { "text", "binary", "delta", "session" };
+        static const char* const ACTIONS[] { "none", "fingers", "arm", "confirm" };
+        static const char* const HANDS[]   { "unknown", "left", "right" };
+        static const char* const FILTERS[] { "complementary", "madgwick" };
+        len = 0;
+
+        if(strcmp(verb, "ping") == 0){
+            id  = glove::CMD_PING;
+            len = argc > 0 ? strnlen(argv[0], glove::CMD_MAX_PAYLOAD) : 0;
+            memcpy(payload, argc > 0 ? argv[0] : "", len);
+        } else if(strcmp(verb, "rate") == 0 && argc == 2 && find(argv[0], TASKS, 4) >= 0){
+            id         = glove::CMD_SET_RATE;
+            payload[0] = static_cast<uint8_t>(find(argv[0], TASKS, 4));
+            glove::put32(payload + 1, static_cast<uint32_t>(strtoul(argv[1], nullptr, 10)));
+            len        = 5;
+        } else if(strcmp(verb, "format") == 0 && argc == 1 && find(argv[0], FORMATS, 4) >= 0){
+            id         = glove::CMD_SET_FORMAT;
+            payload[0] = static_cast<uint8_t>(find(argv[0], FORMATS, 4));
+            len        = 1;
+        } else if(strcmp(verb, "delta") == 0 && argc == 4){
+            id         = glove::CMD_SET_DELTA;
+            glove::put16(payload, static_cast<uint16_t>(strtod(argv[0], nullptr) * 100.0 + 0.5));
+            payload[2] = static_cast<uint8_t>(strtoul(argv[1], nullptr, 10));
+            glove::put32(payload + 3, static_cast<uint32_t>(strtoul(argv[2], nullptr, 10)));
+            glove::put32(payload + 7, static_cast<uint32_t>(strtoul(argv[3], nullptr, 10)));
+            len        = 11;
+        } else if(strcmp(verb, "sensitivity") == 0 && argc == 1){
+            id         = glove::CMD_SET_SENSITIVITY;
+            payload[0] = static_cast<uint8_t>(strtoul(argv[0], nullptr, 10));
+            len        = 1;
+        } else if(strcmp(verb, "bus") == 0 && argc == 1){
+            id         = glove::CMD_SET_BUS_SPEED;
+            glove::put32(payload, static_cast<uint32_t>(strtoul(argv[0], nullptr, 10)));
+            len        = 4;
+        } else if(strcmp(verb, "fusion") == 0 && argc == 2 && find(argv[0], FILTERS, 2) >= 0){
+            id         = glove::CMD_SET_FUSION;
+            payload[0] = static_cast<uint8_t>(find(argv[0], FILTERS, 2));
+            glove::put16(payload + 1, static_cast<uint16_t>(strtod(argv[1], nullptr) * 1000.0 + 0.5));
+            len        = 3;
+        } else if(strcmp(verb, "calibrate") == 0 && argc == 1 && find(argv[0], ACTIONS, 4) > 0){
+            id         = glove::CMD_CALIBRATE;
+            payload[0] = static_cast<uint8_t>(find(argv[0], ACTIONS, 4));
+            len        = 1;
+        } else if(strcmp(verb, "stats") == 0){
+            id         = glove::CMD_GET_STATS;
+        } else if(strcmp(verb, "dump") == 0){
+            id         = glove::CMD_FLIGHT_DUMP;
+        } else if(strcmp(verb, "read-calib") == 0 && argc >= 1){
+            id         = glove::CMD_READ_CALIB;
+            payload[0] = static_cast<uint8_t>(strtoul(argv[0], nullptr, 10));
+            len        = 1;
+        } else if(strcmp(verb, "write-calib") == 0 && argc == 1){
+            FILE* in { fopen(argv[0], "rb") };
+            if(in == nullptr){
+                perror(argv[0]);
+                return false;
+            }
+            id  = glove::CMD_WRITE_CALIB;
+            len = fread(payload, 1, glove::CMD_MAX_PAYLOAD, in);
+            fclose(in);
+        } else if(strcmp(verb, "user") == 0 && argc == 1){
+            id         = glove::CMD_SELECT_USER;
+            payload[0] = static_cast<uint8_t>(strtoul(argv[0], nullptr, 10));
+            len        = 1;
+        } else if(strcmp(verb, "identity") == 0){
+            id         = glove::CMD_GET_IDENTITY;
+        } else if(strcmp(verb, "set-identity") == 0 && argc == 4 && find(argv[2], HANDS, 3) >= 0){
+            glove::DeviceIdentity ident;
+            ident.deviceId = static_cast<uint16_t>(strtoul(argv[0], nullptr, 10));
+            ident.wearer   = static_cast<uint8_t>(strtoul(argv[1], nullptr, 10));
+            ident.hand     = static_cast<uint8_t>(find(argv[2], HANDS, 3));
+            strncpy(ident.name, argv[3], glove::IDENT_NAME);
+            id         = glove::CMD_SET_IDENTITY;
+            len        = glove::encodeIdentity(ident, payload);
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    void printResponse(const glove::Command& rsp, int argc, char** argv){
+        switch(rsp.id){
+            case glove::CMD_PING:
+                printf("pong: %.*s\n", rsp.length, reinterpret_cast<const char*>(rsp.payload));
+                break;
+            case glove::CMD_GET_STATS: {
+                glove::StatsDecoder decoder;
+                glove::StatsReport  rep;
+                for(size_t pos{0}; pos<rsp.length; pos++){
+                    if(!decoder.push(rsp.payload[pos], rep))
+                        continue;
+                    printf("stats: %.3f s window\n", rep.windowUs / 1e6);
+                    for(size_t idx{0}; idx<rep.stageCount; idx++)
+                        printf("  %-14s %8u calls, us mean %.1f p99 %.1f max %.1f\n", glove::stageName(idx),
+                               rep.stages[idx].count, rep.stages[idx].meanNs / 1e3, rep.stages[idx].p99Ns / 1e3,
+                               rep.stages[idx].maxNs / 1e3);
+                }
+                break;
+            }
+            case glove::CMD_READ_CALIB: {
+                glove::CalibrationProfile prof;
+                if(!glove::decodeProfile(rsp.payload, rsp.length, prof)){
+                    printf("bad calibration record\n");
+                    break;
+                }
+                printf("user %u, fingers", prof.user);
+                for(size_t idx{0}; idx<glove::CALIB_FINGERS; idx++)
+                    printf(" %u-%u", prof.fingerMin[idx], prof.fingerMax[idx]);
+                printf(", %u curve points\n", prof.pointCount);
+                if(argc < 2)
+                    break;
+                FILE* out { fopen(argv[1], "wb") };
+                if(out == nullptr || fwrite(rsp.payload, 1, rsp.length, out) != rsp.length)
+                    perror(argv[1]);
+                if(out != nullptr)
+                    fclose(out);
+                break;
+            }
+            case glove::CMD_GET_IDENTITY: {
+                static const char* const HANDS[] { "unknown", "left", "right" };
+                glove::DeviceIdentity ident;
+                if(glove::decodeIdentity(rsp.payload, rsp.length, ident))
+                    printf("device %u, wearer %u, %s hand, name %s\n", ident.deviceId, ident.wearer,
+                           HANDS[ident.hand], ident.name);
+                else
+                    printf("bad identity record\n");
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+} // End anonymous namespace
+
+int main(int argc, char** argv){
+    static const char* const STATUS[] { "ok", "unknown command", "bad arguments", "failed" };
+
+    uint8_t id;
+    uint8_t payload[glove::CMD_MAX_PAYLOAD];
+    size_t  len;
+    if(argc < 3 || !request(argv[2], argc - 3, argv + 3, id, payload, len)){
+        fprintf(stderr, "Usage: %s device ping|rate|format|delta|sensitivity|bus|fusion|calibrate|stats|dump|"
+                        "read-calib|write-calib|user|identity|set-identity [args]\n", argv[0]);
+        return 1;
+    }
+
+    const int fd { open(argv[1], O_RDWR | O_NOCTTY) };
+    if(fd < 0){
+        perror("open");
+        return 1;
+    }
+    if(isatty(fd)){
+        termios tio{};
+        tcgetattr(fd, &tio);
+        cfmakeraw(&tio);
+        cfsetspeed(&tio, B115200);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    // The tag tells this answer from a late one to an earlier run.
+    const uint8_t       tag { static_cast<uint8_t>(getpid()) };
+    uint8_t             frame[glove::CMD_OVERHEAD + glove::CMD_MAX_PAYLOAD];
+    const size_t        size { glove::encodeCommand(id, tag, payload, len, frame) };
+    glove::CommandParser parser { true };
+
+    for(int attempt{0}; attempt<RETRIES; attempt++){
+        const auto start { std::chrono::steady_clock::now() };
+        if(write(fd, frame, size) != static_cast<ssize_t>(size)){
+            perror("write");
+            break;
+        }
+
+        pollfd  pfd { fd, POLLIN, 0 };
+        uint8_t buffer[256];
+        while(poll(&pfd, 1, TIMEOUT_MS) > 0){
+            const ssize_t got { read(fd, buffer, sizeof(buffer)) };
+            if(got <= 0)
+                break;
+            for(ssize_t i{0}; i<got; i++){
+                for(auto res{parser.push(buffer[i])}; res != glove::CommandParser::PARSE_MORE; res = parser.next()){
+                    if(res != glove::CommandParser::PARSE_READY)
+                        continue;
+                    const glove::Command& rsp { parser.command() };
+                    if(rsp.id != id || rsp.tag != tag)
+                        continue;
+
+                    const double ms { std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() };
+                    printf("%s, %.1f ms\n", rsp.status < 4 ? STATUS[rsp.status] : "?", ms);
+                    if(rsp.status == glove::CMD_OK)
+                        printResponse(rsp, argc - 3, argv + 3);
+                    close(fd);
+                    return rsp.status == glove::CMD_OK ? 0 : 2;
+                }
+            }
+        }
+        fprintf(stderr, "no response, %s\n", attempt + 1 < RETRIES ? "retrying" : "giving up");
+    }
+
+    close(fd);
+    return 3;
+}
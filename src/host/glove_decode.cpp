@@ -0,0 +1,166 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+// Host tool: decodes the binary telemetry stream read from a serial port,
+// an RFCOMM device or a capture file (stdin if none) and prints one line per frame;
+// a delta stream (include/delta_stream.h) is printed as the state after each frame.
+// A flight recorder dump (include/flight_recorder.h) found in the stream is
+// printed one line per entry, a stats report (include/profiler.h) as a table,
+// a button event (include/buttons.h) as a line starting with B.
+//
+// Usage: glove_decode [-s seconds] [device_or_file]
+//
+// -s asks the glove for a stats report every 'seconds' on the device.
+
+#include <telemetry.h>
+#include <delta_stream.h>
+#include <flight_recorder.h>
+#include <profiler.h>
+#include <buttons.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <cstdio>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+    void printStats(const glove::StatsReport& rep){
+        printf("stats: %.3f s window%s\n", rep.windowUs / 1e6, rep.stageCount == 0 ? ", profiling not built in" : "");
+        for(size_t idx{0}; idx<rep.stageCount; idx++){
+            const glove::StageSummary& st { rep.stages[idx] };
+            printf("  %-14s %8u calls, us min %.1f mean %.1f p99 %.1f max %.1f", glove::stageName(idx), st.count,
+                   st.minNs / 1e3, st.meanNs / 1e3, st.p99Ns / 1e3, st.maxNs / 1e3);
+            if(idx == glove::STAGE_FRAME && st.meanNs > 0)
+                printf(", %.1f frames/s", 1e9 / st.meanNs);
+            printf("\n");
+        }
+    }
+
+    void printButtons(const glove::ButtonEvent& ev){
+        static const char* const KINDS[] { "press", "release", "long", "chord" };
+        printf("B %10u %-7s %u%u%u held %u%u%u\n", ev.atUs, KINDS[ev.kind],
+               ev.buttons & glove::BTN_LEFT ? 1 : 0, ev.buttons & glove::BTN_MIDDLE ? 1 : 0, ev.buttons & glove::BTN_RIGHT ? 1 : 0,
+               ev.held    & glove::BTN_LEFT ? 1 : 0, ev.held    & glove::BTN_MIDDLE ? 1 : 0, ev.held    & glove::BTN_RIGHT ? 1 : 0);
+    }
+
+} // End anonymous namespace
+
+int main(int argc, char** argv){
+    int         fd       { STDIN_FILENO };
+    const char* path     { nullptr };
+    long        interval { 0 };
+
+    for(int i{1}; i<argc; i++){
+        if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            interval = strtol(argv[++i], nullptr, 10);
+        else
+            path = argv[i];
+    }
+
+    if(path != nullptr){
+        fd = open(path, (interval > 0 ? O_RDWR : O_RDONLY) | O_NOCTTY);
+        if(fd < 0){
+            perror("open");
+            return 1;
+        }
+        if(isatty(fd)){
+            termios tio{};
+            tcgetattr(fd, &tio);
+            cfmakeraw(&tio);
+            cfsetspeed(&tio, B115200);
+            tcsetattr(fd, TCSANOW, &tio);
+        }
+    }
+
+    glove::DeltaDecoder      decoder;
+    glove::FlightDumpDecoder flight;
+    glove::StatsDecoder      stats;
+    glove::StatsReport       report;
+    glove::ButtonEventDecoder buttons;
+    glove::ButtonEvent       event;
+    glove::TelemetrySample   sample;
+    time_t                   asked   { 0 };
+    uint8_t                  buffer[512];
+    ssize_t                  len;
+
+    while((len = read(fd, buffer, sizeof(buffer))) > 0){
+        if(interval > 0 && fd != STDIN_FILENO && time(nullptr) - asked >= interval){
+            if(write(fd, &glove::STATS_REQUEST, 1) != 1)
+                perror("write");
+            asked = time(nullptr);
+        }
+
+        for(ssize_t i{0}; i<len; i++){
+            if(stats.push(buffer[i], report))
+                printStats(report);
+            if(buttons.push(buffer[i], event))
+                printButtons(event);
+
+            switch(flight.push(buffer[i])){
+                case glove::FlightDumpDecoder::FLIGHT_HEADER_READY:
+                    printf("flight recorder: %u entries, frozen at %u us, %u recorded\n", flight.header().entries,
+                           flight.header().frozenUs, flight.header().recorded);
+                    break;
+                case glove::FlightDumpDecoder::FLIGHT_ENTRY_READY: {
+                    const glove::FlightEntry& entry { flight.entry() };
+                    printf("F %10u %s %02x %5u %5u %3u %3u", entry.timestampUs,
+                           entry.kind == glove::FLIGHT_IMUS_STEP ? "imus   " : "fingers",
+                           entry.flags, entry.periodUs, entry.runUs, entry.busErrors, entry.busRecoveries);
+                    if(entry.kind == glove::FLIGHT_IMUS_STEP)
+                        for(const auto& quat: entry.quat)
+                            printf(" [%+.4f %+.4f %+.4f %+.4f]", quat.w, quat.x, quat.y, quat.z);
+                    else
+                        for(const auto val: entry.adc)
+                            printf(" %4u", val);
+                    printf("\n");
+                    break;
+                }
+                case glove::FlightDumpDecoder::FLIGHT_DONE:
+                    printf("flight recorder: end, crc %s\n", flight.crcOk() ? "ok" : "error");
+                    break;
+                default:
+                    break;
+            }
+
+            if(!decoder.push(buffer[i], sample))
+                continue;
+
+            printf("%5u %10u %02x", sample.seq, sample.timestampUs, sample.flags);
+            for(const auto& quat: sample.quat)
+                printf(" [%+.4f %+.4f %+.4f %+.4f]", quat[0], quat[1], quat[2], quat[3]);
+            for(const auto finger: sample.fingers)
+                printf(" %2u", finger);
+            printf(" %u%u%u\n", sample.buttons & glove::BTN_LEFT   ? 1 : 0,
+                                sample.buttons & glove::BTN_MIDDLE ? 1 : 0,
+                                sample.buttons & glove::BTN_RIGHT  ? 1 : 0);
+        }
+    }
+
+    fprintf(stderr, "frames: %u (%u deltas) crc errors: %u dropped bytes: %u lost frames: %u\n",
+            decoder.keyframes() + decoder.deltas(), decoder.deltas(), decoder.crcErrors(),
+            decoder.droppedBytes(), decoder.lostFrames());
+
+    if(fd != STDIN_FILENO)
+        close(fd);
+
+    return 0;
+}
@@ -0,0 +1,453 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+// Host hub: reads several gloves at once (serial ports, RFCOMM devices or
+// pseudo terminals), puts their samples on the host clock and sends every
+// period one frame with the state of all of them, time aligned, to the
+// programs connected to a local socket; format in include/hub_frame.h.
+// Single threaded on epoll; the frames are written once in a ring the
+// subscribers are sent from, at their own pace.
+//
+// Usage: glove_hub [-l socket] [-p period_us] [-a align_us] [-s stale_us] [-d] [-t seconds] device...
+//
+// -l  subscriber socket, /tmp/glove_hub.sock by default
+// -p  output period, 10000 us
+// -a  how far back the frames look, to wait for the late samples, 20000 us
+// -s  how long without samples a glove is marked stale, 250000 us
+// -d  asks the gloves for the delta stream instead of the binary one
+// -t  exits after 'seconds', otherwise on SIGINT or SIGTERM
+//
+// At start and every second until they answer the gloves are sent
+// CMD_SET_FORMAT and CMD_GET_IDENTITY (include/command.h), every 250 ms
+// CMD_TIME_SYNC: once a few are answered the samples are put on the host
+// clock from those (include/time_sync.h), before that and for firmware
+// without it from their arrival times (ClockAligner, hub_frame.h).
+
+#include <telemetry.h>
+#include <delta_stream.h>
+#include <command.h>
+#include <identity.h>
+#include <hub_frame.h>
+#include <time_sync.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+    const size_t   HISTORY         { 16 },              // samples kept per glove, for the alignment
+                   RING_SIZE       { 1 << 20 },
+                   MAX_SUBSCRIBERS { 256 },
+                   MAX_EVENTS      { 64 };
+    const uint32_t RETRY_US        { 1000000 },
+                   SYNC_US         { 250000 },
+                   SYNC_SETTLE     { 8 };               // exchanges before TimeSync takes over
+
+    volatile sig_atomic_t stopRequested { 0 };
+
+    void watch(int epfd, int op, int fd, uint32_t events, void* ptr){
+        epoll_event ev {};
+        ev.events   = events;
+        ev.data.ptr = ptr;
+        epoll_ctl(epfd, op, fd, &ev);
+    }
+
+    uint32_t nowUs(void){
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint32_t>(ts.tv_sec * 1000000ull + ts.tv_nsec / 1000);
+    }
+
+    bool before(uint32_t a, uint32_t b){
+        return static_cast<int32_t>(a - b) <= 0;
+    }
+
+    struct Timed{
+        uint32_t               hostUs;
+        glove::TelemetrySample sample;
+    };
+
+    struct Source{
+        const char*            path        { nullptr };
+        int                    fd          { -1 };
+        glove::DeltaDecoder    decoder;
+        glove::CommandParser   responses   { true };
+        glove::ClockAligner    clock;
+        glove::TimeSync        sync;
+        bool                   syncing     { true };         // false once CMD_TIME_SYNC is unknown
+        glove::DeviceIdentity  ident;
+        bool                   identified  { false },
+                               formatted   { false };
+        uint32_t               askedUs     { 0 },
+                               syncedUs    { 0 },
+                               lastRxUs    { 0 };
+        uint8_t                tag         { 0 };
+        Timed                  history[HISTORY];
+        uint64_t               received    { 0 },            // samples, history[received % HISTORY] is next
+                               emitted     { 0 };            // 'received' of the last sample in a frame
+    };
+
+    struct Subscriber{
+        int                    fd          { -1 };
+        uint64_t               pos         { 0 };            // next ring byte to send
+        bool                   waiting     { false };        // EPOLLOUT armed
+        uint32_t               skips       { 0 };
+    };
+
+    // Frames are written once; each subscriber has its position in them and
+    // is sent straight from the ring. One too slow to keep within the ring
+    // jumps to the newest frame.
+    class FanOut{
+
+        public:
+
+            explicit   FanOut(int epollFd)                     : epfd{epollFd} {}
+
+            void       publish(const uint8_t* data, size_t len);
+            bool       flush(Subscriber& sub);
+            uint64_t   bytes(void)                       const { return head; }
+
+        private:
+
+            int        epfd;
+            uint8_t    ring[RING_SIZE] {};
+            uint64_t   head            { 0 },
+                       lastFrame       { 0 };
+    };
+
+    void FanOut::publish(const uint8_t* data, size_t len){
+        const size_t at    { head % RING_SIZE },
+                     first { len < RING_SIZE - at ? len : RING_SIZE - at };
+        memcpy(ring + at, data, first);
+        memcpy(ring, data + first, len - first);
+        lastFrame = head;
+        head     += len;
+    }
+
+    // False when the subscriber is gone.
+    bool FanOut::flush(Subscriber& sub){
+        if(head - sub.pos > RING_SIZE){
+            sub.pos = lastFrame;
+            sub.skips++;
+        }
+
+        while(sub.pos != head){
+            const size_t at    { sub.pos % RING_SIZE },
+                         pend  { static_cast<size_t>(head - sub.pos) },
+                         first { pend < RING_SIZE - at ? pend : RING_SIZE - at };
+            iovec         iov[2] { { ring + at, first }, { ring, pend - first } };
+            const ssize_t sent { writev(sub.fd, iov, pend > first ? 2 : 1) };
+            if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                break;
+            if(sent <= 0)
+                return false;
+            sub.pos += static_cast<uint64_t>(sent);
+        }
+
+        const bool wait { sub.pos != head };
+        if(wait != sub.waiting){
+            watch(epfd, EPOLL_CTL_MOD, sub.fd, EPOLLIN | (wait ? EPOLLOUT : 0u), &sub);
+            sub.waiting = wait;
+        }
+        return true;
+    }
+
+    void request(Source& src, uint8_t id, const uint8_t* payload, size_t len){
+        uint8_t frame[glove::CMD_OVERHEAD + glove::CMD_MAX_PAYLOAD];
+        const size_t size { glove::encodeCommand(id, ++src.tag, payload, len, frame) };
+        if(write(src.fd, frame, size) != static_cast<ssize_t>(size))
+            fprintf(stderr, "%s: command not sent\n", src.path);
+    }
+
+    void readSource(Source& src){
+        uint8_t buffer[4096];
+        ssize_t len;
+        while((len = read(src.fd, buffer, sizeof(buffer))) > 0){
+            const uint32_t rx { nowUs() };
+            src.lastRxUs = rx;
+            for(ssize_t i{0}; i<len; i++){
+                for(auto res{src.responses.push(buffer[i])}; res != glove::CommandParser::PARSE_MORE; res = src.responses.next()){
+                    if(res != glove::CommandParser::PARSE_READY)
+                        continue;
+                    const glove::Command& rsp { src.responses.command() };
+                    if(rsp.id == glove::CMD_GET_IDENTITY && rsp.status == glove::CMD_OK)
+                        src.identified = glove::decodeIdentity(rsp.payload, rsp.length, src.ident);
+                    else if(rsp.id == glove::CMD_SET_FORMAT)
+                        src.formatted = rsp.status == glove::CMD_OK;
+                    else if(rsp.id == glove::CMD_TIME_SYNC && rsp.status == glove::CMD_UNKNOWN)
+                        src.syncing = false;
+                    else if(rsp.id == glove::CMD_TIME_SYNC && rsp.length == glove::SYNC_RESPONSE_SIZE)
+                        src.sync.add(glove::get32(rsp.payload), glove::get32(rsp.payload + 4),
+                                     glove::get32(rsp.payload + 8), rx);
+                }
+
+                Timed& next { src.history[src.received % HISTORY] };
+                if(!src.decoder.push(buffer[i], next.sample))
+                    continue;
+                next.hostUs = src.clock.toHost(next.sample.timestampUs, rx);
+                if(src.sync.exchanges() >= SYNC_SETTLE)
+                    next.hostUs = src.sync.toHost(next.sample.timestampUs);
+                src.received++;
+            }
+        }
+        if(len == 0 || (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK)){
+            fprintf(stderr, "%s: closed\n", src.path);
+            close(src.fd);
+            src.fd = -1;
+        }
+    }
+
+    // The slot of 'src' in the frame for 'atUs': its last sample taken by then.
+    void fillSlot(Source& src, uint32_t atUs, uint32_t staleUs, glove::HubSlot& slot){
+        slot.deviceId = src.ident.deviceId;
+        slot.wearer   = src.ident.wearer;
+        slot.hand     = src.ident.hand;
+        slot.state    = glove::HUB_EMPTY;
+
+        const uint64_t oldest { src.received > HISTORY ? src.received - HISTORY : 0 };
+        for(uint64_t idx{src.received}; idx>oldest; idx--){
+            const Timed& cand { src.history[(idx - 1) % HISTORY] };
+            if(!before(cand.hostUs, atUs))
+                continue;
+            slot.sample   = cand.sample;
+            slot.sampleUs = cand.hostUs;
+            slot.state    = static_cast<uint8_t>((idx > src.emitted ? glove::HUB_FRESH : 0) |
+                                                 (atUs - cand.hostUs > staleUs ? glove::HUB_STALE : 0));
+            src.emitted   = idx;
+            return;
+        }
+        // All newer than the frame, or older than the history: none to show.
+        if(src.received > 0)
+            slot.state |= glove::HUB_STALE;
+    }
+
+    int listenOn(const char* path){
+        sockaddr_un addr {};
+        addr.sun_family = AF_UNIX;
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+        unlink(path);
+
+        const int fd { socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0) };
+        if(fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 64) < 0){
+            perror(path);
+            return -1;
+        }
+        return fd;
+    }
+
+    int openDevice(const char* path){
+        const int fd { open(path, O_RDWR | O_NOCTTY | O_NONBLOCK) };
+        if(fd < 0){
+            perror(path);
+            return -1;
+        }
+        if(isatty(fd)){
+            termios tio{};
+            tcgetattr(fd, &tio);
+            cfmakeraw(&tio);
+            cfsetspeed(&tio, B115200);
+            tcsetattr(fd, TCSANOW, &tio);
+        }
+        return fd;
+    }
+
+    void onSignal(int){
+        stopRequested = 1;
+    }
+
+} // End anonymous namespace
+
+int main(int argc, char** argv){
+    const char*  socketPath { "/tmp/glove_hub.sock" };
+    uint32_t     periodUs   { 10000 },
+                 alignUs    { 20000 },
+                 staleUs    { 250000 };
+    long         seconds    { 0 };
+    uint8_t      format     { 1 };                    // Glove::BINARY
+    Source*      sources    { new Source[glove::HUB_MAX_GLOVES] };
+    size_t       gloves     { 0 };
+
+    for(int i{1}; i<argc; i++){
+        if(strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+            socketPath = argv[++i];
+        else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            periodUs = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if(strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+            alignUs = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            staleUs = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            seconds = strtol(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-d") == 0)
+            format = 2;                               // Glove::DELTA
+        else if(gloves < glove::HUB_MAX_GLOVES)
+            sources[gloves++].path = argv[i];
+        else
+            fprintf(stderr, "%s: more than %zu gloves, ignored\n", argv[i], glove::HUB_MAX_GLOVES);
+    }
+    if(gloves == 0 || periodUs == 0){
+        fprintf(stderr, "Usage: %s [-l socket] [-p period_us] [-a align_us] [-s stale_us] [-d] [-t seconds] device...\n", argv[0]);
+        return 1;
+    }
+
+    const int epfd     { epoll_create1(0) };
+    const int listenFd { listenOn(socketPath) };
+    int       timerFd  { timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK) };
+    if(epfd < 0 || listenFd < 0 || timerFd < 0)
+        return 1;
+
+    // The pointers in the events tell the sources and subscribers apart from these two.
+    watch(epfd, EPOLL_CTL_ADD, listenFd, EPOLLIN, nullptr);
+    watch(epfd, EPOLL_CTL_ADD, timerFd,  EPOLLIN, &timerFd);
+
+    for(size_t idx{0}; idx<gloves; idx++){
+        Source& src { sources[idx] };
+        src.fd = openDevice(src.path);
+        if(src.fd < 0)
+            return 1;
+        src.ident.deviceId = static_cast<uint16_t>(idx);       // until it answers
+        watch(epfd, EPOLL_CTL_ADD, src.fd, EPOLLIN, &src);
+    }
+
+    const itimerspec period { { 0, static_cast<long>(periodUs) * 1000 }, { 0, static_cast<long>(periodUs) * 1000 } };
+    timerfd_settime(timerFd, 0, &period, nullptr);
+
+    signal(SIGINT,  onSignal);
+    signal(SIGTERM, onSignal);
+    signal(SIGPIPE, SIG_IGN);
+
+    FanOut*          fanOut      { new FanOut(epfd) };
+    Subscriber*      subscribers { new Subscriber[MAX_SUBSCRIBERS] };
+    glove::HubFrame* frame       { new glove::HubFrame() };
+    uint8_t          encoded[glove::HUB_MAX_SIZE];
+    uint32_t         published   { 0 },
+                     overruns    { 0 };
+    const uint32_t   start       { nowUs() };
+    epoll_event      events[MAX_EVENTS];
+
+    frame->gloves = static_cast<uint8_t>(gloves);
+
+    while(stopRequested == 0 && (seconds == 0 || nowUs() - start < seconds * 1000000u)){
+        const int ready { epoll_wait(epfd, events, MAX_EVENTS, 100) };
+
+        for(int e{0}; e<ready; e++){
+            void* const tag { events[e].data.ptr };
+
+            if(tag == nullptr){
+                int fd;
+                while((fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK)) >= 0){
+                    Subscriber* sub { nullptr };
+                    for(size_t idx{0}; idx<MAX_SUBSCRIBERS && sub == nullptr; idx++)
+                        if(subscribers[idx].fd < 0)
+                            sub = &subscribers[idx];
+                    if(sub == nullptr){
+                        close(fd);
+                        continue;
+                    }
+                    *sub = Subscriber{ fd, fanOut->bytes(), false, 0 };
+                    watch(epfd, EPOLL_CTL_ADD, fd, EPOLLIN, sub);
+                }
+            } else if(tag == &timerFd){
+                uint64_t ticks { 0 };
+                if(read(timerFd, &ticks, sizeof(ticks)) != sizeof(ticks))
+                    continue;
+                overruns += static_cast<uint32_t>(ticks - 1);
+
+                const uint32_t now { nowUs() };
+                frame->seq    = static_cast<uint16_t>(published++);
+                frame->hostUs = now - alignUs;
+                for(size_t idx{0}; idx<gloves; idx++){
+                    Source& src { sources[idx] };
+                    fillSlot(src, frame->hostUs, staleUs, frame->slots[idx]);
+                    if(src.fd >= 0 && (!src.identified || !src.formatted) && now - src.askedUs >= RETRY_US){
+                        if(!src.formatted)
+                            request(src, glove::CMD_SET_FORMAT, &format, 1);
+                        if(!src.identified)
+                            request(src, glove::CMD_GET_IDENTITY, nullptr, 0);
+                        src.askedUs = now;
+                    }
+                    if(src.fd >= 0 && src.syncing && now - src.syncedUs >= SYNC_US){
+                        uint8_t sent[glove::SYNC_REQUEST_SIZE];
+                        glove::put32(sent, nowUs());
+                        request(src, glove::CMD_TIME_SYNC, sent, sizeof(sent));
+                        src.syncedUs = now;
+                    }
+                }
+
+                fanOut->publish(encoded, glove::encodeHubFrame(*frame, encoded));
+                for(size_t idx{0}; idx<MAX_SUBSCRIBERS; idx++){
+                    Subscriber& sub { subscribers[idx] };
+                    if(sub.fd >= 0 && !sub.waiting && !fanOut->flush(sub)){
+                        close(sub.fd);
+                        sub.fd = -1;
+                    }
+                }
+            } else if(tag >= sources && tag < sources + gloves){
+                readSource(*static_cast<Source*>(tag));
+            } else {
+                Subscriber& sub { *static_cast<Subscriber*>(tag) };
+                bool        gone { (events[e].events & (EPOLLHUP | EPOLLERR)) != 0 };
+                if(events[e].events & EPOLLIN){
+                    uint8_t discard[256];
+                    gone |= read(sub.fd, discard, sizeof(discard)) == 0;
+                }
+                if(!gone && (events[e].events & EPOLLOUT))
+                    gone = !fanOut->flush(sub);
+                if(gone){
+                    close(sub.fd);
+                    sub.fd = -1;
+                }
+            }
+        }
+    }
+
+    const double elapsed { (nowUs() - start) / 1e6 };
+    fprintf(stderr, "hub: %u frames in %.1f s, %u late ticks, %llu bytes to the subscribers\n", published, elapsed,
+            overruns, static_cast<unsigned long long>(fanOut->bytes()));
+    for(size_t idx{0}; idx<gloves; idx++){
+        const Source& src { sources[idx] };
+        const bool synced { src.sync.exchanges() >= SYNC_SETTLE };
+        fprintf(stderr, "  %s: device %u %s, %llu samples, %u crc errors, %u lost, %u dropped bytes, offset %d us (%s)%s\n",
+                src.path, src.ident.deviceId, src.identified ? src.ident.name : "(no identity)",
+                static_cast<unsigned long long>(src.received), src.decoder.crcErrors(), src.decoder.lostFrames(),
+                src.decoder.droppedBytes(), synced ? src.sync.offsetUs() : src.clock.offsetUs(),
+                synced ? "time sync" : "arrivals", src.fd < 0 ? ", closed" : "");
+    }
+    for(size_t idx{0}; idx<MAX_SUBSCRIBERS; idx++){
+        if(subscribers[idx].fd < 0)
+            continue;
+        if(subscribers[idx].skips > 0)
+            fprintf(stderr, "  subscriber %zu: jumped ahead %u times\n", idx, subscribers[idx].skips);
+        close(subscribers[idx].fd);
+    }
+
+    unlink(socketPath);
+    return 0;
+}
@@ -0,0 +1,440 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+// Host tool: end to end latency of the frames on each link, from the
+// moment the glove took the sample to the moment the host read it. The
+// glove clock is put on the host one with CMD_TIME_SYNC exchanges
+// (include/time_sync.h); every frame is stamped with its host time.
+// Prints per link every interval the latency percentiles, the jitter
+// (RFC 3550 style, of the latency), the clock offset and drift and the
+// best round trip, then a summary.
+//
+// Usage: glove_latency [-p sync_ms] [-i report_s] [-t seconds] [-v] device...
+//        glove_latency -l links [-g delay_ms] [-j jitter_ms] [-q queue_ms] [-r drift_ppm] [-t seconds]
+//
+// -p  time sync period, 250 ms
+// -i  report interval, 1 s
+// -t  duration, until SIGINT by default, 60 s with -l
+// -v  prints each frame: sequence, device time, host time, latency
+// -l  loopback test: synthetic gloves on pseudo terminals, with clocks of
+//     their own off by -r ppm (100), whose bytes take -g ms (5) plus up to
+//     -j ms (10) each way, and whose frames wait up to -q ms (10) to be
+//     sent. Knowing the true latency of every frame it also reports how far
+//     the measured one is from it.
+//
+// The gloves are asked for binary frames (CMD_SET_FORMAT) until they answer.
+
+#include <telemetry.h>
+#include <command.h>
+#include <time_sync.h>
+#include <delay_line.h>
+
+#include <algorithm>
+#include <csignal>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+    const size_t   MAX_LINKS   { 16 },
+                   QUEUE       { 512 };             // loopback: writes held back by the injected delays
+    const uint32_t RETRY_US    { 1000000 },
+                   FRAME_US    { 10000 },           // loopback frame period
+                   SYNC_SETTLE { 8 };               // exchanges before the latency is measured
+
+    volatile sig_atomic_t stopRequested { 0 };
+
+    uint32_t nowUs(void){
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint32_t>(ts.tv_sec * 1000000ull + ts.tv_nsec / 1000);
+    }
+
+    void onSignal(int){
+        stopRequested = 1;
+    }
+
+    struct Injection{
+        uint32_t   delayUs      { 5000 },
+                   jitterUs     { 10000 },
+                   queueUs      { 10000 };
+        int32_t    driftPpm     { 100 };
+    };
+
+    // Loopback glove clock: 'offset' from the host one at 'startUs', off by driftPpm.
+    struct FakeClock{
+        uint32_t   startUs;
+        uint32_t   offset;
+        int32_t    driftPpm;
+
+        uint32_t device(uint32_t hostUs) const{
+            const int64_t since { static_cast<int32_t>(hostUs - startUs) };
+            return hostUs + offset + static_cast<uint32_t>(since * driftPpm / 1000000);
+        }
+
+        uint32_t host(uint32_t deviceUs) const{
+            const double since { static_cast<int32_t>(deviceUs - offset - startUs) / (1.0 + driftPpm * 1e-6) };
+            return startUs + static_cast<uint32_t>(static_cast<int32_t>(lround(since)));
+        }
+    };
+
+    // Writes or requests, each due at its time.
+    using DelayLine = glove::DelayLine<QUEUE, glove::RSP_MAX_SIZE>;
+
+    // Child process of the loopback test: frames every FRAME_US stamped with
+    // its own clock, time sync answered as the firmware does, every byte late.
+    void runFake(int fd, const FakeClock& clock, const Injection& inj, uint32_t seconds, uint32_t seed){
+        DelayLine*           out      { new DelayLine() };
+        DelayLine*           in       { new DelayLine() };
+        glove::CommandParser commands;
+        uint16_t             seq      { 0 };
+        uint32_t             nextUs   { clock.startUs };
+
+        auto rnd  = [&seed](uint32_t range){ seed = seed * 1664525u + 1013904223u; return range == 0 ? 0 : (seed >> 8) % range; };
+        auto link = [&](void){ return inj.delayUs + rnd(inj.jitterUs); };
+
+        while(nowUs() - clock.startUs < (seconds + 1) * 1000000u){
+            pollfd  pfd { fd, POLLIN, 0 };
+            poll(&pfd, 1, 1);
+            uint32_t now { nowUs() };
+
+            uint8_t buffer[256];
+            ssize_t len;
+            while((len = read(fd, buffer, sizeof(buffer))) > 0)
+                for(ssize_t i{0}; i<len; i++)
+                    for(auto res{commands.push(buffer[i])}; res != glove::CommandParser::PARSE_MORE; res = commands.next()){
+                        if(res != glove::CommandParser::PARSE_READY)
+                            continue;
+                        const glove::Command& cmd { commands.command() };
+                        uint8_t frame[glove::CMD_OVERHEAD + glove::CMD_MAX_PAYLOAD];
+                        in->push(now + link(), frame, glove::encodeCommand(cmd.id, cmd.tag, cmd.payload, cmd.length, frame));
+                    }
+
+            for(const DelayLine::Pending* req{in->due(now)}; req != nullptr; req = in->due(now)){
+                glove::CommandParser  one;
+                for(size_t i{0}; i<req->len; i++)
+                    one.push(req->data[i]);
+                const glove::Command& cmd    { one.command() };
+                glove::COMMAND_STATUS status { glove::CMD_OK };
+                uint8_t               reply[glove::SYNC_RESPONSE_SIZE];
+                size_t                replyLen { 0 };
+                if(cmd.id == glove::CMD_TIME_SYNC && cmd.length == glove::SYNC_REQUEST_SIZE){
+                    memcpy(reply, cmd.payload, glove::SYNC_REQUEST_SIZE);
+                    glove::put32(reply + 4, clock.device(now));
+                    glove::put32(reply + 8, clock.device(nowUs()));
+                    replyLen = glove::SYNC_RESPONSE_SIZE;
+                } else if(cmd.id != glove::CMD_SET_FORMAT){
+                    status = glove::CMD_UNKNOWN;
+                }
+                uint8_t rsp[glove::RSP_MAX_SIZE];
+                out->push(now + link(), rsp, glove::encodeResponse(cmd, status, reply, replyLen, rsp));
+                in->pop();
+            }
+
+            while(static_cast<int32_t>(now - nextUs) >= 0){
+                glove::TelemetrySample sample;
+                const float phase { (now % 2000000) / 2000000.0f * 6.2832f };
+                sample.seq         = seq++;
+                sample.timestampUs = clock.device(now);
+                sample.flags       = 0x07;
+                for(size_t imu{0}; imu<glove::FRAME_IMUS; imu++){
+                    sample.quat[imu][0]       = cosf(phase * 0.5f);
+                    sample.quat[imu][1 + imu] = sinf(phase * 0.5f);
+                }
+                uint8_t frame[glove::FRAME_SIZE];
+                out->push(now + rnd(inj.queueUs) + link(), frame, glove::encodeFrame(sample, frame));
+                nextUs += FRAME_US;
+            }
+
+            now = nowUs();
+            for(const DelayLine::Pending* wr{out->due(now)}; wr != nullptr; wr = out->due(now)){
+                if(write(fd, wr->data, wr->len) != static_cast<ssize_t>(wr->len))
+                    break;
+                out->pop();
+            }
+        }
+    }
+
+    struct Link{
+        const char*            path        { nullptr };
+        int                    fd          { -1 };
+        glove::FrameDecoder    frames;
+        glove::CommandParser   responses   { true };
+        glove::TimeSync        sync;
+        bool                   formatted   { false },
+                               haveTransit { false };
+        uint32_t               askedUs     { 0 },
+                               syncedUs    { 0 },
+                               lastTransit { 0 };
+        uint8_t                tag         { 0 };
+        double                 jitter      { 0.0 };
+        std::vector<uint32_t>  interval,                     // latencies since the last report
+                               all;
+        // Loopback only.
+        bool                   fake        { false };
+        FakeClock              truth       {};
+        pid_t                  child       { -1 };
+        std::vector<uint32_t>  errors,                       // |measured - true|
+                               allErrors;
+    };
+
+    void request(Link& lnk, uint8_t id, const uint8_t* payload, size_t len){
+        uint8_t frame[glove::CMD_OVERHEAD + glove::CMD_MAX_PAYLOAD];
+        const size_t size { glove::encodeCommand(id, ++lnk.tag, payload, len, frame) };
+        if(write(lnk.fd, frame, size) != static_cast<ssize_t>(size))
+            fprintf(stderr, "%s: command not sent\n", lnk.path);
+    }
+
+    void readLink(Link& lnk, bool verbose){
+        uint8_t buffer[4096];
+        ssize_t len;
+        while((len = read(lnk.fd, buffer, sizeof(buffer))) > 0){
+            const uint32_t rx { nowUs() };
+            for(ssize_t i{0}; i<len; i++){
+                for(auto res{lnk.responses.push(buffer[i])}; res != glove::CommandParser::PARSE_MORE; res = lnk.responses.next()){
+                    if(res != glove::CommandParser::PARSE_READY)
+                        continue;
+                    const glove::Command& rsp { lnk.responses.command() };
+                    if(rsp.id == glove::CMD_SET_FORMAT)
+                        lnk.formatted = rsp.status == glove::CMD_OK;
+                    else if(rsp.id == glove::CMD_TIME_SYNC && rsp.length == glove::SYNC_RESPONSE_SIZE)
+                        lnk.sync.add(glove::get32(rsp.payload), glove::get32(rsp.payload + 4),
+                                     glove::get32(rsp.payload + 8), rx);
+                }
+
+                glove::TelemetrySample sample;
+                if(!lnk.frames.push(buffer[i], sample) || lnk.sync.exchanges() < SYNC_SETTLE)
+                    continue;
+
+                const uint32_t hostUs  { lnk.sync.toHost(sample.timestampUs) },
+                               latency { rx - hostUs };
+                if(static_cast<int32_t>(latency) < 0)
+                    continue;
+                lnk.interval.push_back(latency);
+                if(lnk.haveTransit)
+                    lnk.jitter += (abs(static_cast<int32_t>(latency - lnk.lastTransit)) - lnk.jitter) / 16.0;
+                lnk.haveTransit = true;
+                lnk.lastTransit = latency;
+
+                if(lnk.fake)
+                    lnk.errors.push_back(static_cast<uint32_t>(abs(static_cast<int32_t>(hostUs - lnk.truth.host(sample.timestampUs)))));
+                if(verbose)
+                    printf("%s %5u %10u %10u %8u\n", lnk.path, sample.seq, sample.timestampUs, hostUs, latency);
+            }
+        }
+        if(len == 0 || (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK)){
+            fprintf(stderr, "%s: closed\n", lnk.path);
+            close(lnk.fd);
+            lnk.fd = -1;
+        }
+    }
+
+    // 'part' of the sorted values, 0 if none.
+    uint32_t percentile(const std::vector<uint32_t>& sorted, double part){
+        return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * part))];
+    }
+
+    void report(Link& lnk, std::vector<uint32_t>& lat, std::vector<uint32_t>& err){
+        std::sort(lat.begin(), lat.end());
+        printf("%-12s %6zu  %7.2f %7.2f %7.2f %7.2f  %6.2f  %+11d %+8.1f  %6.2f",
+               lnk.path, lat.size(), percentile(lat, 0.5) / 1e3, percentile(lat, 0.95) / 1e3,
+               percentile(lat, 0.99) / 1e3, (lat.empty() ? 0 : lat.back()) / 1e3, lnk.jitter / 1e3,
+               lnk.sync.offsetUs(), lnk.sync.driftPpm(), lnk.sync.delayUs() / 1e3);
+        if(lnk.fake){
+            std::sort(err.begin(), err.end());
+            printf("  %6.2f %6.2f", percentile(err, 0.5) / 1e3, (err.empty() ? 0 : err.back()) / 1e3);
+        }
+        printf("\n");
+    }
+
+    void header(bool loopback){
+        printf("%-12s %6s  %7s %7s %7s %7s  %6s  %11s %8s  %6s%s\n", "link", "frames", "p50 ms", "p95", "p99", "max",
+               "jitter", "offset us", "ppm", "rtt ms", loopback ? "  err p50   max" : "");
+    }
+
+    int openDevice(const char* path){
+        const int fd { open(path, O_RDWR | O_NOCTTY | O_NONBLOCK) };
+        if(fd < 0){
+            perror(path);
+            return -1;
+        }
+        if(isatty(fd)){
+            termios tio{};
+            tcgetattr(fd, &tio);
+            cfmakeraw(&tio);
+            cfsetspeed(&tio, B115200);
+            tcsetattr(fd, TCSANOW, &tio);
+        }
+        return fd;
+    }
+
+    // Pseudo terminal for a loopback glove: the master goes to the child.
+    bool openLoopback(Link& lnk, int& master, char* path, size_t size){
+        master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if(master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+            return false;
+        snprintf(path, size, "%s", ptsname(master));
+        termios tio{};
+        tcgetattr(master, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(master, TCSANOW, &tio);
+        lnk.path = path;
+        lnk.fd   = openDevice(path);
+        lnk.fake = true;
+        return lnk.fd >= 0;
+    }
+
+} // End anonymous namespace
+
+int main(int argc, char** argv){
+    Link*      links     { new Link[MAX_LINKS] };
+    size_t     count     { 0 },
+               loopback  { 0 };
+    uint32_t   syncUs    { 250000 },
+               reportUs  { 1000000 },
+               seconds   { 0 };
+    bool       verbose   { false };
+    Injection  inj;
+
+    for(int i{1}; i<argc; i++){
+        if(strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            syncUs = static_cast<uint32_t>(strtod(argv[++i], nullptr) * 1000.0);
+        else if(strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            reportUs = static_cast<uint32_t>(strtod(argv[++i], nullptr) * 1e6);
+        else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            seconds = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if(strcmp(argv[i], "-v") == 0)
+            verbose = true;
+        else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+            loopback = std::min(MAX_LINKS, static_cast<size_t>(strtoul(argv[++i], nullptr, 10)));
+        else if(strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+            inj.delayUs = static_cast<uint32_t>(strtod(argv[++i], nullptr) * 1000.0);
+        else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            inj.jitterUs = static_cast<uint32_t>(strtod(argv[++i], nullptr) * 1000.0);
+        else if(strcmp(argv[i], "-q") == 0 && i + 1 < argc)
+            inj.queueUs = static_cast<uint32_t>(strtod(argv[++i], nullptr) * 1000.0);
+        else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            inj.driftPpm = static_cast<int32_t>(strtol(argv[++i], nullptr, 10));
+        else if(argv[i][0] != '-' && count < MAX_LINKS)
+            links[count++].path = argv[i];
+    }
+    if((count == 0 && loopback == 0) || syncUs == 0 || reportUs == 0){
+        fprintf(stderr, "Usage: %s [-p sync_ms] [-i report_s] [-t seconds] [-v] device...\n"
+                        "       %s -l links [-g delay_ms] [-j jitter_ms] [-q queue_ms] [-r drift_ppm] [-t seconds]\n",
+                argv[0], argv[0]);
+        return 1;
+    }
+
+    for(size_t idx{0}; idx<count; idx++)
+        if((links[idx].fd = openDevice(links[idx].path)) < 0)
+            return 1;
+
+    static char ptyPaths[MAX_LINKS][64];
+    if(loopback > 0 && seconds == 0)
+        seconds = 60;
+    for(size_t idx{0}; idx<loopback; idx++){
+        Link& lnk { links[count] };
+        int   master;
+        if(!openLoopback(lnk, master, ptyPaths[idx], sizeof(ptyPaths[idx]))){
+            perror("pty");
+            return 1;
+        }
+        lnk.truth = FakeClock{ nowUs(), static_cast<uint32_t>(0x9E3779B9u * (idx + 1)),
+                               inj.driftPpm * (idx % 2 ? -1 : 1) };
+        lnk.child = fork();
+        if(lnk.child == 0){
+            runFake(master, lnk.truth, inj, seconds, static_cast<uint32_t>(idx + 1));
+            _exit(0);
+        }
+        close(master);
+        count++;
+    }
+
+    signal(SIGINT,  onSignal);
+    signal(SIGTERM, onSignal);
+
+    const uint8_t  binary   { 1 };                    // Glove::BINARY
+    const uint32_t start    { nowUs() };
+    uint32_t       reportAt { start + reportUs };
+    pollfd         fds[MAX_LINKS];
+
+    header(loopback > 0);
+    while(stopRequested == 0 && (seconds == 0 || nowUs() - start < seconds * 1000000u)){
+        for(size_t idx{0}; idx<count; idx++)
+            fds[idx] = pollfd{ links[idx].fd, POLLIN, 0 };
+        poll(fds, count, 5);
+
+        const uint32_t now { nowUs() };
+        for(size_t idx{0}; idx<count; idx++){
+            Link& lnk { links[idx] };
+            if(lnk.fd < 0)
+                continue;
+            if(fds[idx].revents != 0)
+                readLink(lnk, verbose);
+            if(lnk.fd >= 0 && !lnk.formatted && now - lnk.askedUs >= RETRY_US){
+                request(lnk, glove::CMD_SET_FORMAT, &binary, 1);
+                lnk.askedUs = now;
+            }
+            if(lnk.fd >= 0 && now - lnk.syncedUs >= syncUs){
+                uint8_t sent[glove::SYNC_REQUEST_SIZE];
+                glove::put32(sent, nowUs());
+                request(lnk, glove::CMD_TIME_SYNC, sent, sizeof(sent));
+                lnk.syncedUs = now;
+            }
+        }
+
+        if(static_cast<int32_t>(now - reportAt) >= 0 && !verbose){
+            for(size_t idx{0}; idx<count; idx++){
+                Link& lnk { links[idx] };
+                lnk.all.insert(lnk.all.end(), lnk.interval.begin(), lnk.interval.end());
+                lnk.allErrors.insert(lnk.allErrors.end(), lnk.errors.begin(), lnk.errors.end());
+                report(lnk, lnk.interval, lnk.errors);
+                lnk.interval.clear();
+                lnk.errors.clear();
+            }
+            reportAt += reportUs;
+        }
+    }
+
+    printf("whole run, %.1f s\n", (nowUs() - start) / 1e6);
+    header(loopback > 0);
+    for(size_t idx{0}; idx<count; idx++){
+        Link& lnk { links[idx] };
+        lnk.all.insert(lnk.all.end(), lnk.interval.begin(), lnk.interval.end());
+        lnk.allErrors.insert(lnk.allErrors.end(), lnk.errors.begin(), lnk.errors.end());
+        report(lnk, lnk.all, lnk.allErrors);
+        if(lnk.fake)
+            printf("%-12s true drift %+d ppm, %u exchanges, %u crc errors\n", "", lnk.truth.driftPpm,
+                   lnk.sync.exchanges(), lnk.frames.crcErrors());
+        if(lnk.child > 0){
+            kill(lnk.child, SIGTERM);
+            waitpid(lnk.child, nullptr, 0);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,378 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+// Load generator for glove_hub: makes synthetic gloves on pseudo terminals,
+// answering the hub's commands like the firmware, starts the hub on them
+// and connects subscribers, then reports what the subscribers got and how
+// much of a core the hub used.
+//
+// Usage: glove_load [-g gloves] [-s subscribers] [-r hz] [-t seconds] [-c cpu] [-d] [-H hub]
+//
+// -g  synthetic gloves, 4 by default, up to 16
+// -s  subscribers, 4 by default
+// -r  frames per second of each glove, 100
+// -t  duration, 10 s
+// -c  pins the hub to that cpu
+// -d  delta stream instead of full frames
+// -H  hub program, glove_hub next to this one by default
+//
+// The samples of each glove carry a clock of their own, offset from the
+// host's, so the hub has to align them. Latency is from the sample's time,
+// moved to the host clock by the hub, to the subscriber reading it.
+
+#include <telemetry.h>
+#include <delta_stream.h>
+#include <command.h>
+#include <identity.h>
+#include <hub_frame.h>
+#include <time_sync.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+    const size_t   MAX_SUBSCRIBERS { 256 },
+                   LATENCY_BINS    { 1000 };       // 100 us each
+    const uint32_t BIN_US          { 100 };
+
+    uint32_t nowUs(void){
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<uint32_t>(ts.tv_sec * 1000000ull + ts.tv_nsec / 1000);
+    }
+
+    struct FakeGlove{
+        int                    master      { -1 },
+                               slave       { -1 };
+        char                   path[64]    {};
+        uint32_t               clockOffset { 0 };
+        uint16_t               seq         { 0 };
+        uint8_t                format      { 0 };       // Glove::TEXT until the hub asks
+        glove::DeviceIdentity  ident;
+        glove::CommandParser   commands;
+        glove::DeltaEncoder    delta;
+        uint32_t               dropped     { 0 },
+                               answered    { 0 };
+    };
+
+    struct Reader{
+        int                    fd          { -1 };
+        glove::HubFrameDecoder decoder;
+        uint32_t               fresh       { 0 },
+                               slots       { 0 };
+    };
+
+    bool openPty(FakeGlove& gl){
+        gl.master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+        if(gl.master < 0 || grantpt(gl.master) < 0 || unlockpt(gl.master) < 0)
+            return false;
+        snprintf(gl.path, sizeof(gl.path), "%s", ptsname(gl.master));
+
+        // Held open raw: no echo of the frames, no EIO while the hub starts.
+        gl.slave = open(gl.path, O_RDWR | O_NOCTTY);
+        if(gl.slave < 0)
+            return false;
+        termios tio{};
+        tcgetattr(gl.slave, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(gl.slave, TCSANOW, &tio);
+        return true;
+    }
+
+    // What the firmware does with the hub's requests, see Glove::execute().
+    void answer(FakeGlove& gl){
+        uint8_t buffer[256];
+        ssize_t len;
+        while((len = read(gl.master, buffer, sizeof(buffer))) > 0)
+            for(ssize_t i{0}; i<len; i++){
+                for(auto res{gl.commands.push(buffer[i])}; res != glove::CommandParser::PARSE_MORE; res = gl.commands.next()){
+                    if(res != glove::CommandParser::PARSE_READY)
+                        continue;
+                    const glove::Command& cmd { gl.commands.command() };
+                    uint8_t  reply[glove::IDENT_SIZE];
+                    size_t   replyLen { 0 };
+                    glove::COMMAND_STATUS status { glove::CMD_OK };
+                    if(cmd.id == glove::CMD_GET_IDENTITY)
+                        replyLen = glove::encodeIdentity(gl.ident, reply);
+                    else if(cmd.id == glove::CMD_SET_FORMAT && cmd.length == 1 && cmd.payload[0] <= 2)
+                        gl.format = cmd.payload[0];
+                    else if(cmd.id == glove::CMD_TIME_SYNC && cmd.length == glove::SYNC_REQUEST_SIZE){
+                        const uint32_t device { nowUs() + gl.clockOffset };
+                        memcpy(reply, cmd.payload, glove::SYNC_REQUEST_SIZE);
+                        glove::put32(reply + 4, device);
+                        glove::put32(reply + 8, device);
+                        replyLen = glove::SYNC_RESPONSE_SIZE;
+                    }
+                    else
+                        status = glove::CMD_UNKNOWN;
+
+                    uint8_t out[glove::RSP_MAX_SIZE];
+                    const size_t size { glove::encodeResponse(cmd, status, reply, replyLen, out) };
+                    if(write(gl.master, out, size) == static_cast<ssize_t>(size))
+                        gl.answered++;
+                }
+            }
+    }
+
+    void sendSample(FakeGlove& gl, size_t index, uint32_t now){
+        glove::TelemetrySample sample;
+        const float phase { (now % 4000000) / 4000000.0f * 6.2832f + index };
+        sample.seq         = gl.seq;
+        sample.timestampUs = now + gl.clockOffset;
+        for(size_t imu{0}; imu<glove::FRAME_IMUS; imu++){
+            sample.quat[imu][0] = cosf(phase * 0.5f);
+            sample.quat[imu][1 + imu] = sinf(phase * 0.5f);
+        }
+        for(size_t finger{0}; finger<glove::FRAME_FINGERS; finger++)
+            sample.fingers[finger] = static_cast<uint8_t>(45 + 44 * sinf(phase + finger));
+
+        uint8_t out[glove::DELTA_MAX_SIZE];
+        size_t  len { 0 };
+        if(gl.format == 1)
+            len = glove::encodeFrame(sample, out);
+        else if(gl.format == 2)
+            len = gl.delta.encode(sample, out);
+        if(len == 0)
+            return;
+
+        gl.seq++;
+        if(write(gl.master, out, len) != static_cast<ssize_t>(len))
+            gl.dropped++;
+    }
+
+    int connectTo(const char* path){
+        sockaddr_un addr {};
+        addr.sun_family = AF_UNIX;
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+        for(int attempt{0}; attempt<100; attempt++){
+            const int fd { socket(AF_UNIX, SOCK_STREAM, 0) };
+            if(connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0){
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                return fd;
+            }
+            close(fd);
+            usleep(20000);
+        }
+        return -1;
+    }
+
+    uint32_t percentile(const uint32_t* bins, uint64_t total, double part){
+        uint64_t seen { 0 };
+        for(size_t bin{0}; bin<LATENCY_BINS; bin++){
+            seen += bins[bin];
+            if(seen >= total * part)
+                return static_cast<uint32_t>((bin + 1) * BIN_US);
+        }
+        return LATENCY_BINS * BIN_US;
+    }
+
+} // End anonymous namespace
+
+int main(int argc, char** argv){
+    size_t      gloves      { 4 },
+                subscribers { 4 };
+    uint32_t    rateHz      { 100 },
+                seconds     { 10 };
+    int         cpu         { -1 };
+    bool        delta       { false };
+    char        hubPath[512];
+    const char* slash       { strrchr(argv[0], '/') };
+
+    snprintf(hubPath, sizeof(hubPath), "%.*sglove_hub", slash ? static_cast<int>(slash - argv[0] + 1) : 0, argv[0]);
+    for(int i{1}; i<argc; i++){
+        if(strcmp(argv[i], "-g") == 0 && i + 1 < argc)
+            gloves = strtoul(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            subscribers = strtoul(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            rateHz = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            seconds = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+            cpu = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-d") == 0)
+            delta = true;
+        else if(strcmp(argv[i], "-H") == 0 && i + 1 < argc)
+            snprintf(hubPath, sizeof(hubPath), "%s", argv[++i]);
+    }
+    if(gloves == 0 || gloves > glove::HUB_MAX_GLOVES || subscribers > MAX_SUBSCRIBERS || rateHz == 0){
+        fprintf(stderr, "Usage: %s [-g gloves] [-s subscribers] [-r hz] [-t seconds] [-c cpu] [-d] [-H hub]\n", argv[0]);
+        return 1;
+    }
+
+    FakeGlove* fakes { new FakeGlove[gloves] };
+    for(size_t idx{0}; idx<gloves; idx++){
+        FakeGlove& gl { fakes[idx] };
+        if(!openPty(gl)){
+            perror("pty");
+            return 1;
+        }
+        gl.clockOffset    = static_cast<uint32_t>(idx * 123456789u);
+        gl.ident.deviceId = static_cast<uint16_t>(100 + idx);
+        gl.ident.wearer   = static_cast<uint8_t>(idx / 2);
+        gl.ident.hand     = idx % 2 ? glove::HAND_RIGHT : glove::HAND_LEFT;
+        snprintf(gl.ident.name, sizeof(gl.ident.name), "LOAD_%zu", idx);
+    }
+
+    char socketPath[64];
+    snprintf(socketPath, sizeof(socketPath), "/tmp/glove_load.%d.sock", getpid());
+
+    // The hub runs a second longer than the load, to send what it still has.
+    char        duration[16];
+    const char* args[glove::HUB_MAX_GLOVES + 8];
+    size_t      argn { 0 };
+    snprintf(duration, sizeof(duration), "%u", seconds + 1);
+    args[argn++] = hubPath;
+    args[argn++] = "-l";
+    args[argn++] = socketPath;
+    args[argn++] = "-t";
+    args[argn++] = duration;
+    if(delta)
+        args[argn++] = "-d";
+    for(size_t idx{0}; idx<gloves; idx++)
+        args[argn++] = fakes[idx].path;
+    args[argn] = nullptr;
+
+    const pid_t hub { fork() };
+    if(hub == 0){
+        if(cpu >= 0){
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            sched_setaffinity(0, sizeof(set), &set);
+        }
+        execv(hubPath, const_cast<char* const*>(args));
+        perror(hubPath);
+        _exit(1);
+    }
+
+    Reader* readers { new Reader[subscribers] };
+    for(size_t idx{0}; idx<subscribers; idx++)
+        if((readers[idx].fd = connectTo(socketPath)) < 0){
+            fprintf(stderr, "%s: hub not listening\n", socketPath);
+            kill(hub, SIGTERM);
+            return 1;
+        }
+
+    uint32_t*        latency   { new uint32_t[LATENCY_BINS]() };
+    uint64_t         measured  { 0 };
+    uint32_t         worst     { 0 };
+    glove::HubFrame* frame     { new glove::HubFrame() };
+    pollfd*          fds       { new pollfd[subscribers + gloves] };
+    const uint32_t   periodUs  { 1000000 / rateHz },
+                     start     { nowUs() };
+    uint32_t         nextUs    { start };
+
+    for(size_t idx{0}; idx<subscribers; idx++)
+        fds[idx] = pollfd{ readers[idx].fd, POLLIN, 0 };
+    for(size_t idx{0}; idx<gloves; idx++)
+        fds[subscribers + idx] = pollfd{ fakes[idx].master, POLLIN, 0 };
+
+    // Samples for 'seconds', then reading on until the hub quits.
+    bool hubDone { false };
+    while(!hubDone){
+        const uint32_t now     { nowUs() };
+        const bool     loading { now - start < seconds * 1000000u };
+        if(loading && static_cast<int32_t>(now - nextUs) >= 0){
+            for(size_t idx{0}; idx<gloves; idx++)
+                sendSample(fakes[idx], idx, now);
+            nextUs += periodUs;
+        }
+
+        const int32_t wait { loading ? static_cast<int32_t>(nextUs - nowUs()) / 1000 : 100 };
+        if(poll(fds, subscribers + gloves, wait > 0 ? wait : 0) <= 0){
+            hubDone = !loading && waitpid(hub, nullptr, WNOHANG) == hub;
+            continue;
+        }
+
+        for(size_t idx{0}; idx<gloves; idx++)
+            if(fds[subscribers + idx].revents & POLLIN)
+                answer(fakes[idx]);
+
+        for(size_t idx{0}; idx<subscribers; idx++){
+            if(!(fds[idx].revents & (POLLIN | POLLHUP)))
+                continue;
+            Reader& rd { readers[idx] };
+            uint8_t buffer[16384];
+            const ssize_t len { read(rd.fd, buffer, sizeof(buffer)) };
+            if(len <= 0){
+                fds[idx].fd = -1;
+                continue;
+            }
+            const uint32_t rx { nowUs() };
+            for(ssize_t i{0}; i<len; i++){
+                if(!rd.decoder.push(buffer[i], *frame))
+                    continue;
+                for(size_t slot{0}; slot<frame->gloves; slot++){
+                    rd.slots++;
+                    if(!(frame->slots[slot].state & glove::HUB_FRESH))
+                        continue;
+                    rd.fresh++;
+                    const uint32_t lat { rx - frame->slots[slot].sampleUs };
+                    worst = lat > worst ? lat : worst;
+                    latency[lat / BIN_US < LATENCY_BINS ? lat / BIN_US : LATENCY_BINS - 1]++;
+                    measured++;
+                }
+            }
+        }
+    }
+
+    rusage usage {};
+    getrusage(RUSAGE_CHILDREN, &usage);
+    const double cpuS { usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+                        (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6 };
+
+    uint32_t frames { 0 }, lost { 0 }, crc { 0 }, fresh { 0 }, slots { 0 }, dropped { 0 }, answered { 0 };
+    for(size_t idx{0}; idx<subscribers; idx++){
+        frames += readers[idx].decoder.frames();
+        lost   += readers[idx].decoder.lostFrames();
+        crc    += readers[idx].decoder.crcErrors();
+        fresh  += readers[idx].fresh;
+        slots  += readers[idx].slots;
+    }
+    for(size_t idx{0}; idx<gloves; idx++){
+        dropped  += fakes[idx].dropped;
+        answered += fakes[idx].answered;
+    }
+
+    printf("gloves %zu at %u Hz%s, subscribers %zu, %u s\n", gloves, rateHz, delta ? " (delta)" : "", subscribers, seconds);
+    printf("hub cpu:        %.1f%% of one core\n", cpuS * 100.0 / (seconds + 1));
+    printf("per subscriber: %.0f frames, %.1f lost, %u crc errors in all\n",
+           subscribers ? static_cast<double>(frames) / subscribers : 0.0,
+           subscribers ? static_cast<double>(lost) / subscribers : 0.0, crc);
+    printf("fresh slots:    %.1f%%\n", slots ? fresh * 100.0 / slots : 0.0);
+    printf("latency:        us p50 %u p99 %u max %u\n", percentile(latency, measured, 0.5),
+           percentile(latency, measured, 0.99), worst);
+    printf("gloves:         %u commands answered, %u frames not written\n", answered, dropped);
+    return 0;
+}
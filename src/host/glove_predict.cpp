@@ -0,0 +1,248 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+// Host tool: runs the pose predictor (include/pose_predictor.h) over a
+// capture of binary frames, as saved by glove_sim -o or glove_replay -o
+// from a recorded session, and prints for each horizon how far the
+// predicted pose is from the one the capture reaches at that time, next
+// to simply showing the newest frame.
+//
+// Usage: glove_predict [-h ms,ms,...] [-c cap_ms] [-a rate_alpha] [-f finger_alpha] [-b seconds] capture
+//
+// -h horizons to evaluate (default 0,10,20,50,100), -c the predictor's
+// horizon, -a and -f its smoothing, -b times update() and predict() for
+// 'seconds' instead.
+
+#include <pose_predictor.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+    const float DEG { static_cast<float>(180.0 / M_PI) };
+
+    struct Frame{
+        glove::TelemetrySample sample;
+        int64_t                timeUs;          // device time, unwrapped
+    };
+
+    // Normalized: Q14 leaves the frames a little off the unit length.
+    glove::Quat quatOf(const glove::TelemetrySample& sample, size_t imu){
+        return glove::quatNormalize(glove::Quat{ sample.quat[imu][0], sample.quat[imu][1], sample.quat[imu][2], sample.quat[imu][3] });
+    }
+
+    glove::Quat slerp(const glove::Quat& a, glove::Quat b, float frac){
+        float dot { a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z };
+        if(dot < 0.0f){
+            b   = glove::Quat{ -b.w, -b.x, -b.y, -b.z };
+            dot = -dot;
+        }
+        float wa { 1.0f - frac }, wb { frac };
+        if(dot < 0.9995f){
+            const float angle { acosf(dot) }, sine { sinf(angle) };
+            wa = sinf((1.0f - frac) * angle) / sine;
+            wb = sinf(frac * angle) / sine;
+        }
+        return glove::quatNormalize(glove::Quat{ wa * a.w + wb * b.w, wa * a.x + wb * b.x,
+                                                 wa * a.y + wb * b.y, wa * a.z + wb * b.z });
+    }
+
+    struct Errors{
+        std::vector<float> joints[glove::FRAME_IMUS];
+        double             fingerSum   { 0.0 };
+        size_t             fingerCount { 0 };
+
+        float mean(size_t imu) const{
+            double sum { 0.0 };
+            for(const float err: joints[imu])
+                sum += err;
+            return joints[imu].empty() ? 0.0f : static_cast<float>(sum / joints[imu].size());
+        }
+
+        float p95(void) const{
+            std::vector<float> all;
+            for(const auto& imu: joints)
+                all.insert(all.end(), imu.begin(), imu.end());
+            if(all.empty())
+                return 0.0f;
+            const size_t at { all.size() * 95 / 100 };
+            std::nth_element(all.begin(), all.begin() + at, all.end());
+            return all[at];
+        }
+
+        float fingers(void) const{ return fingerCount == 0 ? 0.0f : static_cast<float>(fingerSum / fingerCount); }
+    };
+
+    // Each frame in turn goes to the predictor, which is then asked for the
+    // pose 'horizonUs' later; the capture itself, interpolated, tells the truth.
+    void evaluate(const std::vector<Frame>& frames, const glove::PredictorConfig& conf, uint32_t horizonUs,
+                  Errors& predicted, Errors& held){
+        glove::PosePredictor predictor;
+        predictor.configure(conf);
+
+        size_t next { 0 };
+        for(size_t idx{0}; idx<frames.size(); idx++){
+            const Frame& base { frames[idx] };
+            predictor.update(base.sample, static_cast<uint32_t>(base.timeUs));
+
+            const int64_t when { base.timeUs + horizonUs };
+            next = std::max(next, idx);
+            while(next + 1 < frames.size() && frames[next + 1].timeUs <= when)
+                next++;
+            if(next + 1 >= frames.size())
+                break;
+
+            const Frame& lo   { frames[next] };
+            const Frame& hi   { frames[next + 1] };
+            const float  frac { static_cast<float>(when - lo.timeUs) / static_cast<float>(hi.timeUs - lo.timeUs) };
+
+            glove::PosePrediction pose;
+            predictor.predict(static_cast<uint32_t>(when), pose);
+
+            for(size_t imu{0}; imu<glove::FRAME_IMUS; imu++){
+                const glove::Quat truth { slerp(quatOf(lo.sample, imu), quatOf(hi.sample, imu), frac) };
+                predicted.joints[imu].push_back(glove::quatAngle(pose.quat[imu], truth) * DEG);
+                held.joints[imu].push_back(glove::quatAngle(quatOf(base.sample, imu), truth) * DEG);
+            }
+            for(size_t finger{0}; finger<glove::FRAME_FINGERS; finger++){
+                const float truth { lo.sample.fingers[finger] + frac * (hi.sample.fingers[finger] - lo.sample.fingers[finger]) };
+                predicted.fingerSum += fabsf(pose.fingers[finger] - truth);
+                held.fingerSum      += fabsf(base.sample.fingers[finger] - truth);
+            }
+            predicted.fingerCount += glove::FRAME_FINGERS;
+            held.fingerCount      += glove::FRAME_FINGERS;
+        }
+    }
+
+    double elapsed(const std::chrono::steady_clock::time_point& start){
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+} // End anonymous namespace
+
+int main(int argc, char** argv){
+    const char*             path     { nullptr };
+    glove::PredictorConfig  conf;
+    std::vector<uint32_t>   horizons { 0, 10000, 20000, 50000, 100000 };
+    double                  seconds  { 0.0 };
+
+    for(int i{1}; i<argc; i++){
+        if(strcmp(argv[i], "-h") == 0 && i + 1 < argc){
+            horizons.clear();
+            for(char* field{argv[++i]}; *field != '\0';){
+                char* end;
+                horizons.push_back(static_cast<uint32_t>(strtod(field, &end) * 1000.0));
+                field = *end == ',' ? end + 1 : end;
+                if(end == field)
+                    break;
+            }
+        } else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc){
+            conf.horizonUs = static_cast<uint32_t>(strtod(argv[++i], nullptr) * 1000.0);
+        } else if(strcmp(argv[i], "-a") == 0 && i + 1 < argc){
+            conf.rateAlpha = strtof(argv[++i], nullptr);
+        } else if(strcmp(argv[i], "-f") == 0 && i + 1 < argc){
+            conf.fingerAlpha = strtof(argv[++i], nullptr);
+        } else if(strcmp(argv[i], "-b") == 0 && i + 1 < argc){
+            seconds = strtod(argv[++i], nullptr);
+        } else {
+            path = argv[i];
+        }
+    }
+
+    FILE* in { path != nullptr ? fopen(path, "rb") : nullptr };
+    if(in == nullptr){
+        fprintf(stderr, "usage: glove_predict [-h ms,ms,...] [-c cap_ms] [-a rate_alpha] [-f finger_alpha] [-b seconds] capture\n");
+        return 1;
+    }
+
+    std::vector<Frame>  frames;
+    glove::FrameDecoder decoder;
+    Frame               frame;
+    uint32_t            lastUs  { 0 };
+    int64_t             timeUs  { 0 };
+    int                 byte;
+    while((byte = fgetc(in)) != EOF){
+        if(!decoder.push(static_cast<uint8_t>(byte), frame.sample))
+            continue;
+        if(!frames.empty())
+            timeUs += static_cast<int32_t>(frame.sample.timestampUs - lastUs);
+        lastUs       = frame.sample.timestampUs;
+        frame.timeUs = timeUs;
+        if(frames.empty() || frame.timeUs > frames.back().timeUs)
+            frames.push_back(frame);
+    }
+    fclose(in);
+
+    if(frames.size() < 3){
+        fprintf(stderr, "%s: %zu frames, too few\n", path, frames.size());
+        return 1;
+    }
+    const double spanS { (frames.back().timeUs - frames.front().timeUs) * 1e-6 };
+    printf("%zu frames over %.1f s (%.0f Hz), %s, horizon %u ms, smoothing %.2f / %.2f\n",
+           frames.size(), spanS, (frames.size() - 1) / spanS,
+           frames.back().sample.flags & glove::FRAME_JOINTS ? "joint rotations" : "IMU rotations",
+           conf.horizonUs / 1000, conf.rateAlpha, conf.fingerAlpha);
+
+    if(seconds <= 0.0){
+        printf("%8s %8s %8s %8s %8s | %8s %8s | %8s %8s\n", "ahead", "arm", "forearm", "hand", "p95",
+               "hold", "p95", "fingers", "hold");
+        printf("%8s %8s %8s %8s %8s | %8s %8s | %8s %8s\n", "ms", "deg", "deg", "deg", "deg", "deg", "deg", "units", "units");
+        for(const uint32_t horizon: horizons){
+            Errors predicted, held;
+            evaluate(frames, conf, horizon, predicted, held);
+            const float holdMean { (held.mean(0) + held.mean(1) + held.mean(2)) / 3.0f };
+            printf("%8.1f %8.3f %8.3f %8.3f %8.3f | %8.3f %8.3f | %8.3f %8.3f\n", horizon / 1000.0,
+                   predicted.mean(0), predicted.mean(1), predicted.mean(2), predicted.p95(),
+                   holdMean, held.p95(), predicted.fingers(), held.fingers());
+        }
+        return 0;
+    }
+
+    glove::PosePredictor  predictor;
+    glove::PosePrediction pose;
+    float                 sink    { 0.0f };
+    uint64_t              updates { 0 }, queries { 0 };
+    predictor.configure(conf);
+
+    auto start { std::chrono::steady_clock::now() };
+    do{
+        predictor.reset();
+        for(const Frame& frm: frames)
+            predictor.update(frm.sample, static_cast<uint32_t>(frm.timeUs));
+        updates += frames.size();
+    } while(elapsed(start) < seconds / 2);
+    const double updateNs { elapsed(start) * 1e9 / updates };
+
+    start = std::chrono::steady_clock::now();
+    do{
+        for(uint32_t step{0}; step<1000; step++){
+            predictor.predict(static_cast<uint32_t>(frames.back().timeUs) + step * 97, pose);
+            sink += pose.quat[2].w + pose.fingers[0];
+        }
+        queries += 1000;
+    } while(elapsed(start) < seconds / 2);
+    const double queryNs { elapsed(start) * 1e9 / queries };
+
+    printf("update: %.1f ns/frame, predict: %.1f ns/query%s\n", updateNs, queryNs, sink == 0.0f ? " (no pose)" : "");
+    return 0;
+}
@@ -0,0 +1,180 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+// Host tool: records a session log (include/session.h) from a glove built
+// with -DGLOVE_SESSION_STREAM, on a serial port or an RFCOMM device, or
+// from a capture of its stream. glove_replay plays it back.
+//
+// Usage: glove_record [-t seconds] device_or_capture session_file
+//
+// -t  duration, until SIGINT or SIGTERM by default
+//
+// A device is switched to the session stream (CMD_SET_FORMAT) until it
+// answers, and back to binary frames at the end. The file starts with the
+// first header the glove sends; records before it are dropped.
+
+#include <command.h>
+#include <session.h>
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+    const int      RETRY_MS    { 500 };
+    const uint8_t  BINARY      { 1 },              // Glove::BINARY
+                   SESSION     { 3 };              // Glove::SESSION
+
+    volatile sig_atomic_t stopRequested { 0 };
+
+    void onSignal(int){
+        stopRequested = 1;
+    }
+
+    bool setFormat(int fd, uint8_t format){
+        uint8_t frame[glove::CMD_OVERHEAD + 1];
+        const size_t len { glove::encodeCommand(glove::CMD_SET_FORMAT, 0, &format, 1, frame) };
+        return write(fd, frame, len) == static_cast<ssize_t>(len);
+    }
+
+} // End anonymous namespace
+
+int main(int argc, char** argv){
+    const char* paths[2] { nullptr, nullptr };
+    int         count    { 0 };
+    long        seconds  { 0 };
+
+    for(int i{1}; i<argc; i++){
+        if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            seconds = strtol(argv[++i], nullptr, 10);
+        else if(count < 2)
+            paths[count++] = argv[i];
+    }
+    if(count != 2){
+        fprintf(stderr, "Usage: %s [-t seconds] device_or_capture session_file\n", argv[0]);
+        return 1;
+    }
+
+    const int fd { open(paths[0], O_RDWR | O_NOCTTY) };
+    if(fd < 0){
+        perror("open");
+        return 1;
+    }
+    const bool device { isatty(fd) != 0 };
+    if(device){
+        termios tio{};
+        tcgetattr(fd, &tio);
+        cfmakeraw(&tio);
+        cfsetspeed(&tio, B115200);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    signal(SIGINT,  onSignal);
+    signal(SIGTERM, onSignal);
+
+    glove::CommandParser        responses { true };
+    glove::SessionStreamDecoder decoder;
+    glove::SessionWriter        writer;
+    bool                        formatted { !device },
+                                recording { false };
+    uint32_t                    firstUs   { 0 },
+                                lastUs    { 0 },
+                                dropped   { 0 };
+    const time_t                start     { time(nullptr) };
+    auto                        asked     { std::chrono::steady_clock::now() - std::chrono::milliseconds(RETRY_MS) };
+    uint8_t                     buffer[512];
+
+    while(!stopRequested && (seconds == 0 || time(nullptr) - start < seconds)){
+        if(!formatted && std::chrono::steady_clock::now() - asked >= std::chrono::milliseconds(RETRY_MS)){
+            if(!setFormat(fd, SESSION)){
+                perror("write");
+                break;
+            }
+            asked = std::chrono::steady_clock::now();
+        }
+
+        pollfd pfd { fd, POLLIN, 0 };
+        if(poll(&pfd, 1, RETRY_MS) <= 0)
+            continue;
+        const ssize_t len { read(fd, buffer, sizeof(buffer)) };
+        if(len <= 0)
+            break;
+
+        for(ssize_t i{0}; i<len; i++){
+            for(auto res{responses.push(buffer[i])}; res != glove::CommandParser::PARSE_MORE; res = responses.next()){
+                if(res != glove::CommandParser::PARSE_READY || responses.command().id != glove::CMD_SET_FORMAT || formatted)
+                    continue;
+                if(responses.command().status != glove::CMD_OK){
+                    fprintf(stderr, "Error: the glove has no session stream, build it with -DGLOVE_SESSION_STREAM\n");
+                    close(fd);
+                    return 2;
+                }
+                formatted = true;
+            }
+
+            switch(decoder.push(buffer[i])){
+                case glove::SessionStreamDecoder::SESSION_HEADER_READY:
+                    if(recording)
+                        break;
+                    if(!writer.open(paths[1], decoder.header())){
+                        perror(paths[1]);
+                        close(fd);
+                        return 1;
+                    }
+                    recording = true;
+                    break;
+                case glove::SessionStreamDecoder::SESSION_RECORD_READY:
+                    if(!recording){
+                        dropped++;
+                        break;
+                    }
+                    if(!writer.append(decoder.record())){
+                        perror(paths[1]);
+                        close(fd);
+                        return 1;
+                    }
+                    if(writer.records() == 1)
+                        firstUs = decoder.record().timestampUs;
+                    lastUs = decoder.record().timestampUs;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    if(device && formatted && !setFormat(fd, BINARY))
+        perror("write");
+    close(fd);
+
+    if(!writer.close()){
+        perror(paths[1]);
+        return 1;
+    }
+    printf("session:        %u records, %.1f s, %u crc errors, %u records before the header\n", writer.records(),
+           writer.records() > 1 ? (lastUs - firstUs) / 1e6 : 0.0, decoder.crcErrors(), dropped);
+    return recording ? 0 : 3;
+}
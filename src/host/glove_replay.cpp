@@ -0,0 +1,144 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+// Host tool: replays a session log (include/session.h, recorded by
+// glove_sim -r or glove_record) through the glove on the simulated
+// board, with the calibration, IMU mode and bus speed of the recording,
+// and reports the throughput.
+//
+// Usage: glove_replay session_file [-x speed] [-o capture_file]
+//
+// -x 1 plays in real time, -x N N times faster; without it the session
+// runs as fast as possible. -o saves the output stream, for comparisons.
+
+#include <hal_sim.h>
+#include <glove.h>
+#include <session_replay.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    const uint32_t FINGERS_PERIOD_US { 2000   };
+    const uint32_t IMU_PERIOD_US     { 5000   };
+    const uint32_t IMU_FAST_PERIOD_US{ 1000   };   // IMU_IRQ and IMU_RAW
+    const uint32_t OUTPUT_PERIOD_US  { 10000  };
+    const uint32_t DISPLAY_PERIOD_US { 100000 };
+    const uint32_t TICK_US           { 100    };
+
+} // End anonymous namespace
+
+int main(int argc, char** argv){
+    const char* path    { nullptr };
+    FILE*       capture { nullptr };
+    float       speed   { 0.0f };
+
+    for(int i{1}; i<argc; i++){
+        if(strcmp(argv[i], "-x") == 0 && i + 1 < argc){
+            speed = strtof(argv[++i], nullptr);
+        } else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc){
+            capture = fopen(argv[++i], "wb");
+            if(capture == nullptr){
+                perror("fopen");
+                return 1;
+            }
+        } else {
+            path = argv[i];
+        }
+    }
+    if(path == nullptr){
+        fprintf(stderr, "Usage: glove_replay session_file [-x speed] [-o capture_file]\n");
+        return 1;
+    }
+
+    const int fd { open(path, O_RDONLY) };
+    struct stat st{};
+    if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0){
+        perror(path);
+        return 1;
+    }
+    void* map { mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0) };
+    close(fd);
+    if(map == MAP_FAILED){
+        perror("mmap");
+        return 1;
+    }
+
+    const glove::SessionView session{ static_cast<const uint8_t*>(map), static_cast<size_t>(st.st_size) };
+    if(!session.valid() || session.records() == 0){
+        fprintf(stderr, "Error: %s is not a session log\n", path);
+        return 1;
+    }
+
+    glove::SimBoard      sim;
+    glove::SessionPlayer player{session, sim};
+    sim.link.setSink(capture);
+    if(!player.prepare()){
+        fprintf(stderr, "Error: bad calibration record in %s\n", path);
+        return 1;
+    }
+
+    glove::Glove     gl{sim.board()};
+    const uint32_t   busHz { session.header().busHz };
+    if(busHz != 0 && !gl.setBusSpeed(busHz)){
+        fprintf(stderr, "Error: unsupported i2c speed %u\n", busHz);
+        return 1;
+    }
+    const glove::IMU_MODE mode { static_cast<glove::IMU_MODE>(session.header().imuMode) };
+    if(!gl.setImuMode(mode)){
+        fprintf(stderr, "Error: imu mode %u not available\n", mode);
+        return 1;
+    }
+
+    glove::Scheduler<5> scheduler{sim.clock};
+    const uint32_t imuPeriod { mode == glove::IMU_IRQ || mode == glove::IMU_RAW ? IMU_FAST_PERIOD_US : IMU_PERIOD_US };
+
+    scheduler.addTask([](void* g){ static_cast<glove::Glove*>(g)->acquireFingers(); }, &gl, FINGERS_PERIOD_US);
+    scheduler.addTask([](void* g){ static_cast<glove::Glove*>(g)->acquireImus();    }, &gl, imuPeriod);
+    const int output  { scheduler.addTask([](void* g){
+                                              static_cast<glove::Glove*>(g)->publish();
+                                              static_cast<glove::Glove*>(g)->drain();
+                                          }, &gl, OUTPUT_PERIOD_US) };
+    scheduler.addTask([](void* g){ static_cast<glove::Glove*>(g)->refreshFingers(); }, &gl, DISPLAY_PERIOD_US);
+
+    const auto     start   { std::chrono::steady_clock::now() };
+    const size_t   records { player.play(scheduler, speed, TICK_US) };
+    const double   wallNs  { static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                 std::chrono::steady_clock::now() - start).count()) };
+    const uint32_t frames  { scheduler.stats(output).runs };
+
+    printf("session:        %zu records, %.1f s, imu mode %u, %s calibration\n", records,
+           player.sessionUs() / 1000000.0, mode, session.header().calibrationLen > 0 ? "recorded" : "no");
+    printf("replay:         %.3f s wall, %.1fx real time\n", wallNs / 1e9,
+           wallNs > 0 ? player.sessionUs() * 1000.0 / wallNs : 0.0);
+    printf("throughput:     %.0f records/s, %.0f ns per record\n", records * 1e9 / wallNs, wallNs / records);
+    printf("frames:         %u, %llu bytes\n", frames, static_cast<unsigned long long>(sim.link.bytes()));
+    printf("calibration:    %u imu self calibrations at boot\n", sim.imu.calibrationRuns());
+
+    if(capture != nullptr)
+        fclose(capture);
+    munmap(map, static_cast<size_t>(st.st_size));
+
+    return 0;
+}
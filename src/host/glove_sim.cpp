@@ -0,0 +1,338 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+// Host tool: runs the firmware schedule on the simulated board as fast as
+// possible and reports the CPU time spent per simulated sample.
+//
+// Usage: glove_sim [simulated_seconds] [-o capture_file] [-m poll|fifo|irq|raw] [-s i2c_hz]
+//                  [-c calibration_file] [-k fingers|arms] [-f complementary|madgwick gain]
+//                  [-r session_file] [-d dump_file] [-a adc_hz oversample]
+//                  [-g none|lowpass|median|euro cutoff beta] [-n adc_noise]
+//                  [-t text|binary|delta|session] [-h]
+//
+// -a converts the fingers in the background, -g filters them and -n adds
+// +-adc_noise counts to every conversion.
+//
+// -r records what the glove reads from the sensors in a session log
+// (include/session.h), glove_replay plays it back. "-t session" sends
+// the same on the link instead, as a glove built with -DGLOVE_SESSION_STREAM
+// does: glove_record makes the log out of the capture.
+//
+// -d asks for the flight recorder at the end, as a host would on the
+// serial port, and saves the serial output until the dump is over;
+// glove_decode prints it.
+//
+// -k plays a scripted button sequence through a whole calibration while
+// the schedule keeps running, then reports how the output fared.
+
+#include <hal_sim.h>
+#include <glove.h>
+#include <session.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+    const uint32_t FINGERS_PERIOD_US { 2000   };
+    const uint32_t IMU_PERIOD_US     { 5000   };
+    const uint32_t IMU_IRQ_PERIOD_US { 1000   };   // cheap when no line fired
+    const uint32_t IMU_RAW_PERIOD_US { 1000   };
+    const uint32_t OUTPUT_PERIOD_US  { 10000  };
+    const uint32_t DISPLAY_PERIOD_US { 100000 };
+    const uint32_t TICK_US           { 100    };
+
+    const uint16_t PRESSED           { 4095 },
+                   RELEASED          { 0    };
+
+    struct Press{
+        uint32_t   atMs;
+        uint8_t    pin;
+        uint16_t   value;
+    };
+
+    // Chord, then LEFT to confirm each step once the hold off is over.
+    const Press FINGERS_SCRIPT[] {
+        { 1000, glove::BUTTON_LEFT_PIN,   PRESSED  }, { 1000, glove::BUTTON_MIDDLE_PIN, PRESSED  },
+        { 1300, glove::BUTTON_LEFT_PIN,   RELEASED }, { 1300, glove::BUTTON_MIDDLE_PIN, RELEASED },
+        { 2500, glove::BUTTON_LEFT_PIN,   PRESSED  }, { 2700, glove::BUTTON_LEFT_PIN,   RELEASED },
+        { 5600, glove::BUTTON_LEFT_PIN,   PRESSED  }, { 5800, glove::BUTTON_LEFT_PIN,   RELEASED }
+    };
+
+    const Press ARMS_SCRIPT[] {
+        { 1000, glove::BUTTON_RIGHT_PIN,  PRESSED  }, { 1000, glove::BUTTON_MIDDLE_PIN, PRESSED  },
+        { 1300, glove::BUTTON_RIGHT_PIN,  RELEASED }, { 1300, glove::BUTTON_MIDDLE_PIN, RELEASED },
+        { 2500, glove::BUTTON_LEFT_PIN,   PRESSED  }, { 2700, glove::BUTTON_LEFT_PIN,   RELEASED }
+    };
+
+} // End anonymous namespace
+
+int main(int argc, char** argv){
+    uint32_t seconds { 10 };
+    FILE*    capture { nullptr };
+    glove::IMU_MODE mode { glove::IMU_POLL };
+    uint32_t busHz   { 400000 };
+    const char* store { nullptr };
+    const char* session { nullptr };
+    FILE*    dump    { nullptr };
+    const Press* script { nullptr };
+    glove::FILTER_KIND filter { glove::FILTER_MADGWICK };
+    float    gain    { 0.1f };
+    size_t   scriptLen { 0 };
+    uint32_t adcHz   { 0 };
+    uint16_t oversample { 1 },
+             noise   { 0 };
+    glove::ADC_FILTER fingerFilter { glove::ADC_FILTER_NONE };
+    glove::Glove::OUTPUT_FORMAT format { glove::Glove::BINARY };
+    float    cutoff  { 5.0f },
+             beta    { 0.0f };
+
+    for(int i{1}; i<argc; i++){
+        if(strcmp(argv[i], "-o") == 0 && i + 1 < argc){
+            capture = fopen(argv[++i], "wb");
+            if(capture == nullptr){
+                perror("fopen");
+                return 1;
+            }
+        } else if(strcmp(argv[i], "-m") == 0 && i + 1 < argc){
+            const char* name { argv[++i] };
+            mode = strcmp(name, "irq") == 0 ? glove::IMU_IRQ : strcmp(name, "fifo") == 0 ? glove::IMU_FIFO :
+                   strcmp(name, "raw") == 0 ? glove::IMU_RAW : glove::IMU_POLL;
+        } else if(strcmp(argv[i], "-f") == 0 && i + 2 < argc){
+            filter = strcmp(argv[++i], "complementary") == 0 ? glove::FILTER_COMPLEMENTARY : glove::FILTER_MADGWICK;
+            gain   = strtof(argv[++i], nullptr);
+        } else if(strcmp(argv[i], "-a") == 0 && i + 2 < argc){
+            adcHz      = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+            oversample = static_cast<uint16_t>(strtoul(argv[++i], nullptr, 10));
+        } else if(strcmp(argv[i], "-g") == 0 && i + 3 < argc){
+            const char* name { argv[++i] };
+            fingerFilter = strcmp(name, "lowpass") == 0 ? glove::ADC_FILTER_LOWPASS : strcmp(name, "median") == 0 ?
+                           glove::ADC_FILTER_MEDIAN : strcmp(name, "euro") == 0 ? glove::ADC_FILTER_ONE_EURO : glove::ADC_FILTER_NONE;
+            cutoff       = strtof(argv[++i], nullptr);
+            beta         = strtof(argv[++i], nullptr);
+        } else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc){
+            const char* name { argv[++i] };
+            format = strcmp(name, "text") == 0 ? glove::Glove::TEXT : strcmp(name, "delta") == 0 ?
+                     glove::Glove::DELTA : strcmp(name, "session") == 0 ? glove::Glove::SESSION : glove::Glove::BINARY;
+        } else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc){
+            noise = static_cast<uint16_t>(strtoul(argv[++i], nullptr, 10));
+        } else if(strcmp(argv[i], "-d") == 0 && i + 1 < argc){
+            dump = fopen(argv[++i], "wb");
+            if(dump == nullptr){
+                perror("fopen");
+                return 1;
+            }
+        } else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc){
+            session = argv[++i];
+        } else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc){
+            store = argv[++i];
+        } else if(strcmp(argv[i], "-k") == 0 && i + 1 < argc){
+            const bool arms { strcmp(argv[++i], "arms") == 0 };
+            script    = arms ? ARMS_SCRIPT : FINGERS_SCRIPT;
+            scriptLen = arms ? sizeof(ARMS_SCRIPT) / sizeof(Press) : sizeof(FINGERS_SCRIPT) / sizeof(Press);
+        } else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc){
+            busHz = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if(argv[i][0] != '-'){
+            seconds = static_cast<uint32_t>(strtoul(argv[i], nullptr, 10));
+        } else {
+            fprintf(stderr, "Usage: %s [simulated_seconds] [-o capture_file] [-m poll|fifo|irq|raw] [-s i2c_hz]\n"
+                            "       [-c calibration_file] [-k fingers|arms] [-f complementary|madgwick gain]\n"
+                            "       [-r session_file] [-d dump_file] [-a adc_hz oversample]\n"
+                            "       [-g none|lowpass|median|euro cutoff beta] [-n adc_noise] [-t text|binary|delta|session]\n",
+                    argv[0]);
+            return strcmp(argv[i], "-h") == 0 ? 0 : 1;
+        }
+    }
+
+    glove::SimBoard  sim;
+    sim.link.setSink(capture);
+    sim.adc.setNoise(noise);
+    if(store != nullptr)
+        sim.store.load(store);
+
+    // Both would take the records of the tap.
+    if(session != nullptr && format == glove::Glove::SESSION){
+        fprintf(stderr, "Error: -r and -t session are exclusive\n");
+        return 1;
+    }
+
+    glove::SessionTap    tap{sim.board()};
+    glove::SessionWriter recorder;
+    glove::SessionRecord record;
+
+    const bool       tapped { session != nullptr || format == glove::Glove::SESSION };
+    glove::Glove     gl{tapped ? tap.board() : sim.board()};
+    if(format == glove::Glove::SESSION)
+        gl.setSessionTap(&tap);
+    if(!gl.setBusSpeed(busHz)){
+        fprintf(stderr, "Error: unsupported i2c speed %u\n", busHz);
+        return 1;
+    }
+    gl.setFusion(filter, gain);
+    gl.setOutputFormat(format);
+    gl.setFingerFilter(fingerFilter, cutoff, beta);
+    if(!gl.setFingerSampling(adcHz, oversample)){
+        fprintf(stderr, "Error: finger sampling at %u Hz x %u not available\n", adcHz, oversample);
+        return 1;
+    }
+    if(!gl.setImuMode(mode)){
+        fprintf(stderr, "Error: imu mode %u not available\n", mode);
+        return 1;
+    }
+    if(session != nullptr && !recorder.open(session, tap.header(mode))){
+        perror(session);
+        return 1;
+    }
+    glove::Scheduler<5> scheduler{sim.clock};
+    const uint32_t imuPeriod { mode == glove::IMU_IRQ ? IMU_IRQ_PERIOD_US :
+                               mode == glove::IMU_RAW ? IMU_RAW_PERIOD_US : IMU_PERIOD_US };
+
+    const int fingers { scheduler.addTask([](void* g){ static_cast<glove::Glove*>(g)->acquireFingers(); }, &gl, FINGERS_PERIOD_US) };
+    const int imus    { scheduler.addTask([](void* g){ static_cast<glove::Glove*>(g)->acquireImus();    }, &gl, imuPeriod) };
+    const int output  { scheduler.addTask([](void* g){ 
+                                              static_cast<glove::Glove*>(g)->publish();
+                                              static_cast<glove::Glove*>(g)->drain();
+                                          }, &gl, OUTPUT_PERIOD_US) };
+    const int display { scheduler.addTask([](void* g){ static_cast<glove::Glove*>(g)->refreshFingers(); }, &gl, DISPLAY_PERIOD_US) };
+    const int tasks[glove::RATE_TASKS] { fingers, imus, output, display };
+
+    gl.resetBusStats();
+    const uint32_t begin { sim.clock.nowUs() };
+    const uint32_t end   { begin + seconds * 1000000 };
+    const auto     start { std::chrono::steady_clock::now() };
+
+    size_t   nextPress     { 0 };
+    uint32_t calibFrames   { 0 },
+             calibStartMs  { 0 },
+             calibEndMs    { 0 },
+             lastFrames    { 0 };
+
+    while(static_cast<int32_t>(end - sim.clock.nowUs()) > 0){
+        const uint32_t nowMs { (sim.clock.nowUs() - begin) / 1000 };
+        for(; nextPress < scriptLen && script[nextPress].atMs <= nowMs; nextPress++)
+            sim.adc.setConstant(script[nextPress].pin, script[nextPress].value);
+
+        for(size_t task{0}; task<glove::RATE_TASKS; task++){
+            uint32_t periodUs;
+            if(gl.takeRate(static_cast<glove::RATE_TASK>(task), periodUs))
+                scheduler.setPeriod(tasks[task], periodUs);
+        }
+
+        const bool before { gl.isCalibrating() };
+        scheduler.runPending();
+        if(session != nullptr && tap.take(record) && !recorder.append(record)){
+            perror(session);
+            return 1;
+        }
+        sim.advanceUs(TICK_US);
+
+        if(gl.isCalibrating()){
+            if(!before)
+                calibStartMs = nowMs;
+            calibFrames += scheduler.stats(output).runs - lastFrames;
+        } else if(before) {
+            calibEndMs = nowMs;
+        }
+        lastFrames = scheduler.stats(output).runs;
+    }
+
+    const double   wallNs  { static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                 std::chrono::steady_clock::now() - start).count()) };
+    const uint32_t samples { scheduler.stats(imus).runs };
+    const uint32_t frames  { scheduler.stats(output).runs };
+
+    printf("simulated:      %u s\n",   seconds);
+    printf("finger reads:   %u (%u adc reads, %u conversions%s)\n", scheduler.stats(fingers).runs,
+           sim.adc.reads(), sim.adc.conversions(), gl.fingerSampling() ? ", continuous" : "");
+    printf("imu reads:      %u (%u packets, %u bus reads, %u mux switches)\n", samples, sim.imu.packets(),
+           sim.imu.reads(), sim.mux.switches());
+    for(size_t idx{0}; idx<3; idx++){
+        const glove::ImuStats& st { gl.imuStats(idx) };
+        printf("imu %zu:          %u packets, %u empty, %u missed, %u duplicates, %u spurious, max latency %u us\n",
+               idx, st.packets, st.empty, st.missed, st.duplicates, st.spurious, st.maxLatencyUs);
+    }
+    const glove::BusStats& bus       { gl.busStats() };
+    const uint32_t         elapsedUs { sim.clock.nowUs() - begin };
+    printf("i2c bus:        %u transactions, %u mux writes (%u skipped), %u errors, %u recoveries, "
+           "busy %.1f%%, longest %u us\n",
+           bus.transactions, bus.switches, bus.skippedSwitches, bus.errors, bus.recoveries,
+           elapsedUs ? 100.0 * bus.busyUs / elapsedUs : 0.0, bus.maxUs);
+    printf("frames:         %u, %llu bytes, %u writes on the link\n", frames,
+           static_cast<unsigned long long>(sim.link.bytes()), sim.link.writes());
+    if(format == glove::Glove::DELTA)
+        printf("delta stream:   %u full frames, %u deltas, %u outputs with nothing to send\n",
+               gl.deltaStats().keyframes(), gl.deltaStats().deltas(), gl.deltaStats().skipped());
+    printf("buttons:        %u events, %u dropped\n", gl.buttonStats().queued(), gl.buttonStats().dropped());
+    printf("display draws:  %u, %u flushes\n", sim.display.draws(), sim.display.flushes());
+    printf("cpu:            %.0f ns per output frame, %.0f ns per imu sample\n",
+           frames  ? wallNs / frames  : 0.0,
+           samples ? wallNs / samples : 0.0);
+
+    printf("calibration:    profile %u, %u imu self calibrations at boot, %u profile writes\n",
+           gl.calibrationUser(), sim.imu.calibrationRuns(), sim.store.puts());
+    if(script != nullptr)
+        printf("calibration:    %u ms to %u ms, %u frames sent meanwhile, output late by %u us at most\n",
+               calibStartMs, calibEndMs, calibFrames, scheduler.stats(output).maxLatenessUs);
+
+    // Wall time on this host: the ratios between the stages are what matters.
+    for(size_t idx{0}; idx<glove::STAGES; idx++){
+        const glove::StageSummary st { gl.profiler().summary(static_cast<glove::PROFILE_STAGE>(idx)) };
+        if(st.count > 0)
+            printf("stage %-14s %8u calls, ns min %u mean %u p99 %u max %u\n", glove::stageName(idx),
+                   st.count, st.minNs, st.meanNs, st.p99Ns, st.maxNs);
+    }
+
+    if(session != nullptr)
+        printf("session:        %u records, %u bytes\n", recorder.records(),
+               static_cast<uint32_t>(glove::SESSION_HEADER + recorder.records() * glove::SESSION_RECORD));
+
+    if(dump != nullptr){
+        // The schedule goes on while the dump trickles out on the serial port.
+        const uint32_t dumpStart  { sim.clock.nowUs() },
+                       dumpFrames { scheduler.stats(output).runs };
+        const uint64_t dumpBytes  { sim.console.bytes() };
+        const auto     step       { [&]{ scheduler.runPending(); sim.advanceUs(TICK_US); } };
+
+        sim.console.setSink(dump);
+        sim.console.feed(&glove::FLIGHT_DUMP_REQUEST, 1);
+        while(!gl.flightDumpActive())
+            step();
+        while(gl.flightDumpActive())
+            step();
+        sim.console.setSink(nullptr);
+
+        printf("flight dump:    %llu bytes in %u ms, %u frames sent meanwhile, output late by %u us at most\n",
+               static_cast<unsigned long long>(sim.console.bytes() - dumpBytes), (sim.clock.nowUs() - dumpStart) / 1000,
+               scheduler.stats(output).runs - dumpFrames, scheduler.stats(output).maxLatenessUs);
+        fclose(dump);
+    }
+
+    if(capture != nullptr)
+        fclose(capture);
+    if(session != nullptr && !recorder.close()){
+        perror(session);
+        return 1;
+    }
+    if(store != nullptr && !sim.store.save(store)){
+        perror(store);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+// -----------------------------------------------------------------
+// vr_glove - a VR glove made with common components and recycled stuff
+// Copyright (C) 2023  Gabriele Bonacini
+//
+// This program is distributed under dual license:
+// - Creative Comons Attribution-NonCommercial 4.0 International (CC BY-NC 4.0) License
+// for non commercial use, the license has the following terms:
+// * Attribution — You must give appropriate credit, provide a link to the license,
+// and indicate if changes were made. You may do so in any reasonable manner,
+// but not in any way that suggests the licensor endorses you or your use.
+// * NonCommercial — You must not use the material for commercial purposes.
+// * NonAI - You must not to use the material to instruct AI / Machine learning systems.
+// A copy of the license it's available to the following address:
+// http://creativecommons.org/licenses/by-nc/4.0/
+// For commercial use a specific license is available contacting the author.
+// -----------------------------------------------------------------
+
+// Host tool: reads the text output of the glove (include/text_protocol.h)
+// from a serial device, an RFCOMM device or a capture file (stdin if none)
+// and prints one line per frame, "S" lines for the status lines.
+//
+// Usage: glove_text [-b seconds] [device_or_file]
+//
+// -b loads the capture in memory and parses it over and over for 'seconds'
+// with the callback and the batch interface, then prints MB/s and frames/s.
+
+#include <text_protocol.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace {
+
+    void printSample(const glove::TextSample& sample, void*){
+        for(const float angle: sample.angles)
+            printf("%8.2f", angle);
+        for(const uint8_t finger: sample.fingers)
+            printf(" %3u", finger);
+        printf("\n");
+    }
+
+    void printStatus(const glove::TextStatus& status, void*){
+        printf("S");
+        for(const uint8_t finger: status.fingers)
+            printf(" %3u", finger);
+        printf(" %u%u%u\n", status.buttons & 1 ? 1 : 0, status.buttons & 2 ? 1 : 0, status.buttons & 4 ? 1 : 0);
+    }
+
+    void countSample(const glove::TextSample& sample, void* ctx){
+        *static_cast<uint64_t*>(ctx) += sample.fingers[0];
+    }
+
+    template<typename F>
+    double throughput(const uint8_t* data, size_t len, double seconds, F&& pass, uint64_t& frames){
+        const auto start  { std::chrono::steady_clock::now() };
+        double     spent  { 0.0 };
+        uint64_t   rounds { 0 };
+        frames = 0;
+        do{
+            frames += pass(data, len);
+            rounds++;
+            spent = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        } while(spent < seconds);
+        frames = static_cast<uint64_t>(frames / spent);
+        return rounds * len / spent / 1e6;
+    }
+
+} // End anonymous namespace
+
+int main(int argc, char** argv){
+    int         fd      { STDIN_FILENO };
+    const char* path    { nullptr };
+    double      seconds { 0.0 };
+
+    for(int i{1}; i<argc; i++){
+        if(strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+            seconds = strtod(argv[++i], nullptr);
+        else
+            path = argv[i];
+    }
+
+    if(path != nullptr){
+        fd = open(path, O_RDONLY | O_NOCTTY);
+        if(fd < 0){
+            perror("open");
+            return 1;
+        }
+        if(isatty(fd)){
+            termios tio{};
+            tcgetattr(fd, &tio);
+            cfmakeraw(&tio);
+            cfsetspeed(&tio, B115200);
+            tcsetattr(fd, TCSANOW, &tio);
+        }
+    }
+
+    glove::TextParser parser;
+    uint8_t           buffer[4096];
+    ssize_t           len;
+
+    if(seconds <= 0.0){
+        while((len = read(fd, buffer, sizeof(buffer))) > 0)
+            parser.feed(buffer, static_cast<size_t>(len), printSample, nullptr, printStatus);
+        fprintf(stderr, "frames: %u status lines: %u bad frames: %u dropped bytes: %llu\n", parser.frames(),
+                parser.statusLines(), parser.badFrames(), static_cast<unsigned long long>(parser.droppedBytes()));
+        return 0;
+    }
+
+    size_t   size     { 0 },
+             capacity { 1 << 20 };
+    uint8_t* capture  { static_cast<uint8_t*>(malloc(capacity)) };
+    while(capture != nullptr && (len = read(fd, capture + size, capacity - size)) > 0){
+        size += static_cast<size_t>(len);
+        if(size == capacity)
+            capture = static_cast<uint8_t*>(realloc(capture, capacity *= 2));
+    }
+    if(capture == nullptr || size == 0){
+        fprintf(stderr, "nothing to parse\n");
+        return 1;
+    }
+
+    uint64_t sink { 0 }, frames { 0 };
+    const double callbackMBs { throughput(capture, size, seconds, [&](const uint8_t* data, size_t bytes){
+        glove::TextParser pass;
+        pass.feed(data, bytes, countSample, &sink);
+        return pass.frames();
+    }, frames) };
+    printf("callback: %.1f MB/s, %.0f frames/s\n", callbackMBs, static_cast<double>(frames));
+
+    glove::TextSample batch[64];
+    const double batchMBs { throughput(capture, size, seconds, [&](const uint8_t* data, size_t bytes){
+        glove::TextParser pass;
+        size_t            used;
+        uint64_t          count { 0 };
+        while(bytes > 0){
+            const size_t got { pass.parse(data, bytes, batch, 64, used) };
+            for(size_t idx{0}; idx<got; idx++)
+                sink += batch[idx].fingers[0];
+            count += got;
+            data  += used;
+            bytes -= used;
+        }
+        return count;
+    }, frames) };
+    printf("batch:    %.1f MB/s, %.0f frames/s (%zu byte capture%s)\n", batchMBs, static_cast<double>(frames),
+           size, sink == 0 ? ", no fingers" : "");
+    return 0;
+}
@@ -17,16 +17,116 @@
 // -----------------------------------------------------------------
 
 
+#include <hal_esp32.h>
 #include <glove.h>
 
-glove::Glove* gl = nullptr;
+// Task periods in microseconds.
+const uint32_t FINGERS_PERIOD_US { 2000   };   // 500 Hz
+const uint32_t IMU_PERIOD_US     { 5000   };   // 200 Hz
+const uint32_t IMU_IRQ_PERIOD_US { 1000   };   // only reads the IMUs whose INT fired
+const uint32_t IMU_RAW_PERIOD_US { 1000   };   // one accel and gyro sample per IMU, 1 kHz
+const uint32_t OUTPUT_PERIOD_US  { 10000  };   // 100 Hz
+const uint32_t DISPLAY_PERIOD_US { 100000 };   //  10 Hz
+
+// Fingers converted by the ADC DMA (-DGLOVE_FINGER_DMA): readings per second,
+// conversions averaged in each, and the 1 Euro filter after.
+const uint32_t FINGER_ADC_HZ     { 1000   };
+const uint16_t FINGER_OVERSAMPLE { 8      };
+const float    FINGER_CUTOFF_HZ  { 5.0f   },
+               FINGER_BETA       { 0.01f  };
+
+// Acquisition runs on the application core, serialization, transport and
+// display on the protocol core, next to the Bluetooth stack.
+const BaseType_t ACQUISITION_CORE  { 1 },
+                 TRANSPORT_CORE    { 0 };
+const uint32_t   TASK_STACK        { 8192 };
+const UBaseType_t ACQUISITION_PRIO { 3 },
+                  TRANSPORT_PRIO   { 2 };
+
+glove::EspBoard*            esp = nullptr;
+glove::SessionTap*          tap = nullptr;
+glove::Glove*               gl = nullptr;
+glove::ArduinoClock         clk;
+glove::Scheduler<3>         acquisition{clk};
+glove::Scheduler<1>         display{clk};
+TaskHandle_t                transportTask = nullptr;
+int                         fingersTask, imusTask, outputTask, displayTask;
+
+// Periods asked by the host with CMD_SET_RATE, applied by the core running the task.
+template<size_t TASKS>
+void applyRate(glove::Scheduler<TASKS>& sched, int id, glove::RATE_TASK task) {
+    uint32_t periodUs;
+    if(gl->takeRate(task, periodUs))
+        sched.setPeriod(id, periodUs);
+}
+
+void acquisitionLoop(void*) {
+    while(true){
+        applyRate(acquisition, fingersTask, glove::RATE_FINGERS);
+        applyRate(acquisition, imusTask,    glove::RATE_IMUS);
+        applyRate(acquisition, outputTask,  glove::RATE_OUTPUT);
+        const uint32_t wait { acquisition.runPending() };
+        glove::StageProbe idle { gl->profiler(), glove::STAGE_IDLE };
+        clk.sleepUs(wait);
+    }
+}
+
+void transportLoop(void*) {
+    while(true){
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(display.untilNextUs() / 1000));
+        gl->drain();
+        applyRate(display, displayTask, glove::RATE_DISPLAY);
+        display.runPending();
+    }
+}
 
 void setup(void) {
-  gl = new glove::Glove();
+  esp = new glove::EspBoard();
+
+  // Build with -DGLOVE_SESSION_STREAM to record sessions from the host:
+  // "glove_ctl <port> format session" or glove_record switch the output to
+  // the session stream of session.h. The tap reads the fingers one at a time.
+#if defined(GLOVE_SESSION_STREAM)
+  tap = new glove::SessionTap(esp->board());
+  gl  = new glove::Glove(tap->board());
+  gl->setSessionTap(tap);
+#else
+  gl  = new glove::Glove(esp->board());
+#endif
+
+  // Build with -DGLOVE_IMU_IRQ when the MPU-6050 INT lines are wired (layout.h),
+  // with -DGLOVE_IMU_RAW to fuse accel and gyro here instead of in the DMPs.
+  uint32_t imuPeriod { IMU_PERIOD_US };
+#if defined(GLOVE_IMU_RAW)
+  if(gl->setImuMode(glove::IMU_RAW))
+    imuPeriod = IMU_RAW_PERIOD_US;
+#elif defined(GLOVE_IMU_IRQ)
+  if(gl->setImuMode(glove::IMU_IRQ))
+    imuPeriod = IMU_IRQ_PERIOD_US;
+#else
+  gl->setImuMode(glove::IMU_FIFO);
+#endif
+
+  // Build with -DGLOVE_FINGER_DMA to convert the fingers in the background
+  // and filter them; if the ADC can't, they are still read one at a time.
+#if defined(GLOVE_FINGER_DMA)
+  if(gl->setFingerSampling(FINGER_ADC_HZ, FINGER_OVERSAMPLE))
+    gl->setFingerFilter(glove::ADC_FILTER_ONE_EURO, FINGER_CUTOFF_HZ, FINGER_BETA);
+#endif
+
+  fingersTask = acquisition.addTask([](void* g){ static_cast<glove::Glove*>(g)->acquireFingers(); }, gl, FINGERS_PERIOD_US);
+  imusTask    = acquisition.addTask([](void* g){ static_cast<glove::Glove*>(g)->acquireImus();    }, gl, imuPeriod);
+  outputTask  = acquisition.addTask([](void* g){ 
+                                        static_cast<glove::Glove*>(g)->publish();
+                                        xTaskNotifyGive(transportTask);
+                                    }, gl, OUTPUT_PERIOD_US);
+  displayTask = display.addTask([](void* g){ static_cast<glove::Glove*>(g)->refreshFingers(); }, gl, DISPLAY_PERIOD_US);
+
+  xTaskCreatePinnedToCore(transportLoop,   "transport",   TASK_STACK, nullptr, TRANSPORT_PRIO,   &transportTask, TRANSPORT_CORE);
+  xTaskCreatePinnedToCore(acquisitionLoop, "acquisition", TASK_STACK, nullptr, ACQUISITION_PRIO, nullptr,        ACQUISITION_CORE);
 }
 
 void loop() {
-    gl->handleEvents();
-    gl->sendMsg();
-    delay(100);  
+    // All the work is done by the pinned tasks.
+    vTaskDelete(nullptr);
 }